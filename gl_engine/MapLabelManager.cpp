@@ -26,6 +26,8 @@
 
 #include "ShaderProgram.h"
 
+#include <limits>
+
 #include "radix/tile.h"
 
 #include <nucleus/srs.h>
@@ -40,7 +42,8 @@ MapLabelManager::MapLabelManager(QObject* parent)
     for (int i = 0; i < nucleus::vectortile::FeatureType::ENUM_END - 1; i++) {
         nucleus::vectortile::FeatureType type = (nucleus::vectortile::FeatureType)i;
         // initialize every type
-        m_gpu_tiles[type] = std::unordered_map<tile::Id, std::shared_ptr<GPUVectorTile>, tile::Id::Hasher>();
+        m_label_tiles[type] = std::unordered_map<tile::Id, LabelTile, tile::Id::Hasher>();
+        m_placed_instances[type] = {};
     }
 }
 
@@ -68,80 +71,84 @@ void MapLabelManager::init()
     m_index_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
     m_index_buffer->allocate(m_mapLabelFactory.indices.data(), m_mapLabelFactory.indices.size() * sizeof(unsigned int));
     m_indices_count = m_mapLabelFactory.indices.size();
+
+    QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
+    for (int i = 0; i < nucleus::vectortile::FeatureType::ENUM_END - 1; i++) {
+        nucleus::vectortile::FeatureType type = (nucleus::vectortile::FeatureType)i;
+        auto& buffer = m_instance_buffers[type];
+
+        buffer.vao = std::make_unique<QOpenGLVertexArrayObject>();
+        buffer.vao->create();
+        buffer.vao->bind();
+
+        { // vao state
+            m_index_buffer->bind();
+
+            buffer.vertex_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
+            buffer.vertex_buffer->create();
+            buffer.vertex_buffer->bind();
+            buffer.vertex_buffer->setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+            // vertex positions
+            f->glEnableVertexAttribArray(0);
+            f->glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), nullptr);
+            f->glVertexAttribDivisor(0, 1); // buffer is active for 1 instance (for the whole quad)
+            // uvs
+            f->glEnableVertexAttribArray(1);
+            f->glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)(sizeof(glm::vec4)));
+            f->glVertexAttribDivisor(1, 1); // buffer is active for 1 instance (for the whole quad)
+            // world position
+            f->glEnableVertexAttribArray(2);
+            f->glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)((sizeof(glm::vec4) * 2)));
+            f->glVertexAttribDivisor(2, 1); // buffer is active for 1 instance (for the whole quad)
+            // label importance
+            f->glEnableVertexAttribArray(3);
+            f->glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)((sizeof(glm::vec4) * 2 + (sizeof(glm::vec3)))));
+            f->glVertexAttribDivisor(3, 1); // buffer is active for 1 instance (for the whole quad)
+        }
+
+        buffer.vao->release();
+    }
 }
 
 void MapLabelManager::add_tile(const tile::Id& id, const nucleus::vectortile::FeatureType& type, const nucleus::vectortile::VectorTile& vector_tile)
 {
-    if (!QOpenGLContext::currentContext()) // can happen during shutdown.
-        return;
-
-    std::shared_ptr<GPUVectorTile> vectortile = std::make_shared<GPUVectorTile>();
-    vectortile->id = id;
-
-    vectortile->vao = std::make_unique<QOpenGLVertexArrayObject>();
-    vectortile->vao->create();
-    vectortile->vao->bind();
-
-    { // vao state
-
-        m_index_buffer->bind();
-
-        vectortile->vertex_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
-        vectortile->vertex_buffer->create();
-        vectortile->vertex_buffer->bind();
-        vectortile->vertex_buffer->setUsagePattern(QOpenGLBuffer::StaticDraw);
-
-        const auto features = vector_tile.at(type);
-        const auto allLabels = m_mapLabelFactory.create_labels(features);
-
-        vectortile->vertex_buffer->allocate(allLabels.data(), allLabels.size() * sizeof(nucleus::maplabel::VertexData));
-        vectortile->instance_count = allLabels.size();
-
-        QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
-
-        // vertex positions
-        f->glEnableVertexAttribArray(0);
-        f->glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), nullptr);
-        f->glVertexAttribDivisor(0, 1); // buffer is active for 1 instance (for the whole quad)
-        // uvs
-        f->glEnableVertexAttribArray(1);
-        f->glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)(sizeof(glm::vec4)));
-        f->glVertexAttribDivisor(1, 1); // buffer is active for 1 instance (for the whole quad)
-        // world position
-        f->glEnableVertexAttribArray(2);
-        f->glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)((sizeof(glm::vec4) * 2)));
-        f->glVertexAttribDivisor(2, 1); // buffer is active for 1 instance (for the whole quad)
-        // label importance
-        f->glEnableVertexAttribArray(3);
-        f->glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(nucleus::maplabel::VertexData), (GLvoid*)((sizeof(glm::vec4) * 2 + (sizeof(glm::vec3)))));
-        f->glVertexAttribDivisor(3, 1); // buffer is active for 1 instance (for the whole quad)
+    LabelTile label_tile;
+    if (vector_tile.contains(type)) {
+        for (const auto& feature : vector_tile.at(type)) {
+            const auto first_instance = uint32_t(label_tile.vertex_data.size());
+            // the shaders importance only scales and fades with distance, it stays 1 as before. the declutterer uses the features importance.
+            m_mapLabelFactory.create_label(feature->labelText(), feature->worldposition, 1.0, label_tile.vertex_data);
+            const auto instance_count = uint32_t(label_tile.vertex_data.size()) - first_instance;
+
+            auto extent_min = glm::vec2(std::numeric_limits<float>::max());
+            auto extent_max = glm::vec2(std::numeric_limits<float>::lowest());
+            for (auto i = first_instance; i < first_instance + instance_count; ++i) {
+                const auto& quad = label_tile.vertex_data[i].position;
+                extent_min = glm::min(extent_min, glm::min(glm::vec2(quad.x, quad.y), glm::vec2(quad.x, quad.y) + glm::vec2(quad.z, quad.w)));
+                extent_max = glm::max(extent_max, glm::max(glm::vec2(quad.x, quad.y), glm::vec2(quad.x, quad.y) + glm::vec2(quad.z, quad.w)));
+            }
+            label_tile.instances.emplace_back(first_instance, instance_count);
+            // the shader lifts the anchor by 5m
+            label_tile.labels.push_back({ feature->id, feature->worldposition + glm::dvec3(0, 0, 5), extent_min, extent_max, feature->importance() });
+        }
     }
-
-    vectortile->vao->release();
-
-    // add vector tile to gpu tiles
-    m_gpu_tiles.at(type)[id] = vectortile;
+    m_label_tiles.at(type)[id] = std::move(label_tile);
 }
 
 void MapLabelManager::remove_tile(const tile::Id& tile_id)
 {
-    if (!QOpenGLContext::currentContext()) // can happen during shutdown.
-        return;
-
     for (int i = 0; i < nucleus::vectortile::FeatureType::ENUM_END - 1; i++) {
         nucleus::vectortile::FeatureType type = (nucleus::vectortile::FeatureType)i;
-
-        // we can only remove something that exists
-        if (!m_gpu_tiles.contains(type) || !m_gpu_tiles.at(type).contains(tile_id))
-            continue;
-
-        if (m_gpu_tiles.at(type)[tile_id]->vao)
-            m_gpu_tiles.at(type)[tile_id]->vao->destroy(); // ecplicitly destroy vao
-
-        m_gpu_tiles.at(type).erase(tile_id);
+        m_label_tiles.at(type).erase(tile_id);
     }
 }
 
+void MapLabelManager::set_depth_tester(std::shared_ptr<const nucleus::camera::TerrainDepthTester> depth_tester)
+{
+    m_depth_tester = std::move(depth_tester);
+}
+
 void MapLabelManager::update_gpu_quads(
     const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads)
 {
@@ -156,7 +163,7 @@ void MapLabelManager::update_gpu_quads(
             for (int i = 0; i < nucleus::vectortile::FeatureType::ENUM_END - 1; i++) {
                 nucleus::vectortile::FeatureType type = (nucleus::vectortile::FeatureType)i;
 
-                if (m_gpu_tiles.at(type).contains(tile.id))
+                if (m_label_tiles.at(type).contains(tile.id))
                     continue; // no need to add it twice
 
                 add_tile(tile.id, type, *tile.vector_tile);
@@ -170,9 +177,59 @@ void MapLabelManager::update_gpu_quads(
     }
 }
 
+void MapLabelManager::declutter(const nucleus::camera::Definition& camera, const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles)
+{
+    // mirrors the distance scaling in labels.vert, quads are in label units and scaled by scale / 4 to pixels.
+    const auto label_scale = [](double dist_to_cam) {
+        constexpr double near_label = 100.0;
+        constexpr double far_label = 500000.0;
+        const auto dist_scale = 1.0 - ((dist_to_cam - near_label) / (far_label - near_label)) * 0.4;
+        return float(2.0 * dist_scale * dist_scale);
+    };
+
+    m_candidates.clear();
+    m_candidate_sources.clear();
+    for (int i = 0; i < nucleus::vectortile::FeatureType::ENUM_END - 1; i++) {
+        nucleus::vectortile::FeatureType type = (nucleus::vectortile::FeatureType)i;
+        for (const auto& [id, label_tile] : m_label_tiles.at(type)) {
+            if (!draw_tiles.contains(id))
+                continue;
+            for (uint32_t j = 0; j < label_tile.labels.size(); ++j) {
+                auto label = label_tile.labels[j];
+                const auto pixels_per_unit = label_scale(glm::distance(label.position, camera.position())) / 4.0f;
+                label.extent_min *= pixels_per_unit;
+                label.extent_max *= pixels_per_unit;
+                m_candidates.push_back(label);
+                m_candidate_sources.push_back({ type, &label_tile, j });
+            }
+        }
+    }
+
+    for (auto& [type, instances] : m_placed_instances)
+        instances.clear();
+    const auto camera_position = camera.position();
+    const auto is_visible = [&](const nucleus::maplabel::LabelDeclutterer::Label& label) {
+        if (!m_depth_tester)
+            return true;
+        const auto to_label = label.position - camera_position;
+        const auto distance = glm::length(to_label);
+        const auto terrain_distance = m_depth_tester->intersect(camera_position, to_label / distance);
+        // same tolerance as the depth test in labels.vert
+        return !terrain_distance || *terrain_distance > distance - 200.0;
+    };
+    for (const auto index : m_declutterer.place(m_candidates, camera, is_visible)) {
+        const auto& source = m_candidate_sources[index];
+        const auto [first_instance, instance_count] = source.tile->instances[source.label];
+        auto& instances = m_placed_instances.at(source.type);
+        instances.insert(instances.end(), source.tile->vertex_data.begin() + first_instance, source.tile->vertex_data.begin() + first_instance + instance_count);
+    }
+}
+
 void MapLabelManager::draw(Framebuffer* gbuffer, ShaderProgram* shader_program, const nucleus::camera::Definition& camera,
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tiles) const
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tiles)
 {
+    declutter(camera, draw_tiles);
+
     QOpenGLExtraFunctions* f = QOpenGLContext::currentContext()->extraFunctions();
 
     f->glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -194,21 +251,22 @@ void MapLabelManager::draw(Framebuffer* gbuffer, ShaderProgram* shader_program,
         shader_program->set_uniform("icon_sampler", 2);
         m_icon_texture.at(type)->bind(2);
 
-        for (const auto& vectortile : m_gpu_tiles.at(type)) {
-            // only draw if vector tile is fully loaded and is contained in draw_tiles
-            if (vectortile.second->instance_count > 0 && draw_tiles.contains(vectortile.first)) {
-                vectortile.second->vao->bind();
-
-                // if the labels wouldn't collide, we could use an extra buffer, one draw call and
-                // f->glBlendEquationSeparate(GL_MIN, GL_MAX);
-                shader_program->set_uniform("drawing_outline", true);
-                f->glDrawElementsInstanced(GL_TRIANGLES, m_indices_count, GL_UNSIGNED_INT, 0, vectortile.second->instance_count);
-                shader_program->set_uniform("drawing_outline", false);
-                f->glDrawElementsInstanced(GL_TRIANGLES, m_indices_count, GL_UNSIGNED_INT, 0, vectortile.second->instance_count);
+        const auto& instances = m_placed_instances.at(type);
+        if (instances.empty())
+            continue;
 
-                vectortile.second->vao->release();
-            }
-        }
+        auto& buffer = m_instance_buffers.at(type);
+        buffer.vertex_buffer->bind();
+        buffer.vertex_buffer->allocate(instances.data(), int(instances.size() * sizeof(nucleus::maplabel::VertexData)));
+        buffer.instance_count = instances.size();
+
+        buffer.vao->bind();
+        // placed labels don't overlap, but the outline of a character may overlap with its neighbours fill
+        shader_program->set_uniform("drawing_outline", true);
+        f->glDrawElementsInstanced(GL_TRIANGLES, m_indices_count, GL_UNSIGNED_INT, 0, buffer.instance_count);
+        shader_program->set_uniform("drawing_outline", false);
+        f->glDrawElementsInstanced(GL_TRIANGLES, m_indices_count, GL_UNSIGNED_INT, 0, buffer.instance_count);
+        buffer.vao->release();
     }
 }
 
@@ -26,6 +26,8 @@
 #include "Framebuffer.h"
 #include "Texture.h"
 #include "nucleus/camera/Definition.h"
+#include "nucleus/camera/TerrainDepthTester.h"
+#include "nucleus/map_label/LabelDeclutterer.h"
 #include "nucleus/map_label/LabelFactory.h"
 #include "nucleus/tile_scheduler/tile_types.h"
 
@@ -38,11 +40,17 @@ class Definition;
 namespace gl_engine {
 class ShaderProgram;
 
-struct GPUVectorTile {
-    tile::Id id;
+// labels of one tile and type are kept on the cpu, the decluttered ones are uploaded every frame
+struct LabelTile {
+    std::vector<nucleus::maplabel::VertexData> vertex_data; // one instance per character (+1 for icon)
+    std::vector<std::pair<uint32_t, uint32_t>> instances; // first instance and instance count of every label
+    std::vector<nucleus::maplabel::LabelDeclutterer::Label> labels; // extents in label units, they are scaled with distance per frame
+};
+
+struct LabelInstanceBuffer {
     std::unique_ptr<QOpenGLBuffer> vertex_buffer;
     std::unique_ptr<QOpenGLVertexArrayObject> vao;
-    size_t instance_count; // how many characters (+1 for icon)
+    size_t instance_count = 0;
 };
 
 class MapLabelManager : public QObject {
@@ -52,19 +60,35 @@ public:
 
     void init();
     void draw(Framebuffer* gbuffer, ShaderProgram* shader_program, const nucleus::camera::Definition& camera,
-        const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tiles) const;
+        const nucleus::tile_scheduler::DrawListGenerator::TileSet draw_tiles);
 
     void update_gpu_quads(const std::vector<nucleus::tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads);
 
     void remove_tile(const tile::Id& tile_id);
+    // labels hidden behind the terrain are dropped before they are placed, otherwise they take the space of visible ones
+    void set_depth_tester(std::shared_ptr<const nucleus::camera::TerrainDepthTester> depth_tester);
 
 private:
     void add_tile(const tile::Id& id, const nucleus::vectortile::FeatureType& type, const nucleus::vectortile::VectorTile& vector_tile);
+    void declutter(const nucleus::camera::Definition& camera, const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles);
 
     std::unique_ptr<Texture> m_font_texture;
     std::unordered_map<nucleus::vectortile::FeatureType, std::unique_ptr<Texture>> m_icon_texture;
 
-    std::unordered_map<nucleus::vectortile::FeatureType, std::unordered_map<tile::Id, std::shared_ptr<GPUVectorTile>, tile::Id::Hasher>> m_gpu_tiles;
+    std::unordered_map<nucleus::vectortile::FeatureType, std::unordered_map<tile::Id, LabelTile, tile::Id::Hasher>> m_label_tiles;
+    std::unordered_map<nucleus::vectortile::FeatureType, LabelInstanceBuffer> m_instance_buffers;
+
+    nucleus::maplabel::LabelDeclutterer m_declutterer;
+    std::shared_ptr<const nucleus::camera::TerrainDepthTester> m_depth_tester;
+    struct CandidateSource {
+        nucleus::vectortile::FeatureType type;
+        const LabelTile* tile;
+        uint32_t label;
+    };
+    // reused between frames
+    std::vector<nucleus::maplabel::LabelDeclutterer::Label> m_candidates;
+    std::vector<CandidateSource> m_candidate_sources;
+    std::unordered_map<nucleus::vectortile::FeatureType, std::vector<nucleus::maplabel::VertexData>> m_placed_instances;
 
     std::unique_ptr<QOpenGLBuffer> m_index_buffer;
     size_t m_indices_count; // how many vertices per character (most likely 6 since quads)
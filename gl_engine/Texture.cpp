@@ -19,6 +19,8 @@
 #include "Texture.h"
 #include "nucleus/utils/ColourTexture.h"
 
+#include <algorithm>
+
 #include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #ifdef __EMSCRIPTEN__
@@ -89,9 +91,6 @@ void gl_engine::Texture::setParams(Filter min_filter, Filter mag_filter)
     // doesn't make sense, does it?
     assert(mag_filter != Filter::MipMapLinear);
 
-    // add upload functionality for compressed mipmaps to support this
-    assert(m_format != Format::CompressedRGBA8 || min_filter != Filter::MipMapLinear);
-
     assert(gl_tex_params(m_format).is_texture_filterable || (min_filter == Filter::Nearest && mag_filter == Filter::Nearest));
 
     m_min_filter = min_filter;
@@ -117,6 +116,7 @@ void gl_engine::Texture::allocate_array(unsigned int width, unsigned int height,
     m_width = width;
     m_height = height;
     m_n_layers = n_layers;
+    m_n_mip_levels = unsigned(mip_level_count);
 
     auto* f = QOpenGLContext::currentContext()->extraFunctions();
     f->glBindTexture(GLenum(m_target), m_id);
@@ -128,15 +128,21 @@ void gl_engine::Texture::upload(const nucleus::utils::ColourTexture& texture)
     QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
     f->glBindTexture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    const auto width = GLsizei(texture.width());
-    const auto height = GLsizei(texture.height());
+    const auto n_levels = m_min_filter == Filter::MipMapLinear ? texture.n_mip_levels() : 1u;
     if (m_format == Format::CompressedRGBA8) {
-        assert(m_min_filter != Filter::MipMapLinear);
+        // compressed textures can't be mipmapped on the gpu, they have to bring their mip chain
+        assert(m_min_filter != Filter::MipMapLinear || texture.n_mip_levels() == nucleus::utils::ColourTexture::mip_chain_length({ texture.width(), texture.height() }));
         const auto format = gl_engine::Texture::compressed_texture_format();
-        f->glCompressedTexImage2D(GLenum(m_target), 0, format, width, height, 0, GLsizei(texture.n_bytes()), texture.data());
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glCompressedTexImage2D(GLenum(m_target), GLint(level), format, GLsizei(texture.width(level)), GLsizei(texture.height(level)), 0,
+                GLsizei(texture.n_bytes(level)), texture.data(level));
+        }
     } else if (m_format == Format::RGBA8) {
-        f->glTexImage2D(GLenum(m_target), 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-        if (m_min_filter == Filter::MipMapLinear)
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glTexImage2D(GLenum(m_target), GLint(level), GL_RGBA8, GLsizei(texture.width(level)), GLsizei(texture.height(level)), 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, texture.data(level));
+        }
+        if (m_min_filter == Filter::MipMapLinear && texture.n_mip_levels() == 1)
             f->glGenerateMipmap(GLenum(m_target));
     } else {
         assert(false);
@@ -152,15 +158,21 @@ void gl_engine::Texture::upload(const nucleus::utils::ColourTexture& texture, un
     auto* f = QOpenGLContext::currentContext()->extraFunctions();
     f->glBindTexture(GLenum(m_target), m_id);
     f->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    const auto width = GLsizei(texture.width());
-    const auto height = GLsizei(texture.height());
+    const auto n_levels = std::min(texture.n_mip_levels(), m_n_mip_levels);
     if (m_format == Format::CompressedRGBA8) {
-        assert(m_min_filter != Filter::MipMapLinear);
+        // compressed textures can't be mipmapped on the gpu, they have to bring their mip chain
+        assert(texture.n_mip_levels() >= m_n_mip_levels);
         const auto format = gl_engine::Texture::compressed_texture_format();
-        f->glCompressedTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, format, GLsizei(texture.n_bytes()), texture.data());
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glCompressedTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(array_index), GLsizei(texture.width(level)), GLsizei(texture.height(level)), 1,
+                format, GLsizei(texture.n_bytes(level)), texture.data(level));
+        }
     } else if (m_format == Format::RGBA8) {
-        f->glTexSubImage3D(GLenum(m_target), 0, 0, 0, GLint(array_index), width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, texture.data());
-        if (m_min_filter == Filter::MipMapLinear)
+        for (unsigned level = 0; level < n_levels; ++level) {
+            f->glTexSubImage3D(GLenum(m_target), GLint(level), 0, 0, GLint(array_index), GLsizei(texture.width(level)), GLsizei(texture.height(level)), 1, GL_RGBA,
+                GL_UNSIGNED_BYTE, texture.data(level));
+        }
+        if (n_levels < m_n_mip_levels)
             f->glGenerateMipmap(GLenum(m_target));
     } else {
         assert(false);
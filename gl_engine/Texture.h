@@ -71,6 +71,7 @@ private:
     unsigned m_width = unsigned(-1);
     unsigned m_height = unsigned(-1);
     unsigned m_n_layers = unsigned(-1);
+    unsigned m_n_mip_levels = 1;
 };
 
 extern template void gl_engine::Texture::upload<uint16_t>(const nucleus::Raster<uint16_t>&);
@@ -38,6 +38,7 @@
 TileManager::TileManager(QObject* parent)
     : QObject { parent }
 {
+    m_draw_list_generator.set_occlusion_culling_enabled(true);
 }
 
 void TileManager::init()
@@ -58,19 +59,19 @@ void TileManager::init()
     m_bounds_buffer->create();
     m_bounds_buffer->bind();
     m_bounds_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_bounds_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(glm::vec4)));
+    m_bounds_buffer->allocate(GLsizei(m_tile_slots.capacity() * sizeof(glm::vec4)));
 
     m_draw_tile_id_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
     m_draw_tile_id_buffer->create();
     m_draw_tile_id_buffer->bind();
     m_draw_tile_id_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_draw_tile_id_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(glm::u32vec2)));
+    m_draw_tile_id_buffer->allocate(GLsizei(m_tile_slots.capacity() * sizeof(glm::u32vec2)));
 
     m_height_texture_layer_buffer = std::make_unique<QOpenGLBuffer>(QOpenGLBuffer::VertexBuffer);
     m_height_texture_layer_buffer->create();
     m_height_texture_layer_buffer->bind();
     m_height_texture_layer_buffer->setUsagePattern(QOpenGLBuffer::DynamicDraw);
-    m_height_texture_layer_buffer->allocate(GLsizei(m_loaded_tiles.size() * sizeof(int32_t)));
+    m_height_texture_layer_buffer->allocate(GLsizei(m_tile_slots.capacity() * sizeof(int32_t)));
 
     m_vao = std::make_unique<QOpenGLVertexArrayObject>();
     m_vao->create();
@@ -79,13 +80,13 @@ void TileManager::init()
     m_vao->release();
 
     m_ortho_textures = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::CompressedRGBA8);
-    m_ortho_textures->setParams(Texture::Filter::Linear, Texture::Filter::Linear);
+    m_ortho_textures->setParams(Texture::Filter::MipMapLinear, Texture::Filter::Linear); // the scheduler delivers the mip chain
     // TODO: might become larger than GL_MAX_ARRAY_TEXTURE_LAYERS
-    m_ortho_textures->allocate_array(ORTHO_RESOLUTION, ORTHO_RESOLUTION, unsigned(m_loaded_tiles.size()));
+    m_ortho_textures->allocate_array(ORTHO_RESOLUTION, ORTHO_RESOLUTION, unsigned(m_tile_slots.capacity()));
 
     m_heightmap_textures = std::make_unique<Texture>(Texture::Target::_2dArray, Texture::Format::R16UI);
     m_heightmap_textures->setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
-    m_heightmap_textures->allocate_array(HEIGHTMAP_RESOLUTION, HEIGHTMAP_RESOLUTION, unsigned(m_loaded_tiles.size()));
+    m_heightmap_textures->allocate_array(HEIGHTMAP_RESOLUTION, HEIGHTMAP_RESOLUTION, unsigned(m_tile_slots.capacity()));
 
     m_tile_id_map_texture = std::make_unique<Texture>(Texture::Target::_2d, Texture::Format::RG32UI);
     m_tile_id_map_texture->setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
@@ -94,12 +95,12 @@ void TileManager::init()
     m_texture_id_map_texture->setParams(Texture::Filter::Nearest, Texture::Filter::Nearest);
 }
 
-const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::generate_tilelist(const nucleus::camera::Definition& camera) const {
+const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::generate_tilelist(const nucleus::camera::Definition& camera) {
     return m_draw_list_generator.generate_for(camera);
 }
 
-const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Frustum& frustum) const {
-    return m_draw_list_generator.cull(tileset, frustum);
+const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Definition& camera) const {
+    return m_draw_list_generator.cull(tileset, camera);
 }
 
 void TileManager::draw(ShaderProgram* shader_program, const nucleus::camera::Definition& camera,
@@ -169,16 +170,17 @@ void TileManager::remove_tile(const tile::Id& tile_id)
     if (!QOpenGLContext::currentContext()) // can happen during shutdown.
         return;
 
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile_id);
-    assert(t != m_loaded_tiles.end()); // removing a tile that's not here. likely there is a race.
-    *t = tile::Id { unsigned(-1), {} };
+    const auto layer_index = m_tile_slots.free(tile_id);
+    assert(layer_index.has_value()); // removing a tile that's not here. likely there is a race.
+    if (!layer_index.has_value())
+        return;
     m_draw_list_generator.remove_tile(tile_id);
 
-    // clear slot
-    // or remove from list and free resources
-    const auto found_tile = std::find_if(m_gpu_tiles.begin(), m_gpu_tiles.end(), [&tile_id](const TileInfo& tileset) { return tileset.tile_id == tile_id; });
-    if (found_tile != m_gpu_tiles.end())
-        m_gpu_tiles.erase(found_tile);
+    // move the last tile into the gap
+    const auto index = m_gpu_tile_index[*layer_index];
+    m_gpu_tiles[index] = m_gpu_tiles.back();
+    m_gpu_tile_index[m_gpu_tiles[index].height_texture_layer] = index;
+    m_gpu_tiles.pop_back();
 }
 
 void TileManager::initilise_attribute_locations(ShaderProgram* program)
@@ -219,8 +221,10 @@ void TileManager::set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbD
 
 void TileManager::set_quad_limit(unsigned int new_limit)
 {
-    m_loaded_tiles.resize(new_limit * 4);
-    std::fill(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
+    m_tile_slots = nucleus::utils::TileSlotAllocator(new_limit * 4);
+    m_gpu_tiles.clear();
+    m_gpu_tiles.reserve(new_limit * 4);
+    m_gpu_tile_index.assign(new_limit * 4, 0);
 }
 
 void TileManager::add_tile(
@@ -234,15 +238,17 @@ void TileManager::add_tile(
     tileinfo.bounds = tile::SrsBounds(bounds);
 
     // find empty spot and upload texture
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
-    assert(t != m_loaded_tiles.end());
-    *t = id;
-    const auto layer_index = unsigned(t - m_loaded_tiles.begin());
-    tileinfo.height_texture_layer = layer_index;
-    m_ortho_textures->upload(ortho_texture, layer_index);
-    m_heightmap_textures->upload(height_map, layer_index);
+    assert(!m_tile_slots.contains(id));
+    const auto layer_index = m_tile_slots.allocate(id);
+    assert(layer_index.has_value());
+    if (!layer_index.has_value())
+        return;
+    tileinfo.height_texture_layer = *layer_index;
+    m_ortho_textures->upload(ortho_texture, *layer_index);
+    m_heightmap_textures->upload(height_map, *layer_index);
 
     // add to m_gpu_tiles
+    m_gpu_tile_index[*layer_index] = m_gpu_tiles.size();
     m_gpu_tiles.push_back(tileinfo);
     m_draw_list_generator.add_tile(id);
 }
@@ -29,6 +29,7 @@
 #include "gl_engine/Texture.h"
 #include <nucleus/tile_scheduler/DrawListGenerator.h>
 #include <nucleus/tile_scheduler/tile_types.h>
+#include <nucleus/utils/SlotAllocator.h>
 
 namespace camera {
 class Definition;
@@ -54,8 +55,8 @@ public:
     void init(); // needs OpenGL context
     void draw(ShaderProgram* shader_program, const nucleus::camera::Definition& camera, const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles, bool sort_tiles, glm::dvec3 sort_position) const;
 
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet generate_tilelist(const nucleus::camera::Definition& camera) const;
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Frustum& frustum) const;
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet generate_tilelist(const nucleus::camera::Definition& camera);
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Definition& camera) const;
 
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
 
@@ -74,7 +75,7 @@ private:
     static constexpr auto ORTHO_RESOLUTION = 256;
     static constexpr auto HEIGHTMAP_RESOLUTION = 65;
 
-    std::vector<tile::Id> m_loaded_tiles;
+    nucleus::utils::TileSlotAllocator m_tile_slots; // slots are texture layers
     std::unique_ptr<Texture> m_ortho_textures;
     std::unique_ptr<Texture> m_heightmap_textures;
     std::unique_ptr<Texture> m_tile_id_map_texture;
@@ -85,7 +86,8 @@ private:
     std::unique_ptr<QOpenGLBuffer> m_draw_tile_id_buffer;
     std::unique_ptr<QOpenGLBuffer> m_height_texture_layer_buffer;
 
-    std::vector<TileInfo> m_gpu_tiles;
+    std::vector<TileInfo> m_gpu_tiles; // dense, in no particular order
+    std::vector<size_t> m_gpu_tile_index; // texture layer -> index in m_gpu_tiles
     unsigned m_tiles_per_set = 1;
     nucleus::tile_scheduler::DrawListGenerator m_draw_list_generator;
     const nucleus::tile_scheduler::DrawListGenerator::TileSet m_last_draw_list; // buffer last generated draw list
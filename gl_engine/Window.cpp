@@ -272,7 +272,7 @@ void Window::paint(QOpenGLFramebufferObject* framebuffer)
 
     shader_manager->tile_shader()->bind();
     m_timer->start_timer("tiles");
-    auto culled_tile_set = m_tile_manager->cull(tile_set, m_camera.frustum());
+    auto culled_tile_set = m_tile_manager->cull(tile_set, m_camera);
     m_tile_manager->draw(shader_manager->tile_shader(), m_camera, culled_tile_set, true, m_camera.position());
     m_timer->stop_timer("tiles");
     shader_manager->tile_shader()->release();
@@ -454,6 +454,14 @@ void Window::set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecora
     m_tile_manager->set_aabb_decorator(new_aabb_decorator);
 }
 
+void Window::set_terrain_depth_tester([[maybe_unused]] const std::shared_ptr<const nucleus::camera::TerrainDepthTester>& depth_tester)
+{
+#ifdef ALP_ENABLE_LABELS
+    if (m_map_label_manager)
+        m_map_label_manager->set_depth_tester(depth_tester);
+#endif
+}
+
 nucleus::camera::AbstractDepthTester* Window::depth_tester() { return this; }
 
 nucleus::utils::ColourTexture::Format Window::ortho_tile_compression_algorithm() const { return Texture::compression_algorithm(); }
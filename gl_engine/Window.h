@@ -69,6 +69,7 @@ public:
     [[nodiscard]] glm::dvec3 position(const glm::dvec2& normalised_device_coordinates) override;
     void destroy() override;
     void set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbDecoratorPtr&) override;
+    void set_terrain_depth_tester(const std::shared_ptr<const nucleus::camera::TerrainDepthTester>&) override;
     [[nodiscard]] nucleus::camera::AbstractDepthTester* depth_tester() override;
     [[nodiscard]] nucleus::utils::ColourTexture::Format ortho_tile_compression_algorithm() const override;
     void updateCameraEvent();
@@ -41,6 +41,7 @@ namespace tile_scheduler::utils {
 namespace camera {
     class Definition;
     class AbstractDepthTester;
+    class TerrainDepthTester;
 }
 
 class AbstractRenderWindow : public QObject {
@@ -59,6 +60,8 @@ public slots:
     virtual void update_camera(const camera::Definition& new_definition) = 0;
     virtual void update_debug_scheduler_stats(const QString& stats) = 0;
     virtual void set_aabb_decorator(const tile_scheduler::utils::AabbDecoratorPtr&) = 0;
+    // cpu ray casts against the ram cache, e.g., to hide labels behind the terrain before they are placed
+    virtual void set_terrain_depth_tester(const std::shared_ptr<const camera::TerrainDepthTester>&) = 0;
     virtual void update_gpu_quads(const std::vector<tile_scheduler::tile_types::GpuTileQuad>& new_quads, const std::vector<tile::Id>& deleted_quads) = 0;
 
 signals:
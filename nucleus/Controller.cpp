@@ -29,6 +29,7 @@
 #include "AbstractRenderWindow.h"
 #include "nucleus/camera/Controller.h"
 #include "nucleus/camera/PositionStorage.h"
+#include "nucleus/camera/TerrainDepthTester.h"
 #include "nucleus/tile_scheduler/LayerAssembler.h"
 #include "nucleus/tile_scheduler/QuadAssembler.h"
 #include "nucleus/tile_scheduler/RateLimiter.h"
@@ -39,6 +40,10 @@
 #include "nucleus/utils/thread.h"
 #include "radix/TileHeights.h"
 
+#ifdef ALP_ENABLE_LABELS
+#include "nucleus/vector_tiles/VectorTileManager.h"
+#endif
+
 using namespace nucleus::tile_scheduler;
 
 namespace nucleus {
@@ -61,9 +66,11 @@ Controller::Controller(AbstractRenderWindow* render_window)
 #ifdef ALP_ENABLE_LABELS
     m_vectortile_service = std::make_unique<TileLoadService>(
         "http://localhost:8080/austria.peaks/", nucleus::tile_scheduler::TileLoadService::UrlPattern::ZXY_yPointingSouth, ".mvt");
+    m_vectortile_service->set_meta_data({ .min_zoom = 0, .max_zoom = unsigned(nucleus::vectortile::VectorTileManager::max_zoom) });
 #endif
     m_tile_scheduler = std::make_unique<nucleus::tile_scheduler::Scheduler>();
     m_tile_scheduler->read_disk_cache();
+    m_tile_scheduler->read_offline_cache();
     m_render_window->set_quad_limit(512); // must be same as scheduler, dynamic resizing is not supported atm
     m_tile_scheduler->set_gpu_quad_limit(512);
     m_tile_scheduler->set_ram_quad_limit(12000);
@@ -75,26 +82,42 @@ Controller::Controller(AbstractRenderWindow* render_window)
         const QByteArray data = file.readAll();
         const auto decorator = nucleus::tile_scheduler::utils::AabbDecorator::make(TileHeights::deserialise(data));
         m_tile_scheduler->set_aabb_decorator(decorator);
+        m_tile_scheduler->set_occlusion_culling_enabled(true);
         m_render_window->set_aabb_decorator(decorator);
     }
     m_data_querier = std::make_shared<DataQuerier>(&m_tile_scheduler->ram_cache());
     m_tile_scheduler->set_dataquerier(m_data_querier);
+    // picking on the cpu, reading back the depth buffer stalls the gpu (m_render_window->depth_tester() still works)
+    m_depth_tester = std::make_shared<nucleus::camera::TerrainDepthTester>(&m_tile_scheduler->ram_cache());
+    m_render_window->set_terrain_depth_tester(m_depth_tester);
     m_camera_controller = std::make_unique<nucleus::camera::Controller>(
-        nucleus::camera::PositionStorage::instance()->get("grossglockner"), m_render_window->depth_tester(), m_data_querier.get());
+        nucleus::camera::PositionStorage::instance()->get("grossglockner"), m_depth_tester.get(), m_data_querier.get());
+    m_depth_tester->set_camera(m_camera_controller->definition());
     {
         auto* sch = m_tile_scheduler.get();
         SlotLimiter* sl = new SlotLimiter(sch);
         RateLimiter* rl = new RateLimiter(sch);
         QuadAssembler* qa = new QuadAssembler(sch);
         LayerAssembler* la = new LayerAssembler(sch);
+        sl->set_limit_range(4, 64);
+        sl->set_adaptive(true);
+        rl->set_policy(RateLimiter::Policy::TokenBucket);
+        rl->set_burst(32);
+        qa->set_timeout(8000);
         connect(sch, &Scheduler::quads_requested, sl, &SlotLimiter::request_quads);
         connect(sl, &SlotLimiter::quad_requested, rl, &RateLimiter::request_quad);
         connect(rl, &RateLimiter::quad_requested, qa, &QuadAssembler::load);
+        la->set_ortho_meta_data(m_ortho_service->meta_data());
+        la->set_height_meta_data(m_terrain_service->meta_data());
+        la->set_height_transcoding_enabled(true);
+#ifdef ALP_ENABLE_LABELS
+        la->set_vectortile_meta_data(m_vectortile_service->meta_data());
+#endif
         connect(qa, &QuadAssembler::tile_requested, la, &LayerAssembler::load);
-        connect(la, &LayerAssembler::tile_requested, m_ortho_service.get(), &TileLoadService::load);
-        connect(la, &LayerAssembler::tile_requested, m_terrain_service.get(), &TileLoadService::load);
+        connect(la, &LayerAssembler::ortho_requested, m_ortho_service.get(), &TileLoadService::load);
+        connect(la, &LayerAssembler::height_requested, m_terrain_service.get(), &TileLoadService::load);
 #ifdef ALP_ENABLE_LABELS
-        connect(la, &LayerAssembler::tile_requested, m_vectortile_service.get(), &TileLoadService::load);
+        connect(la, &LayerAssembler::vectortile_requested, m_vectortile_service.get(), &TileLoadService::load);
 #endif
         connect(m_ortho_service.get(), &TileLoadService::load_finished, la, &LayerAssembler::deliver_ortho);
         connect(m_terrain_service.get(), &TileLoadService::load_finished, la, &LayerAssembler::deliver_height);
@@ -138,6 +161,9 @@ Controller::Controller(AbstractRenderWindow* render_window)
     // this only works if ALP_ENABLE_THREADING is on, i.e., the tile scheduler is on an extra thread. -> potential issue on webassembly
     connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, m_tile_scheduler.get(), &Scheduler::update_camera);
     connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, m_render_window, &AbstractRenderWindow::update_camera);
+    connect(m_camera_controller.get(), &nucleus::camera::Controller::definition_changed, this, [this](const camera::Definition& definition) {
+        m_depth_tester->set_camera(definition);
+    });
 
     connect(m_tile_scheduler.get(), &Scheduler::gpu_quads_updated, m_render_window, &AbstractRenderWindow::update_gpu_quads);
     // TODO signal connected to signal? maybe bug/unnecessary?
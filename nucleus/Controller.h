@@ -31,6 +31,7 @@ class Scheduler;
 }
 namespace camera {
 class Controller;
+class TerrainDepthTester;
 }
 
 class Controller : public QObject {
@@ -54,6 +55,7 @@ private:
 #endif
     std::unique_ptr<tile_scheduler::Scheduler> m_tile_scheduler;
     std::shared_ptr<DataQuerier> m_data_querier;
+    std::shared_ptr<camera::TerrainDepthTester> m_depth_tester;
     std::unique_ptr<camera::Controller> m_camera_controller;
 
 #ifdef ALP_ENABLE_THREADING
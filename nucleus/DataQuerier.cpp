@@ -17,13 +17,90 @@
  *****************************************************************************/
 
 #include "DataQuerier.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <unordered_map>
+
 #include "tile_scheduler/cache_quieries.h"
+#include "utils/TileIdMap.h"
+#include "utils/WorkerPool.h"
+#include "utils/image_loader.h"
 
 nucleus::DataQuerier::DataQuerier(tile_scheduler::MemoryCache* cache)
     : m_memory_cache(cache)
+    , m_decoded_heights(decoded_height_cache_capacity)
 {}
 
 float nucleus::DataQuerier::get_altitude(const glm::dvec2& lat_long) const
 {
-    return tile_scheduler::cache_queries::query_altitude(m_memory_cache, lat_long);
+    const auto world_position = srs::lat_long_to_world(lat_long);
+    const auto height_tile = tile_scheduler::cache_queries::find_height_tile(*m_memory_cache, world_position);
+    if (!height_tile)
+        return tile_scheduler::cache_queries::default_altitude;
+    return tile_scheduler::cache_queries::sample_altitude(*decoded_heights(height_tile->data), height_tile->id, world_position);
+}
+
+void nucleus::DataQuerier::get_altitudes(std::span<const glm::dvec2> lat_longs, std::span<float> altitudes, Execution execution) const
+{
+    assert(lat_longs.size() == altitudes.size());
+    std::vector<glm::dvec2> world_positions;
+    world_positions.reserve(lat_longs.size());
+    std::transform(lat_longs.begin(), lat_longs.end(), std::back_inserter(world_positions), [](const glm::dvec2& lat_long) {
+        return srs::lat_long_to_world(lat_long);
+    });
+    get_world_altitudes(world_positions, altitudes, execution);
+}
+
+std::vector<float> nucleus::DataQuerier::get_altitudes(std::span<const glm::dvec2> lat_longs, Execution execution) const
+{
+    std::vector<float> altitudes(lat_longs.size());
+    get_altitudes(lat_longs, altitudes, execution);
+    return altitudes;
+}
+
+void nucleus::DataQuerier::get_world_altitudes(std::span<const glm::dvec2> world_positions, std::span<float> altitudes, Execution execution) const
+{
+    assert(world_positions.size() == altitudes.size());
+    if (execution == Execution::Serial || world_positions.size() <= batch_chunk_size)
+        return get_world_altitudes_serial(world_positions, altitudes);
+
+    const auto n_chunks = unsigned((world_positions.size() + batch_chunk_size - 1) / batch_chunk_size);
+    utils::WorkerPool::shared().parallel_for(n_chunks, [&](unsigned chunk) {
+        const auto begin = size_t(chunk) * batch_chunk_size;
+        const auto size = std::min(batch_chunk_size, world_positions.size() - begin);
+        get_world_altitudes_serial(world_positions.subspan(begin, size), altitudes.subspan(begin, size));
+    });
+}
+
+void nucleus::DataQuerier::get_world_altitudes_serial(std::span<const glm::dvec2> world_positions, std::span<float> altitudes) const
+{
+    using namespace tile_scheduler;
+    // neighbouring positions share quads and height tiles. lookups (including misses) and decoded rasters are kept for the whole batch,
+    // so the memory cache lock and the decoded height cache are hit once per tile instead of once per position.
+    utils::TileIdMap<std::optional<tile_types::TileQuad>> quads;
+    const auto find_quad = [&](const tile::Id& quad_id) -> const std::optional<tile_types::TileQuad>& {
+        if (const auto iter = quads.find(quad_id); iter != quads.end())
+            return iter->second;
+        return quads[quad_id] = m_memory_cache->find(quad_id);
+    };
+    std::unordered_map<const QByteArray*, std::shared_ptr<const Raster<uint16_t>>> rasters;
+
+    for (size_t i = 0; i < world_positions.size(); ++i) {
+        const auto height_tile = cache_queries::find_height_tile(world_positions[i], find_quad);
+        if (!height_tile) {
+            altitudes[i] = cache_queries::default_altitude;
+            continue;
+        }
+        auto& raster = rasters[height_tile->data.get()];
+        if (!raster)
+            raster = decoded_heights(height_tile->data);
+        altitudes[i] = cache_queries::sample_altitude(*raster, height_tile->id, world_positions[i]);
+    }
+}
+
+std::shared_ptr<const nucleus::Raster<uint16_t>> nucleus::DataQuerier::decoded_heights(const std::shared_ptr<QByteArray>& data) const
+{
+    return m_decoded_heights.get(data, [](const QByteArray& bytes) { return utils::image_loader::height(bytes); });
 }
@@ -18,18 +18,43 @@
 
 #pragma once
 
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "Raster.h"
 #include "tile_scheduler/Cache.h"
+#include "utils/DecodedTileCache.h"
 
 namespace nucleus {
 
 class DataQuerier
 {
     tile_scheduler::MemoryCache* m_memory_cache = nullptr;
+    mutable utils::DecodedTileCache<Raster<uint16_t>> m_decoded_heights;
 
 public:
+    static constexpr size_t decoded_height_cache_capacity = 64; // 65x65 tiles, about 0.5 MiB
+    static constexpr size_t batch_chunk_size = 4096; // positions per task in parallel batch queries
+
+    enum class Execution { Serial, Parallel };
+
     DataQuerier(tile_scheduler::MemoryCache* cache);
 
+    /// bilinearly interpolated altitude of the finest cached height tile. thread safe.
     [[nodiscard]] float get_altitude(const glm::dvec2& lat_long) const;
+
+    /// same results as get_altitude, but for many positions (tracks, labels of a vector tile, ..). every quad is looked up
+    /// once and every height tile decoded once per batch. Parallel splits large inputs into chunks on the shared worker pool.
+    /// altitudes.size() must equal lat_longs.size(). thread safe.
+    void get_altitudes(std::span<const glm::dvec2> lat_longs, std::span<float> altitudes, Execution execution = Execution::Serial) const;
+    [[nodiscard]] std::vector<float> get_altitudes(std::span<const glm::dvec2> lat_longs, Execution execution = Execution::Serial) const;
+    /// as above, but takes world (web mercator) positions.
+    void get_world_altitudes(std::span<const glm::dvec2> world_positions, std::span<float> altitudes, Execution execution = Execution::Serial) const;
+
+private:
+    std::shared_ptr<const Raster<uint16_t>> decoded_heights(const std::shared_ptr<QByteArray>& data) const;
+    void get_world_altitudes_serial(std::span<const glm::dvec2> world_positions, std::span<float> altitudes) const;
 };
 
 } // namespace nucleus
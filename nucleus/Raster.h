@@ -25,6 +25,8 @@
 
 #include <glm/glm.hpp>
 
+#include "nucleus/utils/BufferPool.h"
+
 #ifdef QT_GUI_LIB
 // Qt GUI module is available
 #include <QtGui/QImage>
@@ -33,15 +35,16 @@
 
 namespace nucleus {
 
+// pixels are stored in tile sized blocks from utils::BufferPool::shared(), so streaming tiles reuses memory.
 template <typename T>
 class Raster {
-    std::vector<T> m_data;
+    utils::PooledVector<T> m_data;
     size_t m_width = 0;
     size_t m_height = 0;
 
 public:
     Raster() = default;
-    Raster(size_t square_side_length, std::vector<T>&& vector)
+    Raster(size_t square_side_length, utils::PooledVector<T>&& vector)
         : m_data(std::move(vector))
         , m_width(square_side_length)
         , m_height(square_side_length)
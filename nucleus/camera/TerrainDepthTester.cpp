@@ -0,0 +1,249 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "TerrainDepthTester.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/cache_quieries.h"
+#include "nucleus/utils/TileIdMap.h"
+#include "nucleus/utils/image_loader.h"
+
+using namespace nucleus::camera;
+using nucleus::tile_scheduler::tile_types::TileQuad;
+namespace cache_queries = nucleus::tile_scheduler::cache_queries;
+
+namespace {
+constexpr double max_altitude = 65535 * cache_queries::height_scale; // largest value of the uint16 height format
+constexpr double boundary_step = 0.001; // metres, moves the ray into the next tile
+constexpr unsigned uncovered_zoom_level = 8; // step size where not even the zoom 0 quad is cached
+
+// world z is altitude / cos(latitude), see srs::lat_long_alt_to_world
+double altitude_scale(double world_y)
+{
+    const auto latitude = nucleus::srs::world_to_lat_long({ 0.0, world_y }).x;
+    return 1.0 / std::abs(std::cos(glm::radians(latitude)));
+}
+
+// min and max of altitude_scale between two y coordinates (the smallest scale is at the equator)
+glm::dvec2 altitude_scale_range(double y0, double y1)
+{
+    const auto a = altitude_scale(y0);
+    const auto b = altitude_scale(y1);
+    if ((y0 < 0) != (y1 < 0))
+        return { 1.0, std::max(a, b) };
+    return { std::min(a, b), std::max(a, b) };
+}
+
+// ray parameters of entering and leaving an axis aligned rectangle (empty if x > y)
+glm::dvec2 slab_interval(const glm::dvec2& min, const glm::dvec2& max, const glm::dvec3& origin, const glm::dvec3& direction)
+{
+    auto interval = glm::dvec2(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity());
+    for (unsigned i = 0; i < 2; ++i) {
+        if (direction[i] == 0) {
+            if (origin[i] < min[i] || origin[i] > max[i])
+                return { 1, 0 };
+            continue;
+        }
+        auto t0 = (min[i] - origin[i]) / direction[i];
+        auto t1 = (max[i] - origin[i]) / direction[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        interval = { std::max(interval.x, t0), std::min(interval.y, t1) };
+    }
+    return interval;
+}
+
+class TileRayCaster {
+public:
+    TileRayCaster(const nucleus::utils::HeightPyramid& pyramid, const tile::SrsBounds& bounds, const glm::dvec3& origin, const glm::dvec3& direction)
+        : m_pyramid(pyramid)
+        , m_bounds(bounds)
+        , m_cell_size(bounds.size() / glm::dvec2(pyramid.n_cells()))
+        , m_origin(origin)
+        , m_direction(direction)
+    {
+    }
+
+    std::optional<double> intersect(double t_min, double t_max) const { return intersect(m_pyramid.n_levels() - 1, { 0, 0 }, t_min, t_max); }
+
+private:
+    // node covers the cells [first, last) of level 0. rows go from north to south.
+    std::optional<double> intersect(unsigned level, const glm::uvec2& node, double t_min, double t_max) const
+    {
+        const auto first = node << level;
+        const auto last = glm::min((node + 1u) << level, m_pyramid.n_cells());
+        const auto rect_min = glm::dvec2(m_bounds.min.x + first.x * m_cell_size.x, m_bounds.max.y - last.y * m_cell_size.y);
+        const auto rect_max = glm::dvec2(m_bounds.min.x + last.x * m_cell_size.x, m_bounds.max.y - first.y * m_cell_size.y);
+        const auto interval = slab_interval(rect_min, rect_max, m_origin, m_direction);
+        const auto t0 = std::max(interval.x, t_min);
+        const auto t1 = std::min(interval.y, t_max);
+        if (t0 > t1)
+            return {};
+
+        const auto ray_z = glm::dvec2(m_origin.z + m_direction.z * t0, m_origin.z + m_direction.z * t1);
+        const auto scale = altitude_scale_range(rect_min.y, rect_max.y);
+        const auto min_max = m_pyramid.level(level).pixel(node);
+        if (std::min(ray_z.x, ray_z.y) > min_max.y * cache_queries::height_scale * scale.y)
+            return {}; // above
+        if (std::max(ray_z.x, ray_z.y) < min_max.x * cache_queries::height_scale * scale.x)
+            return t0; // entered below the terrain, e.g., the origin is underground
+
+        if (level == 0)
+            return intersect_cell(node, rect_min, rect_max, t0, t1);
+
+        // front to back: the child at the entry first and the diagonal one last, a ray can't cross both others
+        const auto n_children = m_pyramid.level(level - 1).size();
+        const auto near = glm::uvec2(m_direction.x < 0 ? 1 : 0, m_direction.y > 0 ? 1 : 0); // rows go south
+        for (unsigned j = 0; j < 2; ++j) {
+            for (unsigned i = 0; i < 2; ++i) {
+                const auto child = node * 2u + glm::uvec2(i ^ near.x, j ^ near.y);
+                if (child.x >= n_children.x || child.y >= n_children.y)
+                    continue;
+                if (const auto hit = intersect(level - 1, child, t0, t1))
+                    return hit;
+            }
+        }
+        return {};
+    }
+
+    // the surface is bilinear in the cell, along the ray that's a quadratic in t.
+    std::optional<double> intersect_cell(const glm::uvec2& cell, const glm::dvec2& rect_min, const glm::dvec2& rect_max, double t0, double t1) const
+    {
+        const auto& heights = m_pyramid.heights();
+        const auto scale = cache_queries::height_scale * altitude_scale(0.5 * (rect_min.y + rect_max.y));
+        const auto h00 = heights.pixel(cell) * scale;
+        const auto h10 = heights.pixel(cell + glm::uvec2(1, 0)) * scale;
+        const auto h01 = heights.pixel(cell + glm::uvec2(0, 1)) * scale;
+        const auto h11 = heights.pixel(cell + glm::uvec2(1, 1)) * scale;
+        const auto b = h10 - h00;
+        const auto c = h01 - h00;
+        const auto e = h00 - h10 - h01 + h11;
+
+        // local coordinates, u to the east and v to the south, relative to t0
+        const auto origin = m_origin + m_direction * t0;
+        const auto u0 = (origin.x - rect_min.x) / m_cell_size.x;
+        const auto v0 = (rect_max.y - origin.y) / m_cell_size.y;
+        const auto du = m_direction.x / m_cell_size.x;
+        const auto dv = -m_direction.y / m_cell_size.y;
+
+        // f(t) = ray z - surface z = A t^2 + B t + C
+        const auto A = -e * du * dv;
+        const auto B = m_direction.z - (b * du + c * dv + e * (u0 * dv + v0 * du));
+        const auto C = origin.z - (h00 + b * u0 + c * v0 + e * u0 * v0);
+        if (C <= 0)
+            return t0;
+        const auto discriminant = B * B - 4 * A * C;
+        if (discriminant < 0)
+            return {};
+        const auto q = -0.5 * (B + std::copysign(std::sqrt(discriminant), B));
+        if (q == 0)
+            return {};
+        auto best = std::numeric_limits<double>::infinity();
+        for (const auto root : { C / q, A != 0 ? q / A : -1.0 }) {
+            if (root >= 0 && root <= t1 - t0)
+                best = std::min(best, root);
+        }
+        if (best == std::numeric_limits<double>::infinity())
+            return {};
+        return t0 + best;
+    }
+
+    const nucleus::utils::HeightPyramid& m_pyramid;
+    tile::SrsBounds m_bounds;
+    glm::dvec2 m_cell_size;
+    glm::dvec3 m_origin;
+    glm::dvec3 m_direction;
+};
+} // namespace
+
+TerrainDepthTester::TerrainDepthTester(const tile_scheduler::MemoryCache* cache)
+    : m_memory_cache(cache)
+    , m_pyramids(pyramid_cache_capacity)
+{
+}
+
+void TerrainDepthTester::set_camera(const Definition& camera)
+{
+    std::scoped_lock lock(m_mutex);
+    m_camera = camera;
+}
+
+void TerrainDepthTester::set_max_distance(double distance) { m_max_distance = distance; }
+
+float TerrainDepthTester::depth(const glm::dvec2& normalised_device_coordinates)
+{
+    const auto camera = [this]() {
+        std::scoped_lock lock(m_mutex);
+        return m_camera;
+    }();
+    return float(intersect(camera.position(), camera.ray_direction(normalised_device_coordinates)).value_or(double(m_max_distance)));
+}
+
+glm::dvec3 TerrainDepthTester::position(const glm::dvec2& normalised_device_coordinates)
+{
+    const auto camera = [this]() {
+        std::scoped_lock lock(m_mutex);
+        return m_camera;
+    }();
+    const auto direction = camera.ray_direction(normalised_device_coordinates);
+    return camera.position() + direction * intersect(camera.position(), direction).value_or(double(m_max_distance));
+}
+
+std::optional<double> TerrainDepthTester::intersect(const glm::dvec3& origin, const glm::dvec3& direction) const
+{
+    // a ray visits many tiles of the same quads, lookups (including misses) are kept for the ray
+    utils::TileIdMap<std::optional<TileQuad>> quads;
+    const auto find_quad = [&](const tile::Id& quad_id) -> const std::optional<TileQuad>& {
+        if (const auto iter = quads.find(quad_id); iter != quads.end())
+            return iter->second;
+        return quads[quad_id] = m_memory_cache->find(quad_id);
+    };
+    const auto world = srs::tile_bounds(tile::Id { 0, { 0, 0 } });
+    const double max_distance = m_max_distance;
+    const auto end = origin + direction * max_distance;
+
+    auto t = 0.0;
+    while (t < max_distance) {
+        const auto point = origin + direction * t;
+        if (point.x < world.min.x || point.x > world.max.x || point.y < world.min.y || point.y > world.max.y)
+            return {};
+        if (direction.z >= 0 && point.z > max_altitude * altitude_scale_range(point.y, end.y).y)
+            return {}; // above anything that can be stored in a height tile and rising
+
+        const auto height_tile = cache_queries::find_height_tile(glm::dvec2(point), find_quad);
+        const auto bounds = srs::tile_bounds(height_tile ? height_tile->id : srs::world_to_tile_id(glm::dvec2(point), uncovered_zoom_level));
+        const auto t_exit = std::min(slab_interval(bounds.min, bounds.max, origin, direction).y, max_distance);
+        if (height_tile) {
+            const auto tile_pyramid = pyramid(height_tile->data);
+            if (const auto hit = TileRayCaster(*tile_pyramid, bounds, origin, direction).intersect(t, t_exit))
+                return hit;
+        }
+        t = std::max(t, t_exit) + boundary_step;
+    }
+    return {};
+}
+
+std::shared_ptr<const nucleus::utils::HeightPyramid> TerrainDepthTester::pyramid(const std::shared_ptr<QByteArray>& data) const
+{
+    return m_pyramids.get(data, [](const QByteArray& bytes) { return utils::HeightPyramid(utils::image_loader::height(bytes)); });
+}
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include <QByteArray>
+
+#include "AbstractDepthTester.h"
+#include "Definition.h"
+#include "nucleus/tile_scheduler/Cache.h"
+#include "nucleus/utils/HeightPyramid.h"
+#include "nucleus/utils/DecodedTileCache.h"
+
+namespace nucleus::camera {
+
+// Depth tester on the cpu: casts rays against the height tiles in the ram cache instead of reading back the gpu depth
+// buffer, so picking doesn't stall the render pipeline. The ray walks through the finest cached height tile at each
+// point and descends their min/max pyramids (utils::HeightPyramid), the surface within a cell is bilinear (same as
+// DataQuerier::get_altitude). Thread safe, the camera is the last one passed to set_camera.
+class TerrainDepthTester : public AbstractDepthTester {
+public:
+    static constexpr size_t pyramid_cache_capacity = 128; // 65x65 tiles, about 3 MiB
+    static constexpr double default_max_distance = 1'000'000; // far plane of camera::Definition
+
+    explicit TerrainDepthTester(const tile_scheduler::MemoryCache* cache);
+
+    void set_camera(const Definition& camera);
+    void set_max_distance(double distance);
+
+    /// distance to the terrain along the ray through the given pixel, max_distance if the ray doesn't hit anything
+    [[nodiscard]] float depth(const glm::dvec2& normalised_device_coordinates) override;
+    [[nodiscard]] glm::dvec3 position(const glm::dvec2& normalised_device_coordinates) override;
+
+    /// distance along the normalised direction to the first intersection with the cached terrain (world coordinates)
+    [[nodiscard]] std::optional<double> intersect(const glm::dvec3& origin, const glm::dvec3& direction) const;
+
+private:
+    std::shared_ptr<const utils::HeightPyramid> pyramid(const std::shared_ptr<QByteArray>& data) const;
+
+    const tile_scheduler::MemoryCache* m_memory_cache = nullptr;
+    std::atomic<double> m_max_distance = default_max_distance;
+    mutable std::mutex m_mutex; // guards m_camera
+    Definition m_camera;
+    mutable utils::DecodedTileCache<utils::HeightPyramid> m_pyramids;
+};
+
+} // namespace nucleus::camera
@@ -0,0 +1,116 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "LabelDeclutterer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "nucleus/camera/Definition.h"
+
+namespace nucleus::maplabel {
+
+LabelDeclutterer::LabelDeclutterer(float cell_size)
+    : m_cell_size(cell_size)
+{
+    assert(cell_size > 0);
+}
+
+void LabelDeclutterer::set_stability_bonus(float bonus) { m_stability_bonus = bonus; }
+
+void LabelDeclutterer::reset() { m_placed_ids.clear(); }
+
+std::vector<uint32_t> LabelDeclutterer::place(std::span<const Label> labels, const camera::Definition& camera, const VisibilityTest& is_visible)
+{
+    const auto viewport = glm::vec2(camera.viewport_size());
+    const auto view_projection = camera.world_view_projection_matrix();
+
+    // project and drop labels behind the camera or off screen
+    struct Candidate {
+        uint32_t index;
+        float priority;
+        glm::vec4 rect;
+    };
+    std::vector<Candidate> candidates;
+    candidates.reserve(labels.size());
+    for (uint32_t i = 0; i < labels.size(); ++i) {
+        const auto& label = labels[i];
+        const auto clip = view_projection * glm::dvec4(label.position, 1.0);
+        if (clip.w <= 0)
+            continue;
+        const auto ndc = glm::dvec3(clip) / clip.w;
+        if (ndc.z > 1)
+            continue;
+        const auto anchor = (glm::vec2(ndc) * 0.5f + 0.5f) * viewport;
+        const auto rect = glm::vec4(anchor + label.extent_min, anchor + label.extent_max);
+        if (rect.z < 0 || rect.w < 0 || rect.x > viewport.x || rect.y > viewport.y)
+            continue;
+        const auto priority = label.importance + (m_placed_ids.contains(label.id) ? m_stability_bonus : 0.0f);
+        candidates.push_back({ i, priority, rect });
+    }
+    std::sort(candidates.begin(), candidates.end(), [&](const Candidate& a, const Candidate& b) {
+        if (a.priority != b.priority)
+            return a.priority > b.priority;
+        return labels[a.index].id < labels[b.index].id;
+    });
+
+    const auto n_cells = glm::max(glm::uvec2(glm::ceil(viewport / m_cell_size)), glm::uvec2(1));
+    m_cells.resize(n_cells.x * n_cells.y);
+    for (auto& cell : m_cells)
+        cell.clear();
+    m_placed_rects.clear();
+    m_placed_ids.clear();
+
+    std::vector<uint32_t> placed;
+    for (const auto& candidate : candidates) {
+        const auto& rect = candidate.rect;
+        const auto first_cell = glm::uvec2(glm::clamp(glm::vec2(rect.x, rect.y) / m_cell_size, glm::vec2(0), glm::vec2(n_cells - 1u)));
+        const auto last_cell = glm::uvec2(glm::clamp(glm::vec2(rect.z, rect.w) / m_cell_size, glm::vec2(0), glm::vec2(n_cells - 1u)));
+
+        const auto overlaps = [&]() {
+            for (unsigned y = first_cell.y; y <= last_cell.y; ++y) {
+                for (unsigned x = first_cell.x; x <= last_cell.x; ++x) {
+                    for (const auto other_index : m_cells[y * n_cells.x + x]) {
+                        const auto& other = m_placed_rects[other_index];
+                        if (rect.x < other.z && other.x < rect.z && rect.y < other.w && other.y < rect.w)
+                            return true;
+                    }
+                }
+            }
+            return false;
+        };
+        const auto& label = labels[candidate.index];
+        if (m_placed_ids.contains(label.id) || overlaps())
+            continue;
+        if (is_visible && !is_visible(label))
+            continue;
+
+        const auto rect_index = uint32_t(m_placed_rects.size());
+        m_placed_rects.push_back(rect);
+        for (unsigned y = first_cell.y; y <= last_cell.y; ++y) {
+            for (unsigned x = first_cell.x; x <= last_cell.x; ++x)
+                m_cells[y * n_cells.x + x].push_back(rect_index);
+        }
+        m_placed_ids.insert(label.id);
+        placed.push_back(candidate.index);
+    }
+    return placed;
+}
+
+} // namespace nucleus::maplabel
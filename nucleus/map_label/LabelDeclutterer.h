@@ -0,0 +1,74 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <unordered_set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace nucleus::camera {
+class Definition;
+}
+
+namespace nucleus::maplabel {
+
+// Greedy screen space label placement. Anchors are projected with the camera, labels are placed in order of importance
+// and dropped if their rectangle overlaps one that is already placed. Sorting makes a frame O(n log n) in the number of
+// labels, overlaps are tested through a uniform grid in constant time per label, and the number of placed labels is bounded
+// by the screen area. Labels placed in the previous frame get a bonus, so they don't pop in and out when a slightly more
+// important one moves close.
+class LabelDeclutterer {
+public:
+    struct Label {
+        uint64_t id = 0; // stable across frames, e.g., the feature id. labels with the same id are only placed once.
+        glm::dvec3 position = {}; // anchor in world space
+        glm::vec2 extent_min = {}; // rectangle around the projected anchor in pixels, y pointing up
+        glm::vec2 extent_max = {};
+        float importance = 0; // higher is placed first
+    };
+
+    static constexpr float default_cell_size = 64; // pixels
+    static constexpr float default_stability_bonus = 0.05f; // added to the importance of labels placed in the last frame
+
+    explicit LabelDeclutterer(float cell_size = default_cell_size);
+
+    void set_stability_bonus(float bonus);
+    /// forgets the labels of the last frame
+    void reset();
+
+    /// false for labels hidden behind the terrain. only called for labels that would be placed otherwise, so an expensive
+    /// test (e.g., a ray cast) runs for few labels, and hidden labels don't take the space of visible ones.
+    using VisibilityTest = std::function<bool(const Label&)>;
+
+    /// indices of the labels to draw, in order of placement
+    [[nodiscard]] std::vector<uint32_t> place(std::span<const Label> labels, const camera::Definition& camera, const VisibilityTest& is_visible = {});
+
+private:
+    float m_cell_size;
+    float m_stability_bonus = default_stability_bonus;
+    std::unordered_set<uint64_t> m_placed_ids;
+    std::vector<std::vector<uint32_t>> m_cells; // indices into m_placed_rects, kept to reuse the allocations
+    std::vector<glm::vec4> m_placed_rects; // min x, min y, max x, max y
+};
+
+} // namespace nucleus::maplabel
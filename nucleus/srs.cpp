@@ -50,6 +50,14 @@ bool overlap(const tile::Id& a, const tile::Id& b)
     return smaller_zoom_tile == other;
 }
 
+tile::Id world_to_tile_id(const glm::dvec2& world_pos, unsigned zoom_level)
+{
+    const auto n_tiles = glm::dvec2(number_of_horizontal_tiles_for_zoom_level(zoom_level), number_of_vertical_tiles_for_zoom_level(zoom_level));
+    const auto normalised = (world_pos + cOriginShift) / cEarthCircumference;
+    const auto coords = glm::clamp(glm::floor(normalised * n_tiles), glm::dvec2(0.0), n_tiles - 1.0);
+    return { zoom_level, glm::uvec2(coords) };
+}
+
 // edited from https://stackoverflow.com/questions/14329691/convert-latitude-longitude-point-to-a-pixels-x-y-on-mercator-projection
 glm::dvec2 lat_long_to_world(const glm::dvec2& lat_long)
 {
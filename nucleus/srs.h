@@ -42,6 +42,8 @@ inline unsigned number_of_vertical_tiles_for_zoom_level(unsigned z) { return 1 <
 
 tile::SrsBounds tile_bounds(const tile::Id& tile);
 bool overlap(const tile::Id& a, const tile::Id& b);
+/// the tile (TMS) at zoom_level containing world_pos. positions outside the mercator square are clamped to the border tiles.
+tile::Id world_to_tile_id(const glm::dvec2& world_pos, unsigned zoom_level);
 
 glm::dvec2 lat_long_to_world(const glm::dvec2& lat_long);
 glm::dvec3 lat_long_alt_to_world(const glm::dvec3& lat_long_alt);
@@ -0,0 +1,180 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "BatchFrustumCuller.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace nucleus::tile_scheduler;
+
+void AabbBatch::reserve(size_t n)
+{
+    for (auto* v : { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z })
+        v->reserve(n);
+}
+
+void AabbBatch::clear()
+{
+    for (auto* v : { &min_x, &min_y, &min_z, &max_x, &max_y, &max_z })
+        v->clear();
+}
+
+void AabbBatch::push_back(const tile::SrsAndHeightBounds& aabb)
+{
+    min_x.push_back(aabb.min.x);
+    min_y.push_back(aabb.min.y);
+    min_z.push_back(aabb.min.z);
+    max_x.push_back(aabb.max.x);
+    max_y.push_back(aabb.max.y);
+    max_z.push_back(aabb.max.z);
+}
+
+tile::SrsAndHeightBounds AabbBatch::at(size_t i) const
+{
+    assert(i < size());
+    return { .min = { min_x[i], min_y[i], min_z[i] }, .max = { max_x[i], max_y[i], max_z[i] } };
+}
+
+BatchFrustumCuller::BatchFrustumCuller(const camera::Frustum& frustum)
+    : m_planes(frustum.clipping_planes)
+    , m_corners(frustum.corners)
+{
+    const auto add_axis = [this](const glm::dvec3& direction) {
+        double min = std::numeric_limits<double>::max();
+        double max = std::numeric_limits<double>::lowest();
+        for (const auto& c : m_corners) {
+            const auto p = glm::dot(c, direction);
+            min = std::min(min, p);
+            max = std::max(max, p);
+        }
+        assert(m_n_axes < m_axes.size());
+        m_axes[m_n_axes++] = { direction, min, max };
+    };
+
+    constexpr auto aabb_edges = std::array { glm::dvec3 { 1., 0., 0. }, glm::dvec3 { 0., 1., 0. }, glm::dvec3 { 0., 0., 1. } };
+    for (const auto& ae : aabb_edges)
+        add_axis(ae);
+
+    const auto frustum_edges = std::array {
+        glm::normalize(m_corners[4] - m_corners[0]),
+        glm::normalize(m_corners[5] - m_corners[1]),
+        glm::normalize(m_corners[6] - m_corners[2]),
+        glm::normalize(m_corners[7] - m_corners[3]),
+        glm::normalize(m_corners[1] - m_corners[0]),
+        glm::normalize(m_corners[3] - m_corners[0]),
+    };
+    for (const auto& fe : frustum_edges) {
+        for (const auto& ae : aabb_edges) {
+            const glm::dvec3 direction = glm::cross(fe, ae);
+            if (std::abs(direction.x) < geometry::epsilon<double> && std::abs(direction.y) < geometry::epsilon<double>
+                && std::abs(direction.z) < geometry::epsilon<double>)
+                continue; // parallel
+            add_axis(direction);
+        }
+    }
+}
+
+template <unsigned n_lanes>
+void BatchFrustumCuller::test(
+    const double* min_x, const double* min_y, const double* min_z, const double* max_x, const double* max_y, const double* max_z, uint8_t* result) const
+{
+    // the per aabb corner selection of the scalar version only depends on the direction, which is the same for all lanes.
+    // so we select whole arrays, and the loops over the lanes are plain arithmetic. the operations are in the same order
+    // as in glm::dot, so that the results are bit identical to the scalar version.
+    std::array<uint8_t, n_lanes> outside = {};
+    std::array<uint8_t, n_lanes> all_inside;
+    all_inside.fill(1);
+    for (const auto& p : m_planes) {
+        const auto& n = p.normal;
+        const double* px = n.x > 0 ? max_x : min_x;
+        const double* py = n.y > 0 ? max_y : min_y;
+        const double* pz = n.z > 0 ? max_z : min_z;
+        const double* nx = n.x < 0 ? max_x : min_x;
+        const double* ny = n.y < 0 ? max_y : min_y;
+        const double* nz = n.z < 0 ? max_z : min_z;
+        for (unsigned l = 0; l < n_lanes; ++l) {
+            const auto distance_p = ((n.x * px[l] + n.y * py[l]) + n.z * pz[l]) + p.distance;
+            const auto distance_n = ((n.x * nx[l] + n.y * ny[l]) + n.z * nz[l]) + p.distance;
+            outside[l] |= uint8_t(distance_p <= 0);
+            all_inside[l] &= uint8_t(distance_n > 0);
+        }
+    }
+
+    std::array<uint8_t, n_lanes> contains_corner = {};
+    for (const auto& c : m_corners) {
+        for (unsigned l = 0; l < n_lanes; ++l) {
+            contains_corner[l] |= uint8_t(min_x[l] <= c.x) & uint8_t(min_y[l] <= c.y) & uint8_t(min_z[l] <= c.z) & uint8_t(c.x < max_x[l])
+                & uint8_t(c.y < max_y[l]) & uint8_t(c.z < max_z[l]);
+        }
+    }
+
+    std::array<uint8_t, n_lanes> separated = {};
+    for (unsigned i = 0; i < m_n_axes; ++i) {
+        const auto& axis = m_axes[i];
+        const auto& d = axis.direction;
+        const double* ax = d.x > 0 ? max_x : min_x;
+        const double* ay = d.y > 0 ? max_y : min_y;
+        const double* az = d.z > 0 ? max_z : min_z;
+        const double* bx = d.x < 0 ? max_x : min_x;
+        const double* by = d.y < 0 ? max_y : min_y;
+        const double* bz = d.z < 0 ? max_z : min_z;
+        for (unsigned l = 0; l < n_lanes; ++l) {
+            const auto a = (d.x * ax[l] + d.y * ay[l]) + d.z * az[l];
+            const auto b = (d.x * bx[l] + d.y * by[l]) + d.z * bz[l];
+            const auto aabb_min = std::min(a, b);
+            const auto aabb_max = std::max(a, b);
+            separated[l] |= uint8_t(!(aabb_min <= axis.frustum_max && axis.frustum_min <= aabb_max));
+        }
+    }
+
+    for (unsigned l = 0; l < n_lanes; ++l)
+        result[l] = uint8_t(!outside[l]) & (all_inside[l] | contains_corner[l] | uint8_t(!separated[l]));
+}
+
+bool BatchFrustumCuller::contains(const tile::SrsAndHeightBounds& aabb) const
+{
+    uint8_t result = 0;
+    test<1>(&aabb.min.x, &aabb.min.y, &aabb.min.z, &aabb.max.x, &aabb.max.y, &aabb.max.z, &result);
+    return result;
+}
+
+std::vector<uint8_t> BatchFrustumCuller::cull(const AabbBatch& aabbs) const
+{
+    std::vector<uint8_t> result;
+    cull(aabbs, &result);
+    return result;
+}
+
+void BatchFrustumCuller::cull(const AabbBatch& aabbs, std::vector<uint8_t>* result) const
+{
+    const auto n = aabbs.size();
+    result->resize(n);
+    size_t i = 0;
+    for (; i + lane_count <= n; i += lane_count) {
+        test<lane_count>(aabbs.min_x.data() + i,
+            aabbs.min_y.data() + i,
+            aabbs.min_z.data() + i,
+            aabbs.max_x.data() + i,
+            aabbs.max_y.data() + i,
+            aabbs.max_z.data() + i,
+            result->data() + i);
+    }
+    for (; i < n; ++i)
+        (*result)[i] = contains(aabbs.at(i));
+}
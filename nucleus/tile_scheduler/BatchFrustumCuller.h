@@ -0,0 +1,78 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include <radix/tile.h>
+
+#include "nucleus/camera/Definition.h"
+
+namespace nucleus::tile_scheduler {
+
+// aabbs as structure of arrays, so that BatchFrustumCuller can test several of them with one instruction.
+struct AabbBatch {
+    std::vector<double> min_x;
+    std::vector<double> min_y;
+    std::vector<double> min_z;
+    std::vector<double> max_x;
+    std::vector<double> max_y;
+    std::vector<double> max_z;
+
+    void reserve(size_t n);
+    void clear();
+    void push_back(const tile::SrsAndHeightBounds& aabb);
+    [[nodiscard]] size_t size() const { return min_x.size(); }
+    [[nodiscard]] tile::SrsAndHeightBounds at(size_t i) const;
+};
+
+// Gives the same results as utils::camera_frustum_contains_tile, but the frustum dependent parts of the separating
+// axis test (planes, axes and the projection of the frustum onto them) are computed once in the constructor.
+// cull() processes lane_count aabbs at a time without branches, so that the compiler can vectorise it
+// (sse2/avx on x86, neon on arm, simd128 on wasm). contains() is the scalar fallback, using the same arithmetic.
+class BatchFrustumCuller {
+public:
+    static constexpr unsigned lane_count = 8;
+
+    explicit BatchFrustumCuller(const camera::Frustum& frustum);
+
+    [[nodiscard]] bool contains(const tile::SrsAndHeightBounds& aabb) const;
+    // returns 1 for every aabb that is (potentially) visible, 0 otherwise
+    [[nodiscard]] std::vector<uint8_t> cull(const AabbBatch& aabbs) const;
+    void cull(const AabbBatch& aabbs, std::vector<uint8_t>* result) const;
+
+private:
+    struct Axis {
+        glm::dvec3 direction;
+        double frustum_min;
+        double frustum_max;
+    };
+    template <unsigned n_lanes>
+    void test(const double* min_x, const double* min_y, const double* min_z, const double* max_x, const double* max_y, const double* max_z, uint8_t* result) const;
+
+    std::array<geometry::Plane<double>, 6> m_planes;
+    std::array<glm::dvec3, 8> m_corners;
+    // 3 aabb edges + 6 frustum edges x 3 aabb edges (without the parallel ones)
+    std::array<Axis, 21> m_axes;
+    unsigned m_n_axes = 0;
+};
+
+}
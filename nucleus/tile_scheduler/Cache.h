@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <filesystem>
 #include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <unordered_set>
 #include <vector>
@@ -30,6 +31,7 @@
 #include <tl/expected.hpp>
 #include <zpp_bits.h>
 
+#include "nucleus/utils/TileIdMap.h"
 #include "radix/tile.h"
 #include "tile_types.h"
 #include "utils.h"
@@ -66,7 +68,7 @@ class Cache
         T data;
     };
 
-    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> m_data;
+    nucleus::utils::TileIdMap<CacheObject> m_data;
     mutable std::shared_mutex m_data_mutex;
     std::unordered_map<tile::Id, MetaData, tile::Id::Hasher> m_disk_cached;
     mutable std::shared_mutex m_disk_cached_mutex;
@@ -80,16 +82,34 @@ public:
     template<typename VisitorFunction>
     void visit(const VisitorFunction& functor);
     const T& peak_at(const tile::Id& id) const;
+    /// copy of the cached tile (cheap for tiles holding shared pointers), unlike peak_at safe while other threads insert or purge
+    [[nodiscard]] std::optional<T> find(const tile::Id& id) const;
     std::vector<T> purge(unsigned remaining_capacity);
 
     [[nodiscard]] tl::expected<void, std::string> write_to_disk(const std::filesystem::path& path);
+    /// writes the tiles in ram to disk and removes them from ram. unlike write_to_disk, tiles that are only on disk are kept,
+    /// so it can be called repeatedly to stream a cache that doesn't fit into ram to disk.
+    [[nodiscard]] tl::expected<void, std::string> move_to_disk(const std::filesystem::path& path);
     [[nodiscard]] tl::expected<void, std::string> read_from_disk(const std::filesystem::path& path);
+    /// reads only the index of the tiles on disk, they stay there until loaded with load_from_disk. ram is untouched.
+    [[nodiscard]] tl::expected<void, std::string> read_index_from_disk(const std::filesystem::path& path);
+    [[nodiscard]] bool contains_on_disk(const tile::Id& id) const;
+    [[nodiscard]] unsigned n_disk_cached_objects() const;
+    /// reads a single tile (listed in the index) from disk, without inserting it into ram.
+    [[nodiscard]] tl::expected<T, std::string> load_from_disk(const std::filesystem::path& path, const tile::Id& id) const;
 
 private:
     template<typename VisitorFunction>
     void visit(const tile::Id& start_node,
                const VisitorFunction& functor,
                uint64_t visited_stamp); // must stay private or protected by mutex
+    static tl::expected<void, std::string> write_file(const std::vector<char>& bytes, const std::filesystem::path& path);
+    static tl::expected<void, std::string> write_tile(const std::filesystem::path& base_path, const tile::Id& id, const T& tile);
+    tl::expected<void, std::string> write_meta_info(const std::filesystem::path& base_path) const; // m_disk_cached_mutex must be locked
+    static tl::expected<QByteArray, std::string> read_file(const std::filesystem::path& path);
+    template <typename Archive> static tl::expected<void, std::string> check_version(Archive* in, const std::filesystem::path& path);
+    static tl::expected<T, std::string> read_tile(const std::filesystem::path& base_path, const tile::Id& id);
+    tl::expected<void, std::string> read_meta_info(const std::filesystem::path& base_path); // m_disk_cached_mutex must be locked
 
     static std::filesystem::path tile_path(const std::filesystem::path& base_path, const tile::Id& id)
     {
@@ -135,28 +155,77 @@ const T& Cache<T>::peak_at(const tile::Id& id) const
     return m_data.at(id).data;
 }
 
+template <tile_types::NamedTile T>
+std::optional<T> Cache<T>::find(const tile::Id& id) const
+{
+    auto locker = std::shared_lock(m_data_mutex);
+    const auto iter = m_data.find(id);
+    if (iter == m_data.end())
+        return {};
+    return iter->second.data;
+}
+
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::write_file(const std::vector<char>& bytes, const std::filesystem::path& path)
+{
+    QFile file(path);
+    const auto success = file.open(QIODeviceBase::WriteOnly);
+    if (!success)
+        return tl::unexpected<std::string>(fmt::format("Couldn't open file '{}' for writing!", path.string()));
+    file.write(bytes.data(), qint64(bytes.size()));
+    return {};
+}
+
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::write_tile(const std::filesystem::path& base_path, const tile::Id& id, const T& tile)
+{
+    std::vector<char> bytes;
+    zpp::bits::out out(bytes);
+    const std::remove_cvref_t<decltype(T::version_information)> version = T::version_information;
+    {
+        const auto r = out(version);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    {
+        const auto r = out(tile);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    return write_file(bytes, tile_path(base_path, id));
+}
+
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::write_meta_info(const std::filesystem::path& base_path) const
+{
+    std::vector<char> bytes;
+    zpp::bits::out out(bytes);
+    const std::remove_cvref_t<decltype(T::version_information)> version = T::version_information;
+    {
+        const auto r = out(version);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    {
+        const auto r = out(m_disk_cached);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    return write_file(bytes, meta_info_path(base_path));
+}
+
 template <tile_types::NamedTile T>
 tl::expected<void, std::string> Cache<T>::write_to_disk(const std::filesystem::path& base_path)
 {
     static_assert(tile_types::SerialisableTile<T>);
     std::filesystem::create_directories(base_path);
-    std::unordered_map<tile::Id, CacheObject, tile::Id::Hasher> data;
+    nucleus::utils::TileIdMap<CacheObject> data;
     {
         auto locker = std::scoped_lock(m_data_mutex);
         data = m_data; // copies only metadata and references to tiles
     }
     auto locker = std::scoped_lock(m_disk_cached_mutex);
 
-    const auto write = [](const auto& bytes, const auto& path) -> tl::expected<void, std::string> {
-        QFile file(path);
-        const auto success = file.open(QIODeviceBase::WriteOnly);
-        if (!success)
-            return tl::unexpected<std::string>(
-                fmt::format("Couldn't open file '{}' for writing!", path.string()));
-        file.write(bytes.data(), qint64(bytes.size()));
-        return {};
-    };
-
     std::unordered_map<tile::Id, MetaData, tile::Id::Hasher> disk_cached_old;
     std::swap(m_disk_cached, disk_cached_old);
     m_disk_cached.reserve(data.size());
@@ -171,55 +240,134 @@ tl::expected<void, std::string> Cache<T>::write_to_disk(const std::filesystem::p
         std::filesystem::remove(tile_path(base_path, id));
     }
 
-        // write new or updated items to disk
-        for (const auto& item : data) {
-            const tile::Id& id = item.first;
-            const CacheObject& cache_object = item.second;
-            m_disk_cached[id] = cache_object.meta;
-
-            if (disk_cached_old.contains(id) && disk_cached_old.at(id).created == cache_object.meta.created)
-                continue;
-
-            std::vector<char> bytes;
-            zpp::bits::out out(bytes);
-            const std::remove_cvref_t<decltype(T::version_information)> version = T::version_information;
-            {
-                const auto r = out(version);
-                if (failure(r))
-                    return tl::unexpected(std::make_error_code(r).message());
-            }
-            {
-                const auto r = out(cache_object.data);
-                if (failure(r))
-                    return tl::unexpected(std::make_error_code(r).message());
-            }
-            {
-                const auto r = write(bytes, tile_path(base_path, id));
-                if (!r.has_value())
-                    return r;
-            }
-        }
+    // write new or updated items to disk
+    for (const auto& item : data) {
+        const tile::Id& id = item.first;
+        const CacheObject& cache_object = item.second;
+        m_disk_cached[id] = cache_object.meta;
 
-        std::vector<char> bytes;
-        zpp::bits::out out(bytes);
-        const std::remove_cvref_t<decltype(T::version_information)> version = T::version_information;
-        {
-            const auto r = out(version);
-            if (failure(r))
-                return tl::unexpected(std::make_error_code(r).message());
-        }
+        if (disk_cached_old.contains(id) && disk_cached_old.at(id).created == cache_object.meta.created)
+            continue;
 
-        {
-            const auto r = out(m_disk_cached);
-            if (failure(r))
-                return tl::unexpected(std::make_error_code(r).message());
-        }
+        const auto r = write_tile(base_path, id, cache_object.data);
+        if (!r.has_value())
+            return r;
+    }
+
+    return write_meta_info(base_path);
+}
+
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::move_to_disk(const std::filesystem::path& base_path)
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    std::filesystem::create_directories(base_path);
+    nucleus::utils::TileIdMap<CacheObject> data;
+    {
+        auto locker = std::scoped_lock(m_data_mutex);
+        data = m_data; // copies only metadata and references to tiles
+    }
+    auto locker = std::scoped_lock(m_disk_cached_mutex);
 
-        const auto r = write(bytes, meta_info_path(base_path));
+    for (const auto& item : data) {
+        const tile::Id& id = item.first;
+        const CacheObject& cache_object = item.second;
+        const auto disk_cached = m_disk_cached.find(id);
+        if (disk_cached == m_disk_cached.end() || disk_cached->second.created != cache_object.meta.created) {
+            const auto r = write_tile(base_path, id, cache_object.data);
+            if (!r.has_value())
+                return r;
+        }
+        m_disk_cached[id] = cache_object.meta;
+    }
+    {
+        const auto r = write_meta_info(base_path);
         if (!r.has_value())
             return r;
+    }
 
-        return {};
+    // tiles that were updated in the meantime stay in ram
+    auto data_locker = std::scoped_lock(m_data_mutex);
+    for (const auto& item : data) {
+        const auto iter = m_data.find(item.first);
+        if (iter != m_data.end() && iter->second.meta.created == item.second.meta.created)
+            m_data.erase(iter);
+    }
+    return {};
+}
+
+template <tile_types::NamedTile T>
+tl::expected<QByteArray, std::string> Cache<T>::read_file(const std::filesystem::path& path)
+{
+    QFile file(path);
+    const auto success = file.open(QIODeviceBase::ReadOnly);
+    if (!success)
+        return tl::unexpected(fmt::format("Couldn't open file '{}' for reading!", path.string()));
+    return file.readAll();
+}
+
+template <tile_types::NamedTile T>
+template <typename Archive>
+tl::expected<void, std::string> Cache<T>::check_version(Archive* in, const std::filesystem::path& path)
+{
+    std::remove_cvref_t<decltype(T::version_information)> version_info = {};
+    {
+        const auto r = (*in)(version_info);
+        if (failure(r))
+            return tl::unexpected(std::make_error_code(r).message());
+    }
+    if (version_info != T::version_information) {
+        version_info[version_info.size() - 1] = 0; // make sure that the string is 0 terminated.
+
+        return tl::unexpected(fmt::format("Cache file '{}' has incompatible version! Disk "
+                                          "version is '{}', but we expected '{}'.",
+            path.string(),
+            version_info.data(),
+            T::version_information.data()));
+    }
+    return {};
+}
+
+template <tile_types::NamedTile T>
+tl::expected<T, std::string> Cache<T>::read_tile(const std::filesystem::path& base_path, const tile::Id& id)
+{
+    const auto path = tile_path(base_path, id);
+    const auto bytes = read_file(path);
+    if (!bytes.has_value())
+        return tl::unexpected(bytes.error());
+    zpp::bits::in in(bytes.value());
+    {
+        const auto r = check_version(&in, path);
+        if (!r.has_value())
+            return tl::unexpected(r.error());
+    }
+    T tile;
+    const auto r = in(tile);
+    if (failure(r))
+        return tl::unexpected(std::make_error_code(r).message());
+    return tile;
+}
+
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::read_meta_info(const std::filesystem::path& base_path)
+{
+    m_disk_cached.clear();
+    const auto path = meta_info_path(base_path);
+    const auto bytes = read_file(path);
+    if (!bytes.has_value())
+        return tl::unexpected(bytes.error());
+    zpp::bits::in in(bytes.value());
+    {
+        const auto r = check_version(&in, path);
+        if (!r.has_value())
+            return r;
+    }
+    const auto r = in(m_disk_cached);
+    if (failure(r)) {
+        m_disk_cached.clear();
+        return tl::unexpected(std::make_error_code(r).message());
+    }
+    return {};
 }
 
 template <tile_types::NamedTile T>
@@ -227,31 +375,6 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
 {
     auto locker = std::scoped_lock(m_data_mutex, m_disk_cached_mutex);
     assert(tile_types::SerialisableTile<T>);
-    const auto check_version = [](auto* in, const auto& path) -> tl::expected<void, std::string> {
-        std::remove_cvref_t<decltype(T::version_information)> version_info = {};
-        {
-            const auto r = (*in)(version_info);
-            if (failure(r))
-                return tl::unexpected(std::make_error_code(r).message());
-        }
-        if (version_info != T::version_information) {
-            version_info[version_info.size() - 1] = 0;  // make sure that the string is 0 terminated.
-
-            return tl::unexpected(fmt::format("Cache file '{}' has incompatible version! Disk "
-                                              "version is '{}', but we expected '{}'.",
-                path.string(),
-                version_info.data(),
-                T::version_information.data()));
-        }
-        return {};
-    };
-    const auto read_all = [](const auto& path) -> tl::expected<QByteArray, std::string> {
-        QFile file(path);
-        const auto success = file.open(QIODeviceBase::ReadOnly);
-        if (!success)
-            return tl::unexpected(fmt::format("Couldn't open file '{}' for reading!", path.string()));
-        return file.readAll();
-    };
     const auto clean_up = [&]() {
         m_disk_cached.clear();
         m_data.clear();
@@ -259,26 +382,10 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
 
     clean_up();
     {
-        const auto path = meta_info_path(base_path);
-        const auto bytes = read_all(path);
-        if (!bytes.has_value()) {
+        const auto r = read_meta_info(base_path);
+        if (!r.has_value()) {
             clean_up();
-            return tl::unexpected(bytes.error());
-        }
-        zpp::bits::in in(bytes.value());
-        {
-            const auto r = check_version(&in, path);
-            if (!r.has_value()) {
-                clean_up();
-                return r;
-            }
-        }
-        {
-            const auto r = in(m_disk_cached);
-            if (failure(r)) {
-                clean_up();
-                return tl::unexpected(std::make_error_code(r).message());
-            }
+            return r;
         }
     }
 
@@ -286,29 +393,13 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
         const tile::Id& id = entry.first;
         const MetaData& meta = entry.second;
 
-        const auto path = tile_path(base_path, id);
-        const auto bytes = read_all(path);
-        if (!bytes.has_value()) {
+        auto tile = read_tile(base_path, id);
+        if (!tile.has_value()) {
             clean_up();
-            return tl::unexpected(bytes.error());
+            return tl::unexpected(tile.error());
         }
-        zpp::bits::in in(bytes.value());
-        {
-            const auto r = check_version(&in, path);
-            if (!r.has_value()) {
-                clean_up();
-                return r;
-            }
-        }
-
         CacheObject d;
-        {
-            const auto r = in(d.data);
-            if (failure(r)) {
-                clean_up();
-                return tl::unexpected(std::make_error_code(r).message());
-            }
-        }
+        d.data = std::move(tile.value());
         d.meta = meta;
         m_data[d.data.id] = d;
     }
@@ -316,6 +407,36 @@ tl::expected<void, std::string> Cache<T>::read_from_disk(const std::filesystem::
     return {};
 }
 
+template <tile_types::NamedTile T>
+tl::expected<void, std::string> Cache<T>::read_index_from_disk(const std::filesystem::path& base_path)
+{
+    auto locker = std::scoped_lock(m_disk_cached_mutex);
+    return read_meta_info(base_path);
+}
+
+template <tile_types::NamedTile T>
+bool Cache<T>::contains_on_disk(const tile::Id& id) const
+{
+    auto locker = std::shared_lock(m_disk_cached_mutex);
+    return m_disk_cached.contains(id);
+}
+
+template <tile_types::NamedTile T>
+unsigned Cache<T>::n_disk_cached_objects() const
+{
+    auto locker = std::shared_lock(m_disk_cached_mutex);
+    return unsigned(m_disk_cached.size());
+}
+
+template <tile_types::NamedTile T>
+tl::expected<T, std::string> Cache<T>::load_from_disk(const std::filesystem::path& base_path, const tile::Id& id) const
+{
+    static_assert(tile_types::SerialisableTile<T>);
+    if (!contains_on_disk(id))
+        return tl::unexpected(fmt::format("Tile {}/{}/{} is not in the disk cache.", id.zoom_level, id.coords.x, id.coords.y));
+    return read_tile(base_path, id);
+}
+
 template <tile_types::NamedTile T>
 template <typename VisitorFunction>
 void Cache<T>::visit(const VisitorFunction& functor)
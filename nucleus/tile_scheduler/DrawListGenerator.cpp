@@ -19,13 +19,26 @@
 
 #include "DrawListGenerator.h"
 
-#include "radix/iterator.h"
-#include "radix/quad_tree.h"
+#include <algorithm>
+#include <limits>
 
 using nucleus::tile_scheduler::DrawListGenerator;
 
+DrawListGenerator::TileSet::TileSet(std::vector<tile::Id> ids)
+    : m_ids(std::move(ids))
+{
+    if (!std::is_sorted(m_ids.cbegin(), m_ids.cend(), IdLess()))
+        std::sort(m_ids.begin(), m_ids.end(), IdLess());
+}
+
+bool DrawListGenerator::TileSet::contains(const tile::Id& id) const
+{
+    return std::binary_search(m_ids.cbegin(), m_ids.cend(), id, IdLess());
+}
+
 DrawListGenerator::DrawListGenerator()
 {
+    m_cut.insert(tile::Id { 0, { 0, 0 } });
     TileHeights h;
     h.emplace({ 0, { 0, 0 } }, { 100, 4000 });
     set_aabb_decorator(tile_scheduler::utils::AabbDecorator::make(std::move(h)));
@@ -34,41 +47,221 @@ DrawListGenerator::DrawListGenerator()
 void DrawListGenerator::set_permissible_screen_space_error(float new_permissible_screen_space_error)
 {
     m_permissible_screen_space_error = new_permissible_screen_space_error;
+    invalidate_all();
 }
 
 void DrawListGenerator::set_aabb_decorator(const tile_scheduler::utils::AabbDecoratorPtr& new_aabb_decorator)
 {
     m_aabb_decorator = new_aabb_decorator;
+    invalidate_all();
+}
+
+void DrawListGenerator::set_occlusion_culling_enabled(bool enabled)
+{
+    m_occlusion_culling_enabled = enabled;
+}
+
+bool DrawListGenerator::occlusion_culling_enabled() const
+{
+    return m_occlusion_culling_enabled;
 }
 
 void DrawListGenerator::add_tile(const tile::Id& id)
 {
     m_available_tiles.insert(id);
+    // the parent might be refinable now
+    if (id.zoom_level > 0 && m_cut.contains(id.parent()))
+        m_dirty.push_back(id.parent());
 }
 
 void DrawListGenerator::remove_tile(const tile::Id& id)
 {
     m_available_tiles.erase(id);
+    // the parent must not be refined any more, regardless of the camera
+    if (id.zoom_level > 0 && m_refined.contains(id.parent()))
+        collapse(id.parent());
+}
+
+unsigned DrawListGenerator::n_evaluated_tiles() const
+{
+    return m_n_evaluated_tiles;
 }
 
-DrawListGenerator::TileSet DrawListGenerator::generate_for(const nucleus::camera::Definition& camera) const
+const DrawListGenerator::TileSet& DrawListGenerator::generate_for(const nucleus::camera::Definition& camera)
 {
-    const auto tile_refine_functor
-        = tile_scheduler::utils::refineFunctor(camera,
-                                               m_aabb_decorator,
-                                               m_permissible_screen_space_error);
-    const auto draw_refine_functor = [&tile_refine_functor, this](const tile::Id &tile) {
-        bool all = true;
-        for (const auto &child : tile.children()) {
-            all = all && m_available_tiles.contains(child);
+    m_n_evaluated_tiles = 0;
+    if (m_camera && *m_camera == camera && m_dirty.empty())
+        return m_draw_list;
+
+    const auto same_view = [](const camera::Definition& a, const camera::Definition& b) {
+        const auto ta = a.camera_space_to_world_matrix();
+        const auto tb = b.camera_space_to_world_matrix();
+        return ta[0] == tb[0] && ta[1] == tb[1] && ta[2] == tb[2] && a.projection_matrix() == b.projection_matrix()
+            && a.viewport_size() == b.viewport_size();
+    };
+    // without a camera, invalidate_all() was called already and everything is dirty
+    if (m_camera && !same_view(*m_camera, camera))
+        invalidate_all();
+    else if (m_camera)
+        m_camera_travel += glm::distance(m_camera->position(), camera.position());
+    m_camera = camera;
+    const auto frustum = camera.frustum();
+    m_frustum_culler.emplace(frustum);
+    m_frustum_planes = frustum.clipping_planes;
+
+    // decisions that may have changed with the travelled distance
+    while (!m_schedule.empty() && m_schedule.top().valid_until < m_camera_travel) {
+        const auto scheduled = m_schedule.top();
+        m_schedule.pop();
+        const auto iter = m_scheduled.find(scheduled.id);
+        if (iter == m_scheduled.end() || iter->second.stamp != scheduled.stamp)
+            continue; // outdated entry
+        m_scheduled.erase(iter);
+        m_dirty.push_back(scheduled.id);
+    }
+
+    while (!m_dirty.empty()) {
+        const auto tile = m_dirty.back();
+        m_dirty.pop_back();
+        const auto is_leaf = m_cut.contains(tile);
+        if (!is_leaf && !is_deepest_refined(tile))
+            continue; // not on the boundary (any more)
+
+        const auto decision = evaluate(tile);
+        ++m_n_evaluated_tiles;
+        if (is_leaf && decision.refine) {
+            // split
+            m_cut.erase(tile);
+            m_refined.insert(tile);
+            schedule(tile, decision.valid_until); // it is a merge candidate now
+            for (const auto& child : tile.children()) {
+                m_cut.insert(child);
+                m_dirty.push_back(child);
+            }
+            m_cut_changed = true;
+            continue;
         }
-        return all && tile_refine_functor(tile);
+        if (!is_leaf && !decision.refine) {
+            // merge
+            for (const auto& child : tile.children()) {
+                m_cut.erase(child);
+                m_scheduled.erase(child);
+            }
+            m_refined.erase(tile);
+            m_cut.insert(tile);
+            if (tile.zoom_level > 0)
+                m_dirty.push_back(tile.parent());
+            m_cut_changed = true;
+        }
+        schedule(tile, decision.valid_until);
+    }
+
+    // keep the queue from growing with outdated entries
+    if (m_schedule.size() > 4 * m_scheduled.size() + 64) {
+        m_schedule = {};
+        for (const auto& entry : m_scheduled)
+            m_schedule.push(entry.second);
+    }
+
+    if (m_cut_changed) {
+        m_draw_list = TileSet(std::vector<tile::Id>(m_cut.cbegin(), m_cut.cend()));
+        m_cut_changed = false;
+    }
+    return m_draw_list;
+}
+
+DrawListGenerator::Decision DrawListGenerator::evaluate(const tile::Id& tile) const
+{
+    // same criterion as utils::refineFunctor (with tile size 256), plus all children must be available.
+    constexpr auto sqrt2 = 1.414213562373095;
+    constexpr auto forever = std::numeric_limits<double>::infinity();
+    assert(m_camera && m_frustum_culler);
+    const auto& camera = *m_camera;
+
+    if (tile.zoom_level >= 18)
+        return { false, forever };
+    for (const auto& child : tile.children()) {
+        if (!m_available_tiles.contains(child))
+            return { false, forever }; // add_tile marks the tile dirty
+    }
+
+    // float inaccuracies in the criterion are orders of magnitude below these safety margins
+    const auto valid_until = [this](double margin) { return m_camera_travel + std::max(0.0, margin * 0.99 - 1.0); };
+
+    const auto aabb = m_aabb_decorator->aabb(tile);
+    const auto distance = geometry::distance(aabb, camera.position());
+    const auto pixel_size = float(sqrt2 * aabb.size().x / 256.0);
+    const auto fine_enough = camera.to_screen_space(pixel_size, float(distance)) < m_permissible_screen_space_error;
+    // the distance, at which the screen space error equals the threshold. the camera moving by d changes the distance by at most d.
+    const auto refinement_distance
+        = double(camera.viewport_size().y) * 0.5 * double(pixel_size) * double(camera.distance_scale_factor()) / double(m_permissible_screen_space_error);
+    if (fine_enough)
+        return { false, valid_until(distance - refinement_distance) };
+    // while the view does not rotate, the frustum planes move with the camera. so a tile that is outside of a plane
+    // (or inside of all planes) by a margin, stays invisible (visible) until the camera travelled that far.
+    const auto plane_distance = [&aabb](const geometry::Plane<double>& plane, bool positive_vertex) {
+        const auto& n = plane.normal;
+        const auto select = [positive_vertex](double normal, double min, double max) { return (positive_vertex ? normal > 0 : normal < 0) ? max : min; };
+        const auto vertex = glm::dvec3(select(n.x, aabb.min.x, aabb.max.x), select(n.y, aabb.min.y, aabb.max.y), select(n.z, aabb.min.z, aabb.max.z));
+        return (glm::dot(n, vertex) + plane.distance) / glm::length(n);
     };
+    if (!m_frustum_culler->contains(aabb)) {
+        double outside_margin = 0;
+        for (const auto& plane : m_frustum_planes)
+            outside_margin = std::max(outside_margin, -plane_distance(plane, true));
+        return { false, valid_until(outside_margin) };
+    }
+    double inside_margin = std::numeric_limits<double>::max();
+    for (const auto& plane : m_frustum_planes)
+        inside_margin = std::min(inside_margin, plane_distance(plane, false));
+    return { true, valid_until(std::min(refinement_distance - distance, inside_margin)) };
+}
 
-    const auto all_leaves = quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, draw_refine_functor, [](const tile::Id& v) { return v.children(); });
+bool DrawListGenerator::is_deepest_refined(const tile::Id& tile) const
+{
+    if (!m_refined.contains(tile))
+        return false;
+    const auto children = tile.children();
+    return std::none_of(children.cbegin(), children.cend(), [this](const tile::Id& child) { return m_refined.contains(child); });
+}
+
+void DrawListGenerator::schedule(const tile::Id& tile, double valid_until)
+{
+    if (valid_until == std::numeric_limits<double>::infinity()) {
+        m_scheduled.erase(tile);
+        return;
+    }
+    const auto scheduled = Scheduled { valid_until, ++m_stamp, tile };
+    m_scheduled[tile] = scheduled;
+    m_schedule.push(scheduled);
+}
 
-    TileSet tileset;
-    tileset.reserve(all_leaves.size());
-    std::copy(all_leaves.begin(), all_leaves.end(), radix::unordered_inserter(tileset));
-    return tileset;
+void DrawListGenerator::invalidate_all()
+{
+    m_schedule = {};
+    m_scheduled.clear();
+    m_camera_travel = 0;
+    m_dirty.insert(m_dirty.end(), m_cut.cbegin(), m_cut.cend());
+    m_dirty.insert(m_dirty.end(), m_refined.cbegin(), m_refined.cend());
+    m_camera.reset();
+}
+
+void DrawListGenerator::collapse(const tile::Id& tile)
+{
+    std::vector<tile::Id> stack = { tile };
+    while (!stack.empty()) {
+        const auto t = stack.back();
+        stack.pop_back();
+        m_scheduled.erase(t);
+        m_cut.erase(t);
+        if (m_refined.erase(t)) {
+            for (const auto& child : t.children())
+                stack.push_back(child);
+        }
+    }
+    m_cut.insert(tile);
+    m_dirty.push_back(tile);
+    if (tile.zoom_level > 0)
+        m_dirty.push_back(tile.parent());
+    m_cut_changed = true;
 }
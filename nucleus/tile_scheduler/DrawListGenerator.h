@@ -20,16 +20,50 @@
 #pragma once
 
 #include "nucleus/camera/Definition.h"
+#include "BatchFrustumCuller.h"
+#include "HorizonCuller.h"
+#include "nucleus/utils/TileIdMap.h"
 #include "radix/iterator.h"
 #include "utils.h"
 
-#include <unordered_set>
+#include <optional>
+#include <queue>
+#include <set>
+#include <tuple>
 
 namespace nucleus::tile_scheduler {
+// Generates the list of tiles to draw (the cut through the quad tree, where tiles are either fine enough or have no loaded
+// children). The cut of the previous frame is kept and only tiles on its boundary (leaves, that might need refinement, and
+// the deepest inner nodes, that might not need it any more) are re-evaluated. Decisions, that can't change before the camera
+// travelled a certain distance (e.g., tiles far from the refinement distance or well inside the frustum), are not evaluated
+// again until then. Therefore, the cost per frame scales with the change of the cut and not with its size.
+// The refinement criterion is monotone (a child is never refined if its parent isn't), so the result is identical to a
+// full traversal with utils::refineFunctor. Rotating the view or changing the projection re-evaluates the whole boundary.
 class DrawListGenerator
 {
 public:
-    using TileSet = std::unordered_set<tile::Id, tile::Id::Hasher>;
+    // flat and sorted by tile id (zoom level, x, y)
+    class TileSet {
+    public:
+        using const_iterator = std::vector<tile::Id>::const_iterator;
+        TileSet() = default;
+        explicit TileSet(std::vector<tile::Id> ids);
+        [[nodiscard]] bool contains(const tile::Id& id) const;
+        [[nodiscard]] size_t size() const { return m_ids.size(); }
+        [[nodiscard]] bool empty() const { return m_ids.empty(); }
+        [[nodiscard]] const_iterator begin() const { return m_ids.cbegin(); }
+        [[nodiscard]] const_iterator end() const { return m_ids.cend(); }
+        [[nodiscard]] const std::vector<tile::Id>& ids() const { return m_ids; }
+
+    private:
+        std::vector<tile::Id> m_ids;
+    };
+    struct IdLess {
+        bool operator()(const tile::Id& a, const tile::Id& b) const
+        {
+            return std::tie(a.zoom_level, a.coords.x, a.coords.y) < std::tie(b.zoom_level, b.coords.x, b.coords.y);
+        }
+    };
 
     DrawListGenerator();
 
@@ -37,25 +71,88 @@ public:
     void set_aabb_decorator(const utils::AabbDecoratorPtr& new_aabb_decorator);
     void add_tile(const tile::Id& id);
     void remove_tile(const tile::Id& id);
-    [[nodiscard]] TileSet generate_for(const camera::Definition& camera) const;
+    [[nodiscard]] const TileSet& generate_for(const camera::Definition& camera);
+    // number of refinement decisions, that were evaluated in the last call to generate_for
+    [[nodiscard]] unsigned n_evaluated_tiles() const;
+
+    // occlusion culling is only applied by cull(tileset, camera), the draw list itself stays independent of it
+    void set_occlusion_culling_enabled(bool enabled);
+    [[nodiscard]] bool occlusion_culling_enabled() const;
 
     template<class TileIdContainerType>
     TileSet cull(const TileIdContainerType& tileset, const camera::Frustum& frustum) const
     {
-        TileSet visible_leaves;
-        visible_leaves.reserve(tileset.size());
-
-        const auto is_visible = [frustum, this](const tile::Id& tile) {
-            return tile_scheduler::utils::camera_frustum_contains_tile(frustum, m_aabb_decorator->aabb(tile));
-        };
+        return cull(tileset, frustum, nullptr);
+    }
 
-        std::copy_if(tileset.begin(), tileset.end(), radix::unordered_inserter(visible_leaves), is_visible);
-        return visible_leaves;
+    template<class TileIdContainerType>
+    TileSet cull(const TileIdContainerType& tileset, const camera::Definition& camera) const
+    {
+        if (!m_occlusion_culling_enabled)
+            return cull(tileset, camera.frustum(), nullptr);
+        const auto horizon_culler = HorizonCuller(camera.position(), *m_aabb_decorator);
+        return cull(tileset, camera.frustum(), &horizon_culler);
     }
 
 private:
+    template<class TileIdContainerType>
+    TileSet cull(const TileIdContainerType& tileset, const camera::Frustum& frustum, const HorizonCuller* horizon_culler) const
+    {
+        std::vector<tile::Id> ids;
+        ids.reserve(tileset.size());
+        AabbBatch aabbs;
+        aabbs.reserve(tileset.size());
+        for (const auto& tile : tileset) {
+            ids.push_back(tile);
+            aabbs.push_back(m_aabb_decorator->aabb(tile));
+        }
+        const auto visible = BatchFrustumCuller(frustum).cull(aabbs);
+
+        std::vector<tile::Id> visible_leaves;
+        visible_leaves.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            if (visible[i] && !(horizon_culler && horizon_culler->occluded(aabbs.at(i))))
+                visible_leaves.push_back(ids[i]);
+        }
+        return TileSet(std::move(visible_leaves));
+    }
+
+    struct Decision {
+        bool refine = false;
+        // in units of m_camera_travel; the decision holds at least until the camera travelled that far
+        double valid_until = 0;
+    };
+    struct Scheduled {
+        double valid_until;
+        uint64_t stamp;
+        tile::Id id;
+        bool operator>(const Scheduled& other) const { return valid_until > other.valid_until; }
+    };
+
+    [[nodiscard]] Decision evaluate(const tile::Id& tile) const;
+    [[nodiscard]] bool is_deepest_refined(const tile::Id& tile) const;
+    void schedule(const tile::Id& tile, double valid_until);
+    void invalidate_all();
+    void collapse(const tile::Id& tile);
+
     utils::AabbDecoratorPtr m_aabb_decorator;
-    TileSet m_available_tiles;
+    nucleus::utils::TileIdSet m_available_tiles;
     float m_permissible_screen_space_error = 2.0;
+    bool m_occlusion_culling_enabled = false;
+
+    // state of the incremental traversal
+    std::set<tile::Id, IdLess> m_cut;
+    nucleus::utils::TileIdSet m_refined;
+    std::vector<tile::Id> m_dirty;
+    std::priority_queue<Scheduled, std::vector<Scheduled>, std::greater<>> m_schedule;
+    nucleus::utils::TileIdMap<Scheduled> m_scheduled;
+    uint64_t m_stamp = 0;
+    std::optional<camera::Definition> m_camera;
+    std::optional<BatchFrustumCuller> m_frustum_culler;
+    std::array<geometry::Plane<double>, 6> m_frustum_planes;
+    double m_camera_travel = 0;
+    bool m_cut_changed = true;
+    TileSet m_draw_list;
+    unsigned m_n_evaluated_tiles = 0;
 };
 }
@@ -0,0 +1,257 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "HorizonCuller.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "nucleus/srs.h"
+#include "utils.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+constexpr double pi = 3.1415926535897932384626433;
+constexpr double origin_shift = 2 * pi * 6378137 / 2.0;
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+tile::Id tile_at(const glm::dvec2& world_xy, unsigned zoom_level)
+{
+    const auto n = double(1u << zoom_level);
+    const auto to_coord = [n](double v) { return unsigned(std::clamp(std::floor((v + origin_shift) / (2 * origin_shift) * n), 0.0, n - 1)); };
+    return { zoom_level, { to_coord(world_xy.x), to_coord(world_xy.y) } };
+}
+
+struct Interval {
+    double min;
+    double max;
+};
+
+// bounds of the entry and exit distance of a horizontal ray into the slab [lower, upper] (relative to the camera), valid for
+// all ray directions of the bin. the entry is bounded from above, the exit from below.
+Interval slab_bounds(double lower, double upper, int sign, double min_abs, double max_abs)
+{
+    double near = 0;
+    double far = 0;
+    if (sign > 0) {
+        near = lower;
+        far = upper;
+    } else if (sign < 0) {
+        near = -upper;
+        far = -lower;
+    } else {
+        near = std::max(lower, -upper);
+        far = std::min(upper, -lower);
+    }
+    if (far < 0)
+        return { infinity, -infinity };
+    const auto entry = near <= 0 ? 0.0 : (min_abs > 0 ? near / min_abs : infinity);
+    const auto exit = max_abs > 0 ? far / max_abs : infinity;
+    return { entry, exit };
+}
+
+double distance_to_rect(const glm::dvec2& p, const tile::SrsBounds& r)
+{
+    const auto d = glm::max(glm::max(r.min - p, p - r.max), glm::dvec2(0));
+    return glm::length(d);
+}
+
+std::array<glm::dvec2, 4> corners_of(const tile::SrsBounds& r)
+{
+    return { r.min, glm::dvec2(r.max.x, r.min.y), r.max, glm::dvec2(r.min.x, r.max.y) };
+}
+} // namespace
+
+HorizonCuller::HorizonCuller(const glm::dvec3& camera_position, const utils::AabbDecorator& aabb_decorator)
+    : HorizonCuller(camera_position, aabb_decorator, Settings())
+{
+}
+
+HorizonCuller::HorizonCuller(const glm::dvec3& camera_position, const utils::AabbDecorator& aabb_decorator, const Settings& settings)
+    : m_camera_position(camera_position)
+    , m_settings(settings)
+    , m_bin_width(2 * pi / settings.n_azimuth_bins)
+    , m_horizon(settings.n_azimuth_bins)
+{
+    assert(settings.n_azimuth_bins > 0);
+    m_bin_ranges.reserve(settings.n_azimuth_bins);
+    for (unsigned bin = 0; bin < settings.n_azimuth_bins; ++bin) {
+        const auto from = -pi + bin * m_bin_width;
+        m_bin_ranges.push_back(angle_range(from, from + m_bin_width));
+    }
+    const auto camera_xy = glm::dvec2(camera_position);
+
+    // the argument requires the camera to be above the terrain. the aabb of the finest tile is an upper bound of the surface.
+    if (camera_position.z <= double(aabb_decorator.aabb(tile_at(camera_xy, 18)).max.z)) {
+        m_enabled = false;
+        return;
+    }
+
+    const auto z = settings.occluder_zoom_level;
+    const auto lower_left = tile_at(camera_xy - settings.occluder_radius, z);
+    const auto upper_right = tile_at(camera_xy + settings.occluder_radius, z);
+    for (auto x = lower_left.coords.x; x <= upper_right.coords.x; ++x) {
+        for (auto y = lower_left.coords.y; y <= upper_right.coords.y; ++y) {
+            const auto id = tile::Id { z, { x, y } };
+            const auto bounds = srs::tile_bounds(id);
+            if (distance_to_rect(camera_xy, bounds) > settings.occluder_radius)
+                continue;
+            // altitudes are scaled up by 1/cos(latitude) in srs space, so the unscaled minimum is a lower bound (for positive heights).
+            const auto height = double(aabb_decorator.aabb(id).min.z);
+            if (height <= 0)
+                continue;
+            add_occluder(bounds, height);
+        }
+    }
+
+    for (auto& steps : m_horizon) {
+        std::sort(steps.begin(), steps.end(), [](const HorizonStep& a, const HorizonStep& b) { return a.distance < b.distance; });
+        for (size_t i = 1; i < steps.size(); ++i)
+            steps[i].slope = std::max(steps[i].slope, steps[i - 1].slope);
+    }
+}
+
+void HorizonCuller::add_occluder(const tile::SrsBounds& bounds, double height)
+{
+    const auto camera_xy = glm::dvec2(m_camera_position);
+    if (distance_to_rect(camera_xy, bounds) <= 0)
+        return; // the camera is above this occluder (checked in the constructor), it can't block anything
+
+    const auto lower = bounds.min - camera_xy;
+    const auto upper = bounds.max - camera_xy;
+    const auto [first_bin, last_bin] = bin_span(bounds);
+    bool added = false;
+    for (int b = first_bin; b <= last_bin; ++b) {
+        const auto bin = wrap_bin(b);
+        const auto& range = m_bin_ranges[bin];
+        const auto x = slab_bounds(lower.x, upper.x, range.cos_sign, range.min_abs_cos, range.max_abs_cos);
+        const auto y = slab_bounds(lower.y, upper.y, range.sin_sign, range.min_abs_sin, range.max_abs_sin);
+        // every ray of the bin is inside the occluder between entry and exit
+        const auto entry = std::max(x.min, y.min);
+        const auto exit = std::min(x.max, y.max);
+        if (!(entry < exit) || entry <= 0)
+            continue;
+        // rays below this slope are under the terrain at distance exit (or entry, if the occluder is above the camera)
+        const auto dz = height - m_camera_position.z;
+        const auto slope = dz < 0 ? dz / exit : dz / entry;
+        m_horizon[bin].push_back({ exit, slope });
+        added = true;
+    }
+    m_n_occluders += unsigned(added);
+}
+
+HorizonCuller::AngleRange HorizonCuller::angle_range(double from, double to)
+{
+    const auto contains = [&](double angle) {
+        for (const auto a : { angle - 2 * pi, angle, angle + 2 * pi }) {
+            if (a >= from && a <= to)
+                return true;
+        }
+        return false;
+    };
+    const auto c0 = std::abs(std::cos(from));
+    const auto c1 = std::abs(std::cos(to));
+    const auto s0 = std::abs(std::sin(from));
+    const auto s1 = std::abs(std::sin(to));
+    AngleRange r {};
+    r.max_abs_cos = (contains(0) || contains(pi)) ? 1.0 : std::max(c0, c1);
+    r.min_abs_cos = (contains(pi / 2) || contains(-pi / 2)) ? 0.0 : std::min(c0, c1);
+    r.max_abs_sin = (contains(pi / 2) || contains(-pi / 2)) ? 1.0 : std::max(s0, s1);
+    r.min_abs_sin = (contains(0) || contains(pi)) ? 0.0 : std::min(s0, s1);
+    const auto middle = (from + to) / 2;
+    r.cos_sign = r.min_abs_cos > 0 ? (std::cos(middle) > 0 ? 1 : -1) : 0;
+    r.sin_sign = r.min_abs_sin > 0 ? (std::sin(middle) > 0 ? 1 : -1) : 0;
+    return r;
+}
+
+double HorizonCuller::horizon_slope(unsigned bin, double distance) const
+{
+    const auto& steps = m_horizon[bin];
+    const auto iter = std::upper_bound(steps.cbegin(), steps.cend(), distance, [](double d, const HorizonStep& s) { return d < s.distance; });
+    if (iter == steps.cbegin())
+        return -infinity;
+    return std::prev(iter)->slope;
+}
+
+bool HorizonCuller::occluded(const tile::SrsAndHeightBounds& aabb) const
+{
+    if (!m_enabled)
+        return false;
+    const auto camera_xy = glm::dvec2(m_camera_position);
+    const auto rect = tile::SrsBounds { glm::dvec2(aabb.min), glm::dvec2(aabb.max) };
+    const auto min_distance = distance_to_rect(camera_xy, rect);
+    if (min_distance <= 0)
+        return false;
+    double max_distance = 0;
+    for (const auto& c : corners_of(rect))
+        max_distance = std::max(max_distance, glm::distance(c, camera_xy));
+
+    // the steepest ray from the camera to any point of the aabb
+    const auto dz = double(aabb.max.z) - m_camera_position.z;
+    const auto slope = dz >= 0 ? dz / min_distance : dz / max_distance;
+    // small safety margins against rounding
+    const auto occluder_distance = min_distance * (1 - 1e-9) - 1e-3;
+
+    const auto [first_bin, last_bin] = bin_span(rect);
+    for (int b = first_bin; b <= last_bin; ++b) {
+        if (!(slope < horizon_slope(wrap_bin(b), occluder_distance) - 1e-9))
+            return false;
+    }
+    return true;
+}
+
+std::pair<int, int> HorizonCuller::bin_span(const tile::SrsBounds& rect) const
+{
+    // the camera is outside of the rect, so its angular range is less than pi.
+    const auto camera_xy = glm::dvec2(m_camera_position);
+    const auto centre = (rect.min + rect.max) * 0.5 - camera_xy;
+    const auto centre_angle = std::atan2(centre.y, centre.x);
+    double from = 0;
+    double to = 0;
+    for (const auto& c : corners_of(rect)) {
+        const auto d = c - camera_xy;
+        auto delta = std::atan2(d.y, d.x) - centre_angle;
+        if (delta > pi)
+            delta -= 2 * pi;
+        if (delta < -pi)
+            delta += 2 * pi;
+        from = std::min(from, delta);
+        to = std::max(to, delta);
+    }
+    return { int(std::floor((centre_angle + from + pi) / m_bin_width)), int(std::floor((centre_angle + to + pi) / m_bin_width)) };
+}
+
+unsigned HorizonCuller::wrap_bin(int bin) const
+{
+    const auto n_bins = int(m_settings.n_azimuth_bins);
+    return unsigned(((bin % n_bins) + n_bins) % n_bins);
+}
+
+bool HorizonCuller::enabled() const
+{
+    return m_enabled;
+}
+
+unsigned HorizonCuller::n_occluders() const
+{
+    return m_n_occluders;
+}
@@ -0,0 +1,83 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <radix/tile.h>
+
+namespace nucleus::tile_scheduler {
+namespace utils {
+    class AabbDecorator;
+}
+
+// Conservative terrain occlusion for tile aabbs. Below the minimum height of a tile there is solid terrain, so coarse
+// tiles around the camera (occluders) form a horizon: for every azimuth bin and distance we know an elevation below which
+// all rays hit the terrain. A tile is occluded, if in every bin it covers, even the steepest ray to the top of its aabb
+// stays below the horizon of occluders that are closer than the tile. All bounds are taken over the whole bin, so no
+// visible tile is ever culled. The horizon doesn't depend on the view direction and is rebuilt per camera position.
+// Culling is disabled if the camera might be below the terrain surface.
+class HorizonCuller {
+public:
+    struct Settings {
+        unsigned occluder_zoom_level = 14;
+        double occluder_radius = 30'000; // srs units (about metres)
+        unsigned n_azimuth_bins = 256;
+    };
+
+    HorizonCuller(const glm::dvec3& camera_position, const utils::AabbDecorator& aabb_decorator);
+    HorizonCuller(const glm::dvec3& camera_position, const utils::AabbDecorator& aabb_decorator, const Settings& settings);
+
+    [[nodiscard]] bool occluded(const tile::SrsAndHeightBounds& aabb) const;
+    [[nodiscard]] bool enabled() const;
+    [[nodiscard]] unsigned n_occluders() const;
+
+private:
+    struct HorizonStep {
+        double distance; // the horizon holds for everything further away
+        double slope; // tan of the elevation angle
+    };
+    struct AngleRange {
+        double min_abs_cos;
+        double max_abs_cos;
+        double min_abs_sin;
+        double max_abs_sin;
+        int cos_sign; // 0 if both signs occur
+        int sin_sign;
+    };
+    [[nodiscard]] static AngleRange angle_range(double from, double to);
+    void add_occluder(const tile::SrsBounds& bounds, double height);
+    [[nodiscard]] double horizon_slope(unsigned bin, double distance) const;
+    // first and last azimuth bin covered by rect (unwrapped, last may be smaller than first + n_bins)
+    [[nodiscard]] std::pair<int, int> bin_span(const tile::SrsBounds& rect) const;
+    [[nodiscard]] unsigned wrap_bin(int bin) const;
+
+    glm::dvec3 m_camera_position;
+    Settings m_settings;
+    bool m_enabled = true;
+    unsigned m_n_occluders = 0;
+    double m_bin_width = 0;
+    std::vector<AngleRange> m_bin_ranges;
+    // per azimuth bin, sorted by distance, slope is the running maximum
+    std::vector<std::vector<HorizonStep>> m_horizon;
+};
+
+}
@@ -18,17 +18,32 @@
 
 #include "LayerAssembler.h"
 
+#include "utils.h"
+#include "nucleus/utils/height_codec.h"
+#include "nucleus/utils/image_loader.h"
+
 using namespace nucleus::tile_scheduler;
 
+namespace {
+tile_types::TileLayer not_covered_tile(const tile::Id& id)
+{
+    return { id, { tile_types::NetworkInfo::Status::NotFound, utils::time_since_epoch() }, std::make_shared<QByteArray>() };
+}
+tile_types::TileLayer disabled_tile(const tile::Id& id)
+{
+    return { id, { tile_types::NetworkInfo::Status::Good, utils::time_since_epoch() }, std::make_shared<QByteArray>() };
+}
+} // namespace
+
 LayerAssembler::LayerAssembler(QObject* parent)
     : QObject { parent }
 {
 }
 
 #ifdef ALP_ENABLE_LABELS
-size_t LayerAssembler::n_items_in_flight() const { return m_height_data.size() + m_ortho_data.size() + m_vector_tile_data.size(); }
+size_t LayerAssembler::n_items_in_flight() const { return m_height.data.size() + m_ortho.data.size() + m_vector_tile.data.size(); }
 #else
-size_t LayerAssembler::n_items_in_flight() const { return m_height_data.size() + m_ortho_data.size(); }
+size_t LayerAssembler::n_items_in_flight() const { return m_height.data.size() + m_ortho.data.size(); }
 
 #endif
 
@@ -64,49 +79,120 @@ tile_types::LayeredTile LayerAssembler::join(const tile_types::TileLayer& ortho_
 }
 #endif
 
+void LayerAssembler::set_ortho_meta_data(const tile_types::LayerMetaData& meta_data) { m_ortho.meta_data = meta_data; }
+
+void LayerAssembler::set_height_meta_data(const tile_types::LayerMetaData& meta_data) { m_height.meta_data = meta_data; }
+
+#ifdef ALP_ENABLE_LABELS
+void LayerAssembler::set_vectortile_meta_data(const tile_types::LayerMetaData& meta_data) { m_vector_tile.meta_data = meta_data; }
+#endif
+
+void LayerAssembler::set_ortho_zoom_offset(unsigned zoom_offset) { m_ortho.zoom_offset = zoom_offset; }
+
+void LayerAssembler::set_height_zoom_offset(unsigned zoom_offset) { m_height.zoom_offset = zoom_offset; }
+
+void LayerAssembler::set_ortho_enabled(bool enabled) { m_ortho.enabled = enabled; }
+
+void LayerAssembler::set_height_enabled(bool enabled) { m_height.enabled = enabled; }
+
+#ifdef ALP_ENABLE_LABELS
+void LayerAssembler::set_vectortile_enabled(bool enabled) { m_vector_tile.enabled = enabled; }
+#endif
+
+void LayerAssembler::set_height_transcoding_enabled(bool enabled) { m_height_transcoding = enabled; }
+
 void LayerAssembler::load(const tile::Id& tile_id)
 {
-    emit tile_requested(tile_id);
-}
+    if (const auto id = prepare_request(&m_ortho, tile_id))
+        emit ortho_requested(*id);
 
-void LayerAssembler::deliver_ortho(const tile_types::TileLayer& tile)
-{
-    m_ortho_data[tile.id] = tile;
-    check_and_emit(tile.id);
+    if (const auto id = prepare_request(&m_height, tile_id))
+        emit height_requested(*id);
+
+#ifdef ALP_ENABLE_LABELS
+    if (const auto id = prepare_request(&m_vector_tile, tile_id))
+        emit vectortile_requested(*id);
+#endif
+
+    // happens if no layer has to be requested
+    check_and_emit(tile_id);
 }
 
+void LayerAssembler::deliver_ortho(const tile_types::TileLayer& tile) { receive(&m_ortho, tile); }
+
 void LayerAssembler::deliver_height(const tile_types::TileLayer& tile)
 {
-    m_height_data[tile.id] = tile;
-    check_and_emit(tile.id);
+    if (!m_height_transcoding || !tile.data || tile.data->isEmpty() || nucleus::utils::height_codec::is_encoded(*tile.data))
+        return receive(&m_height, tile);
+
+    auto transcoded = tile;
+    transcoded.data = std::make_shared<QByteArray>(nucleus::utils::height_codec::encode(nucleus::utils::image_loader::height(*tile.data)));
+    receive(&m_height, transcoded);
 }
 
 #ifdef ALP_ENABLE_LABELS
-void LayerAssembler::deliver_vectortile(const tile_types::TileLayer& tile)
+void LayerAssembler::deliver_vectortile(const tile_types::TileLayer& tile) { receive(&m_vector_tile, tile); }
+#endif
+
+std::optional<tile::Id> LayerAssembler::prepare_request(Layer* layer, const tile::Id& tile_id)
+{
+    if (!layer->enabled) {
+        layer->data[tile_id] = disabled_tile(tile_id);
+        return {};
+    }
+    const auto layer_tile_id = utils::ancestor(tile_id, layer->zoom_offset);
+    if (!layer->meta_data.covers(layer_tile_id)) {
+        layer->data[tile_id] = not_covered_tile(tile_id);
+        return {};
+    }
+    auto& waiting = layer->waiting[layer_tile_id];
+    waiting.push_back(tile_id);
+    if (waiting.size() > 1)
+        return {}; // already requested for a sibling
+    return layer_tile_id;
+}
+
+void LayerAssembler::receive(Layer* layer, const tile_types::TileLayer& tile)
 {
-    m_vector_tile_data[tile.id] = tile;
-    check_and_emit(tile.id);
+    std::vector<tile::Id> tile_ids;
+    if (const auto iter = layer->waiting.find(tile.id); iter != layer->waiting.end()) {
+        tile_ids = std::move(iter->second);
+        layer->waiting.erase(iter);
+    } else {
+        tile_ids.push_back(tile.id); // delivered without load, keep it for when the other layers arrive
+    }
+
+    for (const auto& tile_id : tile_ids) {
+        auto& layer_tile = layer->data[tile_id];
+        layer_tile = tile;
+        layer_tile.id = tile_id;
+    }
+    for (const auto& tile_id : tile_ids)
+        check_and_emit(tile_id);
 }
-#endif
 
 void LayerAssembler::check_and_emit(const tile::Id& tile_id)
 {
 #ifdef ALP_ENABLE_LABELS
-    if (m_ortho_data.contains(tile_id) && m_height_data.contains(tile_id) && m_vector_tile_data.contains(tile_id)
-
+    if (m_ortho.data.contains(tile_id) && m_height.data.contains(tile_id) && m_vector_tile.data.contains(tile_id))
 #else
-    if (m_ortho_data.contains(tile_id) && m_height_data.contains(tile_id))
+    if (m_ortho.data.contains(tile_id) && m_height.data.contains(tile_id))
 #endif
     {
 #ifdef ALP_ENABLE_LABELS
-        emit tile_loaded(join(m_ortho_data[tile_id], m_height_data[tile_id], m_vector_tile_data[tile_id]));
+        auto tile = join(m_ortho.data[tile_id], m_height.data[tile_id], m_vector_tile.data[tile_id]);
 #else
-        emit tile_loaded(join(m_ortho_data[tile_id], m_height_data[tile_id]));
+        auto tile = join(m_ortho.data[tile_id], m_height.data[tile_id]);
 #endif
-        m_ortho_data.erase(tile_id);
-        m_height_data.erase(tile_id);
+        const auto effective_offset = [&tile_id](const Layer& layer) { return layer.enabled ? std::min(layer.zoom_offset, tile_id.zoom_level) : 0u; };
+        tile.ortho_zoom_offset = effective_offset(m_ortho);
+        tile.height_zoom_offset = effective_offset(m_height);
+        emit tile_loaded(tile);
+
+        m_ortho.data.erase(tile_id);
+        m_height.data.erase(tile_id);
 #ifdef ALP_ENABLE_LABELS
-        m_vector_tile_data.erase(tile_id);
+        m_vector_tile.data.erase(tile_id);
 #endif
     }
 }
@@ -18,27 +18,62 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <optional>
 
 #include <QObject>
 
+#include "nucleus/utils/TileIdMap.h"
 #include "tile_types.h"
 
 namespace nucleus::tile_scheduler {
 
 class LayerAssembler : public QObject {
     Q_OBJECT
-    using TileId2DataMap = std::unordered_map<tile::Id, tile_types::TileLayer, tile::Id::Hasher>;
+    using TileId2DataMap = nucleus::utils::TileIdMap<tile_types::TileLayer>;
+    using TileId2TileIdsMap = nucleus::utils::TileIdMap<std::vector<tile::Id>>;
 
-    TileId2DataMap m_ortho_data;
-    TileId2DataMap m_height_data;
+    struct Layer {
+        TileId2DataMap data;
+        TileId2TileIdsMap waiting; // layer tile id -> ids of the tiles waiting for it (several, if zoom_offset > 0)
+        tile_types::LayerMetaData meta_data;
+        unsigned zoom_offset = 0;
+        bool enabled = true;
+    };
+
+    Layer m_ortho;
+    Layer m_height;
 #ifdef ALP_ENABLE_LABELS
-    TileId2DataMap m_vector_tile_data;
+    Layer m_vector_tile;
 #endif
+    bool m_height_transcoding = false;
 
 public:
     explicit LayerAssembler(QObject* parent = nullptr);
     [[nodiscard]] size_t n_items_in_flight() const;
+
+    // layers are only requested (and waited for) if their meta data covers the tile. otherwise they are treated as not found.
+    void set_ortho_meta_data(const tile_types::LayerMetaData& meta_data);
+    void set_height_meta_data(const tile_types::LayerMetaData& meta_data);
+#ifdef ALP_ENABLE_LABELS
+    void set_vectortile_meta_data(const tile_types::LayerMetaData& meta_data);
+#endif
+
+    // with a zoom offset of n, the layer is loaded from the ancestor n levels up (e.g., coarser ortho on metered connections).
+    // the offset is stored in the LayeredTile, consumers must cut out the part that belongs to the tile.
+    void set_ortho_zoom_offset(unsigned zoom_offset);
+    void set_height_zoom_offset(unsigned zoom_offset);
+
+    // disabled layers are not requested and delivered empty, but with good network status (e.g., height only for compute).
+    void set_ortho_enabled(bool enabled);
+    void set_height_enabled(bool enabled);
+#ifdef ALP_ENABLE_LABELS
+    void set_vectortile_enabled(bool enabled);
+#endif
+
+    // re-encodes delivered height pngs with the native height codec (see nucleus/utils/height_codec.h), before they are
+    // shared between tiles and end up in the ram and disk cache. off by default, so data passes through untouched.
+    void set_height_transcoding_enabled(bool enabled);
+
 #ifdef ALP_ENABLE_LABELS
     static tile_types::LayeredTile join(
         const tile_types::TileLayer& ortho_tile, const tile_types::TileLayer& height_tile, const tile_types::TileLayer& vector_tile);
@@ -54,10 +89,17 @@ public slots:
 #endif
 
 signals:
-    void tile_requested(const tile::Id& tile_id);
+    void ortho_requested(const tile::Id& tile_id);
+    void height_requested(const tile::Id& tile_id);
+#ifdef ALP_ENABLE_LABELS
+    void vectortile_requested(const tile::Id& tile_id);
+#endif
     void tile_loaded(const tile_types::LayeredTile& tile);
 
 private:
+    /// returns the id, that should be requested from the layer's service (if any)
+    static std::optional<tile::Id> prepare_request(Layer* layer, const tile::Id& tile_id);
+    void receive(Layer* layer, const tile_types::TileLayer& tile);
     void check_and_emit(const tile::Id& tile_id);
 };
 
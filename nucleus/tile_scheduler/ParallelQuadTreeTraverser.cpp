@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "ParallelQuadTreeTraverser.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace nucleus::tile_scheduler;
+
+ParallelQuadTreeTraverser::ParallelQuadTreeTraverser(nucleus::utils::WorkerPool& pool)
+    : m_pool(pool)
+{
+    for (unsigned i = 0; i < m_pool.n_threads(); ++i)
+        m_workers.push_back(std::make_unique<Worker>());
+}
+
+ParallelQuadTreeTraverser::Result ParallelQuadTreeTraverser::traverse(const tile::Id& root, const RefineFunction& refine)
+{
+    m_refine = &refine;
+    m_n_pending = 1;
+    m_n_queued = 1;
+    m_workers.front()->tasks.push_back(root);
+    // one task per worker queue. a task returns only when the whole traversal is done, so if the pool runs the tasks
+    // serially, the first one does all the work and the others return immediately.
+    m_pool.parallel_for(unsigned(m_workers.size()), [this](unsigned worker_index) { work(worker_index); });
+    m_refine = nullptr;
+
+    Result result;
+    for (auto& worker : m_workers) {
+        result.leaves.insert(result.leaves.end(), worker->leaves.cbegin(), worker->leaves.cend());
+        result.inner_nodes.insert(result.inner_nodes.end(), worker->inner_nodes.cbegin(), worker->inner_nodes.cend());
+        worker->leaves.clear();
+        worker->inner_nodes.clear();
+    }
+    if (m_workers.size() > 1) {
+        sort_depth_first(&result.leaves);
+        sort_depth_first(&result.inner_nodes);
+    }
+    return result;
+}
+
+unsigned ParallelQuadTreeTraverser::n_threads() const
+{
+    return unsigned(m_workers.size());
+}
+
+void ParallelQuadTreeTraverser::sort_depth_first(std::vector<tile::Id>* ids)
+{
+    // the path from the root as a sequence of child indices (2 bits per level, most significant first). a descendant has the
+    // key of its ancestor in the leading bits, so ties are broken by the zoom level.
+    const auto path_key = [](tile::Id id) {
+        assert(id.zoom_level <= 31);
+        uint64_t key = 0;
+        while (id.zoom_level > 0) {
+            const auto parent = id.parent();
+            const auto siblings = parent.children();
+            const auto index = uint64_t(std::find(siblings.cbegin(), siblings.cend(), id) - siblings.cbegin());
+            key |= index << (64 - 2 * id.zoom_level);
+            id = parent;
+        }
+        return key;
+    };
+    std::vector<std::pair<uint64_t, tile::Id>> keyed;
+    keyed.reserve(ids->size());
+    for (const auto& id : *ids)
+        keyed.emplace_back(path_key(id), id);
+    std::sort(keyed.begin(), keyed.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first || (a.first == b.first && a.second.zoom_level < b.second.zoom_level);
+    });
+    for (size_t i = 0; i < keyed.size(); ++i)
+        (*ids)[i] = keyed[i].second;
+}
+
+void ParallelQuadTreeTraverser::work(unsigned worker_index)
+{
+    auto& worker = *m_workers[worker_index];
+    tile::Id tile {};
+    while (true) {
+        if (!take_task(worker_index, &tile)) {
+            // the others are still refining, wait for their children (or the end of the traversal).
+            std::unique_lock lock(m_idle_mutex);
+            ++m_n_idle;
+            m_idle_condition.wait(lock, [this]() { return m_n_pending.load() == 0 || m_n_queued.load() > 0; });
+            --m_n_idle;
+            if (m_n_pending.load() == 0)
+                return;
+            continue;
+        }
+        if ((*m_refine)(tile)) {
+            worker.inner_nodes.push_back(tile);
+            const auto children = tile.children();
+            m_n_pending += int64_t(children.size());
+            {
+                std::unique_lock lock(worker.mutex);
+                // reversed, so that the first child is taken next
+                worker.tasks.insert(worker.tasks.end(), children.crbegin(), children.crend());
+                m_n_queued += int64_t(children.size());
+            }
+            if (m_n_idle.load() > 0)
+                notify_idle_workers();
+        } else {
+            worker.leaves.push_back(tile);
+        }
+        if (--m_n_pending == 0)
+            notify_idle_workers();
+    }
+}
+
+void ParallelQuadTreeTraverser::notify_idle_workers()
+{
+    // taking the lock orders the notification after a concurrent check of the wait predicate.
+    { std::unique_lock lock(m_idle_mutex); }
+    m_idle_condition.notify_all();
+}
+
+bool ParallelQuadTreeTraverser::take_task(unsigned worker_index, tile::Id* task)
+{
+    {
+        auto& own = *m_workers[worker_index];
+        std::unique_lock lock(own.mutex);
+        if (!own.tasks.empty()) {
+            *task = own.tasks.back();
+            own.tasks.pop_back();
+            --m_n_queued;
+            return true;
+        }
+    }
+    for (unsigned i = 1; i < m_workers.size(); ++i) {
+        auto& victim = *m_workers[(worker_index + i) % m_workers.size()];
+        std::unique_lock lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            --m_n_queued;
+            return true;
+        }
+    }
+    return false;
+}
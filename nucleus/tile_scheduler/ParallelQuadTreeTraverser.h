@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <radix/tile.h>
+
+#include "nucleus/utils/WorkerPool.h"
+
+namespace nucleus::tile_scheduler {
+
+// Refines the quad tree like quad_tree::onTheFlyTraverse, but subtrees are distributed across the threads of a
+// WorkerPool. Every worker takes tiles from the back of its own queue (depth first) and steals from the front of the
+// others (large subtrees), workers without anything to steal sleep until new tiles are queued. The results are sorted into
+// depth first order afterwards, so they are identical to the serial traversal, independently of the scheduling. The refine
+// function is called concurrently and must be thread safe (utils::refineFunctor is). If the pool is busy with another job,
+// the traversal runs serially on the calling thread.
+class ParallelQuadTreeTraverser {
+public:
+    using RefineFunction = std::function<bool(const tile::Id&)>;
+    struct Result {
+        std::vector<tile::Id> leaves;
+        std::vector<tile::Id> inner_nodes; // in the order in which the serial traversal generates their children
+    };
+
+    explicit ParallelQuadTreeTraverser(nucleus::utils::WorkerPool& pool = nucleus::utils::WorkerPool::shared());
+    ParallelQuadTreeTraverser(const ParallelQuadTreeTraverser&) = delete;
+    ParallelQuadTreeTraverser& operator=(const ParallelQuadTreeTraverser&) = delete;
+
+    [[nodiscard]] Result traverse(const tile::Id& root, const RefineFunction& refine);
+    [[nodiscard]] unsigned n_threads() const;
+
+    // depth first (pre-)order of the serial traversal, ancestors come before their descendants.
+    static void sort_depth_first(std::vector<tile::Id>* ids);
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<tile::Id> tasks;
+        std::vector<tile::Id> leaves;
+        std::vector<tile::Id> inner_nodes;
+    };
+    void work(unsigned worker_index);
+    bool take_task(unsigned worker_index, tile::Id* task);
+    void notify_idle_workers();
+
+    nucleus::utils::WorkerPool& m_pool;
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    const RefineFunction* m_refine = nullptr;
+    // tiles that are queued or being processed. the traversal is done when it drops to 0.
+    std::atomic<int64_t> m_n_pending = 0;
+    std::atomic<int64_t> m_n_queued = 0; // tiles in the queues of the workers
+    std::atomic<unsigned> m_n_idle = 0;
+    std::mutex m_idle_mutex;
+    std::condition_variable m_idle_condition; // new tiles were queued, or the traversal is done
+};
+
+}
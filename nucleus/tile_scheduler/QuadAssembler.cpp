@@ -18,32 +18,157 @@
 
 #include "QuadAssembler.h"
 
+#include <algorithm>
+#include <vector>
+
+#include <QTimer>
+
 using namespace nucleus::tile_scheduler;
 
 QuadAssembler::QuadAssembler(QObject *parent)
     : QObject{parent}
+    , m_timeout_timer(std::make_unique<QTimer>(this))
 {
+    m_timeout_timer->setSingleShot(true);
+    connect(m_timeout_timer.get(), &QTimer::timeout, this, &QuadAssembler::process_deadlines);
 }
 
+QuadAssembler::~QuadAssembler() = default;
+
 size_t QuadAssembler::n_items_in_flight() const
 {
     return m_quads.size();
 }
 
+void QuadAssembler::set_timeout(unsigned msecs)
+{
+    assert(msecs < unsigned(std::numeric_limits<int>::max()));
+    m_timeout = msecs;
+}
+
+unsigned QuadAssembler::timeout() const
+{
+    return m_timeout;
+}
+
+namespace {
+bool contains_tile(const nucleus::tile_scheduler::tile_types::TileQuad& quad, const tile::Id& id)
+{
+    const auto tiles_end = quad.tiles.cbegin() + quad.n_tiles;
+    return std::find_if(quad.tiles.cbegin(), tiles_end, [&](const auto& t) { return t.id == id; }) != tiles_end;
+}
+} // namespace
+
 void QuadAssembler::load(const tile::Id& tile_id)
 {
-    m_quads[tile_id].id = tile_id;
-    for (const auto& child_id : tile_id.children()) {
+    const auto [iter, inserted] = m_quads.try_emplace(tile_id);
+    auto& quad = iter->second.quad;
+    quad.id = tile_id;
+    if (inserted) {
+        const auto partial = m_partial_quads.find(tile_id);
+        if (partial != m_partial_quads.end()) {
+            quad = std::move(partial->second.quad);
+            m_partial_quads.erase(partial);
+            if (quad.n_tiles == 4) {
+                // all missing tiles arrived late, nothing to request.
+                const auto finished_quad = std::move(quad);
+                m_quads.erase(iter);
+                emit quad_loaded(finished_quad);
+                return;
+            }
+        }
+        if (m_timeout > 0) {
+            iter->second.deadline = utils::time_since_epoch() + m_timeout;
+            m_deadlines.emplace_back(iter->second.deadline, tile_id);
+            if (!m_timeout_timer->isActive())
+                m_timeout_timer->start(int(m_timeout));
+        }
+    }
+    // copy the children, emitting might reenter and invalidate quad.
+    const auto missing = [&]() {
+        std::vector<tile::Id> ids;
+        for (const auto& child_id : tile_id.children()) {
+            if (!contains_tile(quad, child_id))
+                ids.push_back(child_id);
+        }
+        return ids;
+    }();
+    for (const auto& child_id : missing) {
         emit tile_requested(child_id);
     }
 }
 
 void QuadAssembler::deliver_tile(const tile_types::LayeredTile& tile)
 {
-    auto& quad = m_quads[tile.id.parent()];
+    const auto iter = m_quads.find(tile.id.parent());
+    if (iter == m_quads.end()) {
+        // late tile of a quad, that was already emitted as partial. keep it for the retry.
+        const auto partial = m_partial_quads.find(tile.id.parent());
+        if (partial != m_partial_quads.end() && !contains_tile(partial->second.quad, tile.id))
+            partial->second.quad.tiles[partial->second.quad.n_tiles++] = tile;
+        return;
+    }
+
+    auto& quad = iter->second.quad;
+    if (contains_tile(quad, tile.id))
+        return; // a retry raced with the original request.
+
     quad.tiles[quad.n_tiles++] = tile;
     if (quad.n_tiles == 4) {
+        // erase before emitting, the receiver might load new quads.
+        const auto finished_quad = std::move(quad);
+        m_quads.erase(iter);
+        emit quad_loaded(finished_quad);
+    }
+}
+
+void QuadAssembler::process_deadlines()
+{
+    const auto now = utils::time_since_epoch();
+    while (!m_deadlines.empty() && m_deadlines.front().first <= now) {
+        const auto [deadline, quad_id] = m_deadlines.front();
+        m_deadlines.pop_front();
+        const auto iter = m_quads.find(quad_id);
+        if (iter == m_quads.end() || iter->second.deadline != deadline)
+            continue; // completed in time (or loaded again later)
+
+        auto quad = std::move(iter->second.quad);
+        m_quads.erase(iter);
+        store_partial(quad);
+        for (const auto& child_id : quad_id.children()) {
+            if (contains_tile(quad, child_id))
+                continue;
+            auto& missing = quad.tiles[quad.n_tiles++];
+            missing.id = child_id;
+            missing.network_info = { tile_types::NetworkInfo::Status::NetworkError, now };
+            missing.ortho = std::make_shared<QByteArray>();
+            missing.height = std::make_shared<QByteArray>();
+#ifdef ALP_ENABLE_LABELS
+            missing.vector_tile = std::make_shared<QByteArray>();
+#endif
+        }
         emit quad_loaded(quad);
-        m_quads.erase(quad.id);
     }
+    if (!m_deadlines.empty())
+        m_timeout_timer->start(int(m_deadlines.front().first - now));
+}
+
+void QuadAssembler::store_partial(const tile_types::TileQuad& quad)
+{
+    const auto sequence_number = m_next_sequence_number++;
+    m_partial_quads[quad.id] = { quad, sequence_number };
+    m_partial_order.emplace_back(sequence_number, quad.id);
+
+    const auto is_stale = [this](const std::pair<uint64_t, tile::Id>& item) {
+        const auto iter = m_partial_quads.find(item.second);
+        return iter == m_partial_quads.end() || iter->second.sequence_number != item.first;
+    };
+    while (!m_partial_order.empty() && (m_partial_quads.size() > max_partial_quads || is_stale(m_partial_order.front()))) {
+        if (!is_stale(m_partial_order.front()))
+            m_partial_quads.erase(m_partial_order.front().second);
+        m_partial_order.pop_front();
+    }
+    // stale entries behind a long lived partial quad
+    if (m_partial_order.size() > 2 * max_partial_quads)
+        std::erase_if(m_partial_order, is_stale);
 }
@@ -18,29 +18,64 @@
 
 #pragma once
 
-#include <unordered_map>
+#include <deque>
+#include <memory>
 
 #include <QObject>
 
+#include "nucleus/utils/TileIdMap.h"
 #include "radix/tile.h"
 #include "tile_types.h"
 
+class QTimer;
+
 namespace nucleus::tile_scheduler {
 
 class QuadAssembler : public QObject {
     Q_OBJECT
-    using TileId2QuadMap = std::unordered_map<tile::Id, tile_types::TileQuad, tile::Id::Hasher>;
+    struct PendingQuad {
+        tile_types::TileQuad quad;
+        uint64_t deadline = 0;
+    };
+    using TileId2QuadMap = nucleus::utils::TileIdMap<PendingQuad>;
 
     TileId2QuadMap m_quads;
+    std::deque<std::pair<uint64_t, tile::Id>> m_deadlines; // ordered by time, entries of completed quads are skipped
+    struct PartialQuad {
+        tile_types::TileQuad quad;
+        uint64_t sequence_number = 0;
+    };
+    // tiles that arrived for quads emitted as partial (in time or late). loading such a quad again only requests the
+    // missing tiles. bounded by max_partial_quads, the oldest are dropped first (and requested in full on a retry).
+    nucleus::utils::TileIdMap<PartialQuad> m_partial_quads;
+    // ordered by age, entries whose sequence number doesn't match (consumed or emitted as partial again) are skipped
+    std::deque<std::pair<uint64_t, tile::Id>> m_partial_order;
+    uint64_t m_next_sequence_number = 0;
+    std::unique_ptr<QTimer> m_timeout_timer;
+    unsigned m_timeout = 0;
 
 public:
+    static constexpr size_t max_partial_quads = 1024;
+
     explicit QuadAssembler(QObject* parent = nullptr);
+    ~QuadAssembler() override;
     [[nodiscard]] size_t n_items_in_flight() const;
+    // quads that are not complete after timeout msecs are emitted as partial. the missing tiles are marked as network
+    // errors with empty data, so that the scheduler can draw a fallback and request them again. only the missing tiles
+    // are requested on the next load of that quad. 0 disables the deadline.
+    void set_timeout(unsigned msecs);
+    [[nodiscard]] unsigned timeout() const;
 
 public slots:
     void load(const tile::Id& tile_id);
     void deliver_tile(const tile_types::LayeredTile& tile);
 
+private slots:
+    void process_deadlines();
+
+private:
+    void store_partial(const tile_types::TileQuad& quad);
+
 signals:
     void tile_requested(const tile::Id& tile_id);
     void quad_loaded(const tile_types::TileQuad& tile);
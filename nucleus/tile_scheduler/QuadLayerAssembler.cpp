@@ -0,0 +1,192 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "QuadLayerAssembler.h"
+
+#include "utils.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+const auto invalid_id = tile::Id { std::numeric_limits<unsigned>::max(), { 0, 0 } };
+
+std::shared_ptr<QByteArray>& layer_data(tile_types::LayeredTile& tile, QuadLayerAssembler::Layer layer)
+{
+    using Layer = QuadLayerAssembler::Layer;
+    switch (layer) {
+    case Layer::Ortho:
+        return tile.ortho;
+    case Layer::Height:
+        return tile.height;
+#ifdef ALP_ENABLE_LABELS
+    case Layer::VectorTile:
+        return tile.vector_tile;
+#endif
+    }
+    assert(false);
+    return tile.ortho;
+}
+} // namespace
+
+QuadLayerAssembler::QuadLayerAssembler(QObject* parent)
+    : QObject { parent }
+    , m_empty_data(std::make_shared<QByteArray>())
+{
+}
+
+size_t QuadLayerAssembler::n_items_in_flight() const { return m_slots.size() - m_free_slots.size(); }
+
+void QuadLayerAssembler::set_meta_data(Layer layer, const tile_types::LayerMetaData& meta_data) { m_meta_data[unsigned(layer)] = meta_data; }
+
+void QuadLayerAssembler::load(const tile::Id& quad_id)
+{
+    if (find_slot(quad_id).has_value())
+        return;
+
+    unsigned slot_index = 0;
+    if (m_free_slots.empty()) {
+        slot_index = unsigned(m_slots.size());
+        m_slots.emplace_back();
+        m_slot_ids.push_back(quad_id);
+    } else {
+        slot_index = m_free_slots.back();
+        m_free_slots.pop_back();
+        m_slot_ids[slot_index] = quad_id;
+    }
+
+    Slot& slot = m_slots[slot_index];
+    slot.quad.id = quad_id;
+    slot.quad.n_tiles = 4;
+    slot.n_missing = 0;
+    const auto children = quad_id.children();
+    const auto now = utils::time_since_epoch();
+    for (unsigned i = 0; i < 4; ++i) {
+        slot.quad.tiles[i] = { children[i], {}, m_empty_data, m_empty_data };
+#ifdef ALP_ENABLE_LABELS
+        slot.quad.tiles[i].vector_tile = m_empty_data;
+#endif
+        slot.missing_layers[i] = 0;
+        for (unsigned l = 0; l < n_layers; ++l) {
+            if (m_meta_data[l].covers(children[i])) {
+                slot.missing_layers[i] |= uint8_t(1u << l);
+                ++slot.n_missing;
+            } else {
+                slot.network_infos[i][l] = { tile_types::NetworkInfo::Status::NotFound, now };
+            }
+        }
+    }
+
+    // copy, signals might cause deliveries (direct connections), which could reuse the slot
+    const auto missing_layers = slot.missing_layers;
+    if (slot.n_missing == 0) {
+        finish(slot_index);
+        return;
+    }
+    for (unsigned i = 0; i < 4; ++i) {
+        for (unsigned l = 0; l < n_layers; ++l) {
+            if (missing_layers[i] & (1u << l))
+                request(Layer(l), children[i]);
+        }
+    }
+}
+
+void QuadLayerAssembler::deliver(Layer layer, const tile::Id& tile_id, const tile_types::NetworkInfo& network_info, std::shared_ptr<QByteArray>&& data)
+{
+    if (tile_id.zoom_level == 0)
+        return;
+    const auto slot_index = find_slot(tile_id.parent());
+    if (!slot_index.has_value())
+        return; // not requested or already delivered
+    Slot& slot = m_slots[*slot_index];
+
+    const auto layer_bit = uint8_t(1u << unsigned(layer));
+    for (unsigned i = 0; i < 4; ++i) {
+        if (slot.quad.tiles[i].id != tile_id)
+            continue;
+        if (!(slot.missing_layers[i] & layer_bit))
+            return; // delivered twice
+        slot.missing_layers[i] &= uint8_t(~layer_bit);
+        slot.network_infos[i][unsigned(layer)] = network_info;
+        if (data)
+            layer_data(slot.quad.tiles[i], layer) = std::move(data);
+        if (--slot.n_missing == 0)
+            finish(*slot_index);
+        return;
+    }
+}
+
+void QuadLayerAssembler::deliver_ortho(const tile_types::TileLayer& tile) { deliver(Layer::Ortho, tile.id, tile.network_info, std::shared_ptr(tile.data)); }
+
+void QuadLayerAssembler::deliver_height(const tile_types::TileLayer& tile) { deliver(Layer::Height, tile.id, tile.network_info, std::shared_ptr(tile.data)); }
+
+#ifdef ALP_ENABLE_LABELS
+void QuadLayerAssembler::deliver_vectortile(const tile_types::TileLayer& tile)
+{
+    deliver(Layer::VectorTile, tile.id, tile.network_info, std::shared_ptr(tile.data));
+}
+#endif
+
+std::optional<unsigned> QuadLayerAssembler::find_slot(const tile::Id& quad_id) const
+{
+    for (unsigned i = 0; i < m_slot_ids.size(); ++i) {
+        if (m_slot_ids[i] == quad_id)
+            return i;
+    }
+    return {};
+}
+
+void QuadLayerAssembler::request(Layer layer, const tile::Id& tile_id)
+{
+    switch (layer) {
+    case Layer::Ortho:
+        emit ortho_requested(tile_id);
+        break;
+    case Layer::Height:
+        emit height_requested(tile_id);
+        break;
+#ifdef ALP_ENABLE_LABELS
+    case Layer::VectorTile:
+        emit vectortile_requested(tile_id);
+        break;
+#endif
+    }
+}
+
+void QuadLayerAssembler::finish(unsigned slot_index)
+{
+    Slot& slot = m_slots[slot_index];
+    for (unsigned i = 0; i < 4; ++i) {
+        auto& tile = slot.quad.tiles[i];
+        const auto& infos = slot.network_infos[i];
+        // same as LayerAssembler::join: the vector tile might be 404 if empty, it doesn't influence the status
+        tile.network_info = tile_types::NetworkInfo::join(infos[unsigned(Layer::Ortho)], infos[unsigned(Layer::Height)]);
+        if (tile.network_info.status == tile_types::NetworkInfo::Status::Good)
+            continue;
+        tile.ortho = m_empty_data;
+        tile.height = m_empty_data;
+#ifdef ALP_ENABLE_LABELS
+        tile.vector_tile = m_empty_data;
+#endif
+    }
+
+    const auto quad = std::move(slot.quad);
+    slot.quad = {};
+    m_slot_ids[slot_index] = invalid_id;
+    m_free_slots.push_back(slot_index);
+    emit quad_loaded(quad);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <optional>
+#include <vector>
+
+#include <QObject>
+
+#include "radix/tile.h"
+#include "tile_types.h"
+
+namespace nucleus::tile_scheduler {
+
+/// Replaces the QuadAssembler -> LayerAssembler chain by a single object. Completion is tracked per quad in a flat table,
+/// which is scanned linearly (the SlotLimiter keeps the number of quads in flight small). Payloads delivered via deliver()
+/// are moved into the quad, no per tile maps or copies are involved. Zoom offsets (see LayerAssembler) are not supported.
+class QuadLayerAssembler : public QObject {
+    Q_OBJECT
+public:
+#ifdef ALP_ENABLE_LABELS
+    enum class Layer : unsigned { Ortho = 0, Height = 1, VectorTile = 2 };
+    static constexpr unsigned n_layers = 3;
+#else
+    enum class Layer : unsigned { Ortho = 0, Height = 1 };
+    static constexpr unsigned n_layers = 2;
+#endif
+
+private:
+    struct Slot {
+        tile_types::TileQuad quad;
+        std::array<std::array<tile_types::NetworkInfo, n_layers>, 4> network_infos = {};
+        std::array<uint8_t, 4> missing_layers = {}; // bit mask per child
+        unsigned n_missing = 0;
+    };
+
+    std::vector<tile::Id> m_slot_ids; // quad id per slot, invalid_id for free slots
+    std::vector<Slot> m_slots;
+    std::vector<unsigned> m_free_slots;
+    std::array<tile_types::LayerMetaData, n_layers> m_meta_data = {};
+    std::shared_ptr<QByteArray> m_empty_data;
+
+public:
+    explicit QuadLayerAssembler(QObject* parent = nullptr);
+    [[nodiscard]] size_t n_items_in_flight() const;
+
+    void set_meta_data(Layer layer, const tile_types::LayerMetaData& meta_data);
+
+    /// same as the deliver_* slots, but moves the data into the quad. use it when calling directly (no queued connection).
+    void deliver(Layer layer, const tile::Id& tile_id, const tile_types::NetworkInfo& network_info, std::shared_ptr<QByteArray>&& data);
+
+public slots:
+    void load(const tile::Id& quad_id);
+    void deliver_ortho(const tile_types::TileLayer& tile);
+    void deliver_height(const tile_types::TileLayer& tile);
+#ifdef ALP_ENABLE_LABELS
+    void deliver_vectortile(const tile_types::TileLayer& tile);
+#endif
+
+signals:
+    void ortho_requested(const tile::Id& tile_id);
+    void height_requested(const tile::Id& tile_id);
+#ifdef ALP_ENABLE_LABELS
+    void vectortile_requested(const tile::Id& tile_id);
+#endif
+    void quad_loaded(const tile_types::TileQuad& quad);
+
+private:
+    [[nodiscard]] std::optional<unsigned> find_slot(const tile::Id& quad_id) const;
+    void request(Layer layer, const tile::Id& tile_id);
+    void finish(unsigned slot_index);
+};
+
+} // namespace nucleus::tile_scheduler
@@ -18,6 +18,8 @@
 
 #include "RateLimiter.h"
 
+#include <cmath>
+
 #include <QTimer>
 
 #include "utils.h"
@@ -47,6 +49,28 @@ std::pair<unsigned int, unsigned int> RateLimiter::limit() const
     return { m_rate, m_rate_period_msecs };
 }
 
+void RateLimiter::set_policy(Policy policy)
+{
+    m_policy = policy;
+}
+
+RateLimiter::Policy RateLimiter::policy() const
+{
+    return m_policy;
+}
+
+void RateLimiter::set_burst(unsigned burst)
+{
+    assert(burst > 0);
+    m_burst = burst;
+    m_tokens = std::min(m_tokens, double(m_burst));
+}
+
+unsigned RateLimiter::burst() const
+{
+    return m_burst;
+}
+
 size_t RateLimiter::queue_size() const
 {
     return m_request_queue.size();
@@ -61,6 +85,14 @@ void RateLimiter::request_quad(const tile::Id& id)
 void RateLimiter::process_request_queue()
 {
     const auto current_msecs = utils::time_since_epoch();
+    if (m_policy == Policy::TokenBucket)
+        process_token_bucket(current_msecs);
+    else
+        process_sliding_window(current_msecs);
+}
+
+void RateLimiter::process_sliding_window(uint64_t current_msecs)
+{
     std::erase_if(m_in_flight, [&current_msecs, this](const auto& x) { return x < current_msecs - m_rate_period_msecs; });
     unsigned requested_now = 0;
     for (const auto& id : m_request_queue) {
@@ -79,3 +111,25 @@ void RateLimiter::process_request_queue()
         m_update_timer->start(int(1 + m_rate_period_msecs - age_of_oldest_in_flight));
     }
 }
+
+void RateLimiter::process_token_bucket(uint64_t current_msecs)
+{
+    const auto elapsed_msecs = current_msecs > m_last_refill_msecs ? current_msecs - m_last_refill_msecs : 0;
+    m_tokens = std::min(double(m_burst), m_tokens + double(elapsed_msecs) * m_rate / m_rate_period_msecs);
+    m_last_refill_msecs = current_msecs;
+
+    unsigned requested_now = 0;
+    for (const auto& id : m_request_queue) {
+        if (m_tokens < 1.0)
+            break;
+        m_tokens -= 1.0;
+        ++requested_now;
+        emit quad_requested(id);
+    }
+    m_request_queue.erase(m_request_queue.cbegin(), m_request_queue.cbegin() + requested_now);
+
+    if (!m_request_queue.empty() && m_rate > 0) {
+        const auto msecs_per_token = double(m_rate_period_msecs) / m_rate;
+        m_update_timer->start(int(1 + std::ceil((1.0 - m_tokens) * msecs_per_token)));
+    }
+}
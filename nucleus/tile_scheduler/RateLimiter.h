@@ -31,8 +31,18 @@ namespace nucleus::tile_scheduler {
 class RateLimiter : public QObject
 {
     Q_OBJECT
+public:
+    // SlidingWindow: never more than rate requests within any period (strict, but bursty).
+    // TokenBucket: up to burst requests at once, refilled continuously with rate / period.
+    enum class Policy { SlidingWindow, TokenBucket };
+
+private:
+    Policy m_policy = Policy::SlidingWindow;
     unsigned m_rate = 100;
     unsigned m_rate_period_msecs = 1000 * 1;
+    unsigned m_burst = 100;
+    double m_tokens = 100;
+    uint64_t m_last_refill_msecs = 0;
     std::vector<tile::Id> m_request_queue;
     std::vector<uint64_t> m_in_flight;
     std::unique_ptr<QTimer> m_update_timer;
@@ -42,6 +52,11 @@ public:
     ~RateLimiter() override;
     void set_limit(unsigned rate, unsigned period_msecs);
     std::pair<unsigned, unsigned> limit() const;
+    void set_policy(Policy policy);
+    Policy policy() const;
+    // capacity of the token bucket, i.e., the number of requests that can be sent at once after a quiet time.
+    void set_burst(unsigned burst);
+    unsigned burst() const;
     size_t queue_size() const;
 
 public slots:
@@ -50,6 +65,10 @@ public slots:
 private slots:
     void process_request_queue();
 
+private:
+    void process_sliding_window(uint64_t current_msecs);
+    void process_token_bucket(uint64_t current_msecs);
+
 signals:
     void quad_requested(const tile::Id& tile_id);
 };
@@ -0,0 +1,257 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "RegionSeeder.h"
+
+#include <algorithm>
+
+#include "nucleus/srs.h"
+#include "utils.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+bool contains(const tile::SrsBounds& box, const glm::dvec2& point)
+{
+    return point.x >= box.min.x && point.x <= box.max.x && point.y >= box.min.y && point.y <= box.max.y;
+}
+
+bool contains(const std::vector<glm::dvec2>& polygon, const glm::dvec2& point)
+{
+    // even-odd rule
+    bool inside = false;
+    for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++) {
+        const auto& a = polygon[i];
+        const auto& b = polygon[j];
+        if ((a.y > point.y) != (b.y > point.y) && point.x < (b.x - a.x) * (point.y - a.y) / (b.y - a.y) + a.x)
+            inside = !inside;
+    }
+    return inside;
+}
+
+bool segment_intersects(const glm::dvec2& a, const glm::dvec2& b, const tile::SrsBounds& box)
+{
+    // liang-barsky clipping
+    double t0 = 0.0;
+    double t1 = 1.0;
+    const auto d = b - a;
+    const std::array<double, 4> p = { -d.x, d.x, -d.y, d.y };
+    const std::array<double, 4> q = { a.x - box.min.x, box.max.x - a.x, a.y - box.min.y, box.max.y - a.y };
+    for (unsigned i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0)
+                return false;
+            continue;
+        }
+        const auto t = q[i] / p[i];
+        if (p[i] < 0.0)
+            t0 = std::max(t0, t);
+        else
+            t1 = std::min(t1, t);
+        if (t0 > t1)
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+double RegionSeeder::Progress::quads_per_second() const
+{
+    if (elapsed_msecs == 0)
+        return 0;
+    return double(n_quads_done + n_quads_failed) * 1000.0 / double(elapsed_msecs);
+}
+
+double RegionSeeder::Progress::bytes_per_second() const
+{
+    if (elapsed_msecs == 0)
+        return 0;
+    return double(n_bytes) * 1000.0 / double(elapsed_msecs);
+}
+
+RegionSeeder::RegionSeeder(QObject* parent)
+    : QObject { parent }
+{
+}
+
+void RegionSeeder::set_region(const tile::SrsBounds& bounds)
+{
+    m_bounds = bounds;
+    m_polygon.clear();
+}
+
+void RegionSeeder::set_region(const std::vector<glm::dvec2>& polygon)
+{
+    assert(polygon.size() >= 3);
+    m_polygon = polygon;
+    m_bounds.min = polygon.front();
+    m_bounds.max = polygon.front();
+    for (const auto& p : polygon) {
+        m_bounds.min = glm::min(m_bounds.min, p);
+        m_bounds.max = glm::max(m_bounds.max, p);
+    }
+}
+
+void RegionSeeder::set_zoom_range(unsigned min_zoom, unsigned max_zoom)
+{
+    assert(min_zoom <= max_zoom);
+    m_min_zoom = min_zoom;
+    m_max_zoom = max_zoom;
+}
+
+void RegionSeeder::set_max_retries(unsigned max_retries)
+{
+    m_max_retries = max_retries;
+}
+
+void RegionSeeder::set_disk_cache(const std::filesystem::path& path, unsigned n_quads_per_write)
+{
+    assert(n_quads_per_write > 0);
+    m_disk_cache_path = path;
+    m_n_quads_per_write = n_quads_per_write;
+}
+
+std::vector<tile::Id> RegionSeeder::quads_for_region() const
+{
+    std::vector<tile::Id> quads;
+    std::vector<tile::Id> stack = { tile::Id { 0, { 0, 0 } } };
+    while (!stack.empty()) {
+        const auto id = stack.back();
+        stack.pop_back();
+        // a quad on zoom level z contains the tiles of level z + 1
+        if (id.zoom_level + 1 > m_max_zoom || !intersects(id))
+            continue;
+        if (id.zoom_level + 1 >= m_min_zoom)
+            quads.push_back(id);
+        for (const auto& child : id.children())
+            stack.push_back(child);
+    }
+    // coarse levels first, they are useful even if seeding is cancelled.
+    std::stable_sort(quads.begin(), quads.end(), [](const tile::Id& a, const tile::Id& b) { return a.zoom_level < b.zoom_level; });
+    return quads;
+}
+
+const RegionSeeder::Progress& RegionSeeder::progress() const
+{
+    return m_progress;
+}
+
+const Cache<tile_types::TileQuad>& RegionSeeder::cache() const
+{
+    return m_cache;
+}
+
+Cache<tile_types::TileQuad>& RegionSeeder::cache()
+{
+    return m_cache;
+}
+
+void RegionSeeder::start()
+{
+    const auto quads = quads_for_region();
+    m_pending.clear();
+    m_pending.insert(quads.cbegin(), quads.cend());
+    m_failed.clear();
+    m_n_retries = 0;
+    m_progress = {};
+    m_progress.n_quads_total = quads.size();
+    m_start_msecs = utils::time_since_epoch();
+    if (quads.empty()) {
+        emit finished(m_progress);
+        return;
+    }
+    emit quads_requested(quads);
+}
+
+void RegionSeeder::receive_quad(const tile_types::TileQuad& quad)
+{
+    using Status = tile_types::NetworkInfo::Status;
+    if (!m_pending.erase(quad.id))
+        return;
+
+    if (quad.network_info().status == Status::NetworkError) {
+        m_failed.push_back(quad.id);
+    } else {
+        m_cache.insert(quad);
+        ++m_progress.n_quads_done;
+        for (const auto& tile : quad.tiles) {
+            for (const auto& data : { tile.ortho, tile.height }) {
+                if (data)
+                    m_progress.n_bytes += size_t(data->size());
+            }
+#ifdef ALP_ENABLE_LABELS
+            if (tile.vector_tile)
+                m_progress.n_bytes += size_t(tile.vector_tile->size());
+#endif
+        }
+    }
+    m_progress.n_quads_failed = m_failed.size();
+    m_progress.elapsed_msecs = utils::time_since_epoch() - m_start_msecs;
+    if (m_cache.n_cached_objects() >= m_n_quads_per_write && !move_cache_to_disk())
+        return;
+    emit progress_updated(m_progress);
+
+    if (!m_pending.empty())
+        return;
+
+    if (!m_failed.empty() && m_n_retries < m_max_retries) {
+        ++m_n_retries;
+        std::vector<tile::Id> retry;
+        std::swap(retry, m_failed);
+        m_pending.insert(retry.cbegin(), retry.cend());
+        emit quads_requested(retry);
+        return;
+    }
+    if (!move_cache_to_disk())
+        return;
+    emit finished(m_progress);
+}
+
+bool RegionSeeder::move_cache_to_disk()
+{
+    if (m_disk_cache_path.empty())
+        return true;
+    const auto r = m_cache.move_to_disk(m_disk_cache_path);
+    if (!r.has_value()) {
+        // stop seeding, quads that are still in flight are ignored
+        m_pending.clear();
+        m_failed.clear();
+        emit disk_write_failed(QString::fromStdString(r.error()));
+        emit finished(m_progress);
+        return false;
+    }
+    return true;
+}
+
+bool RegionSeeder::intersects(const tile::Id& quad_id) const
+{
+    const auto bounds = nucleus::srs::tile_bounds(quad_id);
+    const auto overlaps_bounds = bounds.min.x < m_bounds.max.x && m_bounds.min.x < bounds.max.x && bounds.min.y < m_bounds.max.y && m_bounds.min.y < bounds.max.y;
+    if (!overlaps_bounds)
+        return false;
+    if (m_polygon.empty())
+        return true;
+
+    if (contains(m_polygon, (bounds.min + bounds.max) * 0.5))
+        return true;
+    for (size_t i = 0, j = m_polygon.size() - 1; i < m_polygon.size(); j = i++) {
+        if (contains(bounds, m_polygon[i]) || segment_intersects(m_polygon[j], m_polygon[i], bounds))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <filesystem>
+#include <unordered_set>
+
+#include <QObject>
+
+#include <radix/tile.h>
+
+#include "Cache.h"
+#include "tile_types.h"
+
+namespace nucleus::tile_scheduler {
+
+// Fetches all quads of a region for offline use. It talks to the same chain as the Scheduler
+// (quads_requested -> SlotLimiter -> RateLimiter -> QuadAssembler -> ..., and back via receive_quad),
+// and collects the quads in its own cache, which can then be written to the disk cache of the app. With set_disk_cache, the
+// quads are moved to disk in batches instead, so memory doesn't grow with the region and an interrupted run keeps its progress.
+class RegionSeeder : public QObject {
+    Q_OBJECT
+public:
+    struct Progress {
+        size_t n_quads_total = 0;
+        size_t n_quads_done = 0; // good or not found
+        size_t n_quads_failed = 0; // network errors (after all retries, once finished)
+        size_t n_bytes = 0;
+        uint64_t elapsed_msecs = 0;
+        [[nodiscard]] double quads_per_second() const;
+        [[nodiscard]] double bytes_per_second() const;
+    };
+
+    explicit RegionSeeder(QObject* parent = nullptr);
+
+    // region in srs coordinates (see srs::lat_long_to_world)
+    void set_region(const tile::SrsBounds& bounds);
+    void set_region(const std::vector<glm::dvec2>& polygon);
+    // zoom levels of the tiles. the cache is traversed from the root, so min_zoom should be 0, unless
+    // the upper levels are cached already.
+    void set_zoom_range(unsigned min_zoom, unsigned max_zoom);
+    void set_max_retries(unsigned max_retries);
+    // quads are moved to the disk cache at path whenever n_quads_per_write are in ram, and once finished.
+    // the disk cache should be read into cache() beforehand, otherwise quads that are only on disk are dropped from its index.
+    void set_disk_cache(const std::filesystem::path& path, unsigned n_quads_per_write = 1024);
+
+    [[nodiscard]] std::vector<tile::Id> quads_for_region() const;
+    [[nodiscard]] const Progress& progress() const;
+    [[nodiscard]] const Cache<tile_types::TileQuad>& cache() const;
+    [[nodiscard]] Cache<tile_types::TileQuad>& cache();
+
+public slots:
+    void start();
+    void receive_quad(const tile_types::TileQuad& quad);
+
+signals:
+    void quads_requested(const std::vector<tile::Id>& ids);
+    void progress_updated(const nucleus::tile_scheduler::RegionSeeder::Progress& progress);
+    void finished(const nucleus::tile_scheduler::RegionSeeder::Progress& progress);
+    // seeding stops (finished is emitted) if the disk cache can't be written
+    void disk_write_failed(const QString& message);
+
+private:
+    [[nodiscard]] bool intersects(const tile::Id& quad_id) const;
+    bool move_cache_to_disk();
+
+    tile::SrsBounds m_bounds = {};
+    std::vector<glm::dvec2> m_polygon;
+    unsigned m_min_zoom = 0;
+    unsigned m_max_zoom = 0;
+    unsigned m_max_retries = 2;
+    unsigned m_n_retries = 0;
+    std::unordered_set<tile::Id, tile::Id::Hasher> m_pending;
+    std::vector<tile::Id> m_failed;
+    uint64_t m_start_msecs = 0;
+    Progress m_progress;
+    Cache<tile_types::TileQuad> m_cache;
+    std::filesystem::path m_disk_cache_path;
+    unsigned m_n_quads_per_write = 1024;
+};
+
+}
@@ -20,7 +20,6 @@
 
 #include "Scheduler.h"
 
-#include <unordered_set>
 
 #include <QBuffer>
 #include <QDebug>
@@ -29,10 +28,11 @@
 #include <QTimer>
 
 #include "nucleus/DataQuerier.h"
+#include "nucleus/tile_scheduler/HorizonCuller.h"
+#include "nucleus/tile_scheduler/ParallelQuadTreeTraverser.h"
 #include "nucleus/tile_scheduler/utils.h"
 #include "nucleus/utils/image_loader.h"
 #include "nucleus/utils/tile_conversion.h"
-#include "radix/quad_tree.h"
 #include "nucleus/stb/stb_image_loader.h"
 
 #ifdef ALP_ENABLE_LABELS
@@ -44,8 +44,13 @@ using namespace nucleus::tile_scheduler;
 Scheduler::Scheduler(QObject* parent)
     : QObject { parent},
     m_default_ortho_raster(glm::uvec2(m_ortho_tile_size), { 255, 255, 255, 255}),
-    m_default_height_raster(glm::uvec2(m_height_tile_size), { 0, 0, 0, 255})
+    m_default_height_raster(glm::uvec2(m_height_tile_size), 0)
 {
+    m_traverser = std::make_unique<ParallelQuadTreeTraverser>();
+#ifdef ALP_ENABLE_LABELS
+    m_vector_tile_manager = std::make_unique<vectortile::VectorTileManager>();
+#endif
+
     m_update_timer = std::make_unique<QTimer>(this);
     m_update_timer->setSingleShot(true);
     connect(m_update_timer.get(), &QTimer::timeout, this, &Scheduler::send_quad_requests);
@@ -64,7 +69,7 @@ Scheduler::Scheduler(const QByteArray& default_ortho_tile, const QByteArray& def
     : Scheduler(parent)
 {
     m_default_ortho_raster = nucleus::utils::image_loader::rgba8(default_ortho_tile);
-    m_default_height_raster = nucleus::utils::image_loader::rgba8(default_height_tile);
+    m_default_height_raster = nucleus::utils::image_loader::height(default_height_tile);
 }
 
 Scheduler::~Scheduler() = default;
@@ -78,36 +83,86 @@ void Scheduler::update_camera(const camera::Definition& camera)
 void Scheduler::receive_quad(const tile_types::TileQuad& new_quad)
 {
     using Status = tile_types::NetworkInfo::Status;
+    const auto status = new_quad.network_info().status;
+    // partial quad (e.g., timed out in the QuadAssembler). cache it, so the loaded tiles can be drawn.
+    // missing tiles are drawn from the parent and requested again after m_retry_age_for_partial_quads.
+    const auto is_partial = status == Status::NetworkError && new_quad.n_missing_tiles() < 4;
 #ifdef __EMSCRIPTEN__
     // webassembly doesn't report 404 (well, probably it does, but not if there is a cors failure as well).
     // so we'll simply treat any 404 as network error.
-    // however, we need to pass tiles with zoomlevel < 10, otherwise the top of the tree won't be built.
-    if (new_quad.network_info().status == Status::Good || new_quad.id.zoom_level < 10) {
-        m_ram_cache.insert(new_quad);
-        schedule_purge();
-        schedule_update();
-        schedule_persist();
-        emit quad_received(new_quad.id);
-    }
+    // however, we need to pass failed quads with zoomlevel < 10, otherwise the top of the tree won't be built.
+    const auto is_complete = status == Status::Good || (!is_partial && new_quad.id.zoom_level < 10);
 #else
-    switch (new_quad.network_info().status) {
-    case Status::Good:
-    case Status::NotFound:
-        m_ram_cache.insert(new_quad);
-        schedule_purge();
-        schedule_update();
-        schedule_persist();
-        emit quad_received(new_quad.id);
-        update_stats();
-        break;
-    case Status::NetworkError:
+    const auto is_complete = status == Status::Good || status == Status::NotFound;
+#endif
+    if (!is_complete && !is_partial) {
         // do not persist the tile.
         // do not reschedule retrieval (wait for user input or a reconnect signal).
         // do not purge (nothing was added, so no need to check).
         // do nothing.
-        break;
+        return;
+    }
+
+    const auto was_on_gpu = m_gpu_cached.contains(new_quad.id);
+    m_ram_cache.insert(is_partial ? with_fallbacks(new_quad) : new_quad);
+    if (was_on_gpu)
+        m_gpu_stale.insert(new_quad.id);
+    schedule_purge();
+    schedule_update();
+    schedule_persist();
+    emit quad_received(new_quad.id);
+    update_stats();
+}
+
+tile_types::TileQuad Scheduler::with_fallbacks(tile_types::TileQuad quad) const
+{
+    using Status = tile_types::NetworkInfo::Status;
+    const auto is_missing = [](const tile_types::LayeredTile& t) { return t.network_info.status == Status::NetworkError; };
+
+    // keep tiles that arrived with an earlier attempt
+    if (m_ram_cache.contains(quad.id)) {
+        const auto& cached = m_ram_cache.peak_at(quad.id);
+        for (auto& tile : quad.tiles) {
+            if (!is_missing(tile))
+                continue;
+            const auto cached_tile = std::find_if(cached.tiles.cbegin(), cached.tiles.cend(), [&](const auto& t) { return t.id == tile.id; });
+            if (cached_tile != cached.tiles.cend() && !is_missing(*cached_tile))
+                tile = *cached_tile;
+        }
+    }
+
+    // the parent tile lives in the grand parent quad
+    const tile_types::LayeredTile* parent = nullptr;
+    if (quad.id.zoom_level > 0 && m_ram_cache.contains(quad.id.parent())) {
+        const auto& parent_quad = m_ram_cache.peak_at(quad.id.parent());
+        const auto iter = std::find_if(parent_quad.tiles.cbegin(), parent_quad.tiles.cend(), [&](const auto& t) { return t.id == quad.id; });
+        if (iter != parent_quad.tiles.cend())
+            parent = &*iter;
     }
+
+    for (auto& tile : quad.tiles) {
+        if (!is_missing(tile))
+            continue;
+        // still missing, draw the corresponding part of the parent (see LayeredTile::*_zoom_offset).
+        tile.ortho = std::make_shared<QByteArray>();
+        tile.height = std::make_shared<QByteArray>();
+        tile.ortho_zoom_offset = 0;
+        tile.height_zoom_offset = 0;
+#ifdef ALP_ENABLE_LABELS
+        tile.vector_tile = std::make_shared<QByteArray>(); // labels of the parent would be duplicated
 #endif
+        if (!parent)
+            continue;
+        if (parent->ortho && parent->ortho->size()) {
+            tile.ortho = parent->ortho;
+            tile.ortho_zoom_offset = parent->ortho_zoom_offset + 1;
+        }
+        if (parent->height && parent->height->size()) {
+            tile.height = parent->height;
+            tile.height_zoom_offset = parent->height_zoom_offset + 1;
+        }
+    }
+    return quad;
 }
 
 void Scheduler::set_network_reachability(QNetworkInformation::Reachability reachability)
@@ -130,18 +185,25 @@ void Scheduler::set_network_reachability(QNetworkInformation::Reachability reach
 
 void Scheduler::update_gpu_quads()
 {
-    const auto should_refine = tile_scheduler::utils::refineFunctor(m_current_camera, m_aabb_decorator, m_permissible_screen_space_error, m_ortho_tile_size);
+    const auto should_refine = tile_scheduler::utils::refineFunctor(m_current_camera, m_aabb_decorator, m_permissible_screen_space_error, m_ortho_tile_size, horizon_culler());
     std::vector<tile_types::TileQuad> gpu_candidates;
     m_ram_cache.visit([this, &gpu_candidates, &should_refine](const tile_types::TileQuad& quad) {
         if (!should_refine(quad.id))
             return false;
-        if (m_gpu_cached.contains(quad.id))
+        if (m_gpu_cached.contains(quad.id) && !m_gpu_stale.contains(quad.id))
             return true;
 
         gpu_candidates.push_back(quad);
         return true;
     });
 
+    // stale quads are replaced on the gpu, i.e., removed and uploaded again.
+    std::vector<tile::Id> replaced_ids;
+    for (const auto& q : gpu_candidates) {
+        if (m_gpu_stale.erase(q.id))
+            replaced_ids.push_back(q.id);
+    }
+
     for (const auto& q : gpu_candidates) {
         m_gpu_cached.insert(tile_types::GpuCacheInfo { q.id });
     }
@@ -153,7 +215,7 @@ void Scheduler::update_gpu_quads()
     const auto superfluous_quads = m_gpu_cached.purge(m_gpu_quad_limit);
 
     // elimitate double entries (happens when the gpu has not enough space for all quads selected above)
-    std::unordered_set<tile::Id, tile::Id::Hasher> superfluous_ids;
+    nucleus::utils::TileIdSet superfluous_ids;
     superfluous_ids.reserve(superfluous_quads.size());
     for (const auto& quad : superfluous_quads)
         superfluous_ids.insert(quad.id);
@@ -166,12 +228,40 @@ void Scheduler::update_gpu_quads()
         return false;
     });
 
+#ifdef ALP_ENABLE_LABELS
+    // labels are held while their tiles are on the gpu. replaced quads are acquired again below.
+    for (const auto& quad_id : superfluous_ids) {
+        for (const auto& tile_id : quad_id.children())
+            m_vector_tile_manager->release(tile_id);
+    }
+    for (const auto& quad_id : replaced_ids) {
+        for (const auto& tile_id : quad_id.children())
+            m_vector_tile_manager->release(tile_id);
+    }
+
+    // labels are parsed in parallel, one task per tile (vector_tile might be empty, see VectorTileManager)
+    nucleus::utils::TileIdMap<std::shared_ptr<const vectortile::VectorTile>> vector_tiles;
+    {
+        std::vector<tile::Id> tile_ids;
+        std::vector<const QByteArray*> tile_data;
+        for (const auto& quad : gpu_candidates) {
+            for (const auto& tile : quad.tiles) {
+                tile_ids.push_back(tile.id);
+                tile_data.push_back(tile.vector_tile.get());
+            }
+        }
+        const auto parsed = m_vector_tile_manager->to_vector_tiles(tile_ids, tile_data, m_dataquerier);
+        for (size_t i = 0; i < tile_ids.size(); ++i)
+            vector_tiles[tile_ids[i]] = parsed[i];
+    }
+#endif
+
     std::vector<tile_types::GpuTileQuad> new_gpu_quads;
     new_gpu_quads.reserve(gpu_candidates.size());
     std::transform(gpu_candidates.cbegin(),
                    gpu_candidates.cend(),
                    std::back_inserter(new_gpu_quads),
-                   [this](const auto& quad) {
+                   [&](const auto& quad) {
                        // create GpuQuad based on cpu quad
                        tile_types::GpuTileQuad gpu_quad;
                        gpu_quad.id = quad.id;
@@ -180,53 +270,90 @@ void Scheduler::update_gpu_quads()
                            gpu_quad.tiles[i].id = quad.tiles[i].id;
                            gpu_quad.tiles[i].bounds = m_aabb_decorator->aabb(quad.tiles[i].id);
 
-                           if (quad.tiles[i].ortho->size()) {
-                               // Ortho image is available
-                               Raster<glm::u8vec4> ortho_raster = nucleus::utils::image_loader::rgba8(*quad.tiles[i].ortho.get());
-                               gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(ortho_raster, m_ortho_tile_compression_algorithm);
+                           if (quad.tiles[i].ortho->size() && quad.tiles[i].ortho_zoom_offset > 0) {
+                               // Ortho image of an ancestor is available, cut out and upsample
+                               const auto ancestor_raster = nucleus::utils::image_loader::rgba8(*quad.tiles[i].ortho.get());
+                               const auto ortho_raster = nucleus::utils::tile_conversion::descendant_ortho(ancestor_raster, quad.tiles[i].id, quad.tiles[i].ortho_zoom_offset);
+                               gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(
+                                   ortho_raster, m_ortho_tile_compression_algorithm, nucleus::utils::ColourTexture::MipMaps::Full);
+                           } else if (quad.tiles[i].ortho->size()) {
+                               // Ortho image is available, decode straight into the texture
+                               gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(
+                                   nucleus::utils::image_loader::colour_texture(
+                                       *quad.tiles[i].ortho.get(), m_ortho_tile_compression_algorithm, nucleus::utils::ColourTexture::MipMaps::Full));
                            } else {
                                // Ortho image is not available (use white default tile)
-                               gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(m_default_ortho_raster, m_ortho_tile_compression_algorithm);
+                               gpu_quad.tiles[i].ortho = std::make_shared<nucleus::utils::ColourTexture>(
+                                   m_default_ortho_raster, m_ortho_tile_compression_algorithm, nucleus::utils::ColourTexture::MipMaps::Full);
                            }
 
                            if (quad.tiles[i].height->size()) {
                                // Height image is available
-                               Raster<glm::u8vec4> height_image = nucleus::utils::image_loader::rgba8(*quad.tiles[i].height.get());
-                               auto heightraster = nucleus::utils::tile_conversion::to_u16raster(height_image);
+                               auto heightraster = nucleus::utils::image_loader::height(*quad.tiles[i].height.get());
+                               if (quad.tiles[i].height_zoom_offset > 0)
+                                   heightraster = nucleus::utils::tile_conversion::descendant_height(heightraster, quad.tiles[i].id, quad.tiles[i].height_zoom_offset);
                                gpu_quad.tiles[i].height = std::make_shared<nucleus::Raster<uint16_t>>(std::move(heightraster));
                            } else {
                                // Height image is not available (use black default tile)
-                               auto heightraster = nucleus::utils::tile_conversion::to_u16raster(m_default_height_raster);
-                               gpu_quad.tiles[i].height = std::make_shared<nucleus::Raster<uint16_t>>(std::move(heightraster));
+                               gpu_quad.tiles[i].height = std::make_shared<nucleus::Raster<uint16_t>>(m_default_height_raster);
                            }
 
 #ifdef ALP_ENABLE_LABELS
-                           const auto* vectortile_data = m_default_vector_tile.get();
-                           vectortile_data = quad.tiles[i].vector_tile.get();
-                           // moved into this if -> since vector_tile might be empty
-                           auto vectortile = nucleus::vectortile::VectorTileManager::to_vector_tile(quad.tiles[i].id, *vectortile_data, m_dataquerier);
-                           gpu_quad.tiles[i].vector_tile = vectortile;
+                           gpu_quad.tiles[i].vector_tile = vector_tiles.at(quad.tiles[i].id);
 #endif
                        }
                        return gpu_quad;
                    });
 
+    nucleus::utils::erase_if(m_gpu_stale, [this](const tile::Id& id) { return !m_gpu_cached.contains(id); });
+    superfluous_ids.insert(replaced_ids.cbegin(), replaced_ids.cend());
+
     emit gpu_quads_updated(new_gpu_quads, { superfluous_ids.cbegin(), superfluous_ids.cend() });
     update_stats();
 }
 
 void Scheduler::send_quad_requests()
 {
+    auto currently_active_tiles = tiles_for_current_camera_position();
+    load_from_offline_cache(currently_active_tiles);
     if (!m_network_requests_enabled)
         return;
-    auto currently_active_tiles = tiles_for_current_camera_position();
     const auto current_time = utils::time_since_epoch();
     std::erase_if(currently_active_tiles, [this, current_time](const tile::Id& id) {
-        return m_ram_cache.contains(id) && m_ram_cache.peak_at(id).network_info().timestamp + m_retirement_age_for_tile_cache > current_time;
+        if (!m_ram_cache.contains(id))
+            return false;
+        const auto& quad = m_ram_cache.peak_at(id);
+        if (quad.n_missing_tiles() > 0) {
+            // partial quad, the QuadAssembler requests only the missing tiles again.
+            uint64_t last_failure = 0;
+            for (const auto& tile : quad.tiles) {
+                if (tile.network_info.status == tile_types::NetworkInfo::Status::NetworkError)
+                    last_failure = std::max(last_failure, tile.network_info.timestamp);
+            }
+            return last_failure + m_retry_age_for_partial_quads > current_time;
+        }
+        return quad.network_info().timestamp + m_retirement_age_for_tile_cache > current_time;
     });
     emit quads_requested(currently_active_tiles);
 }
 
+void Scheduler::load_from_offline_cache(const std::vector<tile::Id>& ids)
+{
+    // only the quads needed for the current camera are read, a seeded region can be much larger than the ram cache.
+    for (const auto& id : ids) {
+        if (m_ram_cache.contains(id) || !m_offline_cache.contains_on_disk(id))
+            continue;
+        const auto quad = m_offline_cache.load_from_disk(m_offline_cache_path, id);
+        if (!quad.has_value()) {
+            qDebug() << QString("Reading quad from the offline cache (%1) failed: %2")
+                            .arg(QString::fromStdString(m_offline_cache_path.string()))
+                            .arg(QString::fromStdString(quad.error()));
+            continue;
+        }
+        receive_quad(quad.value());
+    }
+}
+
 void Scheduler::purge_ram_cache()
 {
     if (m_ram_cache.n_cached_objects() <= unsigned(float(m_ram_quad_limit) * 1.05f)){
@@ -286,6 +413,7 @@ void Scheduler::update_stats()
 {
     m_statistics.n_tiles_in_ram_cache = m_ram_cache.n_cached_objects();
     m_statistics.n_tiles_in_gpu_cache = m_gpu_cached.n_cached_objects();
+    m_statistics.buffer_pool = nucleus::utils::BufferPool::shared().statistics();
     emit statistics_updated(m_statistics);
 }
 
@@ -302,22 +430,35 @@ void Scheduler::read_disk_cache()
     }
 }
 
-std::vector<tile::Id> Scheduler::tiles_for_current_camera_position() const
+void Scheduler::read_offline_cache(const std::filesystem::path& path)
 {
-    std::vector<tile::Id> all_inner_nodes;
-    const auto all_leaves = quad_tree::onTheFlyTraverse(
-        tile::Id{0, {0, 0}},
-        tile_scheduler::utils::refineFunctor(m_current_camera,
-                                             m_aabb_decorator,
-                                             m_permissible_screen_space_error,
-                                             m_ortho_tile_size),
-        [&all_inner_nodes](const tile::Id &v) {
-            all_inner_nodes.push_back(v);
-            return v.children();
-        });
+    m_offline_cache_path = path;
+    if (!std::filesystem::exists(path))
+        return;
+    const auto r = m_offline_cache.read_index_from_disk(path);
+    if (!r.has_value()) {
+        // unlike the disk cache, the offline cache is never removed, it might be expensive to seed again.
+        qDebug() << QString("Reading the offline cache (%1) failed: \n%2")
+                        .arg(QString::fromStdString(path.string()))
+                        .arg(QString::fromStdString(r.error()));
+    }
+}
 
+std::vector<tile::Id> Scheduler::tiles_for_current_camera_position() const
+{
+    const auto refine = tile_scheduler::utils::refineFunctor(m_current_camera, m_aabb_decorator, m_permissible_screen_space_error, m_ortho_tile_size, horizon_culler());
     // not adding leaves, because they we will be fetching quads, which also fetch their children
-    return all_inner_nodes;
+    return m_traverser->traverse(tile::Id { 0, { 0, 0 } }, refine).inner_nodes;
+}
+
+std::shared_ptr<const HorizonCuller> Scheduler::horizon_culler() const
+{
+    if (!m_occlusion_culling_enabled || !m_aabb_decorator)
+        return {};
+    auto culler = std::make_shared<const HorizonCuller>(m_current_camera.position(), *m_aabb_decorator);
+    if (!culler->enabled())
+        return {};
+    return culler;
 }
 
 nucleus::utils::ColourTexture::Format Scheduler::ortho_tile_compression_algorithm() const { return m_ortho_tile_compression_algorithm; }
@@ -332,6 +473,11 @@ void Scheduler::set_retirement_age_for_tile_cache(unsigned int new_retirement_ag
     m_retirement_age_for_tile_cache = new_retirement_age_for_tile_cache;
 }
 
+void Scheduler::set_retry_age_for_partial_quads(unsigned int new_retry_age_for_partial_quads)
+{
+    m_retry_age_for_partial_quads = new_retry_age_for_partial_quads;
+}
+
 unsigned int Scheduler::persist_timeout() const
 {
     return m_persist_timeout;
@@ -352,6 +498,8 @@ const Cache<tile_types::TileQuad>& Scheduler::ram_cache() const
     return m_ram_cache;
 }
 
+const Cache<tile_types::TileQuad>& Scheduler::offline_cache() const { return m_offline_cache; }
+
 Cache<tile_types::TileQuad>& Scheduler::ram_cache()
 {
     return m_ram_cache;
@@ -365,6 +513,14 @@ std::filesystem::path Scheduler::disk_cache_path()
     return  base_path / "tile_cache";
 }
 
+std::filesystem::path Scheduler::offline_cache_path()
+{
+    // not in the cache location, the os may clear that
+    const auto base_path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation).toStdString());
+    std::filesystem::create_directories(base_path);
+    return base_path / "offline_tiles";
+}
+
 void Scheduler::set_purge_timeout(unsigned int new_purge_timeout)
 {
     assert(new_purge_timeout < unsigned(std::numeric_limits<int>::max()));
@@ -406,6 +562,17 @@ void Scheduler::set_enabled(bool new_enabled)
     schedule_update();
 }
 
+bool Scheduler::occlusion_culling_enabled() const
+{
+    return m_occlusion_culling_enabled;
+}
+
+void Scheduler::set_occlusion_culling_enabled(bool new_occlusion_culling_enabled)
+{
+    m_occlusion_culling_enabled = new_occlusion_culling_enabled;
+    schedule_update();
+}
+
 void Scheduler::set_update_timeout(unsigned new_update_timeout)
 {
     assert(m_update_timeout < unsigned(std::numeric_limits<int>::max()));
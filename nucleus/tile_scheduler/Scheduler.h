@@ -26,6 +26,8 @@
 
 #include "Cache.h"
 #include "nucleus/camera/Definition.h"
+#include "nucleus/utils/BufferPool.h"
+#include "nucleus/utils/TileIdMap.h"
 #include "radix/tile.h"
 #include "tile_types.h"
 
@@ -34,8 +36,13 @@ class QTimer;
 namespace nucleus {
 class DataQuerier;
 }
+namespace nucleus::vectortile {
+class VectorTileManager;
+}
 
 namespace nucleus::tile_scheduler {
+class HorizonCuller;
+class ParallelQuadTreeTraverser;
 namespace utils {
     class AabbDecorator;
     using AabbDecoratorPtr = std::shared_ptr<AabbDecorator>;
@@ -47,6 +54,7 @@ public:
     struct Statistics {
         unsigned n_tiles_in_ram_cache = 0;
         unsigned n_tiles_in_gpu_cache = 0;
+        nucleus::utils::BufferPool::Statistics buffer_pool; // tile payload memory (rasters, textures), see BufferPool::shared()
     };
 
     explicit Scheduler(QObject* parent = nullptr);
@@ -59,6 +67,10 @@ public:
     [[nodiscard]] bool enabled() const;
     void set_enabled(bool new_enabled);
 
+    // skips refinement of tiles hidden behind terrain closer to the camera (see HorizonCuller)
+    [[nodiscard]] bool occlusion_culling_enabled() const;
+    void set_occlusion_culling_enabled(bool new_occlusion_culling_enabled);
+
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
 
     void set_aabb_decorator(const utils::AabbDecoratorPtr& new_aabb_decorator);
@@ -79,7 +91,14 @@ public:
 
     void read_disk_cache();
 
+    // quads seeded for offline use (see tile_seeder). only the index is read, quads are loaded from disk when the camera
+    // needs them. unlike the disk cache, the offline cache is never written or pruned by the scheduler.
+    static std::filesystem::path offline_cache_path();
+    void read_offline_cache(const std::filesystem::path& path = offline_cache_path());
+    [[nodiscard]] const Cache<tile_types::TileQuad>& offline_cache() const;
+
     void set_retirement_age_for_tile_cache(unsigned int new_retirement_age_for_tile_cache);
+    void set_retry_age_for_partial_quads(unsigned int new_retry_age_for_partial_quads);
     
     nucleus::utils::ColourTexture::Format ortho_tile_compression_algorithm() const;
     void set_ortho_tile_compression_algorithm(nucleus::utils::ColourTexture::Format new_ortho_tile_compression_algorithm);
@@ -107,10 +126,14 @@ protected:
     void schedule_persist();
     void update_stats();
     std::vector<tile::Id> tiles_for_current_camera_position() const;
+    void load_from_offline_cache(const std::vector<tile::Id>& ids);
+    std::shared_ptr<const HorizonCuller> horizon_culler() const;
+    tile_types::TileQuad with_fallbacks(tile_types::TileQuad quad) const;
     std::shared_ptr<DataQuerier> m_dataquerier;
 
 private:
     unsigned m_retirement_age_for_tile_cache = 10u * 24u * 3600u * 1000u; // 10 days
+    unsigned m_retry_age_for_partial_quads = 10u * 1000u; // 10 seconds
     float m_permissible_screen_space_error = 2;
     unsigned m_update_timeout = 100;
     unsigned m_purge_timeout = 1000;
@@ -120,6 +143,7 @@ private:
     static constexpr unsigned m_ortho_tile_size = 256;
     static constexpr unsigned m_height_tile_size = 65;
     bool m_enabled = false;
+    bool m_occlusion_culling_enabled = false;
     bool m_network_requests_enabled = true;
     Statistics m_statistics;
     std::unique_ptr<QTimer> m_update_timer;
@@ -127,11 +151,18 @@ private:
     std::unique_ptr<QTimer> m_persist_timer;
     camera::Definition m_current_camera;
     utils::AabbDecoratorPtr m_aabb_decorator;
+    std::unique_ptr<ParallelQuadTreeTraverser> m_traverser;
     Cache<tile_types::TileQuad> m_ram_cache;
+    Cache<tile_types::TileQuad> m_offline_cache; // only the index, the quads stay on disk
+    std::filesystem::path m_offline_cache_path;
     Cache<tile_types::GpuCacheInfo> m_gpu_cached;
+    nucleus::utils::TileIdSet m_gpu_stale; // on the gpu, but the ram cache has newer data (e.g., a completed partial quad)
     Raster<glm::u8vec4> m_default_ortho_raster;
-    Raster<glm::u8vec4> m_default_height_raster;
+    Raster<uint16_t> m_default_height_raster;
     std::shared_ptr<QByteArray> m_default_vector_tile;
+#ifdef ALP_ENABLE_LABELS
+    std::unique_ptr<vectortile::VectorTileManager> m_vector_tile_manager; // holds the labels of the tiles on the gpu
+#endif
 
     nucleus::utils::ColourTexture::Format m_ortho_tile_compression_algorithm = nucleus::utils::ColourTexture::Format::Uncompressed_RGBA;
 
@@ -18,6 +18,10 @@
 
 #include "SlotLimiter.h"
 
+#include <algorithm>
+
+#include "utils.h"
+
 using namespace nucleus::tile_scheduler;
 
 SlotLimiter::SlotLimiter(QObject* parent)
@@ -28,12 +32,12 @@ SlotLimiter::SlotLimiter(QObject* parent)
 void SlotLimiter::set_limit(unsigned new_limit)
 {
     assert(new_limit > 0);
-    m_limit = new_limit;
+    m_limit = float(new_limit);
 }
 
 unsigned SlotLimiter::limit() const
 {
-    return m_limit;
+    return unsigned(m_limit);
 }
 
 unsigned SlotLimiter::slots_taken() const
@@ -41,16 +45,47 @@ unsigned SlotLimiter::slots_taken() const
     return unsigned(m_in_flight.size());
 }
 
+void SlotLimiter::set_adaptive(bool enabled)
+{
+    m_adaptive = enabled;
+}
+
+bool SlotLimiter::is_adaptive() const
+{
+    return m_adaptive;
+}
+
+void SlotLimiter::set_limit_range(unsigned min_limit, unsigned max_limit)
+{
+    assert(min_limit > 0);
+    assert(min_limit <= max_limit);
+    m_min_limit = min_limit;
+    m_max_limit = max_limit;
+    m_limit = std::clamp(m_limit, float(m_min_limit), float(m_max_limit));
+}
+
+std::pair<unsigned, unsigned> SlotLimiter::limit_range() const
+{
+    return { m_min_limit, m_max_limit };
+}
+
+void SlotLimiter::set_latency_tolerance(float tolerance)
+{
+    assert(tolerance > 1.0f);
+    m_latency_tolerance = tolerance;
+}
+
 void SlotLimiter::request_quads(const std::vector<tile::Id>& ids)
 {
     m_request_queue.clear();
+    const auto now = utils::time_since_epoch();
     for (const tile::Id& id : ids) {
         if (m_in_flight.contains(id))
             continue;
-        if (m_in_flight.size() >= m_limit) {
+        if (m_in_flight.size() >= limit()) {
             m_request_queue.push_back(id);
         } else {
-            m_in_flight.insert(id);
+            m_in_flight[id] = now;
             emit quad_requested(id);
         }
     }
@@ -58,12 +93,57 @@ void SlotLimiter::request_quads(const std::vector<tile::Id>& ids)
 
 void SlotLimiter::deliver_quad(const tile_types::TileQuad& tile)
 {
-    m_in_flight.erase(tile.id);
+    const auto it = m_in_flight.find(tile.id);
+    if (it != m_in_flight.end()) {
+        if (m_adaptive) {
+            const auto now = utils::time_since_epoch();
+            const auto latency = now > it->second ? now - it->second : 0;
+            const auto saturated = !m_request_queue.empty() || m_in_flight.size() >= limit();
+            update_limit(tile.network_info().status == tile_types::NetworkInfo::Status::NetworkError, latency, saturated);
+        }
+        m_in_flight.erase(it);
+    }
     emit quad_delivered(tile);
-    if (m_request_queue.empty())
+    process_request_queue();
+}
+
+void SlotLimiter::update_limit(bool failed, uint64_t latency, bool saturated)
+{
+    if (m_deliveries_until_next_decrease > 0)
+        --m_deliveries_until_next_decrease;
+
+    const auto sample = float(latency);
+    if (m_base_latency < 0) {
+        m_base_latency = sample;
+        m_smoothed_latency = sample;
+    } else {
+        m_smoothed_latency += (sample - m_smoothed_latency) / 8;
+        // the base drifts slowly towards the smoothed latency, so that a permanent change (e.g., different route) is picked up.
+        m_base_latency = std::min(sample, m_base_latency + (m_smoothed_latency - m_base_latency) / 256);
+    }
+    // the floor keeps jitter on very fast links (or local servers) from being read as congestion.
+    const auto congested = m_smoothed_latency > m_latency_tolerance * std::max(m_base_latency, 10.0f);
+
+    if (failed || congested) {
+        // decrease at most once per window, otherwise all requests in flight during an outage would each halve the limit.
+        if (m_deliveries_until_next_decrease == 0) {
+            m_limit = std::max(float(m_min_limit), m_limit * 0.5f);
+            m_deliveries_until_next_decrease = unsigned(m_in_flight.size());
+        }
         return;
+    }
+    // growing is only justified if the limit was actually the bottleneck.
+    if (saturated)
+        m_limit = std::min(float(m_max_limit), m_limit + 1.0f / m_limit);
+}
 
-    m_in_flight.insert(m_request_queue.front());
-    emit quad_requested(m_request_queue.front());
-    m_request_queue.erase(m_request_queue.cbegin());
+void SlotLimiter::process_request_queue()
+{
+    const auto now = utils::time_since_epoch();
+    while (!m_request_queue.empty() && m_in_flight.size() < limit()) {
+        const auto id = m_request_queue.front();
+        m_request_queue.pop_front();
+        m_in_flight[id] = now;
+        emit quad_requested(id);
+    }
 }
@@ -18,12 +18,14 @@
 
 #pragma once
 
-#include <unordered_set>
+#include <deque>
+#include <vector>
 
 #include <QObject>
 
 #include <radix/tile.h>
 
+#include "nucleus/utils/TileIdMap.h"
 #include "tile_types.h"
 
 namespace nucleus::tile_scheduler {
@@ -31,9 +33,18 @@ namespace nucleus::tile_scheduler {
 class SlotLimiter : public QObject {
     Q_OBJECT
 
-    unsigned m_limit = 16;
-    std::unordered_set<tile::Id, tile::Id::Hasher> m_in_flight;
-    std::vector<tile::Id> m_request_queue;
+    // the limit is kept as float, so that the additive increase can be spread over one window of deliveries.
+    float m_limit = 16;
+    nucleus::utils::TileIdMap<uint64_t> m_in_flight; // id -> request time in msecs
+    std::deque<tile::Id> m_request_queue; // seeding queues the whole region, popping the front must be cheap
+
+    bool m_adaptive = false;
+    unsigned m_min_limit = 4;
+    unsigned m_max_limit = 64;
+    float m_latency_tolerance = 2.0f;
+    float m_base_latency = -1; // < 0 until the first sample
+    float m_smoothed_latency = 0;
+    unsigned m_deliveries_until_next_decrease = 0;
 
 public:
     explicit SlotLimiter(QObject* parent = nullptr);
@@ -42,10 +53,22 @@ public:
     [[nodiscard]] unsigned int limit() const;
     unsigned int slots_taken() const;
 
+    // adaptive concurrency (AIMD): the limit grows by one slot per window of successful deliveries and is halved on
+    // network errors or when the smoothed latency exceeds latency_tolerance * base latency (queueing at the server).
+    void set_adaptive(bool enabled);
+    [[nodiscard]] bool is_adaptive() const;
+    void set_limit_range(unsigned min_limit, unsigned max_limit);
+    [[nodiscard]] std::pair<unsigned, unsigned> limit_range() const;
+    void set_latency_tolerance(float tolerance);
+
 public slots:
     void request_quads(const std::vector<tile::Id>& id);
     void deliver_quad(const tile_types::TileQuad& tile);
 
+private:
+    void update_limit(bool failed, uint64_t latency, bool saturated);
+    void process_request_queue();
+
 signals:
     void quad_requested(const tile::Id& tile_id);
     void quad_delivered(const tile_types::TileQuad& id);
@@ -110,3 +110,14 @@ void TileLoadService::set_transfer_timeout(unsigned int new_transfer_timeout)
     assert(new_transfer_timeout < unsigned(std::numeric_limits<int>::max()));
     m_transfer_timeout = new_transfer_timeout;
 }
+
+const tile_types::LayerMetaData& TileLoadService::meta_data() const
+{
+    return m_meta_data;
+}
+
+void TileLoadService::set_meta_data(const tile_types::LayerMetaData& new_meta_data)
+{
+    assert(new_meta_data.min_zoom <= new_meta_data.max_zoom);
+    m_meta_data = new_meta_data;
+}
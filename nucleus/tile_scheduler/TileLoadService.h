@@ -47,6 +47,9 @@ public:
     [[nodiscard]] unsigned int transfer_timeout() const;
     void set_transfer_timeout(unsigned int new_transfer_timeout);
 
+    [[nodiscard]] const tile_types::LayerMetaData& meta_data() const;
+    void set_meta_data(const tile_types::LayerMetaData& new_meta_data);
+
 public slots:
     void load(const tile::Id& tile_id) const;
 
@@ -60,5 +63,6 @@ private:
     UrlPattern m_url_pattern;
     QString m_file_ending;
     LoadBalancingTargets m_load_balancing_targets;
+    tile_types::LayerMetaData m_meta_data;
 };
 }
@@ -19,48 +19,76 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <optional>
+
+#include "nucleus/Raster.h"
 #include "nucleus/srs.h"
 #include "nucleus/tile_scheduler/Cache.h"
-#include "radix/height_encoding.h"
 #include "nucleus/utils/image_loader.h"
 
 namespace nucleus::tile_scheduler::cache_queries {
 
-// NOTE: UNTESTED since swap from QImage!
-inline float query_altitude(MemoryCache* cache, const glm::dvec2& lat_long)
-{
-    const auto world_space = srs::lat_long_to_world(lat_long);
-    nucleus::tile_scheduler::tile_types::TileQuad selected_quad;
-    cache->visit([&](const nucleus::tile_scheduler::tile_types::TileQuad& tile) {
-        if (srs::tile_bounds(tile.id).contains(world_space)) {
-            selected_quad = tile;
-            return true;
-        }
-        return false;
-    });
-
-    for (const auto& layered_tile : selected_quad.tiles) {
-        if (srs::tile_bounds(layered_tile.id).contains(world_space)) {
-            const auto bounds = srs::tile_bounds(layered_tile.id);
-            const auto uv = (world_space - bounds.min) / bounds.size();
+// quads are stored under the id of the parent of their tiles. the scheduler doesn't refine beyond this.
+constexpr unsigned max_quad_zoom_level = 21;
+// returned if there is no height data for a position (e.g., before the first tiles arrived)
+constexpr float default_altitude = 1000;
+// uint16 heights are in 1/8 metres (same as radix::height_encoding and the shaders)
+constexpr double height_scale = 1.0 / 8.0;
 
-            if (layered_tile.height && layered_tile.height->size()) {
+/// height data of a cached tile, and the id of the tile it covers (an ancestor of the drawn tile, if it was loaded with a height zoom offset)
+struct HeightTile {
+    tile::Id id;
+    std::shared_ptr<QByteArray> data;
+};
 
-                const auto height_tile = nucleus::utils::image_loader::rgba8(*layered_tile.height);
-                const auto p = glm::uvec2(
-                    uint32_t(uv.x * height_tile.width()),
-                    uint32_t((1 - uv.y) * height_tile.height())
-                );
-                const auto px = height_tile.pixel(p);
-                return radix::height_encoding::to_float(glm::u8vec3(px));
-            } else {
-                return 1000;
-            }
+/// looks up the quads containing world_position by id, from the finest zoom level up. returns the finest tile with height data.
+/// find_quad(quad_id) returns the cached quad as an optional (or anything else testable and dereferencable), see below.
+template <typename QuadLookup> std::optional<HeightTile> find_height_tile(const glm::dvec2& world_position, const QuadLookup& find_quad)
+{
+    for (auto tile_id = srs::world_to_tile_id(world_position, max_quad_zoom_level + 1); tile_id.zoom_level > 0; tile_id = tile_id.parent()) {
+        const auto& quad = find_quad(tile_id.parent());
+        if (!quad)
+            continue;
+        for (const auto& layered_tile : quad->tiles) {
+            if (layered_tile.id == tile_id && layered_tile.height && layered_tile.height->size())
+                return HeightTile { utils::ancestor(layered_tile.id, layered_tile.height_zoom_offset), layered_tile.height };
         }
     }
+    return {};
+}
 
-    assert(false);
-    return 1000;
+inline std::optional<HeightTile> find_height_tile(const MemoryCache& cache, const glm::dvec2& world_position)
+{
+    return find_height_tile(world_position, [&cache](const tile::Id& quad_id) { return cache.find(quad_id); });
+}
+
+/// bilinear interpolation of a height raster covering the bounds of tile_id. samples lie on a vertex grid (the outermost
+/// samples are on the tile border), rows go from north to south.
+inline float sample_altitude(const Raster<uint16_t>& heights, const tile::Id& tile_id, const glm::dvec2& world_position)
+{
+    assert(heights.width() >= 2 && heights.height() >= 2);
+    const auto bounds = srs::tile_bounds(tile_id);
+    const auto uv = glm::clamp((world_position - bounds.min) / bounds.size(), 0.0, 1.0);
+    const auto position = glm::dvec2(uv.x, 1.0 - uv.y) * glm::dvec2(heights.width() - 1, heights.height() - 1);
+    const auto x = std::min(unsigned(position.x), unsigned(heights.width() - 2));
+    const auto y = std::min(unsigned(position.y), unsigned(heights.height() - 2));
+    const auto f = position - glm::dvec2(x, y);
+    const auto h = [&](unsigned dx, unsigned dy) { return double(heights.pixel({ x + dx, y + dy })); };
+    const auto top = h(0, 0) * (1 - f.x) + h(1, 0) * f.x;
+    const auto bottom = h(0, 1) * (1 - f.x) + h(1, 1) * f.x;
+    return float((top * (1 - f.y) + bottom * f.y) * height_scale);
+}
+
+/// decodes the height tile on every call, DataQuerier::get_altitude keeps decoded tiles around.
+inline float query_altitude(const MemoryCache* cache, const glm::dvec2& lat_long)
+{
+    const auto world_position = srs::lat_long_to_world(lat_long);
+    const auto height_tile = find_height_tile(*cache, world_position);
+    if (!height_tile)
+        return default_altitude;
+    return sample_altitude(nucleus::utils::image_loader::height(*height_tile->data), height_tile->id, world_position);
 }
 
 } // namespace nucleus::tile_scheduler::cache_queries
@@ -18,6 +18,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <optional>
+
 #include <QByteArray>
 
 #include "nucleus/tile_scheduler/utils.h"
@@ -71,6 +74,24 @@ concept SerialisableTile = requires(T t) {
     requires std::is_same<std::remove_reference_t<decltype(T::version_information)>, const std::array<char, 25>>::value;
 };
 
+/// Describes where a layer (ortho, height, vector tiles..) has data. Requests outside of zoom range or coverage are guaranteed to fail,
+/// so they are not sent in the first place. coverage is given in srs (web mercator), no coverage means the whole world.
+struct LayerMetaData {
+    unsigned min_zoom = 0;
+    unsigned max_zoom = std::numeric_limits<unsigned>::max();
+    std::optional<tile::SrsBounds> coverage = {};
+
+    [[nodiscard]] bool covers(const tile::Id& id) const
+    {
+        if (id.zoom_level < min_zoom || id.zoom_level > max_zoom)
+            return false;
+        if (!coverage.has_value())
+            return true;
+        const auto bounds = srs::tile_bounds(id);
+        return bounds.min.x < coverage->max.x && coverage->min.x < bounds.max.x && bounds.min.y < coverage->max.y && coverage->min.y < bounds.max.y;
+    }
+};
+
 struct TileLayer {
     tile::Id id;
     NetworkInfo network_info;
@@ -86,6 +107,9 @@ struct LayeredTile {
 #ifdef ALP_ENABLE_LABELS
     std::shared_ptr<QByteArray> vector_tile;
 #endif
+    // ortho and height can come from an ancestor tile (see LayerAssembler). 0 means they belong to this tile.
+    unsigned ortho_zoom_offset = 0;
+    unsigned height_zoom_offset = 0;
 };
 static_assert(NamedTile<LayeredTile>);
 
@@ -96,7 +120,12 @@ struct TileQuad {
     NetworkInfo network_info() const {
         return NetworkInfo::join(tiles[0].network_info, tiles[1].network_info, tiles[2].network_info, tiles[3].network_info);
     }
-    static constexpr std::array<char, 25> version_information = {"TileQuad, version 0.3"};
+    // tiles that failed or timed out (QuadAssembler emits such quads as partial). they are drawn from a fallback and requested again.
+    unsigned n_missing_tiles() const
+    {
+        return unsigned(std::count_if(tiles.cbegin(), tiles.cend(), [](const LayeredTile& t) { return t.network_info.status == NetworkInfo::Status::NetworkError; }));
+    }
+    static constexpr std::array<char, 25> version_information = {"TileQuad, version 0.4"};
 };
 static_assert(NamedTile<TileQuad>);
 static_assert(SerialisableTile<TileQuad>);
@@ -18,4 +18,92 @@
 
 #include "utils.h"
 
+#include <algorithm>
+#include <mutex>
 
+using namespace nucleus::tile_scheduler::utils;
+
+AabbDecorator::AabbDecorator(TileHeights tile_heights, size_t cache_capacity)
+    : m_tile_heights(std::move(tile_heights))
+    , m_shards(std::min(cache_capacity, max_n_shards))
+{
+    if (!m_shards.empty())
+        m_shard_capacity = cache_capacity / m_shards.size();
+}
+
+AabbDecorator::Shard& AabbDecorator::shard(const tile::Id& id) const
+{
+    // neighbouring tiles have neighbouring morton keys, mix the bits so that they end up in different shards
+    const auto key = nucleus::utils::morton_key(id) * 0x9e37'79b9'7f4a'7c15ull;
+    return m_shards[(key >> 32) % m_shards.size()];
+}
+
+tile::SrsAndHeightBounds AabbDecorator::aabb(const tile::Id& id) const
+{
+    if (m_shards.empty()) {
+        std::shared_lock lock(m_heights_mutex);
+        const auto heights = m_tile_heights.query({ id.zoom_level, id.coords });
+        return make_bounds(id, heights.first, heights.second);
+    }
+
+    auto& shard = this->shard(id);
+    {
+        std::shared_lock lock(shard.mutex);
+        const auto iter = shard.aabbs.find(id);
+        if (iter != shard.aabbs.end())
+            return iter->second;
+    }
+
+    uint64_t generation = 0;
+    tile::SrsAndHeightBounds bounds;
+    {
+        std::shared_lock lock(m_heights_mutex);
+        generation = m_generation;
+        const auto heights = m_tile_heights.query({ id.zoom_level, id.coords });
+        bounds = make_bounds(id, heights.first, heights.second);
+    }
+
+    std::unique_lock lock(shard.mutex);
+    // update_heights bumps the generation before it invalidates the shards. so either the update is seen here, or the
+    // stale aabb is inserted before the update erases it.
+    if (generation != m_generation)
+        return bounds;
+    // clearing one shard is cheaper than tracking usage on every (concurrent) read. the working set of a frame is much
+    // smaller than the capacity, so only a fraction of it is refilled.
+    if (shard.aabbs.size() >= m_shard_capacity)
+        shard.aabbs.clear();
+    shard.aabbs.try_emplace(id, bounds);
+    return bounds;
+}
+
+void AabbDecorator::update_heights(const tile::Id& id, float min_height, float max_height)
+{
+    std::unique_lock lock(m_heights_mutex);
+    m_tile_heights.emplace(id, { min_height, max_height });
+    ++m_generation;
+    for (auto& shard : m_shards) {
+        std::unique_lock shard_lock(shard.mutex);
+        nucleus::utils::erase_if(shard.aabbs, [&id](const auto& entry) {
+            const auto& cached_id = entry.first;
+            return cached_id.zoom_level >= id.zoom_level && ancestor(cached_id, cached_id.zoom_level - id.zoom_level) == id;
+        });
+    }
+}
+
+void AabbDecorator::clear_cache()
+{
+    for (auto& shard : m_shards) {
+        std::unique_lock lock(shard.mutex);
+        shard.aabbs.clear();
+    }
+}
+
+size_t AabbDecorator::n_cached_aabbs() const
+{
+    size_t n = 0;
+    for (auto& shard : m_shards) {
+        std::shared_lock lock(shard.mutex);
+        n += shard.aabbs.size();
+    }
+    return n;
+}
@@ -22,11 +22,19 @@
 #include <concepts>
 #endif
 
+#include <atomic>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
 #include <QByteArray>
 
+#include "BatchFrustumCuller.h"
+#include "HorizonCuller.h"
 #include "constants.h"
 #include "nucleus/camera/Definition.h"
 #include "nucleus/srs.h"
+#include "nucleus/utils/TileIdMap.h"
 #include "radix/TileHeights.h"
 #include "radix/geometry.h"
 
@@ -115,23 +123,40 @@ namespace utils {
 
     class AabbDecorator;
     using AabbDecoratorPtr = std::shared_ptr<AabbDecorator>;
+    // Computes tile aabbs from the tile heights. make_bounds is relatively expensive (atan, exp, cos) and the same tiles
+    // are queried by every traversal, therefore the results are memoised. The decorator is shared between the scheduler
+    // and the render thread (and the workers of the parallel traversal), so all methods are thread safe. The memo is split
+    // into shards with their own locks, so concurrent misses rarely contend, and a full shard is cleared on its own.
     class AabbDecorator {
-        TileHeights tile_heights;
-
     public:
-        explicit inline AabbDecorator(TileHeights tile_heights)
-            : tile_heights(std::move(tile_heights))
-        {
-        }
-        inline tile::SrsAndHeightBounds aabb(const tile::Id& id) const
-        {
-            const auto heights = tile_heights.query({ id.zoom_level, id.coords });
-            return make_bounds(id, heights.first, heights.second);
-        }
+        static constexpr size_t default_cache_capacity = 1 << 16;
+
+        explicit AabbDecorator(TileHeights tile_heights, size_t cache_capacity = default_cache_capacity);
+        [[nodiscard]] tile::SrsAndHeightBounds aabb(const tile::Id& id) const;
+        // refines the heights of a tile (and therefore of all descendants, that don't have their own heights).
+        void update_heights(const tile::Id& id, float min_height, float max_height);
+        void clear_cache();
+        [[nodiscard]] size_t n_cached_aabbs() const;
+
         static inline AabbDecoratorPtr make(TileHeights heights)
         {
             return std::make_shared<AabbDecorator>(std::move(heights));
         }
+
+    private:
+        static constexpr size_t max_n_shards = 16;
+        struct Shard {
+            std::shared_mutex mutex;
+            nucleus::utils::TileIdMap<tile::SrsAndHeightBounds> aabbs;
+        };
+        [[nodiscard]] Shard& shard(const tile::Id& id) const;
+
+        TileHeights m_tile_heights;
+        mutable std::shared_mutex m_heights_mutex;
+        // bumped on every height update, so that aabbs computed from old heights are not inserted into the cache.
+        std::atomic<uint64_t> m_generation = 0;
+        size_t m_shard_capacity = 0;
+        mutable std::vector<Shard> m_shards;
     };
 
     inline auto camera_frustum_contains_tile_old(const nucleus::camera::Frustum& frustum, const tile::SrsAndHeightBounds& aabb)
@@ -246,14 +271,14 @@ namespace utils {
                                      float tile_size = 256)
     {
         constexpr auto sqrt2 = 1.414213562373095f;
-        const auto camera_frustum = camera.frustum();
+        const auto frustum_culler = BatchFrustumCuller(camera.frustum());
         auto refine =
-            [camera_frustum, camera, error_threshold_px, tile_size, aabb_decorator](const tile::Id& tile) {
+            [frustum_culler, camera, error_threshold_px, tile_size, aabb_decorator](const tile::Id& tile) {
                 if (tile.zoom_level >= 18)
                     return false;
 
                 auto aabb = aabb_decorator->aabb(tile);
-                if (!tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb))
+                if (!frustum_culler.contains(aabb))
                     return false;
                 const auto aabb_float = geometry::Aabb<3, float>{aabb.min - camera.position(),
                                                                  aabb.max - camera.position()};
@@ -269,26 +294,39 @@ namespace utils {
     inline auto refineFunctor(const nucleus::camera::Definition& camera,
         const AabbDecoratorPtr& aabb_decorator,
         float error_threshold_px,
-        double tile_size = 256)
+        double tile_size = 256,
+        std::shared_ptr<const HorizonCuller> horizon_culler = {})
     {
         constexpr auto sqrt2 = 1.414213562373095;
-        const auto camera_frustum = camera.frustum();
-        auto refine = [&camera, camera_frustum, error_threshold_px, tile_size, aabb_decorator](const tile::Id& tile) {
+        const auto frustum_culler = BatchFrustumCuller(camera.frustum());
+        auto refine = [&camera, frustum_culler, error_threshold_px, tile_size, aabb_decorator, horizon_culler](const tile::Id& tile) {
             if (tile.zoom_level >= 18)
                 return false;
 
             const auto aabb = aabb_decorator->aabb(tile);
-            if (!tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb))
+            if (!frustum_culler.contains(aabb))
                 return false;
 
             const auto distance = float(geometry::distance(aabb, camera.position()));
             const auto pixel_size = float(sqrt2 * aabb.size().x / tile_size);
 
-            return camera.to_screen_space(pixel_size, distance) >= error_threshold_px;
+            if (camera.to_screen_space(pixel_size, distance) < error_threshold_px)
+                return false;
+
+            // occluded tiles are drawn at their current resolution, no need to refine (and load) them
+            return !horizon_culler || !horizon_culler->occluded(aabb);
         };
         return refine;
     }
 
+    /// returns the ancestor n_levels up the tree (or the root, if the tile is not deep enough)
+    inline tile::Id ancestor(tile::Id id, unsigned n_levels)
+    {
+        for (unsigned i = 0; i < n_levels && id.zoom_level > 0; ++i)
+            id = id.parent();
+        return id;
+    }
+
     inline uint64_t time_since_epoch()
     {
         return uint64_t(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
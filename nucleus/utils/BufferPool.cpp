@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <new>
+
+namespace nucleus::utils {
+
+namespace {
+    bool is_pooled(size_t n_bytes) { return n_bytes >= BufferPool::min_block_size && n_bytes <= BufferPool::max_block_size; }
+    void* allocate_aligned(size_t n_bytes) { return ::operator new(n_bytes, std::align_val_t(BufferPool::alignment)); }
+    void free_aligned(void* ptr) { ::operator delete(ptr, std::align_val_t(BufferPool::alignment)); }
+} // namespace
+
+BufferPool::BufferPool(size_t max_cached_bytes)
+    : m_max_cached_bytes(max_cached_bytes)
+{
+}
+
+BufferPool::~BufferPool()
+{
+    assert(m_statistics.n_bytes_in_use == 0);
+    release_cached();
+}
+
+void* BufferPool::allocate(size_t n_bytes)
+{
+    if (!is_pooled(n_bytes))
+        return allocate_aligned(n_bytes);
+
+    const auto c = size_class(n_bytes);
+    const auto size = class_size(c);
+    {
+        std::unique_lock lock(m_mutex);
+        ++m_statistics.n_allocations;
+        m_statistics.n_bytes_in_use += size;
+        auto& free_blocks = m_free_blocks[c];
+        if (!free_blocks.empty()) {
+            void* ptr = free_blocks.back();
+            free_blocks.pop_back();
+            m_statistics.n_bytes_cached -= size;
+            ++m_statistics.n_reused;
+            return ptr;
+        }
+        m_statistics.n_bytes_peak = std::max(m_statistics.n_bytes_peak, m_statistics.n_bytes_in_use + m_statistics.n_bytes_cached);
+    }
+    return allocate_aligned(size);
+}
+
+void BufferPool::deallocate(void* ptr, size_t n_bytes)
+{
+    if (ptr == nullptr)
+        return;
+    if (is_pooled(n_bytes)) {
+        const auto c = size_class(n_bytes);
+        const auto size = class_size(c);
+        std::unique_lock lock(m_mutex);
+        assert(m_statistics.n_bytes_in_use >= size);
+        m_statistics.n_bytes_in_use -= size;
+        if (m_statistics.n_bytes_cached + size <= m_max_cached_bytes) {
+            m_free_blocks[c].push_back(ptr);
+            m_statistics.n_bytes_cached += size;
+            return;
+        }
+    }
+    free_aligned(ptr);
+}
+
+void BufferPool::release_cached()
+{
+    std::unique_lock lock(m_mutex);
+    for (auto& free_blocks : m_free_blocks) {
+        for (void* ptr : free_blocks)
+            free_aligned(ptr);
+        free_blocks.clear();
+        free_blocks.shrink_to_fit();
+    }
+    m_statistics.n_bytes_cached = 0;
+}
+
+BufferPool::Statistics BufferPool::statistics() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_statistics;
+}
+
+size_t BufferPool::max_cached_bytes() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_max_cached_bytes;
+}
+
+void BufferPool::set_max_cached_bytes(size_t max_cached_bytes)
+{
+    std::unique_lock lock(m_mutex);
+    m_max_cached_bytes = max_cached_bytes;
+    trim();
+}
+
+size_t BufferPool::block_size(size_t n_bytes) { return is_pooled(n_bytes) ? class_size(size_class(n_bytes)) : n_bytes; }
+
+BufferPool& BufferPool::shared()
+{
+    static auto* pool = new BufferPool();
+    return *pool;
+}
+
+unsigned BufferPool::size_class(size_t n_bytes)
+{
+    assert(is_pooled(n_bytes));
+    if (n_bytes <= min_block_size)
+        return 0;
+    // n_bytes is in (base, 2 * base], which is split into n_steps_per_octave classes
+    const auto octave = unsigned(std::bit_width((n_bytes - 1) / min_block_size)) - 1;
+    const auto base = min_block_size << octave;
+    const auto step = unsigned(((n_bytes - base) * n_steps_per_octave + base - 1) / base);
+    return octave * n_steps_per_octave + step;
+}
+
+size_t BufferPool::class_size(unsigned size_class)
+{
+    assert(size_class < n_size_classes);
+    const auto octave = size_class / n_steps_per_octave;
+    const auto step = size_class % n_steps_per_octave;
+    return (min_block_size << octave) / n_steps_per_octave * (n_steps_per_octave + step);
+}
+
+void BufferPool::trim()
+{
+    // largest blocks first, they are the least likely to be needed again soon
+    for (unsigned c = n_size_classes; c-- > 0 && m_statistics.n_bytes_cached > m_max_cached_bytes;) {
+        auto& free_blocks = m_free_blocks[c];
+        for (; !free_blocks.empty() && m_statistics.n_bytes_cached > m_max_cached_bytes; free_blocks.pop_back()) {
+            free_aligned(free_blocks.back());
+            m_statistics.n_bytes_cached -= class_size(c);
+        }
+    }
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,101 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace nucleus::utils {
+
+/// Recycles tile sized heap blocks (decoded images, rasters, compressed textures), so that streaming tiles doesn't
+/// churn the allocator. Sizes are rounded up to one of 4 size classes per power of two (at most 25% waste); blocks
+/// outside [min_block_size, max_block_size] are not pooled. Freed blocks are kept up to max_cached_bytes in total,
+/// everything beyond that goes back to the system. Thread safe.
+class BufferPool {
+public:
+    struct Statistics {
+        uint64_t n_allocations = 0; // pooled sizes only
+        uint64_t n_reused = 0; // allocations served from a cached block
+        size_t n_bytes_in_use = 0; // handed out and not yet returned (rounded up to the size class)
+        size_t n_bytes_cached = 0; // returned and kept for reuse
+        size_t n_bytes_peak = 0; // high water mark of in use + cached
+        [[nodiscard]] double reuse_rate() const { return n_allocations == 0 ? 0.0 : double(n_reused) / double(n_allocations); }
+    };
+
+    static constexpr size_t min_block_size = 4 * 1024;
+    static constexpr size_t max_block_size = 16 * 1024 * 1024;
+    static constexpr size_t alignment = 64; // cache line, also enough for the simd texture compressors
+    static constexpr size_t default_max_cached_bytes = 64 * 1024 * 1024;
+
+    explicit BufferPool(size_t max_cached_bytes = default_max_cached_bytes);
+    ~BufferPool(); // all blocks must have been returned
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /// returns memory aligned to BufferPool::alignment. n_bytes must be passed to deallocate again.
+    [[nodiscard]] void* allocate(size_t n_bytes);
+    void deallocate(void* ptr, size_t n_bytes);
+    /// frees all cached blocks (e.g., when the app goes into the background)
+    void release_cached();
+
+    [[nodiscard]] Statistics statistics() const;
+    [[nodiscard]] size_t max_cached_bytes() const;
+    void set_max_cached_bytes(size_t max_cached_bytes);
+
+    /// the size a request is rounded up to. n_bytes outside the pooled range are returned unchanged.
+    static size_t block_size(size_t n_bytes);
+
+    /// used by PoolAllocator, i.e., by Raster and ColourTexture storage. never destroyed, so that static rasters can outlive it.
+    static BufferPool& shared();
+
+private:
+    static constexpr unsigned n_steps_per_octave = 4;
+    static constexpr unsigned n_size_classes = 12 * n_steps_per_octave + 1; // min_block_size << 12 == max_block_size
+    static unsigned size_class(size_t n_bytes);
+    static size_t class_size(unsigned size_class);
+    void trim(); // m_mutex must be held
+
+    mutable std::mutex m_mutex;
+    std::array<std::vector<void*>, n_size_classes> m_free_blocks;
+    size_t m_max_cached_bytes;
+    Statistics m_statistics;
+};
+
+/// std allocator on top of BufferPool::shared(). small allocations still go through it, but are not pooled.
+template <typename T> class PoolAllocator {
+public:
+    using value_type = T;
+    static_assert(alignof(T) <= BufferPool::alignment);
+
+    PoolAllocator() noexcept = default;
+    template <typename U> PoolAllocator(const PoolAllocator<U>&) noexcept { }
+
+    [[nodiscard]] T* allocate(size_t n) { return static_cast<T*>(BufferPool::shared().allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) noexcept { BufferPool::shared().deallocate(ptr, n * sizeof(T)); }
+
+    template <typename U> bool operator==(const PoolAllocator<U>&) const noexcept { return true; }
+};
+
+template <typename T> using PooledVector = std::vector<T, PoolAllocator<T>>;
+
+} // namespace nucleus::utils
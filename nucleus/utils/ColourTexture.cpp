@@ -19,103 +19,174 @@
 
 #include "ColourTexture.h"
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <stdexcept>
 
+#include "BufferPool.h"
+#include "WorkerPool.h"
+
 #define GOOFYTC_IMPLEMENTATION
 #include <GoofyTC/goofy_tc.h>
 
 
 namespace {
 
-std::vector<uint8_t> to_dxt1(const nucleus::Raster<glm::u8vec4>& image)
+using Buffer = nucleus::utils::ColourTexture::Buffer;
+
+struct alignas(16) AlignedBlock {
+    std::array<uint8_t, 16> data;
+};
+static_assert(sizeof(AlignedBlock) == 16);
+
+// goofy needs 16 byte aligned input. rasters (pooled storage) and decoder allocations usually are, copy only if not.
+const uint8_t* aligned_rgba(const uint8_t* rgba, const glm::uvec2& size, nucleus::utils::PooledVector<AlignedBlock>* storage)
 {
-    assert(image.width() == image.height());
-    assert(image.width() % 16 == 0);
-    assert(image.size_per_line() * image.height() == image.width() * image.height() * 4);
-    assert(image.size_in_bytes() == image.width() * image.height() * 4);
-
-    struct alignas(16) AlignedBlock
-    {
-        std::array<uint8_t, 16> data;
-    };
-    static_assert(sizeof(AlignedBlock) == 16);
-
-    const auto n_bytes_in = size_t(image.size_in_bytes());
-    const auto n_bytes_out = image.width() * image.height() / 2;
+    if (reinterpret_cast<uintptr_t>(rgba) % alignof(AlignedBlock) == 0)
+        return rgba;
+    const auto n_bytes_in = size_t(size.x) * size.y * 4;
     assert(n_bytes_in % sizeof(AlignedBlock) == 0);
+    storage->resize(n_bytes_in / sizeof(AlignedBlock));
+    auto data_ptr = reinterpret_cast<uint8_t*>(storage->data());
+    std::copy(rgba, rgba + n_bytes_in, data_ptr);
+    return data_ptr;
+}
 
-    auto aligned_in = std::vector<AlignedBlock>(n_bytes_in / sizeof(AlignedBlock));
-    auto data_ptr = reinterpret_cast<uint8_t*>(aligned_in.data());
-    std::copy(image.bytes(), image.bytes() + n_bytes_in, data_ptr);
-
-    std::vector<uint8_t> compressed(n_bytes_out);
-    const auto result = goofy::compressDXT1(compressed.data(), data_ptr, (uint32_t)image.width(), (uint32_t)image.height(), (uint32_t)image.width() * 4);
-    assert(result == 0);
+// goofy compresses rows of 4x4 blocks independently, so horizontal strips can be compressed in parallel, straight into
+// their place in the output. the result is identical to compressing the whole texture at once.
+template <typename Compressor> Buffer compress_in_strips(const uint8_t* rgba, const glm::uvec2& size, Compressor compress)
+{
+    using nucleus::utils::ColourTexture;
+    assert(size.x == size.y);
+    assert(size.x % 16 == 0);
+    assert(ColourTexture::strip_height % 16 == 0);
+
+    nucleus::utils::PooledVector<AlignedBlock> aligned_storage;
+    const auto* data_ptr = aligned_rgba(rgba, size, &aligned_storage);
+
+    Buffer compressed(size_t(size.x) * size.y / 2);
+    const auto stride = size.x * 4;
+    const auto n_strips = std::max(size.y / ColourTexture::strip_height, 1u);
+    nucleus::utils::WorkerPool::shared().parallel_for(n_strips, [&](unsigned strip) {
+        const auto first_row = strip * ColourTexture::strip_height;
+        const auto n_rows = strip + 1 == n_strips ? size.y - first_row : ColourTexture::strip_height;
+        // 8 bytes per 4x4 block, i.e., half a byte per pixel
+        [[maybe_unused]] const auto result = compress(compressed.data() + size_t(first_row) * size.x / 2, data_ptr + size_t(first_row) * stride, size.x, n_rows, stride);
+        assert(result == 0);
+    });
 
     return compressed;
 }
 
-std::vector<uint8_t> to_etc1(const nucleus::Raster<glm::u8vec4>& image)
+Buffer to_dxt1(const uint8_t* rgba, const glm::uvec2& size)
 {
-    assert(image.width() == image.height());
-    assert(image.width() % 16 == 0);
-    assert(image.size_per_line() * image.height() == image.width() * image.height() * 4);
-    assert(image.size_in_bytes() == image.width() * image.height() * 4);
-
-    struct alignas(16) AlignedBlock
-    {
-        std::array<uint8_t, 16> data;
-    };
-    static_assert(sizeof(AlignedBlock) == 16);
-
-    const auto n_bytes_in = size_t(image.size_in_bytes());
-    const auto n_bytes_out = image.width() * image.height() / 2;
-    assert(n_bytes_in % sizeof(AlignedBlock) == 0);
-
-    auto aligned_in = std::vector<AlignedBlock>(n_bytes_in / sizeof(AlignedBlock));
-    auto data_ptr = reinterpret_cast<uint8_t*>(aligned_in.data());
-    std::copy(image.bytes(), image.bytes() + n_bytes_in, data_ptr);
-
-    std::vector<uint8_t> compressed(n_bytes_out);
-    const auto result = goofy::compressETC1(compressed.data(), data_ptr, (uint32_t)image.width(), (uint32_t)image.height(), (uint32_t)image.width() * 4);
-    assert(result == 0);
+    return compress_in_strips(rgba, size, [](auto... args) { return goofy::compressDXT1(args...); });
+}
 
-    return compressed;
+Buffer to_etc1(const uint8_t* rgba, const glm::uvec2& size)
+{
+    return compress_in_strips(rgba, size, [](auto... args) { return goofy::compressETC1(args...); });
 }
 
-std::vector<uint8_t> to_uncompressed_rgba(const nucleus::Raster<glm::u8vec4>& image)
+Buffer to_uncompressed_rgba(const uint8_t* rgba, const glm::uvec2& size) { return { rgba, rgba + size_t(size.x) * size.y * 4 }; }
+
+template <typename Compressor> Buffer compress_padded(const uint8_t* rgba, const glm::uvec2& size, Compressor compress)
 {
-    size_t size_in_bytes = image.size_in_bytes();
-    assert(size_in_bytes == (size_t)image.width() * image.height() * 4);
-    std::vector<uint8_t> data(size_in_bytes);
-    // Note: AND Another copy... We copy the data two times (once in stb_image_loader.cpp)
-    std::copy(image.bytes(), image.bytes() + image.size_in_bytes(), data.data());
-    return data;
+    // goofy works on at least 16x16 pixels. small mip levels are padded by repeating the edge, and only the blocks covering
+    // the level are kept (levels smaller than 4x4 still take a whole block).
+    constexpr unsigned n = 16;
+    assert(size.x <= n && size.y <= n);
+    std::array<AlignedBlock, n * n * 4 / sizeof(AlignedBlock)> padded;
+    auto* padded_ptr = reinterpret_cast<uint8_t*>(padded.data());
+    for (unsigned y = 0; y < n; ++y) {
+        for (unsigned x = 0; x < n; ++x) {
+            const auto* source = rgba + (size_t(std::min(y, size.y - 1)) * size.x + std::min(x, size.x - 1)) * 4;
+            std::copy(source, source + 4, padded_ptr + (y * n + x) * 4);
+        }
+    }
+    const auto compressed = compress_in_strips(padded_ptr, { n, n }, compress);
+
+    constexpr auto n_bytes_per_block = 8u;
+    const auto n_blocks = (size + 3u) / 4u;
+    Buffer retval;
+    retval.reserve(n_blocks.x * n_blocks.y * n_bytes_per_block);
+    for (unsigned y = 0; y < n_blocks.y; ++y) {
+        const auto row = compressed.cbegin() + y * (n / 4) * n_bytes_per_block;
+        retval.insert(retval.end(), row, row + n_blocks.x * n_bytes_per_block);
+    }
+    return retval;
 }
 
-std::vector<uint8_t> to_compressed(const nucleus::Raster<glm::u8vec4>& image, nucleus::utils::ColourTexture::Format algorithm)
+Buffer to_compressed(const uint8_t* rgba, const glm::uvec2& size, nucleus::utils::ColourTexture::Format algorithm)
 {
     using Algorithm = nucleus::utils::ColourTexture::Format;
+    const auto small = size.x < 16 || size.y < 16;
 
     switch (algorithm) {
     case Algorithm::Uncompressed_RGBA:
-        return to_uncompressed_rgba(image);
+        return to_uncompressed_rgba(rgba, size);
     case nucleus::utils::ColourTexture::Format::DXT1:
-        return to_dxt1(image);
+        return small ? compress_padded(rgba, size, [](auto... args) { return goofy::compressDXT1(args...); }) : to_dxt1(rgba, size);
     case nucleus::utils::ColourTexture::Format::ETC1:
-        return to_etc1(image);
+        return small ? compress_padded(rgba, size, [](auto... args) { return goofy::compressETC1(args...); }) : to_etc1(rgba, size);
     }
     throw std::runtime_error("Unsupported algorithm for nucleus::Raster<glm::u8vec4>");
 }
+
+// 2x2 box filter. odd sizes repeat the last row / column.
+Buffer half_size(const uint8_t* rgba, const glm::uvec2& size)
+{
+    const auto target_size = glm::max(size / 2u, 1u);
+    Buffer retval(size_t(target_size.x) * target_size.y * 4);
+    for (unsigned y = 0; y < target_size.y; ++y) {
+        const auto* row_0 = rgba + size_t(std::min(2 * y, size.y - 1)) * size.x * 4;
+        const auto* row_1 = rgba + size_t(std::min(2 * y + 1, size.y - 1)) * size.x * 4;
+        for (unsigned x = 0; x < target_size.x; ++x) {
+            const auto x0 = std::min(2 * x, size.x - 1) * 4;
+            const auto x1 = std::min(2 * x + 1, size.x - 1) * 4;
+            for (unsigned c = 0; c < 4; ++c) {
+                const auto sum = unsigned(row_0[x0 + c]) + row_0[x1 + c] + row_1[x0 + c] + row_1[x1 + c];
+                retval[(size_t(y) * target_size.x + x) * 4 + c] = uint8_t((sum + 2) / 4);
+            }
+        }
+    }
+    return retval;
+}
 } // namespace
 
-nucleus::utils::ColourTexture::ColourTexture(const nucleus::Raster<glm::u8vec4>& image, Format format)
-    : m_data(to_compressed(image, format))
-    , m_width(unsigned(image.width()))
-    , m_height(unsigned(image.height()))
+nucleus::utils::ColourTexture::ColourTexture(const nucleus::Raster<glm::u8vec4>& image, Format format, MipMaps mip_maps)
+    : ColourTexture(image.bytes(), image.size(), format, mip_maps)
+{
+}
+
+nucleus::utils::ColourTexture::ColourTexture(const uint8_t* rgba, const glm::uvec2& size, Format format, MipMaps mip_maps)
+    : m_data(to_compressed(rgba, size, format))
+    , m_level_offsets({ 0, m_data.size() })
+    , m_width(size.x)
+    , m_height(size.y)
     , m_format(format)
 {
+    if (mip_maps == MipMaps::None)
+        return;
+
+    const auto n_levels = mip_chain_length(size);
+    Buffer level_rgba;
+    auto level_size = size;
+    for (unsigned level = 1; level < n_levels; ++level) {
+        level_rgba = half_size(level == 1 ? rgba : level_rgba.data(), level_size);
+        level_size = glm::max(level_size / 2u, 1u);
+        const auto level_data = to_compressed(level_rgba.data(), level_size, format);
+        m_data.insert(m_data.end(), level_data.cbegin(), level_data.cend());
+        m_level_offsets.push_back(m_data.size());
+    }
+}
+
+unsigned nucleus::utils::ColourTexture::mip_chain_length(const glm::uvec2& size)
+{
+    unsigned n = 1;
+    for (auto s = std::max(size.x, size.y); s > 1; s /= 2)
+        ++n;
+    return n;
 }
 
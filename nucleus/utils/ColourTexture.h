@@ -19,29 +19,43 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <glm/glm.hpp>
 #include "nucleus/Raster.h"
+#include "nucleus/utils/BufferPool.h"
 
 namespace nucleus::utils {
 
 class ColourTexture {
 public:
     enum class Format { Uncompressed_RGBA, DXT1, ETC1 };
+    enum class MipMaps { None, Full }; // Full: box filtered down to 1x1, each level is compressed separately
+    using Buffer = PooledVector<uint8_t>;
 
 private:
-    std::vector<uint8_t> m_data;
+    Buffer m_data; // all mip levels, largest first
+    std::vector<size_t> m_level_offsets; // n_mip_levels + 1 entries
     unsigned m_width = 0;
     unsigned m_height = 0;
     Format m_format = Format::Uncompressed_RGBA;
 
 public:
-    explicit ColourTexture(const nucleus::Raster<glm::u8vec4>& data, Format format);
-    [[nodiscard]] const uint8_t* data() const { return m_data.data(); }
-    [[nodiscard]] size_t n_bytes() const { return m_data.size(); }
-    [[nodiscard]] unsigned width() const { return m_width; }
-    [[nodiscard]] unsigned height() const { return m_height; }
+    // compression is split into strips of this many rows, which are processed on the shared WorkerPool
+    static constexpr unsigned strip_height = 64;
+
+    explicit ColourTexture(const nucleus::Raster<glm::u8vec4>& data, Format format, MipMaps mip_maps = MipMaps::None);
+    /// rgba points to size.x * size.y tightly packed rgba8 pixels, e.g., straight out of the image decoder
+    ColourTexture(const uint8_t* rgba, const glm::uvec2& size, Format format, MipMaps mip_maps = MipMaps::None);
+    [[nodiscard]] const uint8_t* data(unsigned mip_level = 0) const { return m_data.data() + m_level_offsets[mip_level]; }
+    [[nodiscard]] size_t n_bytes(unsigned mip_level = 0) const { return m_level_offsets[mip_level + 1] - m_level_offsets[mip_level]; }
+    [[nodiscard]] unsigned width(unsigned mip_level = 0) const { return std::max(m_width >> mip_level, 1u); }
+    [[nodiscard]] unsigned height(unsigned mip_level = 0) const { return std::max(m_height >> mip_level, 1u); }
+    [[nodiscard]] unsigned n_mip_levels() const { return unsigned(m_level_offsets.size() - 1); }
     [[nodiscard]] Format format() const { return m_format; }
+
+    /// number of levels down to 1x1
+    static unsigned mip_chain_length(const glm::uvec2& size);
 };
 
 } // namespace nucleus::utils
@@ -0,0 +1,62 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+
+#include <QByteArray>
+
+#include "LruCache.h"
+
+namespace nucleus::utils {
+
+/// Thread safe lru cache for data decoded from tiles in the ram cache (height rasters, height pyramids, ..). Keyed by the
+/// address of the tile bytes, entries hold on to the bytes, so the address can't be reused for other data while cached.
+template <typename T> class DecodedTileCache {
+    struct Entry {
+        std::shared_ptr<const QByteArray> source;
+        std::shared_ptr<const T> decoded;
+    };
+    std::mutex m_mutex;
+    LruCache<const QByteArray*, Entry> m_entries;
+
+public:
+    explicit DecodedTileCache(size_t capacity)
+        : m_entries(capacity)
+    {
+    }
+
+    /// decode(const QByteArray&) -> T runs outside of the lock. two threads might decode the same tile, that's cheaper than
+    /// serialising all lookups.
+    template <typename DecodeFunction> [[nodiscard]] std::shared_ptr<const T> get(const std::shared_ptr<QByteArray>& data, const DecodeFunction& decode)
+    {
+        {
+            std::scoped_lock lock(m_mutex);
+            if (const auto* entry = m_entries.get(data.get()))
+                return entry->decoded;
+        }
+        auto decoded = std::make_shared<const T>(decode(*data));
+        std::scoped_lock lock(m_mutex);
+        m_entries.put(data.get(), { data, decoded });
+        return decoded;
+    }
+};
+
+} // namespace nucleus::utils
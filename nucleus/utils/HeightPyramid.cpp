@@ -0,0 +1,63 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "HeightPyramid.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace nucleus::utils {
+
+HeightPyramid::HeightPyramid(Raster<uint16_t> heights)
+    : m_heights(std::move(heights))
+{
+    assert(m_heights.width() >= 2 && m_heights.height() >= 2);
+
+    Raster<glm::u16vec2> cells({ unsigned(m_heights.width() - 1), unsigned(m_heights.height() - 1) });
+    for (unsigned y = 0; y < cells.height(); ++y) {
+        for (unsigned x = 0; x < cells.width(); ++x) {
+            const auto a = m_heights.pixel({ x, y });
+            const auto b = m_heights.pixel({ x + 1, y });
+            const auto c = m_heights.pixel({ x, y + 1 });
+            const auto d = m_heights.pixel({ x + 1, y + 1 });
+            cells.pixel({ x, y }) = { std::min({ a, b, c, d }), std::max({ a, b, c, d }) };
+        }
+    }
+    m_levels.push_back(std::move(cells));
+
+    while (m_levels.back().width() > 1 || m_levels.back().height() > 1) {
+        const auto& finer = m_levels.back();
+        Raster<glm::u16vec2> coarser({ unsigned(finer.width() + 1) / 2, unsigned(finer.height() + 1) / 2 });
+        for (unsigned y = 0; y < coarser.height(); ++y) {
+            for (unsigned x = 0; x < coarser.width(); ++x) {
+                auto min_max = finer.pixel({ 2 * x, 2 * y });
+                for (const auto& offset : { glm::uvec2(1, 0), glm::uvec2(0, 1), glm::uvec2(1, 1) }) {
+                    const auto position = glm::uvec2(2 * x, 2 * y) + offset;
+                    if (position.x >= finer.width() || position.y >= finer.height())
+                        continue;
+                    const auto value = finer.pixel(position);
+                    min_max = { std::min(min_max.x, value.x), std::max(min_max.y, value.y) };
+                }
+                coarser.pixel({ x, y }) = min_max;
+            }
+        }
+        m_levels.push_back(std::move(coarser));
+    }
+}
+
+} // namespace nucleus::utils
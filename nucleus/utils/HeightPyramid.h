@@ -0,0 +1,51 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "nucleus/Raster.h"
+
+namespace nucleus::utils {
+
+// Min/max mipmaps of a height raster for hierarchical ray casting. The raster is a vertex grid (as in the tile cache,
+// the outermost samples lie on the tile border), so w x h samples span (w - 1) x (h - 1) cells. Level 0 holds the
+// min and max of the 4 corner samples of every cell, every further level reduces 2x2 entries of the previous one
+// (rounding up for odd sizes) until a single entry bounds the whole tile.
+class HeightPyramid {
+public:
+    /// heights must be at least 2x2 samples
+    explicit HeightPyramid(Raster<uint16_t> heights);
+
+    [[nodiscard]] const Raster<uint16_t>& heights() const { return m_heights; }
+    [[nodiscard]] unsigned n_levels() const { return unsigned(m_levels.size()); }
+    /// x = min, y = max
+    [[nodiscard]] const Raster<glm::u16vec2>& level(unsigned index) const { return m_levels[index]; }
+    [[nodiscard]] glm::u16vec2 min_max() const { return m_levels.back().pixel({ 0, 0 }); }
+    [[nodiscard]] glm::uvec2 n_cells() const { return m_levels.front().size(); }
+
+private:
+    Raster<uint16_t> m_heights;
+    std::vector<Raster<glm::u16vec2>> m_levels;
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,81 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace nucleus::utils {
+
+/// Least recently used cache with a fixed number of entries. get and put are O(1), put evicts the least recently used
+/// entry when full. Not thread safe.
+template <typename Key, typename Value, typename Hash = std::hash<Key>> class LruCache {
+    using Entry = std::pair<Key, Value>;
+    std::list<Entry> m_entries; // most recently used first
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> m_index;
+    size_t m_capacity;
+
+public:
+    explicit LruCache(size_t capacity)
+        : m_capacity(capacity)
+    {
+        assert(capacity > 0);
+        m_index.reserve(capacity);
+    }
+
+    /// marks the entry as recently used. nullptr if not cached, the pointer is valid until the next put or clear.
+    [[nodiscard]] const Value* get(const Key& key)
+    {
+        const auto iter = m_index.find(key);
+        if (iter == m_index.end())
+            return nullptr;
+        m_entries.splice(m_entries.begin(), m_entries, iter->second);
+        return &iter->second->second;
+    }
+
+    void put(const Key& key, Value value)
+    {
+        if (const auto iter = m_index.find(key); iter != m_index.end()) {
+            iter->second->second = std::move(value);
+            m_entries.splice(m_entries.begin(), m_entries, iter->second);
+            return;
+        }
+        if (m_entries.size() == m_capacity) {
+            m_index.erase(m_entries.back().first);
+            m_entries.pop_back();
+        }
+        m_entries.emplace_front(key, std::move(value));
+        m_index.emplace(key, m_entries.begin());
+    }
+
+    [[nodiscard]] bool contains(const Key& key) const { return m_index.contains(key); }
+    [[nodiscard]] size_t size() const { return m_entries.size(); }
+    [[nodiscard]] size_t capacity() const { return m_capacity; }
+    void clear()
+    {
+        m_entries.clear();
+        m_index.clear();
+    }
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,203 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "SlotAllocator.h"
+
+#include <cassert>
+
+using namespace nucleus::utils;
+
+SlotAllocator::SlotAllocator(unsigned capacity)
+    : m_position_in_free_stack(capacity)
+{
+    clear();
+}
+
+std::optional<unsigned> SlotAllocator::allocate()
+{
+    if (m_free_stack.empty())
+        return {};
+    const auto slot = m_free_stack.back();
+    m_free_stack.pop_back();
+    m_position_in_free_stack[slot] = used;
+    return slot;
+}
+
+bool SlotAllocator::allocate(unsigned slot)
+{
+    assert(slot < capacity());
+    const auto position = m_position_in_free_stack[slot];
+    if (position == used)
+        return false;
+    // swap with the top of the stack and pop
+    const auto top = m_free_stack.back();
+    m_free_stack[position] = top;
+    m_position_in_free_stack[top] = position;
+    m_free_stack.pop_back();
+    m_position_in_free_stack[slot] = used;
+    return true;
+}
+
+std::vector<unsigned> SlotAllocator::allocate_n(unsigned n)
+{
+    if (n > n_free())
+        return {};
+    std::vector<unsigned> slots;
+    slots.reserve(n);
+    for (unsigned i = 0; i < n; ++i)
+        slots.push_back(*allocate());
+    return slots;
+}
+
+bool SlotAllocator::free(unsigned slot)
+{
+    assert(slot < capacity());
+    if (m_position_in_free_stack[slot] != used)
+        return false;
+    m_position_in_free_stack[slot] = unsigned(m_free_stack.size());
+    m_free_stack.push_back(slot);
+    return true;
+}
+
+void SlotAllocator::free(std::span<const unsigned> slots)
+{
+    for (const auto slot : slots)
+        free(slot);
+}
+
+void SlotAllocator::clear()
+{
+    // reversed, so that a fresh allocator hands out 0, 1, 2, ..
+    const auto n = capacity();
+    m_free_stack.resize(n);
+    for (unsigned i = 0; i < n; ++i) {
+        m_free_stack[i] = n - 1 - i;
+        m_position_in_free_stack[n - 1 - i] = i;
+    }
+}
+
+bool SlotAllocator::is_used(unsigned slot) const { return slot < capacity() && m_position_in_free_stack[slot] == used; }
+
+unsigned SlotAllocator::n_used() const { return capacity() - n_free(); }
+
+unsigned SlotAllocator::n_free() const { return unsigned(m_free_stack.size()); }
+
+unsigned SlotAllocator::capacity() const { return unsigned(m_position_in_free_stack.size()); }
+
+std::vector<unsigned> SlotAllocator::used_slots() const
+{
+    std::vector<unsigned> slots;
+    slots.reserve(n_used());
+    for (unsigned i = 0; i < capacity(); ++i) {
+        if (m_position_in_free_stack[i] == used)
+            slots.push_back(i);
+    }
+    return slots;
+}
+
+SlotAllocator::Statistics SlotAllocator::statistics() const
+{
+    Statistics s;
+    s.n_used = n_used();
+    s.capacity = capacity();
+    for (unsigned i = capacity(); i > 0; --i) {
+        if (m_position_in_free_stack[i - 1] == used) {
+            s.high_water_mark = i;
+            break;
+        }
+    }
+    s.n_holes = s.high_water_mark - s.n_used;
+    return s;
+}
+
+TileSlotAllocator::TileSlotAllocator(unsigned capacity)
+    : m_slots(capacity)
+    , m_tile_of_slot(capacity)
+{
+    m_slot_of_tile.reserve(capacity);
+}
+
+std::optional<unsigned> TileSlotAllocator::allocate(const tile::Id& id)
+{
+    if (const auto iter = m_slot_of_tile.find(id); iter != m_slot_of_tile.end())
+        return iter->second;
+    const auto slot = m_slots.allocate();
+    if (!slot)
+        return {};
+    m_slot_of_tile[id] = *slot;
+    m_tile_of_slot[*slot] = id;
+    return slot;
+}
+
+std::vector<std::optional<unsigned>> TileSlotAllocator::allocate(std::span<const tile::Id> ids)
+{
+    std::vector<std::optional<unsigned>> slots;
+    slots.reserve(ids.size());
+    for (const auto& id : ids)
+        slots.push_back(allocate(id));
+    return slots;
+}
+
+std::optional<unsigned> TileSlotAllocator::free(const tile::Id& id)
+{
+    const auto iter = m_slot_of_tile.find(id);
+    if (iter == m_slot_of_tile.end())
+        return {};
+    const auto slot = iter->second;
+    m_slot_of_tile.erase(iter);
+    m_slots.free(slot);
+    return slot;
+}
+
+std::vector<std::optional<unsigned>> TileSlotAllocator::free(std::span<const tile::Id> ids)
+{
+    std::vector<std::optional<unsigned>> slots;
+    slots.reserve(ids.size());
+    for (const auto& id : ids)
+        slots.push_back(free(id));
+    return slots;
+}
+
+void TileSlotAllocator::clear()
+{
+    m_slots.clear();
+    m_slot_of_tile.clear();
+}
+
+std::optional<unsigned> TileSlotAllocator::slot(const tile::Id& id) const
+{
+    const auto iter = m_slot_of_tile.find(id);
+    if (iter == m_slot_of_tile.end())
+        return {};
+    return iter->second;
+}
+
+std::optional<tile::Id> TileSlotAllocator::tile_at(unsigned slot) const
+{
+    if (!m_slots.is_used(slot))
+        return {};
+    return m_tile_of_slot[slot];
+}
+
+bool TileSlotAllocator::contains(const tile::Id& id) const { return m_slot_of_tile.contains(id); }
+
+unsigned TileSlotAllocator::n_used() const { return m_slots.n_used(); }
+
+unsigned TileSlotAllocator::capacity() const { return m_slots.capacity(); }
+
+SlotAllocator::Statistics TileSlotAllocator::statistics() const { return m_slots.statistics(); }
@@ -0,0 +1,96 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <radix/tile.h>
+
+#include "TileIdMap.h"
+
+namespace nucleus::utils {
+
+/// Hands out slots (e.g., texture array layers) from a fixed capacity in O(1). Free slots are kept on a stack, freed slots
+/// are reused first. Slots don't move once they are allocated.
+class SlotAllocator {
+public:
+    struct Statistics {
+        unsigned n_used = 0;
+        unsigned capacity = 0;
+        unsigned high_water_mark = 0; // highest used slot + 1
+        unsigned n_holes = 0; // free slots below the high water mark
+        [[nodiscard]] float fragmentation() const { return high_water_mark == 0 ? 0.0f : float(n_holes) / float(high_water_mark); }
+    };
+
+    explicit SlotAllocator(unsigned capacity = 0);
+
+    /// returns the lowest free slot of a fresh allocator, later on the most recently freed one. nullopt if full.
+    [[nodiscard]] std::optional<unsigned> allocate();
+    /// allocates the given slot, returns false if it is already in use
+    bool allocate(unsigned slot);
+    /// allocates n slots, or none (returns an empty vector) if there are not enough free slots
+    [[nodiscard]] std::vector<unsigned> allocate_n(unsigned n);
+    /// returns false, if the slot was not in use
+    bool free(unsigned slot);
+    void free(std::span<const unsigned> slots);
+    void clear();
+
+    [[nodiscard]] bool is_used(unsigned slot) const;
+    [[nodiscard]] unsigned n_used() const;
+    [[nodiscard]] unsigned n_free() const;
+    [[nodiscard]] unsigned capacity() const;
+    [[nodiscard]] std::vector<unsigned> used_slots() const;
+    [[nodiscard]] Statistics statistics() const;
+
+private:
+    static constexpr unsigned used = unsigned(-1);
+    std::vector<unsigned> m_free_stack;
+    std::vector<unsigned> m_position_in_free_stack; // or used
+};
+
+/// SlotAllocator with a tile id per slot and an id -> slot lookup.
+class TileSlotAllocator {
+public:
+    explicit TileSlotAllocator(unsigned capacity = 0);
+
+    /// returns the slot of the tile, allocating one if it doesn't have one yet. nullopt if full.
+    std::optional<unsigned> allocate(const tile::Id& id);
+    /// allocates slots for all ids (or returns their existing slots). nullopt for the ids that didn't fit.
+    std::vector<std::optional<unsigned>> allocate(std::span<const tile::Id> ids);
+    /// returns the freed slot, or nullopt if the tile didn't have one
+    std::optional<unsigned> free(const tile::Id& id);
+    std::vector<std::optional<unsigned>> free(std::span<const tile::Id> ids);
+    void clear();
+
+    [[nodiscard]] std::optional<unsigned> slot(const tile::Id& id) const;
+    [[nodiscard]] std::optional<tile::Id> tile_at(unsigned slot) const;
+    [[nodiscard]] bool contains(const tile::Id& id) const;
+    [[nodiscard]] unsigned n_used() const;
+    [[nodiscard]] unsigned capacity() const;
+    [[nodiscard]] SlotAllocator::Statistics statistics() const;
+
+private:
+    SlotAllocator m_slots;
+    TileIdMap<unsigned> m_slot_of_tile;
+    std::vector<tile::Id> m_tile_of_slot;
+};
+
+} // namespace nucleus::utils
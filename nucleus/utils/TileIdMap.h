@@ -0,0 +1,462 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <radix/tile.h>
+
+namespace nucleus::utils {
+
+/// packs a tile id into a 64 bit key: 6 bits zoom level, 1 bit scheme and the interleaved coordinates (z-order).
+/// only the lower 28 bits of the coordinates are used, deeper tiles still work, but their keys collide more often.
+inline uint64_t morton_key(const tile::Id& id)
+{
+    const auto spread = [](uint64_t v) {
+        v &= 0x0fff'ffff;
+        v = (v | (v << 16)) & 0x0000'ffff'0000'ffff;
+        v = (v | (v << 8)) & 0x00ff'00ff'00ff'00ff;
+        v = (v | (v << 4)) & 0x0f0f'0f0f'0f0f'0f0f;
+        v = (v | (v << 2)) & 0x3333'3333'3333'3333;
+        v = (v | (v << 1)) & 0x5555'5555'5555'5555;
+        return v;
+    };
+    return (uint64_t(id.zoom_level & 0x3f) << 57) | (uint64_t(id.scheme == tile::Scheme::SlippyMap) << 56) | spread(id.coords.x) | (spread(id.coords.y) << 1);
+}
+
+namespace detail {
+    // open addressing table in the style of swiss tables: one control byte per slot (empty, deleted or 7 bits of the hash),
+    // probed 16 at a time. elements are stored inline, so inserting doesn't allocate (apart from growing).
+    class ControlGroup {
+    public:
+        static constexpr unsigned width = 16;
+        static constexpr int8_t empty = -128;
+        static constexpr int8_t deleted = -2;
+
+        explicit ControlGroup(const int8_t* ctrl)
+        {
+#if defined(__SSE2__)
+            m_ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#else
+            std::memcpy(m_ctrl, ctrl, width);
+#endif
+        }
+
+        // bit i is set, if control byte i equals h2
+        [[nodiscard]] uint32_t match(int8_t h2) const
+        {
+#if defined(__SSE2__)
+            return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(m_ctrl, _mm_set1_epi8(h2))));
+#else
+            uint32_t mask = 0;
+            for (unsigned i = 0; i < width; ++i)
+                mask |= uint32_t(m_ctrl[i] == h2) << i;
+            return mask;
+#endif
+        }
+
+        [[nodiscard]] uint32_t match_empty() const { return match(empty); }
+
+        // empty and deleted are the only negative values
+        [[nodiscard]] uint32_t match_empty_or_deleted() const
+        {
+#if defined(__SSE2__)
+            return uint32_t(_mm_movemask_epi8(m_ctrl));
+#else
+            uint32_t mask = 0;
+            for (unsigned i = 0; i < width; ++i)
+                mask |= uint32_t(m_ctrl[i] < 0) << i;
+            return mask;
+#endif
+        }
+
+    private:
+#if defined(__SSE2__)
+        __m128i m_ctrl;
+#else
+        int8_t m_ctrl[width];
+#endif
+    };
+
+    template<typename Value, typename KeyOf>
+    class FlatTileIdTable {
+    public:
+        using value_type = Value;
+        using size_type = size_t;
+
+        template<bool is_const>
+        class Iterator {
+            friend class FlatTileIdTable;
+            using Table = std::conditional_t<is_const, const FlatTileIdTable, FlatTileIdTable>;
+            Table* m_table = nullptr;
+            size_t m_index = 0;
+
+            Iterator(Table* table, size_t index)
+                : m_table(table)
+                , m_index(index)
+            {
+                skip_free();
+            }
+            void skip_free()
+            {
+                while (m_index < m_table->m_capacity && m_table->m_ctrl[m_index] < 0)
+                    ++m_index;
+            }
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Value;
+            using difference_type = std::ptrdiff_t;
+            using pointer = std::conditional_t<is_const, const Value*, Value*>;
+            using reference = std::conditional_t<is_const, const Value&, Value&>;
+
+            Iterator() = default;
+            template<bool other_is_const>
+                requires(is_const && !other_is_const)
+            Iterator(const Iterator<other_is_const>& other)
+                : m_table(other.m_table)
+                , m_index(other.m_index)
+            {
+            }
+            reference operator*() const { return m_table->m_slots[m_index]; }
+            pointer operator->() const { return &m_table->m_slots[m_index]; }
+            Iterator& operator++()
+            {
+                ++m_index;
+                skip_free();
+                return *this;
+            }
+            Iterator operator++(int)
+            {
+                auto copy = *this;
+                ++*this;
+                return copy;
+            }
+            bool operator==(const Iterator& other) const { return m_index == other.m_index; }
+            friend class Iterator<!is_const>;
+        };
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        FlatTileIdTable() = default;
+        FlatTileIdTable(const FlatTileIdTable& other)
+        {
+            reserve(other.m_size);
+            for (const auto& v : other)
+                emplace_unique(KeyOf::key(v), v);
+        }
+        FlatTileIdTable(FlatTileIdTable&& other) noexcept { swap(other); }
+        FlatTileIdTable& operator=(const FlatTileIdTable& other)
+        {
+            if (this != &other) {
+                auto copy = other;
+                swap(copy);
+            }
+            return *this;
+        }
+        FlatTileIdTable& operator=(FlatTileIdTable&& other) noexcept
+        {
+            auto moved = std::move(other);
+            swap(moved);
+            return *this;
+        }
+        ~FlatTileIdTable() { release(); }
+
+        void swap(FlatTileIdTable& other) noexcept
+        {
+            std::swap(m_ctrl, other.m_ctrl);
+            std::swap(m_slots, other.m_slots);
+            std::swap(m_capacity, other.m_capacity);
+            std::swap(m_size, other.m_size);
+            std::swap(m_growth_left, other.m_growth_left);
+        }
+
+        [[nodiscard]] size_t size() const { return m_size; }
+        [[nodiscard]] bool empty() const { return m_size == 0; }
+        [[nodiscard]] size_t capacity() const { return m_capacity; }
+
+        iterator begin() { return iterator(this, 0); }
+        iterator end() { return iterator(this, m_capacity); }
+        const_iterator begin() const { return const_iterator(this, 0); }
+        const_iterator end() const { return const_iterator(this, m_capacity); }
+        const_iterator cbegin() const { return begin(); }
+        const_iterator cend() const { return end(); }
+
+        void clear()
+        {
+            for (size_t i = 0; i < m_capacity; ++i) {
+                if (m_ctrl[i] >= 0)
+                    std::destroy_at(&m_slots[i]);
+            }
+            std::fill(m_ctrl.begin(), m_ctrl.end(), ControlGroup::empty);
+            m_size = 0;
+            m_growth_left = max_load(m_capacity);
+        }
+
+        void reserve(size_t n)
+        {
+            if (n <= max_load(m_capacity))
+                return;
+            size_t capacity = ControlGroup::width;
+            while (max_load(capacity) < n)
+                capacity *= 2;
+            rehash(capacity);
+        }
+
+        iterator find(const tile::Id& id) { return iterator(this, find_index(id)); }
+        const_iterator find(const tile::Id& id) const { return const_iterator(this, find_index(id)); }
+        [[nodiscard]] bool contains(const tile::Id& id) const { return find_index(id) != m_capacity; }
+        [[nodiscard]] size_t count(const tile::Id& id) const { return contains(id) ? 1 : 0; }
+
+        size_t erase(const tile::Id& id)
+        {
+            const auto index = find_index(id);
+            if (index == m_capacity)
+                return 0;
+            erase_at(index);
+            return 1;
+        }
+        iterator erase(const_iterator position)
+        {
+            erase_at(position.m_index);
+            return iterator(this, position.m_index + 1);
+        }
+        iterator erase(iterator position) { return erase(const_iterator(position)); }
+
+        template<typename... Args>
+        std::pair<iterator, bool> emplace_unique(const tile::Id& id, Args&&... args)
+        {
+            const auto hash = hash_of(id);
+            auto index = find_index(id, hash);
+            if (index != m_capacity)
+                return { iterator(this, index), false };
+            index = prepare_insert(hash);
+            std::construct_at(&m_slots[index], std::forward<Args>(args)...);
+            return { iterator(this, index), true };
+        }
+
+    private:
+        static constexpr size_t max_load(size_t capacity) { return capacity - capacity / 8; }
+
+        static uint64_t hash_of(const tile::Id& id)
+        {
+            // splitmix64 finaliser, neighbouring tiles have very similar morton keys
+            auto h = morton_key(id);
+            h = (h ^ (h >> 30)) * 0xbf58'476d'1ce4'e5b9;
+            h = (h ^ (h >> 27)) * 0x94d0'49bb'1331'11eb;
+            return h ^ (h >> 31);
+        }
+        static int8_t h2(uint64_t hash) { return int8_t(hash & 0x7f); }
+
+        // groups are probed in triangular order, which visits every group once, as the number of groups is a power of two
+        template<typename Function>
+        size_t probe(uint64_t hash, const Function& visit_group) const
+        {
+            const auto group_mask = m_capacity / ControlGroup::width - 1;
+            auto group = size_t(hash >> 7) & group_mask;
+            for (size_t step = 1;; ++step) {
+                const auto result = visit_group(group * ControlGroup::width, ControlGroup(&m_ctrl[group * ControlGroup::width]));
+                if (result != npos)
+                    return result;
+                group = (group + step) & group_mask;
+            }
+        }
+
+        size_t find_index(const tile::Id& id) const { return find_index(id, hash_of(id)); }
+        size_t find_index(const tile::Id& id, uint64_t hash) const
+        {
+            if (m_size == 0)
+                return m_capacity;
+            const auto fingerprint = h2(hash);
+            return probe(hash, [&](size_t offset, const ControlGroup& group) {
+                for (auto mask = group.match(fingerprint); mask; mask &= mask - 1) {
+                    const auto index = offset + unsigned(std::countr_zero(mask));
+                    if (KeyOf::key(m_slots[index]) == id)
+                        return index;
+                }
+                // an empty slot ends the search, the key would have been inserted there
+                return group.match_empty() ? m_capacity : npos;
+            });
+        }
+
+        size_t prepare_insert(uint64_t hash)
+        {
+            if (m_growth_left == 0)
+                rehash(m_capacity == 0 || m_size >= max_load(m_capacity) / 2 ? std::max(size_t(ControlGroup::width), m_capacity * 2) : m_capacity);
+            const auto index = probe(hash, [](size_t offset, const ControlGroup& group) {
+                const auto mask = group.match_empty_or_deleted();
+                return mask ? offset + unsigned(std::countr_zero(mask)) : npos;
+            });
+            // reusing a deleted slot doesn't use up growth
+            m_growth_left -= size_t(m_ctrl[index] == ControlGroup::empty);
+            m_ctrl[index] = h2(hash);
+            ++m_size;
+            return index;
+        }
+
+        void erase_at(size_t index)
+        {
+            assert(index < m_capacity && m_ctrl[index] >= 0);
+            std::destroy_at(&m_slots[index]);
+            --m_size;
+            // probing stops at groups with an empty slot, so if this group has one, no probe sequence runs past it.
+            const auto group_start = index - index % ControlGroup::width;
+            if (ControlGroup(&m_ctrl[group_start]).match_empty()) {
+                m_ctrl[index] = ControlGroup::empty;
+                ++m_growth_left;
+            } else {
+                m_ctrl[index] = ControlGroup::deleted;
+            }
+        }
+
+        void rehash(size_t new_capacity)
+        {
+            assert(std::has_single_bit(new_capacity) && new_capacity >= ControlGroup::width && max_load(new_capacity) >= m_size);
+            FlatTileIdTable rehashed;
+            rehashed.m_capacity = new_capacity;
+            rehashed.m_ctrl.assign(new_capacity, ControlGroup::empty);
+            rehashed.m_slots = std::allocator<Value>().allocate(new_capacity);
+            rehashed.m_growth_left = max_load(new_capacity);
+            for (size_t i = 0; i < m_capacity; ++i) {
+                if (m_ctrl[i] < 0)
+                    continue;
+                const auto index = rehashed.prepare_insert(hash_of(KeyOf::key(m_slots[i])));
+                std::construct_at(&rehashed.m_slots[index], std::move(m_slots[i]));
+            }
+            swap(rehashed);
+        }
+
+        void release()
+        {
+            if (!m_slots)
+                return;
+            clear();
+            std::allocator<Value>().deallocate(m_slots, m_capacity);
+            m_slots = nullptr;
+        }
+
+        static constexpr size_t npos = size_t(-1);
+        std::vector<int8_t> m_ctrl;
+        Value* m_slots = nullptr;
+        size_t m_capacity = 0;
+        size_t m_size = 0;
+        size_t m_growth_left = 0;
+    };
+
+    template<typename T>
+    struct MapKeyOf {
+        static const tile::Id& key(const std::pair<const tile::Id, T>& v) { return v.first; }
+    };
+    struct SetKeyOf {
+        static const tile::Id& key(const tile::Id& v) { return v; }
+    };
+} // namespace detail
+
+/// flat hash map with tile ids as keys. the interface follows std::unordered_map, but iterators and references are
+/// invalidated by every insertion that grows the table (erasing doesn't move elements).
+template<typename T>
+class TileIdMap : public detail::FlatTileIdTable<std::pair<const tile::Id, T>, detail::MapKeyOf<T>> {
+    using Base = detail::FlatTileIdTable<std::pair<const tile::Id, T>, detail::MapKeyOf<T>>;
+
+public:
+    using key_type = tile::Id;
+    using mapped_type = T;
+    using typename Base::const_iterator;
+    using typename Base::iterator;
+
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const tile::Id& id, Args&&... args)
+    {
+        return this->emplace_unique(id, std::piecewise_construct, std::forward_as_tuple(id), std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+    std::pair<iterator, bool> insert(const std::pair<const tile::Id, T>& value) { return this->emplace_unique(value.first, value); }
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const tile::Id& id, M&& value)
+    {
+        auto result = try_emplace(id, std::forward<M>(value));
+        if (!result.second)
+            result.first->second = std::forward<M>(value);
+        return result;
+    }
+    T& operator[](const tile::Id& id) { return try_emplace(id).first->second; }
+    T& at(const tile::Id& id)
+    {
+        const auto iter = this->find(id);
+        if (iter == this->end())
+            throw std::out_of_range("TileIdMap::at: tile id not found");
+        return iter->second;
+    }
+    const T& at(const tile::Id& id) const
+    {
+        const auto iter = this->find(id);
+        if (iter == this->end())
+            throw std::out_of_range("TileIdMap::at: tile id not found");
+        return iter->second;
+    }
+};
+
+/// flat hash set of tile ids, see TileIdMap.
+class TileIdSet : public detail::FlatTileIdTable<tile::Id, detail::SetKeyOf> {
+public:
+    using key_type = tile::Id;
+
+    TileIdSet() = default;
+    template<typename Iterator>
+    TileIdSet(Iterator first, Iterator last)
+    {
+        for (; first != last; ++first)
+            insert(*first);
+    }
+    std::pair<iterator, bool> insert(const tile::Id& id) { return emplace_unique(id, id); }
+    template<typename Iterator>
+    void insert(Iterator first, Iterator last)
+    {
+        for (; first != last; ++first)
+            insert(*first);
+    }
+};
+
+/// counterpart of std::erase_if for TileIdMap and TileIdSet
+template<typename Value, typename KeyOf, typename Predicate>
+size_t erase_if(detail::FlatTileIdTable<Value, KeyOf>& container, const Predicate& predicate)
+{
+    const auto old_size = container.size();
+    for (auto iter = container.begin(); iter != container.end();) {
+        if (predicate(*iter))
+            iter = container.erase(iter);
+        else
+            ++iter;
+    }
+    return old_size - container.size();
+}
+
+} // namespace nucleus::utils
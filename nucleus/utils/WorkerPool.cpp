@@ -0,0 +1,115 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+namespace nucleus::utils {
+
+WorkerPool::WorkerPool(unsigned n_threads)
+{
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    n_threads = 1;
+#endif
+    for (unsigned i = 1; i < std::max(n_threads, 1u); ++i)
+        m_threads.emplace_back(&WorkerPool::thread_main, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock lock(m_mutex);
+        m_quit = true;
+    }
+    m_start_condition.notify_all();
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+void WorkerPool::parallel_for(unsigned n_tasks, const Task& task)
+{
+    std::unique_lock job_lock(m_job_mutex, std::try_to_lock);
+    if (!job_lock.owns_lock() || m_threads.empty() || n_tasks <= 1) {
+        for (unsigned i = 0; i < n_tasks; ++i)
+            task(i);
+        return;
+    }
+
+    // the calling thread takes part, wake only as many workers as there are tasks left for them.
+    const auto n_helpers = std::min(n_tasks - 1, unsigned(m_threads.size()));
+    {
+        std::unique_lock lock(m_mutex);
+        m_task = &task;
+        m_n_tasks = n_tasks;
+        m_next_task = 0;
+        m_n_open_slots = n_helpers;
+        m_n_busy_threads = n_helpers;
+    }
+    if (n_helpers == m_threads.size()) {
+        m_start_condition.notify_all();
+    } else {
+        for (unsigned i = 0; i < n_helpers; ++i)
+            m_start_condition.notify_one();
+    }
+    work();
+    std::unique_lock lock(m_mutex);
+    m_done_condition.wait(lock, [this]() { return m_n_busy_threads == 0; });
+    m_task = nullptr;
+}
+
+unsigned WorkerPool::n_threads() const { return unsigned(m_threads.size()) + 1; }
+
+unsigned WorkerPool::default_n_threads()
+{
+    // leave some cores for rendering and the rest of the app
+    return std::clamp(std::thread::hardware_concurrency() / 2, 1u, 8u);
+}
+
+WorkerPool& WorkerPool::shared()
+{
+    static WorkerPool pool;
+    return pool;
+}
+
+void WorkerPool::work()
+{
+    for (auto i = m_next_task++; i < m_n_tasks; i = m_next_task++)
+        (*m_task)(i);
+}
+
+void WorkerPool::thread_main()
+{
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_start_condition.wait(lock, [&]() { return m_quit || m_n_open_slots > 0; });
+            if (m_quit)
+                return;
+            --m_n_open_slots;
+        }
+        work();
+        {
+            std::unique_lock lock(m_mutex);
+            --m_n_busy_threads;
+        }
+        m_done_condition.notify_all();
+    }
+}
+
+} // namespace nucleus::utils
@@ -0,0 +1,67 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace nucleus::utils {
+
+// A fixed set of threads for short, data parallel jobs (e.g., compressing strips of a texture). The calling thread takes
+// part, so n_threads = 1 doesn't start any threads. One job runs at a time, calls from other threads (or nested calls)
+// don't wait for the pool but run their tasks serially.
+class WorkerPool {
+public:
+    using Task = std::function<void(unsigned)>;
+
+    explicit WorkerPool(unsigned n_threads = default_n_threads());
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// calls task(0) .. task(n_tasks - 1), in no particular order, and returns once all are done. tasks must not throw.
+    void parallel_for(unsigned n_tasks, const Task& task);
+    [[nodiscard]] unsigned n_threads() const;
+
+    static unsigned default_n_threads();
+    /// shared by everything in nucleus that needs a few threads for a moment
+    static WorkerPool& shared();
+
+private:
+    void work();
+    void thread_main();
+
+    std::vector<std::thread> m_threads;
+    std::mutex m_job_mutex; // held by the thread that owns the current job
+    std::mutex m_mutex;
+    std::condition_variable m_start_condition;
+    std::condition_variable m_done_condition;
+    unsigned m_n_open_slots = 0; // workers still to join the current job
+    unsigned m_n_busy_threads = 0;
+    bool m_quit = false;
+    const Task* m_task = nullptr;
+    unsigned m_n_tasks = 0;
+    std::atomic<unsigned> m_next_task = 0;
+};
+
+} // namespace nucleus::utils
@@ -0,0 +1,157 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "height_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace nucleus::utils::height_codec {
+
+namespace {
+    constexpr std::array<char, 4> magic = { 'A', 'H', 'C', '1' };
+    constexpr qsizetype header_size = 8;
+
+    uint16_t predict(const uint16_t* row, const uint16_t* row_above, unsigned x)
+    {
+        if (!row_above)
+            return x == 0 ? 0 : row[x - 1];
+        if (x == 0)
+            return row_above[0];
+        const int left = row[x - 1], up = row_above[x], up_left = row_above[x - 1];
+        if (up_left >= std::max(left, up))
+            return uint16_t(std::min(left, up));
+        if (up_left <= std::min(left, up))
+            return uint16_t(std::max(left, up));
+        return uint16_t(left + up - up_left);
+    }
+
+    // residuals wrap around (mod 2^16), so the round trip is exact for any input
+    uint16_t zigzag(uint16_t value, uint16_t prediction)
+    {
+        const unsigned delta = uint16_t(value - prediction);
+        return uint16_t((delta << 1) ^ (0u - (delta >> 15)));
+    }
+
+    uint16_t unzigzag(uint16_t residual, uint16_t prediction) { return uint16_t(prediction + ((residual >> 1) ^ (0u - (residual & 1u)))); }
+
+    void append_u16(QByteArray* bytes, unsigned value)
+    {
+        bytes->append(char(value & 0xFF));
+        bytes->append(char(value >> 8));
+    }
+
+    unsigned read_u16(const uint8_t* data) { return unsigned(data[0]) | unsigned(data[1]) << 8; }
+} // namespace
+
+QByteArray encode(const Raster<uint16_t>& raster)
+{
+    assert(raster.width() <= 0xFFFF && raster.height() <= 0xFFFF);
+    const auto width = unsigned(raster.width());
+    const auto height = unsigned(raster.height());
+
+    std::vector<uint16_t> residuals(raster.buffer_length());
+    for (unsigned y = 0; y < height; ++y) {
+        const uint16_t* row = raster.data() + size_t(y) * width;
+        const uint16_t* row_above = y == 0 ? nullptr : row - width;
+        for (unsigned x = 0; x < width; ++x)
+            residuals[size_t(y) * width + x] = zigzag(row[x], predict(row, row_above, x));
+    }
+
+    QByteArray bytes;
+    bytes.reserve(header_size + qsizetype(residuals.size() * 2 + residuals.size() / block_size + 1));
+    bytes.append(magic.data(), qsizetype(magic.size()));
+    append_u16(&bytes, width);
+    append_u16(&bytes, height);
+    for (size_t begin = 0; begin < residuals.size(); begin += block_size) {
+        const auto end = std::min(begin + block_size, residuals.size());
+        const auto n_bits = unsigned(std::bit_width(*std::max_element(residuals.cbegin() + begin, residuals.cbegin() + end)));
+        bytes.append(char(n_bits));
+        uint32_t buffer = 0;
+        unsigned n_buffered = 0;
+        for (size_t i = begin; i < end; ++i) {
+            buffer |= uint32_t(residuals[i]) << n_buffered;
+            n_buffered += n_bits;
+            for (; n_buffered >= 8; n_buffered -= 8) {
+                bytes.append(char(buffer & 0xFF));
+                buffer >>= 8;
+            }
+        }
+        if (n_buffered > 0)
+            bytes.append(char(buffer));
+    }
+    return bytes;
+}
+
+Raster<uint16_t> decode(const QByteArray& bytes)
+{
+    if (bytes.size() < header_size || !is_encoded(bytes))
+        throw std::runtime_error("height_codec: not a height codec stream");
+
+    const auto* data = reinterpret_cast<const uint8_t*>(bytes.constData());
+    const auto* const data_end = data + bytes.size();
+    const auto width = read_u16(data + 4);
+    const auto height = read_u16(data + 6);
+    data += header_size;
+
+    // pass 1: unpack the zigzag residuals into the raster
+    Raster<uint16_t> raster(glm::uvec2(width, height));
+    uint16_t* out = raster.data();
+    const size_t n_samples = raster.buffer_length();
+    for (size_t begin = 0; begin < n_samples; begin += block_size) {
+        if (data == data_end)
+            throw std::runtime_error("height_codec: truncated stream");
+        const unsigned n_bits = *data++;
+        if (n_bits > 16)
+            throw std::runtime_error("height_codec: invalid bit width");
+        const auto n_values = unsigned(std::min<size_t>(block_size, n_samples - begin));
+        if (size_t(data_end - data) < (n_values * n_bits + 7) / 8)
+            throw std::runtime_error("height_codec: truncated stream");
+
+        const uint32_t mask = (1u << n_bits) - 1;
+        uint32_t buffer = 0;
+        unsigned n_buffered = 0;
+        for (unsigned i = 0; i < n_values; ++i) {
+            for (; n_buffered < n_bits; n_buffered += 8)
+                buffer |= uint32_t(*data++) << n_buffered;
+            out[begin + i] = uint16_t(buffer & mask);
+            buffer >>= n_bits;
+            n_buffered -= n_bits;
+        }
+    }
+    if (data != data_end)
+        throw std::runtime_error("height_codec: trailing data");
+
+    // pass 2: undo the prediction in place, neighbours to the left and above are already reconstructed
+    for (unsigned y = 0; y < height; ++y) {
+        uint16_t* row = out + size_t(y) * width;
+        const uint16_t* row_above = y == 0 ? nullptr : row - width;
+        for (unsigned x = 0; x < width; ++x)
+            row[x] = unzigzag(row[x], predict(row, row_above, x));
+    }
+    return raster;
+}
+
+bool is_encoded(const QByteArray& bytes) { return bytes.size() >= qsizetype(magic.size()) && std::memcmp(bytes.constData(), magic.data(), magic.size()) == 0; }
+
+} // namespace nucleus::utils::height_codec
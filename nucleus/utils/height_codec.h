@@ -0,0 +1,43 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+
+#include "nucleus/Raster.h"
+
+// Lossless codec for uint16 height rasters, used instead of the alpine height pngs in the tile cache (ram and disk).
+// Each sample is predicted from its left, upper and upper left neighbours (LOCO-I / MED predictor), the zigzag coded
+// residuals are bit packed in blocks of 16 with one bit width per block. Smooth terrain needs 4-7 bits per sample and
+// decoding is two linear passes, no zlib.
+//
+// Layout (little endian): "AHC1", u16 width, u16 height, then per block: u8 bit width, ceil(n * bit width / 8) bytes.
+namespace nucleus::utils::height_codec {
+
+static constexpr unsigned block_size = 16;
+
+[[nodiscard]] QByteArray encode(const Raster<uint16_t>& raster);
+
+/// throws std::runtime_error if the data is truncated or not in this format
+[[nodiscard]] Raster<uint16_t> decode(const QByteArray& bytes);
+
+/// checks the magic bytes only
+[[nodiscard]] bool is_encoded(const QByteArray& bytes);
+
+} // namespace nucleus::utils::height_codec
@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "image_decoder.h"
+
+// Limit the dimensions of images to 8192x8192. This is already quite restricting
+// in terms of that a lot of GPUs don't support textures that large. Make sure
+// you know what you are doing, before you change this value.
+#define STBI_MAX_DIMENSIONS 8192
+
+// Only include the code for the formats we need. This reduces the code footprint
+// and allows for faster compilation times. Add more formats here, if you need them.
+// For possible options check the stb_image.h file.
+#define STBI_ONLY_JPEG
+#define STBI_ONLY_PNG
+
+// Remove if you intend to use stbi_failure_reason()
+#define STBI_NO_FAILURE_STRINGS
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_slim/stb_image.h>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <stdexcept>
+
+static_assert(STBI_MAX_DIMENSIONS == nucleus::utils::image_decoder::max_image_dimension);
+
+namespace nucleus::utils::image_decoder {
+
+namespace {
+    class StbDecoder final : public Decoder {
+    public:
+        [[nodiscard]] std::string_view name() const override { return "stb_image"; }
+        [[nodiscard]] bool handles(Format) const override { return true; }
+        [[nodiscard]] Image decode(std::span<const uint8_t> data, unsigned n_channels) const override
+        {
+            assert(n_channels == 0 || n_channels == 3 || n_channels == 4);
+            int width = 0, height = 0, channels = 0;
+            auto* pixels = stbi_load_from_memory(data.data(), int(data.size()), &width, &height, &channels, int(n_channels));
+            if (pixels == nullptr) {
+                throw std::runtime_error("Failed to load image from bytearray");
+            }
+            Image image;
+            image.pixels = { pixels, [](uint8_t* p) { stbi_image_free(p); } };
+            image.size = { unsigned(width), unsigned(height) };
+            image.n_channels = n_channels == 0 ? unsigned(channels) : n_channels;
+            return image;
+        }
+    };
+} // namespace
+
+Image Image::allocate(const glm::uvec2& size, unsigned n_channels)
+{
+    Image image;
+    image.size = size;
+    image.n_channels = n_channels;
+    image.pixels = { new uint8_t[image.n_bytes()], [](uint8_t* p) { delete[] p; } };
+    return image;
+}
+
+const Decoder& backend::stb()
+{
+    static const StbDecoder decoder;
+    return decoder;
+}
+
+Format format_of(std::span<const uint8_t> data)
+{
+    constexpr auto png_magic = std::to_array<uint8_t>({ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' });
+    constexpr auto jpeg_magic = std::to_array<uint8_t>({ 0xff, 0xd8, 0xff });
+    if (data.size() >= png_magic.size() && std::equal(png_magic.begin(), png_magic.end(), data.begin()))
+        return Format::Png;
+    if (data.size() >= jpeg_magic.size() && std::equal(jpeg_magic.begin(), jpeg_magic.end(), data.begin()))
+        return Format::Jpeg;
+    return Format::Unknown;
+}
+
+const std::vector<const Decoder*>& decoders()
+{
+    static const std::vector<const Decoder*> list = {
+#ifdef ALP_ENABLE_TURBOJPEG
+        &backend::turbojpeg(),
+#endif
+#ifdef ALP_ENABLE_SPNG
+        &backend::spng(),
+#endif
+        &backend::stb(),
+    };
+    return list;
+}
+
+const Decoder& decoder_for(Format format)
+{
+    const auto& list = decoders();
+    const auto found = std::find_if(list.begin(), list.end(), [format](const Decoder* d) { return d->handles(format); });
+    assert(found != list.end()); // stb handles everything
+    return **found;
+}
+
+Image decode(std::span<const uint8_t> data, unsigned n_channels) { return decoder_for(format_of(data)).decode(data, n_channels); }
+
+} // namespace nucleus::utils::image_decoder
@@ -0,0 +1,79 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace nucleus::utils::image_decoder {
+
+// larger images are rejected by all backends
+constexpr unsigned max_image_dimension = 8192;
+
+enum class Format { Unknown, Jpeg, Png };
+
+/// tightly packed 8 bit pixels, rows start at the top of the image
+struct Image {
+    std::unique_ptr<uint8_t[], void (*)(uint8_t*)> pixels = { nullptr, nullptr };
+    glm::uvec2 size = {};
+    unsigned n_channels = 0;
+
+    [[nodiscard]] size_t n_bytes() const { return size_t(size.x) * size.y * n_channels; }
+    [[nodiscard]] std::span<const uint8_t> bytes() const { return { pixels.get(), n_bytes() }; }
+    static Image allocate(const glm::uvec2& size, unsigned n_channels);
+};
+
+class Decoder {
+public:
+    virtual ~Decoder() = default;
+    [[nodiscard]] virtual std::string_view name() const = 0;
+    [[nodiscard]] virtual bool handles(Format format) const = 0;
+    /// n_channels: 0 keeps the channels of the file, 3 gives rgb, 4 rgba (alpha = 255 if the file has none).
+    /// throws std::runtime_error if the data can't be decoded.
+    [[nodiscard]] virtual Image decode(std::span<const uint8_t> data, unsigned n_channels) const = 0;
+};
+
+namespace backend {
+    const Decoder& stb();
+#ifdef ALP_ENABLE_TURBOJPEG
+    const Decoder& turbojpeg();
+#endif
+#ifdef ALP_ENABLE_SPNG
+    const Decoder& spng();
+#endif
+} // namespace backend
+
+/// looks at the magic bytes
+[[nodiscard]] Format format_of(std::span<const uint8_t> data);
+
+/// all compiled in backends, preferred (fastest) first. stb is always there and last, it's the fallback.
+[[nodiscard]] const std::vector<const Decoder*>& decoders();
+
+/// first decoder in decoders() that handles the format
+[[nodiscard]] const Decoder& decoder_for(Format format);
+
+/// decodes with decoder_for(format_of(data))
+[[nodiscard]] Image decode(std::span<const uint8_t> data, unsigned n_channels);
+
+} // namespace nucleus::utils::image_decoder
@@ -0,0 +1,86 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "image_decoder.h"
+
+#include <stdexcept>
+
+#include <spng.h>
+
+namespace nucleus::utils::image_decoder {
+
+namespace {
+    struct SpngFormat {
+        spng_format format;
+        unsigned n_channels;
+    };
+
+    // 16 bit and palette images are reduced / expanded to 8 bit rgb(a), just like stb does.
+    SpngFormat native_format(const spng_ihdr& ihdr)
+    {
+        switch (ihdr.color_type) {
+        case SPNG_COLOR_TYPE_GRAYSCALE:
+            return ihdr.bit_depth <= 8 ? SpngFormat { SPNG_FMT_G8, 1 } : SpngFormat { SPNG_FMT_RGB8, 3 };
+        case SPNG_COLOR_TYPE_GRAYSCALE_ALPHA:
+            return ihdr.bit_depth <= 8 ? SpngFormat { SPNG_FMT_GA8, 2 } : SpngFormat { SPNG_FMT_RGBA8, 4 };
+        case SPNG_COLOR_TYPE_TRUECOLOR_ALPHA:
+            return { SPNG_FMT_RGBA8, 4 };
+        default:
+            return { SPNG_FMT_RGB8, 3 };
+        }
+    }
+
+    class SpngDecoder final : public Decoder {
+    public:
+        [[nodiscard]] std::string_view name() const override { return "libspng"; }
+        [[nodiscard]] bool handles(Format format) const override { return format == Format::Png; }
+        [[nodiscard]] Image decode(std::span<const uint8_t> data, unsigned n_channels) const override
+        {
+            const auto ctx = std::unique_ptr<spng_ctx, void (*)(spng_ctx*)>(spng_ctx_new(0), &spng_ctx_free);
+            if (!ctx)
+                throw std::runtime_error("Failed to initialise libspng");
+            spng_set_image_limits(ctx.get(), max_image_dimension, max_image_dimension);
+            if (spng_set_png_buffer(ctx.get(), data.data(), data.size()) != 0)
+                throw std::runtime_error("Failed to load image from bytearray");
+
+            spng_ihdr ihdr {};
+            if (spng_get_ihdr(ctx.get(), &ihdr) != 0)
+                throw std::runtime_error("Failed to load image from bytearray");
+
+            auto format = native_format(ihdr);
+            if (n_channels == 3)
+                format = { SPNG_FMT_RGB8, 3 };
+            else if (n_channels == 4)
+                format = { SPNG_FMT_RGBA8, 4 };
+
+            auto image = Image::allocate({ ihdr.width, ihdr.height }, format.n_channels);
+            const int flags = format.n_channels == 4 ? SPNG_DECODE_TRNS : 0;
+            if (spng_decode_image(ctx.get(), image.pixels.get(), image.n_bytes(), format.format, flags) != 0)
+                throw std::runtime_error("Failed to load image from bytearray");
+            return image;
+        }
+    };
+} // namespace
+
+const Decoder& backend::spng()
+{
+    static const SpngDecoder decoder;
+    return decoder;
+}
+
+} // namespace nucleus::utils::image_decoder
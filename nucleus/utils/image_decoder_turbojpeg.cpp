@@ -0,0 +1,63 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "image_decoder.h"
+
+#include <stdexcept>
+
+#include <turbojpeg.h>
+
+namespace nucleus::utils::image_decoder {
+
+namespace {
+    class TurboJpegDecoder final : public Decoder {
+    public:
+        [[nodiscard]] std::string_view name() const override { return "libjpeg-turbo"; }
+        [[nodiscard]] bool handles(Format format) const override { return format == Format::Jpeg; }
+        [[nodiscard]] Image decode(std::span<const uint8_t> data, unsigned n_channels) const override
+        {
+            // handles are not thread safe, but cheap to keep around
+            thread_local const auto handle = std::unique_ptr<void, int (*)(tjhandle)>(tjInitDecompress(), &tjDestroy);
+            if (!handle)
+                throw std::runtime_error("Failed to initialise libjpeg-turbo");
+
+            int width = 0, height = 0, subsampling = 0, colour_space = 0;
+            if (tjDecompressHeader3(handle.get(), data.data(), static_cast<unsigned long>(data.size()), &width, &height, &subsampling, &colour_space) != 0)
+                throw std::runtime_error("Failed to load image from bytearray");
+            if (width <= 0 || height <= 0 || unsigned(width) > max_image_dimension || unsigned(height) > max_image_dimension)
+                throw std::runtime_error("Failed to load image from bytearray");
+
+            if (n_channels == 0)
+                n_channels = colour_space == TJCS_GRAY ? 1 : 3;
+            const auto pixel_format = n_channels == 1 ? TJPF_GRAY : (n_channels == 3 ? TJPF_RGB : TJPF_RGBA);
+
+            auto image = Image::allocate({ unsigned(width), unsigned(height) }, n_channels);
+            if (tjDecompress2(handle.get(), data.data(), static_cast<unsigned long>(data.size()), image.pixels.get(), width, 0, height, pixel_format, 0) != 0)
+                throw std::runtime_error("Failed to load image from bytearray");
+            return image;
+        }
+    };
+} // namespace
+
+const Decoder& backend::turbojpeg()
+{
+    static const TurboJpegDecoder decoder;
+    return decoder;
+}
+
+} // namespace nucleus::utils::image_decoder
@@ -19,54 +19,60 @@
 
 #include "image_loader.h"
 
-// Limit the dimensions of images to 8192x8192. This is already quite restricting
-// in terms of that a lot of GPUs don't support textures that large. Make sure
-// you know what you are doing, before you change this value.
-#define STBI_MAX_DIMENSIONS 8192
-
-// Only include the code for the formats we need. This reduces the code footprint
-// and allows for faster compilation times. Add more formats here, if you need them.
-// For possible options check the stb_image.h file.
-#define STBI_ONLY_JPEG
-#define STBI_ONLY_PNG
-
-// Remove if you intend to use stbi_failure_reason()
-#define STBI_NO_FAILURE_STRINGS
-
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_slim/stb_image.h>
+#include "height_codec.h"
+#include "image_decoder.h"
 
+#include <cstring>
 #include <stdexcept>
 #include <QFile>
 
 namespace nucleus::utils::image_loader {
 
+namespace {
+    // requested_channels = 0 keeps the channels of the file
+    image_decoder::Image decode(const QByteArray& byte_array, unsigned requested_channels)
+    {
+        const auto bytes = std::span(reinterpret_cast<const uint8_t*>(byte_array.constData()), size_t(byte_array.size()));
+        return image_decoder::decode(bytes, requested_channels);
+    }
+} // namespace
+
 Raster<glm::u8vec4> rgba8(const QByteArray& byteArray)
 {
-    int width, height, channels;
-    const int requested_channels = 4; // Request 4 channels to always get RGBA8 images
-    const stbi_uc* source_data = reinterpret_cast<const stbi_uc*>(byteArray.constData());
-    unsigned char* data = stbi_load_from_memory(
-        source_data,
-        byteArray.size(),
-        &width, &height, &channels,
-        requested_channels
-        );
-
-    if (data == nullptr) {
-        throw std::runtime_error("Failed to load image from bytearray");
-    }
+    const auto image = decode(byteArray, 4); // Request 4 channels to always get RGBA8 images
 
-    // NOTE: We copy the contents of the data pointer into a Raster object. Sadly
-    // we can't use the allocated memory directly, because for that we would need a custom
-    // allocator for the std::vector class.
-    Raster<glm::u8vec4> raster(glm::uvec2(width, height));
-    memcpy(raster.data(), data, raster.size_in_bytes());
-    stbi_image_free(data);
+    // NOTE: We copy the decoded pixels into a Raster object. Sadly we can't use the allocated
+    // memory directly, because for that we would need a custom allocator for the std::vector class.
+    Raster<glm::u8vec4> raster(image.size);
+    std::memcpy(raster.data(), image.pixels.get(), raster.size_in_bytes());
+    return raster;
+}
 
+Raster<uint16_t> height(const QByteArray& byte_array)
+{
+    if (height_codec::is_encoded(byte_array))
+        return height_codec::decode(byte_array);
+
+    const auto image = decode(byte_array, 0);
+    // grey images would be expanded to (grey, grey, grey) by rgba8, so use the same channel twice.
+    const auto n = image.n_channels;
+    const auto green_offset = n >= 3 ? 1u : 0u;
+
+    Raster<uint16_t> raster(image.size);
+    const uint8_t* source = image.pixels.get();
+    for (uint16_t& r : raster) {
+        r = uint16_t(source[0] << 8) | uint16_t(source[green_offset]);
+        source += n;
+    }
     return raster;
 }
 
+ColourTexture colour_texture(const QByteArray& byte_array, ColourTexture::Format format, ColourTexture::MipMaps mip_maps)
+{
+    const auto image = decode(byte_array, 4);
+    return ColourTexture(image.pixels.get(), image.size, format, mip_maps);
+}
+
 Raster<glm::u8vec4> rgba8(const QString& filename)
 {
     QFile file(filename);
@@ -77,7 +83,7 @@ Raster<glm::u8vec4> rgba8(const QString& filename)
     QByteArray byteArray = file.readAll();
     file.close();
 
-    // NOTE: We don't use the stb_image loader directly, because QFile can load from ressources
+    // NOTE: We don't let the decoders read the file directly, because QFile can load from ressources
     return rgba8(byteArray);
 }
 
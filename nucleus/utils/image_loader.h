@@ -20,12 +20,21 @@
 #pragma once
 
 #include <nucleus/Raster.h>
+#include <nucleus/utils/ColourTexture.h>
 #include <QByteArray>
 
 namespace nucleus::utils::image_loader {
 
 Raster<glm::u8vec4> rgba8(const QByteArray& byteArray);
 
+/// Decodes an alpine height png (red: high byte, green: low byte) straight into the packed uint16 raster.
+/// Decodes only the channels present in the file, there is no intermediate rgba raster.
+/// Heights that were re-encoded for the tile cache (see height_codec.h) are recognised and decoded as well.
+Raster<uint16_t> height(const QByteArray& byte_array);
+
+/// Decodes an image (jpeg, png) and hands the decoder output directly to the texture compressor.
+ColourTexture colour_texture(const QByteArray& byte_array, ColourTexture::Format format, ColourTexture::MipMaps mip_maps = ColourTexture::MipMaps::None);
+
 Raster<glm::u8vec4> rgba8(const QString& filename);
 Raster<glm::u8vec4> rgba8(const char* filename);
 
@@ -19,8 +19,54 @@
 
 #include "tile_conversion.h"
 
+#include <cmath>
+
 namespace nucleus::utils::tile_conversion {
 
+namespace {
+    template <typename T>
+    Raster<T> cut_out_descendant(const Raster<T>& ancestor, const tile::Id& descendant, unsigned zoom_offset, bool vertex_grid)
+    {
+        if (zoom_offset == 0)
+            return ancestor;
+        assert(zoom_offset <= descendant.zoom_level);
+        const auto n = 1u << zoom_offset;
+        // tile ids are tms (y pointing north), rasters start with the northern most row.
+        const auto tile_in_ancestor = glm::dvec2(descendant.coords.x % n, n - 1 - descendant.coords.y % n);
+        const auto size = glm::dvec2(ancestor.size());
+        const auto extent = vertex_grid ? size - 1.0 : size;
+        const auto origin = tile_in_ancestor * extent / double(n);
+        const auto step = 1.0 / double(n);
+        const auto max_index = glm::uvec2(ancestor.size()) - 1u;
+
+        const auto sample = [&](const glm::dvec2& position) {
+            const auto p = glm::clamp(position, glm::dvec2(0.0), glm::dvec2(max_index));
+            const auto p0 = glm::uvec2(p);
+            const auto p1 = glm::min(p0 + 1u, max_index);
+            const auto f = p - glm::dvec2(p0);
+            if constexpr (std::is_same_v<T, uint16_t>) {
+                const auto top = glm::mix(double(ancestor.pixel(p0)), double(ancestor.pixel({ p1.x, p0.y })), f.x);
+                const auto bottom = glm::mix(double(ancestor.pixel({ p0.x, p1.y })), double(ancestor.pixel(p1)), f.x);
+                return uint16_t(std::round(glm::mix(top, bottom, f.y)));
+            } else {
+                const auto top = glm::mix(glm::dvec4(ancestor.pixel(p0)), glm::dvec4(ancestor.pixel({ p1.x, p0.y })), f.x);
+                const auto bottom = glm::mix(glm::dvec4(ancestor.pixel({ p0.x, p1.y })), glm::dvec4(ancestor.pixel(p1)), f.x);
+                return T(glm::round(glm::mix(top, bottom, f.y)));
+            }
+        };
+
+        Raster<T> retval(ancestor.size());
+        for (unsigned y = 0; y < retval.height(); ++y) {
+            for (unsigned x = 0; x < retval.width(); ++x) {
+                const auto xy = glm::dvec2(x, y);
+                const auto position = vertex_grid ? origin + xy * step : origin + (xy + 0.5) * step - 0.5;
+                retval.pixel({ x, y }) = sample(position);
+            }
+        }
+        return retval;
+    }
+} // namespace
+
 Raster<uint16_t> to_u16raster(const Raster<glm::u8vec4>& raster)
 {
     Raster<uint16_t> retval(raster.size());
@@ -30,4 +76,14 @@ Raster<uint16_t> to_u16raster(const Raster<glm::u8vec4>& raster)
     return retval;
 }
 
+Raster<glm::u8vec4> descendant_ortho(const Raster<glm::u8vec4>& ancestor, const tile::Id& descendant, unsigned zoom_offset)
+{
+    return cut_out_descendant(ancestor, descendant, zoom_offset, false);
+}
+
+Raster<uint16_t> descendant_height(const Raster<uint16_t>& ancestor, const tile::Id& descendant, unsigned zoom_offset)
+{
+    return cut_out_descendant(ancestor, descendant, zoom_offset, true);
+}
+
 }
@@ -22,6 +22,7 @@
 #include <glm/glm.hpp>
 
 #include <QByteArray>
+#include <radix/tile.h>
 #include "nucleus/Raster.h"
 
 #ifdef QT_GUI_LIB
@@ -35,6 +36,17 @@ namespace nucleus::utils::tile_conversion {
  */
 Raster<uint16_t> to_u16raster(const Raster<glm::u8vec4>& raster);
 
+/**
+ * @brief Cuts the part belonging to a descendant (zoom_offset levels below) out of an ancestor ortho tile and upsamples it to the full size.
+ * Pixels are treated as cells, i.e., the pixel centres are half a pixel from the border.
+ */
+Raster<glm::u8vec4> descendant_ortho(const Raster<glm::u8vec4>& ancestor, const tile::Id& descendant, unsigned zoom_offset);
+
+/**
+ * @brief Same as descendant_ortho, but for height tiles. Samples are treated as vertices, i.e., the first and last ones are on the tile border (65x65).
+ */
+Raster<uint16_t> descendant_height(const Raster<uint16_t>& ancestor, const tile::Id& descendant, unsigned zoom_offset);
+
 #ifdef QT_GUI_LIB
 inline Raster<uint16_t> to_u16raster(const QImage& qimage)
 {
@@ -18,6 +18,8 @@
 
 #include "VectorTileFeature.h"
 
+#include <algorithm>
+
 #include "nucleus/DataQuerier.h"
 
 namespace nucleus::vectortile {
@@ -60,4 +62,10 @@ QString FeatureTXTPeak::labelText()
         return QString("%1 (%2m)").arg(name).arg(double(elevation), 0, 'f', 0);
 }
 
+float FeatureTXTPeak::importance() const
+{
+    // higher peaks first, the highest ones in the alps are a bit below 5000m
+    return std::clamp(float(elevation) / 5000.0f, 0.0f, 1.0f);
+}
+
 } // namespace nucleus::vectortile
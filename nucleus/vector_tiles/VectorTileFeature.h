@@ -55,14 +55,17 @@ struct FeatureTXT {
     // }
 
     virtual QString labelText() = 0;
+    // in [0, 1], more important labels win when they overlap on screen
+    virtual float importance() const { return 0; }
 };
 
 struct FeatureTXTPeak : public FeatureTXT {
-    int elevation;
+    int elevation = 0;
 
     static std::shared_ptr<FeatureTXT> parse(const mapbox::vector_tile::feature& feature, const std::shared_ptr<DataQuerier> dataquerier);
 
     QString labelText();
+    float importance() const override;
 };
 
 typedef std::unordered_map<FeatureType, std::unordered_set<std::shared_ptr<FeatureTXT>>> VectorTile;
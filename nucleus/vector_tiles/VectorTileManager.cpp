@@ -18,9 +18,16 @@
 
 #include "VectorTileManager.h"
 
+#include <cassert>
+#include <mutex>
+#include <vector>
+
 #include <mapbox/vector_tile.hpp>
+#include <protozero/pbf_reader.hpp>
 
 #include "nucleus/DataQuerier.h"
+#include "nucleus/srs.h"
+#include "nucleus/utils/WorkerPool.h"
 
 namespace nucleus::vectortile {
 
@@ -29,68 +36,195 @@ VectorTileManager::VectorTileManager(QObject* parent)
 {
 }
 
-const std::shared_ptr<VectorTile> VectorTileManager::to_vector_tile(
-    tile::Id id, const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier> dataquerier)
+std::shared_ptr<const VectorTile> VectorTileManager::to_vector_tile(
+    const tile::Id& id, const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier)
 {
-    // vectortile might be empty -> no parsing possible
-    if (vectorTileData == nullptr) {
-        // try to find a parent tile and return previously parsed parent tile
-        if (id.zoom_level > max_zoom)
-            id = get_suitable_id(id);
-
-        if (!m_loaded_tiles.contains(id)) // tile id not found -> create empty
-            m_loaded_tiles[id] = std::make_shared<VectorTile>();
-
-        return m_loaded_tiles.at(id);
+    // vectortile might be empty -> no parsing possible, use the tile of the parent (if it is beyond max_zoom)
+    const auto has_data = !vectorTileData.isEmpty();
+    const auto key = (!has_data && id.zoom_level > max_zoom) ? get_suitable_id(id) : id;
+
+    bool needs_parsing = has_data;
+    if (has_data) {
+        std::shared_lock lock(m_mutex);
+        const auto iter = m_tiles.find(key);
+        needs_parsing = iter == m_tiles.end() || !iter->second.has_data;
     }
 
-    // convert data buffer into vectortile
-    std::string d = vectorTileData.toStdString();
-    mapbox::vector_tile::buffer tile(d);
+    std::vector<ParsedFeature> parsed;
+    bool is_parsed = false;
+    while (true) {
+        if (needs_parsing && !is_parsed) {
+            parsed = parse(vectorTileData, dataquerier);
+            is_parsed = true;
+        }
 
-    std::shared_ptr<VectorTile> vector_tile;
-    if (!m_loaded_tiles.contains(id))
-        m_loaded_tiles[id] = std::make_shared<VectorTile>();
-    vector_tile = m_loaded_tiles.at(id);
+        std::unique_lock lock(m_mutex);
+        if (has_data && !is_parsed) {
+            const auto iter = m_tiles.find(key);
+            if (iter == m_tiles.end() || !iter->second.has_data) {
+                // released by another thread after the check above
+                needs_parsing = true;
+                continue;
+            }
+        }
 
-    for (auto const& layerName : tile.layerNames()) {
-        if (FEATURE_TYPES_FACTORY.contains(layerName)) {
-            const mapbox::vector_tile::layer layer = tile.getLayer(layerName);
+        auto& entry = m_tiles[key];
+        if (has_data && !entry.has_data) {
+            // another thread might have parsed the same features in the meantime, the first one wins
+            auto vector_tile = std::make_shared<VectorTile>();
+            entry.feature_ids.reserve(parsed.size());
+            for (auto& parsed_feature : parsed) {
+                auto& feature_entry = m_features[parsed_feature.id];
+                if (!feature_entry.feature)
+                    feature_entry.feature = std::move(parsed_feature.feature);
+                ++feature_entry.n_tiles;
+                entry.feature_ids.push_back(parsed_feature.id);
+                (*vector_tile)[parsed_feature.type].insert(feature_entry.feature);
+            }
+            entry.tile = std::move(vector_tile);
+            entry.has_data = true;
+        }
+        if (!entry.tile)
+            entry.tile = std::make_shared<const VectorTile>();
+        ++entry.n_references;
+        auto vector_tile = entry.tile;
+
+        // release the previous acquisition only after referencing the new one, re-acquiring the same key must not drop its data
+        release_locked(id);
+        m_acquired[id] = key;
+        return vector_tile;
+    }
+}
 
-            auto features = std::unordered_set<std::shared_ptr<FeatureTXT>>();
+std::vector<std::shared_ptr<const VectorTile>> VectorTileManager::to_vector_tiles(
+    const std::vector<tile::Id>& ids, const std::vector<const QByteArray*>& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier)
+{
+    assert(ids.size() == vectorTileData.size());
+    // descendants without data share the tile of their ancestor, which must be parsed before they are acquired.
+    // otherwise they would get an empty placeholder, that is replaced (not filled) once the ancestor is parsed.
+    std::vector<unsigned> with_data;
+    std::vector<unsigned> sharing_ancestor;
+    for (unsigned i = 0; i < ids.size(); ++i) {
+        if (vectorTileData[i]->isEmpty() && ids[i].zoom_level > max_zoom)
+            sharing_ancestor.push_back(i);
+        else
+            with_data.push_back(i);
+    }
 
-            std::size_t feature_count = layer.featureCount();
-            for (std::size_t i = 0; i < feature_count; ++i) {
+    std::vector<std::shared_ptr<const VectorTile>> vector_tiles(ids.size());
+    utils::WorkerPool::shared().parallel_for(unsigned(with_data.size()), [&](unsigned j) {
+        const auto i = with_data[j];
+        vector_tiles[i] = to_vector_tile(ids[i], *vectorTileData[i], dataquerier);
+    });
+    // no parsing, only lookups
+    for (const auto i : sharing_ancestor)
+        vector_tiles[i] = to_vector_tile(ids[i], *vectorTileData[i], dataquerier);
+    return vector_tiles;
+}
 
-                auto const feature = mapbox::vector_tile::feature(layer.getFeature(i), layer);
+std::vector<VectorTileManager::ParsedFeature> VectorTileManager::parse(const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier) const
+{
+    std::vector<ParsedFeature> features;
+    // layers are read straight from the QByteArray, mapbox::vector_tile::buffer would need a std::string copy
+    protozero::pbf_reader tile_reader(protozero::data_view(vectorTileData.constData(), size_t(vectorTileData.size())));
+    while (tile_reader.next(3)) { // Tile.layers
+        const mapbox::vector_tile::layer layer(tile_reader.get_view());
+        const auto& layerName = layer.getName();
+        if (!FEATURE_TYPES_FACTORY.contains(layerName))
+            continue;
+        const auto type = FEATURE_TYPES.at(layerName);
+
+        std::size_t feature_count = layer.featureCount();
+        for (std::size_t i = 0; i < feature_count; ++i) {
+            auto const feature = mapbox::vector_tile::feature(layer.getFeature(i), layer);
+            // create the feature with the designated parser method
+            features.push_back({ feature.getID().get<uint64_t>(), type, FEATURE_TYPES_FACTORY.at(layerName)(feature, nullptr) });
+        }
+    }
 
-                // check if feature was loaded previously and abort
-                const unsigned long id = feature.getID().get<uint64_t>();
-                if (m_loaded_features.contains(id)) {
-                    const auto feat = m_loaded_features.at(id);
-                    // feat->updateWorldPosition(dataquerier);
-                    features.insert(feat);
-                    continue; // feature is already loaded
-                }
+    // reuse features that were loaded previously. the lock is only held for the lookups, so parallel parses don't hold back the merge.
+    // altitudes of new features are queried in one batch (one height tile decode instead of one per label)
+    std::vector<std::shared_ptr<FeatureTXT>> new_features;
+    {
+        std::shared_lock lock(m_mutex);
+        for (auto& parsed_feature : features) {
+            if (const auto iter = m_features.find(parsed_feature.id); iter != m_features.end())
+                parsed_feature.feature = iter->second.feature;
+            else
+                new_features.push_back(parsed_feature.feature);
+        }
+    }
 
-                // create the feature with the designated parser method
-                const std::shared_ptr<FeatureTXT> feat = FEATURE_TYPES_FACTORY.at(layerName)(feature, dataquerier);
-                // feat->updateWorldPosition(dataquerier);
+    if (dataquerier && !new_features.empty()) {
+        std::vector<glm::dvec2> positions;
+        positions.reserve(new_features.size());
+        for (const auto& feat : new_features)
+            positions.push_back(feat->position);
+        const auto altitudes = dataquerier->get_altitudes(positions);
+        for (size_t i = 0; i < new_features.size(); ++i) {
+            const auto& position = new_features[i]->position;
+            new_features[i]->worldposition = nucleus::srs::lat_long_alt_to_world(glm::dvec3(position.x, position.y, altitudes[i]));
+        }
+    }
+    return features;
+}
 
-                m_loaded_features[id] = feat;
-                features.insert(feat);
-            }
+void VectorTileManager::release(const tile::Id& id)
+{
+    std::unique_lock lock(m_mutex);
+    release_locked(id);
+}
 
-            vector_tile->insert(std::make_pair(FEATURE_TYPES.at(layerName), features));
-        }
+void VectorTileManager::release_locked(const tile::Id& id)
+{
+    const auto acquired = m_acquired.find(id);
+    if (acquired == m_acquired.end())
+        return;
+    const auto entry = m_tiles.find(acquired->second);
+    m_acquired.erase(acquired);
+    assert(entry != m_tiles.end());
+    if (--entry->second.n_references > 0)
+        return;
+    for (const auto feature_id : entry->second.feature_ids) {
+        const auto feature = m_features.find(feature_id);
+        assert(feature != m_features.end());
+        if (--feature->second.n_tiles == 0)
+            m_features.erase(feature);
     }
+    m_tiles.erase(entry);
+}
 
-    m_loaded_tiles[id] = vector_tile;
+std::shared_ptr<const VectorTile> VectorTileManager::find(const tile::Id& id) const
+{
+    std::shared_lock lock(m_mutex);
+    const auto acquired = m_acquired.find(id);
+    if (acquired == m_acquired.end())
+        return {};
+    return m_tiles.find(acquired->second)->second.tile;
+}
+
+std::shared_ptr<const FeatureTXT> VectorTileManager::feature(unsigned long feature_id) const
+{
+    std::shared_lock lock(m_mutex);
+    const auto iter = m_features.find(feature_id);
+    if (iter == m_features.end())
+        return {};
+    return iter->second.feature;
+}
 
-    return vector_tile;
+size_t VectorTileManager::n_tiles() const
+{
+    std::shared_lock lock(m_mutex);
+    return m_tiles.size();
+}
+
+size_t VectorTileManager::n_features() const
+{
+    std::shared_lock lock(m_mutex);
+    return m_features.size();
 }
 
-const tile::Id VectorTileManager::get_suitable_id(tile::Id id)
+tile::Id VectorTileManager::get_suitable_id(tile::Id id)
 {
     while (id.zoom_level > max_zoom) {
         id = id.parent();
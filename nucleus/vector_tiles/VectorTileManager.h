@@ -22,12 +22,15 @@
 #include <radix/tile.h>
 
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include <QByteArray>
 #include <QObject>
 
+#include "nucleus/utils/TileIdMap.h"
 #include "nucleus/vector_tiles/VectorTileFeature.h"
 
 namespace nucleus {
@@ -36,6 +39,11 @@ class DataQuerier;
 
 namespace nucleus::vectortile {
 
+// Parses vector tiles into labels and holds them while they are in use. Features appearing in several tiles (e.g., a peak
+// on all zoom levels) are parsed once and shared, counting the tiles that reference them. A tile is held from
+// to_vector_tile until release (the Scheduler releases tiles when they leave the gpu cache), so memory is bounded by the
+// gpu quad limit. Thread safe: parsing runs outside of the lock (only the merge into the store is serialised), lookups
+// only take a shared lock.
 class VectorTileManager : public QObject {
     Q_OBJECT
 public:
@@ -45,13 +53,48 @@ public:
 
     static const int max_zoom = 14; // defined by the tile server / extractor (extractor only supports zoom to 14)
 
-    static const std::shared_ptr<VectorTile> to_vector_tile(tile::Id id, const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier> dataquerier);
+    /// parses the tile and holds it until release(id). tiles beyond max_zoom without data share the tile of their
+    /// ancestor at max_zoom, which has to be acquired first (otherwise they get an empty tile). acquiring an id again
+    /// replaces the previous acquisition.
+    std::shared_ptr<const VectorTile> to_vector_tile(const tile::Id& id, const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier);
+    /// to_vector_tile for many tiles, parsed in parallel on utils::WorkerPool::shared(). tiles with data are acquired
+    /// before the descendants sharing their tile, so the order of ids doesn't matter. results are in the order of ids.
+    std::vector<std::shared_ptr<const VectorTile>> to_vector_tiles(
+        const std::vector<tile::Id>& ids, const std::vector<const QByteArray*>& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier);
+    void release(const tile::Id& id);
+
+    /// nullptr if id is not acquired
+    [[nodiscard]] std::shared_ptr<const VectorTile> find(const tile::Id& id) const;
+    /// nullptr if no held tile contains the feature
+    [[nodiscard]] std::shared_ptr<const FeatureTXT> feature(unsigned long feature_id) const;
+    [[nodiscard]] size_t n_tiles() const;
+    [[nodiscard]] size_t n_features() const;
 
 private:
-    static const tile::Id get_suitable_id(tile::Id id);
+    struct TileEntry {
+        std::shared_ptr<const VectorTile> tile;
+        std::vector<unsigned long> feature_ids;
+        unsigned n_references = 0;
+        bool has_data = false; // entries of empty tiles are filled in when the tile is acquired with data
+    };
+    struct FeatureEntry {
+        std::shared_ptr<FeatureTXT> feature;
+        unsigned n_tiles = 0;
+    };
+    struct ParsedFeature {
+        unsigned long id;
+        FeatureType type;
+        std::shared_ptr<FeatureTXT> feature;
+    };
+
+    static tile::Id get_suitable_id(tile::Id id);
+    std::vector<ParsedFeature> parse(const QByteArray& vectorTileData, const std::shared_ptr<DataQuerier>& dataquerier) const;
+    void release_locked(const tile::Id& id);
 
-    inline static std::unordered_map<unsigned long, std::shared_ptr<FeatureTXT>> m_loaded_features = {};
-    inline static std::unordered_map<tile::Id, std::shared_ptr<VectorTile>, tile::Id::Hasher> m_loaded_tiles;
+    mutable std::shared_mutex m_mutex;
+    nucleus::utils::TileIdMap<TileEntry> m_tiles; // keyed by the id that owns the features (see get_suitable_id)
+    nucleus::utils::TileIdMap<tile::Id> m_acquired; // acquired id -> key in m_tiles
+    std::unordered_map<unsigned long, FeatureEntry> m_features;
 
     // all individual features and an appropriate parser method are stored in the following map
     // typedef std::shared_ptr<FeatureTXT> (*FeatureTXTParser)(const mapbox::vector_tile::feature& feature, tile::SrsBounds& tile_bounds, double extent);
@@ -0,0 +1,193 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <iostream>
+#include <optional>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/LayerAssembler.h"
+#include "nucleus/tile_scheduler/QuadAssembler.h"
+#include "nucleus/tile_scheduler/RateLimiter.h"
+#include "nucleus/tile_scheduler/RegionSeeder.h"
+#include "nucleus/tile_scheduler/Scheduler.h"
+#include "nucleus/tile_scheduler/SlotLimiter.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+#ifdef ALP_ENABLE_LABELS
+#include "nucleus/vector_tiles/VectorTileManager.h"
+#endif
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+std::optional<std::vector<glm::dvec2>> parse_lat_long_list(const QString& text)
+{
+    // "lat long; lat long; ..."
+    std::vector<glm::dvec2> points;
+    for (const auto& pair : text.split(';', Qt::SkipEmptyParts)) {
+        const auto values = pair.trimmed().split(' ', Qt::SkipEmptyParts);
+        if (values.size() != 2)
+            return {};
+        bool ok_lat = false;
+        bool ok_long = false;
+        const auto lat_long = glm::dvec2(values[0].toDouble(&ok_lat), values[1].toDouble(&ok_long));
+        if (!ok_lat || !ok_long)
+            return {};
+        points.push_back(nucleus::srs::lat_long_to_world(lat_long));
+    }
+    return points;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    // same as the app, so that the default output is the app's offline cache
+    QCoreApplication::setOrganizationName("AlpineMaps.org");
+    QCoreApplication::setApplicationName("AlpineApp");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Downloads all tiles of a region into the offline cache of the app, so that it can be used offline.");
+    parser.addHelpOption();
+    const QCommandLineOption bbox_option("bbox", "Region as bounding box: 'lat long; lat long' (two opposite corners).", "corners");
+    const QCommandLineOption polygon_option("polygon", "Region as polygon: 'lat long; lat long; lat long; ...'.", "points");
+    const QCommandLineOption min_zoom_option("min-zoom", "Minimum zoom level of the tiles (default 0).", "zoom", "0");
+    const QCommandLineOption max_zoom_option("max-zoom", "Maximum zoom level of the tiles (default 16).", "zoom", "16");
+    const QCommandLineOption output_option("output", "Offline cache directory (default: the offline cache of the app).", "path", QString::fromStdString(Scheduler::offline_cache_path().string()));
+    const QCommandLineOption height_url_option("height-url", "Base url of the height tiles (zxy, png).", "url", "https://alpinemaps.cg.tuwien.ac.at/tiles/alpine_png/");
+    const QCommandLineOption ortho_url_option("ortho-url", "Base url of the ortho tiles (zyx, y pointing south, jpeg).", "url", "https://gataki.cg.tuwien.ac.at/raw/basemap/tiles/");
+#ifdef ALP_ENABLE_LABELS
+    const QCommandLineOption vectortile_url_option("vectortile-url", "Base url of the vector tiles (zxy, y pointing south, mvt).", "url", "http://localhost:8080/austria.peaks/");
+    const QCommandLineOption no_labels_option("no-labels", "Do not download vector tiles.");
+    parser.addOptions({ vectortile_url_option, no_labels_option });
+#endif
+    const QCommandLineOption slots_option("slots", "Maximum number of quads in flight (default 64).", "n", "64");
+    const QCommandLineOption rate_option("rate", "Maximum number of quad requests per second (default 100).", "n", "100");
+    parser.addOptions({ bbox_option, polygon_option, min_zoom_option, max_zoom_option, output_option, height_url_option, ortho_url_option, slots_option, rate_option });
+    parser.process(app);
+
+    RegionSeeder seeder;
+    if (parser.isSet(bbox_option) == parser.isSet(polygon_option)) {
+        std::cerr << "Exactly one of --bbox and --polygon is required.\n";
+        return 1;
+    }
+    if (parser.isSet(bbox_option)) {
+        const auto corners = parse_lat_long_list(parser.value(bbox_option));
+        if (!corners || corners->size() != 2) {
+            std::cerr << "Could not parse --bbox, expected 'lat long; lat long'.\n";
+            return 1;
+        }
+        tile::SrsBounds bounds;
+        bounds.min = glm::min((*corners)[0], (*corners)[1]);
+        bounds.max = glm::max((*corners)[0], (*corners)[1]);
+        seeder.set_region(bounds);
+    } else {
+        const auto polygon = parse_lat_long_list(parser.value(polygon_option));
+        if (!polygon || polygon->size() < 3) {
+            std::cerr << "Could not parse --polygon, expected at least three points 'lat long; lat long; lat long'.\n";
+            return 1;
+        }
+        seeder.set_region(*polygon);
+    }
+    const auto min_zoom = parser.value(min_zoom_option).toUInt();
+    const auto max_zoom = parser.value(max_zoom_option).toUInt();
+    if (min_zoom > max_zoom || max_zoom > 22) {
+        std::cerr << "Invalid zoom range.\n";
+        return 1;
+    }
+    seeder.set_zoom_range(min_zoom, max_zoom);
+
+    const auto output_path = std::filesystem::path(parser.value(output_option).toStdString());
+    {
+        // add to the existing cache instead of replacing it. only the index is read, the quads stay on disk.
+        const auto r = seeder.cache().read_index_from_disk(output_path);
+        if (!r.has_value() && std::filesystem::exists(output_path))
+            std::cerr << "Existing cache could not be read (" << r.error() << "), it will be replaced.\n";
+    }
+    // quads are written while seeding, so an interrupted run keeps what it downloaded so far
+    seeder.set_disk_cache(output_path);
+
+    TileLoadService height_service(parser.value(height_url_option), TileLoadService::UrlPattern::ZXY, ".png");
+    TileLoadService ortho_service(parser.value(ortho_url_option), TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg");
+    SlotLimiter sl;
+    RateLimiter rl;
+    QuadAssembler qa;
+    LayerAssembler la;
+    sl.set_limit(std::max(1u, parser.value(slots_option).toUInt()));
+    rl.set_limit(std::max(1u, parser.value(rate_option).toUInt()), 1000);
+    rl.set_policy(RateLimiter::Policy::TokenBucket);
+    la.set_ortho_meta_data(ortho_service.meta_data());
+    la.set_height_meta_data(height_service.meta_data());
+
+    QObject::connect(&seeder, &RegionSeeder::quads_requested, &sl, &SlotLimiter::request_quads);
+    QObject::connect(&sl, &SlotLimiter::quad_requested, &rl, &RateLimiter::request_quad);
+    QObject::connect(&rl, &RateLimiter::quad_requested, &qa, &QuadAssembler::load);
+    QObject::connect(&qa, &QuadAssembler::tile_requested, &la, &LayerAssembler::load);
+    QObject::connect(&la, &LayerAssembler::ortho_requested, &ortho_service, &TileLoadService::load);
+    QObject::connect(&la, &LayerAssembler::height_requested, &height_service, &TileLoadService::load);
+    QObject::connect(&ortho_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_ortho);
+    QObject::connect(&height_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_height);
+#ifdef ALP_ENABLE_LABELS
+    TileLoadService vectortile_service(parser.value(vectortile_url_option), TileLoadService::UrlPattern::ZXY_yPointingSouth, ".mvt");
+    vectortile_service.set_meta_data({ .min_zoom = 0, .max_zoom = unsigned(nucleus::vectortile::VectorTileManager::max_zoom) });
+    la.set_vectortile_meta_data(vectortile_service.meta_data());
+    la.set_vectortile_enabled(!parser.isSet(no_labels_option));
+    QObject::connect(&la, &LayerAssembler::vectortile_requested, &vectortile_service, &TileLoadService::load);
+    QObject::connect(&vectortile_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_vectortile);
+#endif
+    QObject::connect(&la, &LayerAssembler::tile_loaded, &qa, &QuadAssembler::deliver_tile);
+    QObject::connect(&qa, &QuadAssembler::quad_loaded, &sl, &SlotLimiter::deliver_quad);
+    QObject::connect(&sl, &SlotLimiter::quad_delivered, &seeder, &RegionSeeder::receive_quad);
+
+    QElapsedTimer print_timer;
+    print_timer.start();
+    const auto print = [](const RegionSeeder::Progress& p) {
+        std::cout << "\r" << p.n_quads_done << "/" << p.n_quads_total << " quads";
+        if (p.n_quads_failed)
+            std::cout << " (" << p.n_quads_failed << " failed)";
+        std::cout << ", " << int(p.quads_per_second()) << " quads/s, " << (p.bytes_per_second() / (1024.0 * 1024.0)) << " MiB/s    " << std::flush;
+    };
+    QObject::connect(&seeder, &RegionSeeder::progress_updated, [&](const RegionSeeder::Progress& p) {
+        if (print_timer.elapsed() < 500)
+            return;
+        print_timer.restart();
+        print(p);
+    });
+
+    int exit_code = 0;
+    QObject::connect(&seeder, &RegionSeeder::disk_write_failed, [&](const QString& message) {
+        std::cerr << "\nWriting the cache to " << output_path.string() << " failed: " << message.toStdString() << "\n";
+        exit_code = 2;
+    });
+    QObject::connect(&seeder, &RegionSeeder::finished, [&](const RegionSeeder::Progress& p) {
+        print(p);
+        std::cout << std::endl;
+        if (exit_code == 0 && p.n_quads_failed > 0)
+            exit_code = 3;
+        QCoreApplication::quit();
+    });
+
+    std::cout << "seeding " << seeder.quads_for_region().size() << " quads (zoom levels " << min_zoom << " to " << max_zoom << ")" << std::endl;
+    QMetaObject::invokeMethod(&seeder, &RegionSeeder::start, Qt::QueuedConnection);
+    const auto r = app.exec();
+    return r != 0 ? r : exit_code;
+}
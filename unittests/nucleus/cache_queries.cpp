@@ -16,18 +16,28 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include "nucleus/DataQuerier.h"
+#include "nucleus/srs.h"
 #include "nucleus/tile_scheduler/Cache.h"
 #include "nucleus/tile_scheduler/Scheduler.h"
 #include "nucleus/tile_scheduler/cache_quieries.h"
 #include "nucleus/tile_scheduler/tile_types.h"
 #include "radix/height_encoding.h"
+#include "test_helpers.h"
 
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_approx.hpp>
 #include <catch2/catch_test_macros.hpp>
 
+#include <cmath>
+#include <vector>
+
 #include <QBuffer>
 #include <QImage>
 
 using namespace nucleus::tile_scheduler;
+using test_helpers::quad_with_heights;
+using test_helpers::ramp_tile;
 
 namespace {
 
@@ -89,3 +99,111 @@ TEST_CASE("cache_queries")
     CHECK(cache_queries::query_altitude(&cache, {-47.5587933, -12.3450985}) == 3000);
     CHECK(cache_queries::query_altitude(&cache, {47.5587933, 12.3450985}) == 2000);
 }
+
+TEST_CASE("cache_queries/altitude lookup")
+{
+    Cache<tile_types::TileQuad> cache;
+    const auto tile_id = tile::Id { 10, { 548, 676 } }; // grossglockner region
+    const auto bounds = nucleus::srs::tile_bounds(tile_id);
+    const auto lat_long_at = [&](const glm::dvec2& uv) { return nucleus::srs::world_to_lat_long(bounds.min + uv * bounds.size()); };
+
+    SECTION("empty cache")
+    {
+        nucleus::DataQuerier querier(&cache);
+        CHECK(querier.get_altitude(lat_long_at({ 0.5, 0.5 })) == cache_queries::default_altitude);
+        CHECK(cache_queries::query_altitude(&cache, lat_long_at({ 0.5, 0.5 })) == cache_queries::default_altitude);
+    }
+
+    SECTION("bilinear interpolation")
+    {
+        cache.insert(quad_with_heights(tile_id.parent(), ramp_tile(65)));
+        nucleus::DataQuerier querier(&cache);
+        // uv (0, 1) is the north west corner, i.e., the first sample. stay a bit inside, the neighbours are not cached.
+        constexpr auto e = 1e-7;
+        CHECK(querier.get_altitude(lat_long_at({ e, 1.0 - e })) == Catch::Approx(0.0).margin(0.01));
+        CHECK(querier.get_altitude(lat_long_at({ 1.0 - e, 1.0 - e })) == Catch::Approx(64.0).margin(0.01));
+        CHECK(querier.get_altitude(lat_long_at({ e, e })) == Catch::Approx(6400.0).margin(0.01));
+        // half a sample east and south of the first one
+        CHECK(querier.get_altitude(lat_long_at({ 0.5 / 64, 1.0 - 0.5 / 64 })) == Catch::Approx(50.5).margin(0.01));
+        CHECK(querier.get_altitude(lat_long_at({ 0.25, 0.5 })) == Catch::Approx(16.0 + 3200.0).margin(0.01));
+        CHECK(cache_queries::query_altitude(&cache, lat_long_at({ 0.25, 0.5 })) == querier.get_altitude(lat_long_at({ 0.25, 0.5 })));
+    }
+
+    SECTION("finest tile wins, updates are picked up")
+    {
+        cache.insert(example_tile_quad_for(tile_id.parent().parent(), 1000.0f));
+        nucleus::DataQuerier querier(&cache);
+        CHECK(querier.get_altitude(lat_long_at({ 0.5, 0.5 })) == 1000.0f);
+
+        cache.insert(example_tile_quad_for(tile_id.parent(), 2000.0f));
+        CHECK(querier.get_altitude(lat_long_at({ 0.5, 0.5 })) == 2000.0f);
+
+        cache.insert(example_tile_quad_for(tile_id.parent(), 2500.0f)); // e.g., a partial quad that was completed
+        CHECK(querier.get_altitude(lat_long_at({ 0.5, 0.5 })) == 2500.0f);
+    }
+
+    SECTION("height zoom offset")
+    {
+        // the tiles of the quad carry the heights of their parent (tile_id), see LayeredTile::height_zoom_offset
+        auto quad = quad_with_heights(tile_id, ramp_tile(65));
+        for (auto& tile : quad.tiles)
+            tile.height_zoom_offset = 1;
+        cache.insert(quad);
+        nucleus::DataQuerier querier(&cache);
+        CHECK(querier.get_altitude(lat_long_at({ 0.25, 0.5 })) == Catch::Approx(16.0 + 3200.0).margin(0.01));
+    }
+
+    SECTION("batch queries")
+    {
+        // ramps around tile_id, a constant coarse tile further out and nothing at all in the opposite hemisphere
+        cache.insert(quad_with_heights(tile_id.parent(), ramp_tile(65)));
+        cache.insert(example_tile_quad_for(tile::Id { 6, { 34, 42 } }, 1500.0f));
+        nucleus::DataQuerier querier(&cache);
+
+        std::vector<glm::dvec2> lat_longs;
+        for (unsigned i = 0; i < 100; ++i) {
+            for (unsigned j = 0; j < 100; ++j)
+                lat_longs.push_back(lat_long_at({ -1.0 + i * 0.03, -1.0 + j * 0.03 }));
+        }
+        lat_longs.push_back({ -47.0, -12.0 });
+        REQUIRE(lat_longs.size() > nucleus::DataQuerier::batch_chunk_size);
+
+        std::vector<float> expected;
+        for (const auto& lat_long : lat_longs)
+            expected.push_back(querier.get_altitude(lat_long));
+        CHECK(expected.back() == cache_queries::default_altitude);
+
+        CHECK(querier.get_altitudes(lat_longs) == expected);
+        CHECK(querier.get_altitudes(lat_longs, nucleus::DataQuerier::Execution::Parallel) == expected);
+
+        std::vector<glm::dvec2> world_positions;
+        for (const auto& lat_long : lat_longs)
+            world_positions.push_back(nucleus::srs::lat_long_to_world(lat_long));
+        std::vector<float> altitudes(world_positions.size());
+        querier.get_world_altitudes(world_positions, altitudes, nucleus::DataQuerier::Execution::Parallel);
+        CHECK(altitudes == expected);
+    }
+
+    SECTION("benchmark")
+    {
+        for (auto id = tile_id; id.zoom_level > 0; id = id.parent())
+            cache.insert(quad_with_heights(id.parent(), ramp_tile(65)));
+        nucleus::DataQuerier querier(&cache);
+        const auto position = lat_long_at({ 0.3, 0.6 });
+        BENCHMARK("query_altitude (decodes)") { return cache_queries::query_altitude(&cache, position); };
+        BENCHMARK("DataQuerier::get_altitude") { return querier.get_altitude(position); };
+
+        std::vector<glm::dvec2> track; // 50k points, e.g., a long gpx track
+        for (unsigned i = 0; i < 50'000; ++i)
+            track.push_back(lat_long_at({ -2.0 + i * 0.0001, 0.5 + 0.4 * std::sin(i * 0.001) }));
+        BENCHMARK("DataQuerier::get_altitude (50k points, one by one)")
+        {
+            float sum = 0;
+            for (const auto& lat_long : track)
+                sum += querier.get_altitude(lat_long);
+            return sum;
+        };
+        BENCHMARK("DataQuerier::get_altitudes (50k points)") { return querier.get_altitudes(track); };
+        BENCHMARK("DataQuerier::get_altitudes (50k points, parallel)") { return querier.get_altitudes(track, nucleus::DataQuerier::Execution::Parallel); };
+    }
+}
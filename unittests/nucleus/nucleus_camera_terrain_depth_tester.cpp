@@ -0,0 +1,126 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/camera/TerrainDepthTester.h"
+
+#include <random>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_approx.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/camera/Definition.h"
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/cache_quieries.h"
+#include "nucleus/utils/height_codec.h"
+#include "test_helpers.h"
+
+using namespace nucleus::tile_scheduler;
+using nucleus::camera::TerrainDepthTester;
+using test_helpers::quad_with_heights;
+using test_helpers::ramp_tile;
+
+namespace {
+QByteArray flat_tile(unsigned size, float altitude) { return nucleus::utils::height_codec::encode(nucleus::Raster<uint16_t>({ size, size }, uint16_t(altitude * 8))); }
+
+double terrain_z(const MemoryCache& cache, const glm::dvec2& world_position)
+{
+    const auto lat_long = nucleus::srs::world_to_lat_long(world_position);
+    const auto altitude = cache_queries::query_altitude(&cache, lat_long);
+    return nucleus::srs::lat_long_alt_to_world({ lat_long.x, lat_long.y, altitude }).z;
+}
+} // namespace
+
+TEST_CASE("nucleus/camera/TerrainDepthTester")
+{
+    MemoryCache cache;
+    TerrainDepthTester tester(&cache);
+    const auto tile_id = tile::Id { 10, { 548, 676 } }; // grossglockner region
+    const auto bounds = nucleus::srs::tile_bounds(tile_id);
+    const auto world_at = [&](const glm::dvec2& uv) { return bounds.min + uv * bounds.size(); };
+    const auto down = glm::dvec3(0, 0, -1);
+
+    SECTION("empty cache")
+    {
+        const auto centre = world_at({ 0.5, 0.5 });
+        CHECK(!tester.intersect({ centre, 10'000 }, down));
+        tester.set_camera(nucleus::camera::Definition({ centre, 10'000 }, { centre + glm::dvec2(0, 1), 0 }));
+        CHECK(tester.depth({ 0, 0 }) == Catch::Approx(TerrainDepthTester::default_max_distance));
+    }
+
+    SECTION("flat terrain")
+    {
+        cache.insert(quad_with_heights(tile_id.parent(), flat_tile(65, 1000)));
+        const auto centre = world_at({ 0.3, 0.6 });
+        const auto surface_z = terrain_z(cache, centre);
+        CHECK(surface_z > 1000); // scaled by 1 / cos(latitude)
+
+        const auto hit = tester.intersect({ centre, 10'000 }, down);
+        REQUIRE(hit);
+        CHECK(*hit == Catch::Approx(10'000 - surface_z).margin(1.0));
+        CHECK(!tester.intersect({ centre, 10'000 }, -down));
+        CHECK(!tester.intersect({ centre, 10'000 }, glm::dvec3(1, 0, 0))); // flies over everything
+
+        // from below the surface
+        CHECK(tester.intersect({ centre, 10 }, -down) == 0.0);
+
+        tester.set_camera(nucleus::camera::Definition({ centre + glm::dvec2(-3000, 2000), 8'000 }, { centre, surface_z }));
+        const auto position = tester.position({ 0, 0 });
+        CHECK(position.x == Catch::Approx(centre.x).margin(1.0));
+        CHECK(position.y == Catch::Approx(centre.y).margin(1.0));
+        CHECK(position.z == Catch::Approx(surface_z).margin(1.0));
+    }
+
+    SECTION("oblique rays hit the interpolated surface")
+    {
+        cache.insert(quad_with_heights(tile_id.parent(), ramp_tile(65)));
+        std::mt19937 rng(1);
+        std::uniform_real_distribution<double> uv(0.01, 0.99);
+        for (unsigned i = 0; i < 200; ++i) {
+            const auto origin = glm::dvec3(world_at({ uv(rng), uv(rng) }), 20'000);
+            const auto target = world_at({ uv(rng), uv(rng) });
+            const auto direction = glm::normalize(glm::dvec3(target, 0) - origin);
+            const auto hit = tester.intersect(origin, direction);
+            REQUIRE(hit);
+            const auto position = origin + direction * *hit;
+            CHECK(position.z == Catch::Approx(terrain_z(cache, glm::dvec2(position))).margin(1.0));
+        }
+    }
+
+    SECTION("finer tiles take precedence")
+    {
+        cache.insert(quad_with_heights(tile_id.parent().parent(), flat_tile(65, 500)));
+        const auto centre = world_at({ 0.5, 0.5 });
+        const auto coarse_hit = tester.intersect({ centre, 10'000 }, down);
+        cache.insert(quad_with_heights(tile_id.parent(), flat_tile(65, 2000)));
+        const auto fine_hit = tester.intersect({ centre, 10'000 }, down);
+        REQUIRE(coarse_hit);
+        REQUIRE(fine_hit);
+        CHECK(*fine_hit < *coarse_hit);
+        CHECK(10'000 - *fine_hit == Catch::Approx(terrain_z(cache, centre)).margin(1.0));
+    }
+
+    SECTION("benchmark")
+    {
+        for (auto id = tile_id; id.zoom_level > 0; id = id.parent())
+            cache.insert(quad_with_heights(id.parent(), ramp_tile(65)));
+        const auto origin = glm::dvec3(world_at({ 0.1, 0.1 }), 12'000);
+        const auto direction = glm::normalize(glm::dvec3(world_at({ 0.9, 0.8 }), 0) - origin);
+        BENCHMARK("TerrainDepthTester::intersect") { return tester.intersect(origin, direction); };
+    }
+}
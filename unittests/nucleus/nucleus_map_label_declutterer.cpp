@@ -0,0 +1,123 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/map_label/LabelDeclutterer.h"
+
+#include <random>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/camera/Definition.h"
+
+using nucleus::maplabel::LabelDeclutterer;
+
+namespace {
+LabelDeclutterer::Label label(uint64_t id, const glm::dvec3& position, float importance)
+{
+    return { id, position, { -20, 0 }, { 20, 20 }, importance };
+}
+} // namespace
+
+TEST_CASE("nucleus/map_label/LabelDeclutterer")
+{
+    const auto camera = nucleus::camera::Definition({ 0, -500, 1000 }, { 0, 0, 0 });
+    LabelDeclutterer declutterer;
+
+    SECTION("overlapping labels, the more important one wins")
+    {
+        const std::vector labels = { label(1, { 0, 0, 0 }, 0.2f), label(2, { 0, 0, 0 }, 0.8f), label(3, { 300, 0, 0 }, 0.1f) };
+        CHECK(declutterer.place(labels, camera) == std::vector<uint32_t> { 1, 2 });
+    }
+
+    SECTION("hidden labels don't take the space of visible ones")
+    {
+        const std::vector labels = { label(1, { 0, 0, 0 }, 0.2f), label(2, { 0, 0, 0 }, 0.8f), label(3, { 300, 0, 0 }, 0.1f) };
+        unsigned n_tests = 0;
+        const auto is_visible = [&](const LabelDeclutterer::Label& l) {
+            ++n_tests;
+            return l.id != 2;
+        };
+        CHECK(declutterer.place(labels, camera, is_visible) == std::vector<uint32_t> { 0, 2 });
+        CHECK(n_tests == 3);
+
+        // labels that overlap a placed one are not tested
+        n_tests = 0;
+        CHECK(declutterer.place(labels, camera, [&](const LabelDeclutterer::Label&) { return ++n_tests > 0; }) == std::vector<uint32_t> { 1, 2 });
+        CHECK(n_tests == 2);
+    }
+
+    SECTION("labels behind the camera or off screen are dropped")
+    {
+        const std::vector labels = { label(1, { 0, -2000, 2000 }, 1.0f), label(2, { 100'000, 0, 0 }, 1.0f), label(3, { 0, 0, 0 }, 0.0f) };
+        CHECK(declutterer.place(labels, camera) == std::vector<uint32_t> { 2 });
+    }
+
+    SECTION("labels with the same id are placed once")
+    {
+        const std::vector labels = { label(7, { 0, 0, 0 }, 1.0f), label(7, { 300, 0, 0 }, 1.0f) };
+        CHECK(declutterer.place(labels, camera).size() == 1);
+    }
+
+    SECTION("placed labels don't overlap and are bounded by the screen area")
+    {
+        std::mt19937 rng(0);
+        std::uniform_real_distribution<double> position(-1500, 1500);
+        std::uniform_real_distribution<float> importance(0, 1);
+        std::vector<LabelDeclutterer::Label> labels;
+        for (uint64_t i = 0; i < 10'000; ++i)
+            labels.push_back(label(i, { position(rng), position(rng), 0 }, importance(rng)));
+
+        const auto placed = declutterer.place(labels, camera);
+        CHECK(placed.size() > 10);
+        // rectangles touching the screen lie within the screen grown by one label size
+        CHECK(placed.size() <= ((480 + 2 * 40) * (270 + 2 * 20)) / (40 * 20));
+
+        const auto view_projection = camera.world_view_projection_matrix();
+        const auto screen_rect = [&](const LabelDeclutterer::Label& l) {
+            const auto clip = view_projection * glm::dvec4(l.position, 1.0);
+            const auto anchor = (glm::vec2(glm::dvec2(clip) / clip.w) * 0.5f + 0.5f) * glm::vec2(480, 270);
+            return glm::vec4(anchor + l.extent_min, anchor + l.extent_max);
+        };
+        for (size_t i = 0; i < placed.size(); ++i) {
+            const auto a = screen_rect(labels[placed[i]]);
+            for (size_t j = i + 1; j < placed.size(); ++j) {
+                const auto b = screen_rect(labels[placed[j]]);
+                CHECK(!(a.x < b.z && b.x < a.z && a.y < b.w && b.y < a.w));
+            }
+        }
+
+        BENCHMARK("place 10k labels") { return declutterer.place(labels, camera); };
+    }
+
+    SECTION("labels of the last frame are kept if they are about as important")
+    {
+        const auto a = label(1, { 0, 0, 0 }, 0.50f);
+        const auto b = label(2, { 5, 0, 0 }, 0.52f);
+        CHECK(declutterer.place(std::vector { a }, camera) == std::vector<uint32_t> { 0 });
+        CHECK(declutterer.place(std::vector { a, b }, camera) == std::vector<uint32_t> { 0 });
+        CHECK(declutterer.place(std::vector { a, b }, camera) == std::vector<uint32_t> { 0 });
+
+        // a lot more important ones take over
+        const auto c = label(3, { 5, 0, 0 }, 0.9f);
+        CHECK(declutterer.place(std::vector { a, c }, camera) == std::vector<uint32_t> { 1 });
+
+        declutterer.reset();
+        CHECK(declutterer.place(std::vector { a, b }, camera) == std::vector<uint32_t> { 1 });
+    }
+}
@@ -422,6 +422,69 @@ TEST_CASE("nucleus/tile_scheduler/cache")
     }
 
 
+    SECTION("move to disk in batches") {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            cache.insert(create_test_tile({ 0, { 0, 0 } }));
+            cache.insert(create_test_tile({ 1, { 0, 0 } }));
+            CHECK(cache.move_to_disk(path).has_value());
+            CHECK(cache.n_cached_objects() == 0);
+            cache.insert(create_test_tile({ 2, { 0, 0 } }));
+            cache.insert(create_test_tile({ 3, { 0, 0 } }));
+            CHECK(cache.move_to_disk(path).has_value());
+            CHECK(cache.n_cached_objects() == 0);
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            CHECK(cache.read_from_disk(path).has_value());
+            CHECK(cache.n_cached_objects() == 4);
+            verify_tile(cache, {0, {0, 0}});
+            verify_tile(cache, {1, {0, 0}});
+            verify_tile(cache, {2, {0, 0}});
+            verify_tile(cache, {3, {0, 0}});
+        }
+        std::filesystem::remove_all(path);
+    }
+
+    SECTION("reading only the index keeps tiles on disk until they are loaded") {
+        const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
+        std::filesystem::remove_all(path);
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            cache.insert(create_test_tile({ 0, { 0, 0 } }));
+            cache.insert(create_test_tile({ 1, { 0, 0 } }));
+            CHECK(cache.move_to_disk(path).has_value());
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            CHECK(cache.read_index_from_disk(path).has_value());
+            CHECK(cache.n_cached_objects() == 0);
+            CHECK(cache.n_disk_cached_objects() == 2);
+            CHECK(cache.contains_on_disk({ 1, { 0, 0 } }));
+            CHECK(!cache.contains_on_disk({ 2, { 0, 0 } }));
+            CHECK(!cache.load_from_disk(path, { 2, { 0, 0 } }).has_value());
+            const auto tile = cache.load_from_disk(path, { 1, { 0, 0 } });
+            REQUIRE(tile.has_value());
+            CHECK(tile->id == tile::Id { 1, { 0, 0 } });
+            CHECK(cache.n_cached_objects() == 0);
+
+            // adding to an index only cache keeps the tiles that are only on disk
+            cache.insert(create_test_tile({ 2, { 0, 0 } }));
+            CHECK(cache.move_to_disk(path).has_value());
+        }
+        {
+            nucleus::tile_scheduler::Cache<DiskWriteTestTile> cache;
+            CHECK(cache.read_from_disk(path).has_value());
+            CHECK(cache.n_cached_objects() == 3);
+            verify_tile(cache, {0, {0, 0}});
+            verify_tile(cache, {1, {0, 0}});
+            verify_tile(cache, {2, {0, 0}});
+        }
+        std::filesystem::remove_all(path);
+    }
+
     SECTION("cache doesn't remember items that were in cache and on disk, but later deleted") {
         const auto path = std::filesystem::path(QStandardPaths::writableLocation(QStandardPaths::CacheLocation).toStdString()) / "test_tile_cache";
         std::filesystem::remove_all(path);
@@ -0,0 +1,198 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/tile_scheduler/HorizonCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include <QFile>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/camera/PositionStorage.h"
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/utils.h"
+#include "radix/TileHeights.h"
+#include "radix/quad_tree.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+// a ridge running north-south, 6 km east of the camera. heights are a function of world x only.
+struct Ridge {
+    double x0 = 0;
+    double base = 500;
+    double peak = 2500;
+    double width = 2000;
+
+    [[nodiscard]] double height(double x) const { return base + peak * std::exp(-((x - x0) / width) * ((x - x0) / width)); }
+    [[nodiscard]] double min_height(double x_min, double x_max) const { return std::min(height(x_min), height(x_max)); }
+    [[nodiscard]] double max_height(double x_min, double x_max) const
+    {
+        if (x0 >= x_min && x0 <= x_max)
+            return base + peak;
+        return std::max(height(x_min), height(x_max));
+    }
+    // rendered surface, altitudes are scaled like in the shaders
+    [[nodiscard]] double surface(const glm::dvec2& world_xy) const
+    {
+        const auto lat = nucleus::srs::world_to_lat_long(world_xy).x;
+        return height(world_xy.x) / std::cos(lat * 3.1415926535897932384626433 / 180.0);
+    }
+};
+
+tile::Id tile_at(const glm::dvec2& world_xy, unsigned zoom_level)
+{
+    const auto n = double(1u << zoom_level);
+    const auto to_coord = [n](double v) { return unsigned(std::clamp(std::floor((v + 20037508.34) / (2 * 20037508.34) * n), 0.0, n - 1)); };
+    return { zoom_level, { to_coord(world_xy.x), to_coord(world_xy.y) } };
+}
+
+TileHeights make_tile_heights(const Ridge& ridge, const glm::dvec2& centre, double extent, unsigned max_zoom)
+{
+    TileHeights heights;
+    for (unsigned z = 0; z <= max_zoom; ++z) {
+        const auto lower_left = tile_at(centre - extent, z);
+        const auto upper_right = tile_at(centre + extent, z);
+        for (auto x = lower_left.coords.x; x <= upper_right.coords.x; ++x) {
+            for (auto y = lower_left.coords.y; y <= upper_right.coords.y; ++y) {
+                const auto id = tile::Id { z, { x, y } };
+                const auto bounds = nucleus::srs::tile_bounds(id);
+                heights.emplace(id, { float(ridge.min_height(bounds.min.x, bounds.max.x)), float(ridge.max_height(bounds.min.x, bounds.max.x)) });
+            }
+        }
+    }
+    return heights;
+}
+
+bool visible(const Ridge& ridge, const glm::dvec3& camera, const glm::dvec3& point)
+{
+    const auto horizontal_distance = glm::distance(glm::dvec2(camera), glm::dvec2(point));
+    const auto n_steps = std::max(1, int(horizontal_distance / 20.0));
+    for (int i = 1; i < n_steps; ++i) {
+        const auto p = glm::mix(camera, point, double(i) / n_steps);
+        if (p.z < ridge.surface(glm::dvec2(p)))
+            return false;
+    }
+    return true;
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/HorizonCuller")
+{
+    // centred in an occluder tile, so that the ridge tiles cover the azimuth bins towards the tiles behind it
+    const auto camera_tile_bounds = nucleus::srs::tile_bounds(tile_at(nucleus::srs::lat_long_to_world({ 47.0, 12.7 }), 15));
+    const auto camera_xy = (camera_tile_bounds.min + camera_tile_bounds.max) * 0.5;
+    Ridge ridge;
+    ridge.x0 = camera_xy.x + 6000;
+    const auto decorator = utils::AabbDecorator::make(make_tile_heights(ridge, camera_xy, 40'000, 16));
+    const auto camera = glm::dvec3(camera_xy, 1000.0);
+
+    SECTION("culling is disabled below the terrain")
+    {
+        const auto culler = HorizonCuller(glm::dvec3(camera_xy, 500.0), *decorator);
+        CHECK(!culler.enabled());
+        CHECK(!culler.occluded(decorator->aabb(tile_at(camera_xy + glm::dvec2(12'000, 0), 15))));
+    }
+
+    // ground truth by ray marching towards samples on the surface of every culled tile
+    const auto check_culled_tiles_are_hidden = [&](const glm::dvec3& camera_position) {
+        const auto culler = HorizonCuller(camera_position, *decorator, { .occluder_zoom_level = 15 });
+        REQUIRE(culler.enabled());
+        CHECK(culler.n_occluders() > 0);
+
+        const auto lower_left = tile_at(glm::dvec2(camera_position) + glm::dvec2(-2'000, -10'000), 15);
+        const auto upper_right = tile_at(glm::dvec2(camera_position) + glm::dvec2(20'000, 10'000), 15);
+        unsigned n_occluded = 0;
+        for (auto x = lower_left.coords.x; x <= upper_right.coords.x; ++x) {
+            for (auto y = lower_left.coords.y; y <= upper_right.coords.y; ++y) {
+                const auto id = tile::Id { 15, { x, y } };
+                if (!culler.occluded(decorator->aabb(id)))
+                    continue;
+                ++n_occluded;
+                const auto bounds = nucleus::srs::tile_bounds(id);
+                constexpr auto n_samples = 5;
+                for (int i = 0; i < n_samples; ++i) {
+                    for (int j = 0; j < n_samples; ++j) {
+                        const auto xy = glm::mix(bounds.min, bounds.max, glm::dvec2(i, j) / double(n_samples - 1));
+                        CHECK(!visible(ridge, camera_position, glm::dvec3(xy, ridge.surface(xy))));
+                    }
+                }
+            }
+        }
+        return n_occluded;
+    };
+
+    SECTION("no visible tile is culled, tiles behind the ridge are")
+    {
+        CHECK(check_culled_tiles_are_hidden(camera) > 50);
+
+        const auto culler = HorizonCuller(camera, *decorator, { .occluder_zoom_level = 15 });
+        // behind the ridge
+        CHECK(culler.occluded(decorator->aabb(tile_at(camera_xy + glm::dvec2(12'000, 0), 15))));
+        // front side of the ridge
+        CHECK(!culler.occluded(decorator->aabb(tile_at(camera_xy + glm::dvec2(4'000, 0), 15))));
+    }
+
+    SECTION("other camera heights")
+    {
+        for (const auto height : { 800.0, 2'000.0, 4'000.0, 10'000.0 })
+            (void)check_culled_tiles_are_hidden(glm::dvec3(camera_xy, height));
+    }
+}
+
+TEST_CASE("nucleus/tile_scheduler/HorizonCuller alpine views")
+{
+    QFile file(":/map/height_data.atb");
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    assert(open);
+    Q_UNUSED(open);
+    const auto decorator = utils::AabbDecorator::make(TileHeights::deserialise(file.readAll()));
+
+    auto camera = nucleus::camera::stored_positions::heiligenblut_popping();
+    camera.set_viewport_size({ 1920, 1080 });
+
+    const auto count_quads = [&](const std::shared_ptr<const HorizonCuller>& horizon_culler) {
+        const auto refine = utils::refineFunctor(camera, decorator, 2.0, 256, horizon_culler);
+        unsigned n_quads = 0;
+        (void)quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, refine, [&n_quads](const tile::Id& v) {
+            ++n_quads;
+            return v.children();
+        });
+        return n_quads;
+    };
+    const auto horizon_culler = std::make_shared<const HorizonCuller>(camera.position(), *decorator);
+    const auto n_without_occlusion = count_quads({});
+    const auto n_with_occlusion = count_quads(horizon_culler);
+    CHECK(n_with_occlusion <= n_without_occlusion);
+
+    BENCHMARK("HorizonCuller construction")
+    {
+        return HorizonCuller(camera.position(), *decorator).n_occluders();
+    };
+    BENCHMARK("refine traversal with occlusion culling")
+    {
+        return count_quads(std::make_shared<const HorizonCuller>(camera.position(), *decorator));
+    };
+    BENCHMARK("refine traversal without occlusion culling")
+    {
+        return count_quads({});
+    };
+}
@@ -16,11 +16,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <QFile>
 #include <QSignalSpy>
 #include <catch2/catch_test_macros.hpp>
 
 #include "nucleus/tile_scheduler/LayerAssembler.h"
 #include "nucleus/tile_scheduler/utils.h"
+#include "nucleus/utils/height_codec.h"
+#include "nucleus/utils/image_loader.h"
 
 using namespace nucleus::tile_scheduler;
 using namespace tile_types;
@@ -73,7 +76,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
 
     SECTION("request only once")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
 
         assembler.load(tile::Id { 0, { 0, 0 } });
@@ -84,7 +87,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
 
     SECTION("assemble 1 (ortho, height, vector)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
 
         assembler.load(tile::Id { 0, { 0, 0 } });
@@ -113,7 +116,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
 
     SECTION("assemble 2 (height, ortho, vector)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
         assembler.load(tile::Id { 0, { 0, 0 } });
 
@@ -141,7 +144,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
 
     SECTION("assemble 3 (several tiles)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
         assembler.load(tile::Id { 0, { 0, 0 } });
         assembler.load(tile::Id { 1, { 0, 0 } });
@@ -238,6 +241,135 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler")
         REQUIRE(!loaded_tile.vector_tile->size());
         CHECK(assembler.n_items_in_flight() == 0);
     }
+
+    SECTION("heights are transcoded to the native height codec")
+    {
+        QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "test-tile.png"));
+        const auto open = file.open(QIODevice::ReadOnly);
+        REQUIRE(open);
+        const auto png = file.readAll();
+
+        assembler.set_height_transcoding_enabled(true);
+        assembler.set_height_zoom_offset(1);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+        assembler.load(tile::Id { 1, { 0, 0 } });
+        assembler.load(tile::Id { 1, { 1, 0 } });
+        assembler.deliver_ortho(good_tile({ 1, { 0, 0 } }, "ortho"));
+        assembler.deliver_ortho(good_tile({ 1, { 1, 0 } }, "ortho"));
+        assembler.deliver_vectortile(good_tile({ 1, { 0, 0 } }, "vector"));
+        assembler.deliver_vectortile(good_tile({ 1, { 1, 0 } }, "vector"));
+        assembler.deliver_height({ { 0, { 0, 0 } }, { NetworkInfo::Status::Good, utils::time_since_epoch() }, std::make_shared<QByteArray>(png) });
+
+        REQUIRE(spy_loaded.size() == 2);
+        const auto tile_0 = spy_loaded.at(0).constFirst().value<LayeredTile>();
+        const auto tile_1 = spy_loaded.at(1).constFirst().value<LayeredTile>();
+        REQUIRE(tile_0.height);
+        CHECK(nucleus::utils::height_codec::is_encoded(*tile_0.height));
+        CHECK(tile_0.height == tile_1.height); // encoded once, shared by the tiles waiting for the ancestor
+        CHECK(nucleus::utils::image_loader::height(*tile_0.height).buffer() == nucleus::utils::image_loader::height(png).buffer());
+    }
+
+    SECTION("layers are only requested within their zoom range")
+    {
+        assembler.set_vectortile_meta_data({ .min_zoom = 0, .max_zoom = 14 });
+        QSignalSpy spy_ortho_requested(&assembler, &LayerAssembler::ortho_requested);
+        QSignalSpy spy_height_requested(&assembler, &LayerAssembler::height_requested);
+        QSignalSpy spy_vector_requested(&assembler, &LayerAssembler::vectortile_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        assembler.load(tile::Id { 14, { 0, 0 } });
+        assembler.load(tile::Id { 15, { 0, 0 } });
+        CHECK(spy_ortho_requested.size() == 2);
+        CHECK(spy_height_requested.size() == 2);
+        REQUIRE(spy_vector_requested.size() == 1);
+        CHECK(spy_vector_requested.constFirst().constFirst().value<tile::Id>() == tile::Id { 14, { 0, 0 } });
+
+        assembler.deliver_ortho(good_tile({ 15, { 0, 0 } }, "ortho"));
+        CHECK(spy_loaded.empty());
+        assembler.deliver_height(good_tile({ 15, { 0, 0 } }, "height"));
+
+        REQUIRE(spy_loaded.size() == 1);
+        auto loaded_tile = spy_loaded.constFirst().constFirst().value<LayeredTile>();
+        CHECK(loaded_tile.id == tile::Id { 15, { 0, 0 } });
+        CHECK(loaded_tile.network_info.status == NetworkInfo::Status::Good);
+        CHECK(*loaded_tile.ortho == QByteArray("ortho"));
+        CHECK(*loaded_tile.height == QByteArray("height"));
+        REQUIRE(loaded_tile.vector_tile);
+        CHECK(loaded_tile.vector_tile->isEmpty());
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("layers outside of their coverage are reported missing without a request")
+    {
+        // srs bounds of a tile far away from tile 1/0/0
+        assembler.set_height_meta_data({ .coverage = tile::SrsBounds { { 1.0e6, 1.0e6 }, { 2.0e6, 2.0e6 } } });
+        QSignalSpy spy_height_requested(&assembler, &LayerAssembler::height_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        assembler.load(tile::Id { 1, { 0, 0 } });
+        CHECK(spy_height_requested.empty());
+        assembler.deliver_ortho(good_tile({ 1, { 0, 0 } }, "ortho"));
+        assembler.deliver_vectortile(good_tile({ 1, { 0, 0 } }, "vector"));
+
+        REQUIRE(spy_loaded.size() == 1);
+        auto loaded_tile = spy_loaded.constFirst().constFirst().value<LayeredTile>();
+        CHECK(loaded_tile.network_info.status == NetworkInfo::Status::NotFound);
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("ortho with zoom offset is requested once for all siblings")
+    {
+        assembler.set_ortho_zoom_offset(1);
+        QSignalSpy spy_ortho_requested(&assembler, &LayerAssembler::ortho_requested);
+        QSignalSpy spy_height_requested(&assembler, &LayerAssembler::height_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        const auto parent = tile::Id { 3, { 2, 2 } };
+        for (const auto& child : parent.children())
+            assembler.load(child);
+        REQUIRE(spy_ortho_requested.size() == 1);
+        CHECK(spy_ortho_requested.constFirst().constFirst().value<tile::Id>() == parent);
+        CHECK(spy_height_requested.size() == 4);
+
+        for (const auto& child : parent.children()) {
+            assembler.deliver_height(good_tile(child, "height"));
+            assembler.deliver_vectortile(good_tile(child, "vector"));
+        }
+        CHECK(spy_loaded.empty());
+        assembler.deliver_ortho(good_tile(parent, "parent ortho"));
+
+        REQUIRE(spy_loaded.size() == 4);
+        for (int i = 0; i < spy_loaded.size(); ++i) {
+            const auto tile = spy_loaded.at(i).constFirst().value<LayeredTile>();
+            CHECK(tile.id == parent.children()[unsigned(i)]);
+            CHECK(*tile.ortho == QByteArray("parent ortho"));
+            CHECK(*tile.height == QByteArray("height"));
+            CHECK(tile.ortho_zoom_offset == 1);
+            CHECK(tile.height_zoom_offset == 0);
+        }
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("disabled layers are not requested")
+    {
+        assembler.set_ortho_enabled(false);
+        assembler.set_vectortile_enabled(false);
+        QSignalSpy spy_ortho_requested(&assembler, &LayerAssembler::ortho_requested);
+        QSignalSpy spy_vector_requested(&assembler, &LayerAssembler::vectortile_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        CHECK(spy_ortho_requested.empty());
+        CHECK(spy_vector_requested.empty());
+        assembler.deliver_height(good_tile({ 0, { 0, 0 } }, "height"));
+
+        REQUIRE(spy_loaded.size() == 1);
+        auto loaded_tile = spy_loaded.constFirst().constFirst().value<LayeredTile>();
+        CHECK(loaded_tile.network_info.status == NetworkInfo::Status::Good);
+        CHECK(loaded_tile.ortho->isEmpty());
+        CHECK(*loaded_tile.height == QByteArray("height"));
+        CHECK(loaded_tile.vector_tile->isEmpty());
+    }
 }
 #else
 TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
@@ -271,7 +403,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
 
     SECTION("request only once")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
 
         assembler.load(tile::Id { 0, { 0, 0 } });
@@ -282,7 +414,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
 
     SECTION("assemble 1 (ortho, height, vector)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
 
         assembler.load(tile::Id { 0, { 0, 0 } });
@@ -306,7 +438,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
 
     SECTION("assemble 2 (height, ortho, vector)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
         assembler.load(tile::Id { 0, { 0, 0 } });
 
@@ -329,7 +461,7 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
 
     SECTION("assemble 3 (several tiles)")
     {
-        QSignalSpy spy_requested(&assembler, &LayerAssembler::tile_requested);
+        QSignalSpy spy_requested(&assembler, &LayerAssembler::ortho_requested);
         QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
         assembler.load(tile::Id { 0, { 0, 0 } });
         assembler.load(tile::Id { 1, { 0, 0 } });
@@ -400,5 +532,24 @@ TEST_CASE("nucleus/tile_scheduler/layer assembler (no labels)")
         REQUIRE(!loaded_tile.height->size());
         CHECK(assembler.n_items_in_flight() == 0);
     }
+
+    SECTION("layers are only requested within their zoom range")
+    {
+        assembler.set_ortho_meta_data({ .min_zoom = 0, .max_zoom = 14 });
+        QSignalSpy spy_ortho_requested(&assembler, &LayerAssembler::ortho_requested);
+        QSignalSpy spy_height_requested(&assembler, &LayerAssembler::height_requested);
+        QSignalSpy spy_loaded(&assembler, &LayerAssembler::tile_loaded);
+
+        assembler.load(tile::Id { 15, { 0, 0 } });
+        CHECK(spy_ortho_requested.empty());
+        CHECK(spy_height_requested.size() == 1);
+
+        assembler.deliver_height(good_tile({ 15, { 0, 0 } }, "height"));
+        REQUIRE(spy_loaded.size() == 1);
+        auto loaded_tile = spy_loaded.constFirst().constFirst().value<LayeredTile>();
+        CHECK(loaded_tile.id == tile::Id { 15, { 0, 0 } });
+        CHECK(loaded_tile.network_info.status == NetworkInfo::Status::NotFound);
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
 }
 #endif
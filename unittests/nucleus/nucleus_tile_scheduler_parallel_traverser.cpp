@@ -0,0 +1,148 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/tile_scheduler/ParallelQuadTreeTraverser.h"
+
+#include <algorithm>
+#include <string>
+
+#include <QFile>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/camera/PositionStorage.h"
+#include "nucleus/tile_scheduler/utils.h"
+#include "nucleus/utils/WorkerPool.h"
+#include "radix/quad_tree.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+ParallelQuadTreeTraverser::Result serial_traverse(const ParallelQuadTreeTraverser::RefineFunction& refine)
+{
+    ParallelQuadTreeTraverser::Result result;
+    result.leaves = quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, refine, [&result](const tile::Id& v) {
+        result.inner_nodes.push_back(v);
+        return v.children();
+    });
+    return result;
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/ParallelQuadTreeTraverser")
+{
+    QFile file(":/map/height_data.atb");
+    const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+    REQUIRE(open);
+    const auto decorator = utils::AabbDecorator::make(TileHeights::deserialise(file.readAll()));
+
+    auto camera_positions = std::vector {
+        nucleus::camera::stored_positions::karwendel(),
+        nucleus::camera::stored_positions::grossglockner(),
+        nucleus::camera::stored_positions::oestl_hochgrubach_spitze(),
+        nucleus::camera::stored_positions::schneeberg(),
+        nucleus::camera::stored_positions::wien(),
+        nucleus::camera::stored_positions::stephansdom(),
+    };
+    for (auto& camera : camera_positions)
+        camera.set_viewport_size({ 2560, 1440 });
+
+    SECTION("sort depth first")
+    {
+        const auto expected = serial_traverse([](const tile::Id& v) { return v.zoom_level < 4; });
+        auto inner_nodes = expected.inner_nodes;
+        auto leaves = expected.leaves;
+        std::reverse(inner_nodes.begin(), inner_nodes.end());
+        std::reverse(leaves.begin(), leaves.end());
+        ParallelQuadTreeTraverser::sort_depth_first(&inner_nodes);
+        ParallelQuadTreeTraverser::sort_depth_first(&leaves);
+        CHECK(inner_nodes == expected.inner_nodes);
+        CHECK(leaves == expected.leaves);
+    }
+
+    SECTION("identical to the serial traversal")
+    {
+        for (const unsigned n_threads : { 1u, 2u, 3u, 8u }) {
+            nucleus::utils::WorkerPool pool(n_threads);
+            ParallelQuadTreeTraverser traverser(pool);
+            CHECK(traverser.n_threads() == n_threads);
+            for (const auto& camera : camera_positions) {
+                const auto refine = utils::refineFunctor(camera, decorator, 1.0);
+                const auto expected = serial_traverse(refine);
+                // several runs, the scheduling is different every time
+                for (unsigned i = 0; i < 3; ++i) {
+                    const auto result = traverser.traverse(tile::Id { 0, { 0, 0 } }, refine);
+                    CHECK(result.leaves == expected.leaves);
+                    CHECK(result.inner_nodes == expected.inner_nodes);
+                }
+            }
+        }
+    }
+
+    SECTION("busy pool runs the traversal serially")
+    {
+        nucleus::utils::WorkerPool pool(4);
+        ParallelQuadTreeTraverser traverser(pool);
+        const auto refine = utils::refineFunctor(camera_positions.front(), decorator, 1.0);
+        const auto expected = serial_traverse(refine);
+        ParallelQuadTreeTraverser::Result result;
+        pool.parallel_for(2, [&](unsigned i) {
+            if (i == 0)
+                result = traverser.traverse(tile::Id { 0, { 0, 0 } }, refine);
+        });
+        CHECK(result.leaves == expected.leaves);
+        CHECK(result.inner_nodes == expected.inner_nodes);
+    }
+
+    SECTION("refining nothing")
+    {
+        nucleus::utils::WorkerPool pool(4);
+        ParallelQuadTreeTraverser traverser(pool);
+        const auto result = traverser.traverse(tile::Id { 0, { 0, 0 } }, [](const tile::Id&) { return false; });
+        CHECK(result.inner_nodes.empty());
+        REQUIRE(result.leaves.size() == 1);
+        CHECK(result.leaves.front() == tile::Id { 0, { 0, 0 } });
+    }
+
+    SECTION("benchmark")
+    {
+        // a low error threshold, as on high dpi displays
+        std::vector<ParallelQuadTreeTraverser::RefineFunction> refine_functions;
+        for (const auto& camera : camera_positions)
+            refine_functions.push_back(utils::refineFunctor(camera, decorator, 0.5));
+
+        BENCHMARK("serial")
+        {
+            size_t n = 0;
+            for (const auto& refine : refine_functions)
+                n += serial_traverse(refine).leaves.size();
+            return n;
+        };
+        for (const unsigned n_threads : { 2u, 4u, 8u }) {
+            nucleus::utils::WorkerPool pool(n_threads);
+            ParallelQuadTreeTraverser traverser(pool);
+            BENCHMARK("parallel, " + std::to_string(n_threads) + " threads")
+            {
+                size_t n = 0;
+                for (const auto& refine : refine_functions)
+                    n += traverser.traverse(tile::Id { 0, { 0, 0 } }, refine).leaves.size();
+                return n;
+            };
+        }
+    }
+}
@@ -21,6 +21,8 @@
 #include <QSignalSpy>
 #include <catch2/catch_test_macros.hpp>
 
+#include "test_helpers.h"
+
 using namespace nucleus::tile_scheduler;
 using namespace tile_types;
 
@@ -269,4 +271,157 @@ TEST_CASE("nucleus/tile_scheduler/quad assembler")
         CHECK(loaded_tile.id == tile::Id { 0, { 0, 0 } });
         CHECK(loaded_tile.network_info().status == NetworkInfo::Status::NotFound);
     }
+
+    SECTION("incomplete quads are emitted as partial after the deadline")
+    {
+        assembler.set_timeout(20);
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.load(tile::Id { 3, { 4, 5 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        assembler.deliver_tile(good_tile({ 1, { 1, 1 } }, "ortho 111", "height 111", "vector 111"));
+        assembler.deliver_tile(missing_tile({ 1, { 0, 1 } }));
+        assembler.deliver_tile(good_tile({ 4, { 8, 10 } }, "ortho 4810", "height 4810", "vector 4810"));
+        assembler.deliver_tile(good_tile({ 4, { 8, 11 } }, "ortho 4811", "height 4811", "vector 4811"));
+        assembler.deliver_tile(good_tile({ 4, { 9, 11 } }, "ortho 4911", "height 4911", "vector 4911"));
+        assembler.deliver_tile(good_tile({ 4, { 9, 10 } }, "ortho 4910", "height 4910", "vector 4910"));
+        REQUIRE(spy_loaded.size() == 1);
+        CHECK(assembler.n_items_in_flight() == 1);
+
+        test_helpers::process_events_for(40);
+        REQUIRE(spy_loaded.size() == 2); // complete quad is not emitted again
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        const auto partial_quad = spy_loaded[1].constFirst().value<tile_types::TileQuad>();
+        CHECK(partial_quad.id == tile::Id { 0, { 0, 0 } });
+        REQUIRE(partial_quad.n_tiles == 4);
+        CHECK(partial_quad.n_missing_tiles() == 1);
+        CHECK(partial_quad.network_info().status == NetworkInfo::Status::NetworkError);
+        CHECK(partial_quad.tiles[0].id == tile::Id { 1, { 0, 0 } });
+        CHECK(partial_quad.tiles[1].id == tile::Id { 1, { 1, 1 } });
+        CHECK(partial_quad.tiles[2].id == tile::Id { 1, { 0, 1 } });
+        CHECK(partial_quad.tiles[2].network_info.status == NetworkInfo::Status::NotFound);
+        CHECK(partial_quad.tiles[3].id == tile::Id { 1, { 1, 0 } });
+        CHECK(partial_quad.tiles[3].network_info.status == NetworkInfo::Status::NetworkError);
+        REQUIRE(partial_quad.tiles[3].ortho);
+        REQUIRE(partial_quad.tiles[3].height);
+        CHECK(partial_quad.tiles[3].ortho->isEmpty());
+        CHECK(partial_quad.tiles[3].height->isEmpty());
+#ifdef ALP_ENABLE_LABELS
+        REQUIRE(partial_quad.tiles[3].vector_tile);
+#endif
+
+        // the late tile is dropped
+        assembler.deliver_tile(good_tile({ 1, { 1, 0 } }, "ortho 110", "height 110", "vector 110"));
+        CHECK(spy_loaded.size() == 2);
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("loading a partial quad again only requests the missing tiles")
+    {
+        assembler.set_timeout(20);
+        QSignalSpy spy_requested(&assembler, &QuadAssembler::tile_requested);
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        assembler.deliver_tile(missing_tile({ 1, { 0, 1 } }));
+        test_helpers::process_events_for(40);
+        REQUIRE(spy_loaded.size() == 1);
+        CHECK(spy_loaded[0].constFirst().value<tile_types::TileQuad>().n_missing_tiles() == 2);
+
+        // late tile is kept for the retry
+        assembler.deliver_tile(good_tile({ 1, { 1, 1 } }, "ortho 111", "height 111", "vector 111"));
+        CHECK(spy_loaded.size() == 1);
+
+        spy_requested.clear();
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        REQUIRE(spy_requested.size() == 1);
+        CHECK(spy_requested[0].constFirst().value<tile::Id>() == tile::Id { 1, { 1, 0 } });
+
+        assembler.deliver_tile(good_tile({ 1, { 1, 0 } }, "ortho 110", "height 110", "vector 110"));
+        REQUIRE(spy_loaded.size() == 2);
+        const auto quad = spy_loaded[1].constFirst().value<tile_types::TileQuad>();
+        CHECK(quad.id == tile::Id { 0, { 0, 0 } });
+        REQUIRE(quad.n_tiles == 4);
+        CHECK(quad.n_missing_tiles() == 0);
+        CHECK(quad.network_info().status == NetworkInfo::Status::Good);
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        // the quad is complete, a further load requests all tiles again.
+        spy_requested.clear();
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        CHECK(spy_requested.size() == 4);
+    }
+
+    SECTION("partial quads emitted again are not dropped early")
+    {
+        assembler.set_timeout(10);
+        QSignalSpy spy_requested(&assembler, &QuadAssembler::tile_requested);
+        const auto quad_id = tile::Id { 0, { 0, 0 } };
+
+        // timeout, reload, timeout again
+        assembler.load(quad_id);
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        test_helpers::process_events_for(40);
+        assembler.load(quad_id);
+        test_helpers::process_events_for(40);
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        // fill up to the limit with other partial quads
+        for (unsigned i = 0; i < QuadAssembler::max_partial_quads - 1; ++i)
+            assembler.load(tile::Id { 10, { i, 0 } });
+        test_helpers::process_events_for(40);
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        spy_requested.clear();
+        assembler.load(quad_id);
+        CHECK(spy_requested.size() == 3); // still known as partial
+        test_helpers::process_events_for(40);
+
+        // one more than the limit drops the oldest
+        for (unsigned i = 0; i < QuadAssembler::max_partial_quads; ++i)
+            assembler.load(tile::Id { 11, { i, 0 } });
+        test_helpers::process_events_for(40);
+        spy_requested.clear();
+        assembler.load(quad_id);
+        CHECK(spy_requested.size() == 4);
+    }
+
+    SECTION("partial quads whose missing tiles all arrived late are emitted on load")
+    {
+        assembler.set_timeout(20);
+        QSignalSpy spy_requested(&assembler, &QuadAssembler::tile_requested);
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        assembler.deliver_tile(good_tile({ 1, { 0, 1 } }, "ortho 101", "height 101", "vector 101"));
+        assembler.deliver_tile(good_tile({ 1, { 1, 1 } }, "ortho 111", "height 111", "vector 111"));
+        test_helpers::process_events_for(40);
+        REQUIRE(spy_loaded.size() == 1);
+        assembler.deliver_tile(good_tile({ 1, { 1, 0 } }, "ortho 110", "height 110", "vector 110"));
+
+        spy_requested.clear();
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        CHECK(spy_requested.empty());
+        REQUIRE(spy_loaded.size() == 2);
+        CHECK(spy_loaded[1].constFirst().value<tile_types::TileQuad>().n_missing_tiles() == 0);
+        CHECK(assembler.n_items_in_flight() == 0);
+    }
+
+    SECTION("tiles delivered twice are counted once")
+    {
+        QSignalSpy spy_loaded(&assembler, &QuadAssembler::quad_loaded);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        assembler.deliver_tile(good_tile({ 1, { 0, 0 } }, "ortho 100", "height 100", "vector 100"));
+        assembler.deliver_tile(good_tile({ 1, { 0, 1 } }, "ortho 101", "height 101", "vector 101"));
+        assembler.deliver_tile(good_tile({ 1, { 1, 0 } }, "ortho 110", "height 110", "vector 110"));
+        CHECK(spy_loaded.empty());
+        assembler.deliver_tile(good_tile({ 1, { 1, 1 } }, "ortho 111", "height 111", "vector 111"));
+        REQUIRE(spy_loaded.size() == 1);
+        CHECK(spy_loaded[0].constFirst().value<tile_types::TileQuad>().n_missing_tiles() == 0);
+    }
 }
@@ -0,0 +1,196 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include <QSignalSpy>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/tile_scheduler/LayerAssembler.h"
+#include "nucleus/tile_scheduler/QuadAssembler.h"
+#include "nucleus/tile_scheduler/QuadLayerAssembler.h"
+#include "nucleus/tile_scheduler/utils.h"
+
+using namespace nucleus::tile_scheduler;
+using namespace tile_types;
+using Layer = QuadLayerAssembler::Layer;
+
+namespace {
+TileLayer good_tile(const tile::Id& id, const char* bytes) { return { id, { NetworkInfo::Status::Good, utils::time_since_epoch() }, std::make_shared<QByteArray>(bytes) }; }
+TileLayer missing_tile(const tile::Id& id) { return { id, { NetworkInfo::Status::NotFound, utils::time_since_epoch() }, std::make_shared<QByteArray>() }; }
+
+void deliver_all_layers(QuadLayerAssembler* assembler, const tile::Id& tile_id)
+{
+    assembler->deliver_ortho(good_tile(tile_id, "ortho"));
+    assembler->deliver_height(good_tile(tile_id, "height"));
+#ifdef ALP_ENABLE_LABELS
+    assembler->deliver_vectortile(good_tile(tile_id, "vector"));
+#endif
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/quad layer assembler")
+{
+    QuadLayerAssembler assembler;
+
+    SECTION("request all layers of all children once")
+    {
+        QSignalSpy spy_ortho(&assembler, &QuadLayerAssembler::ortho_requested);
+        QSignalSpy spy_height(&assembler, &QuadLayerAssembler::height_requested);
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        assembler.load(tile::Id { 0, { 0, 0 } });
+        REQUIRE(spy_ortho.size() == 4);
+        REQUIRE(spy_height.size() == 4);
+        const auto children = tile::Id { 0, { 0, 0 } }.children();
+        for (unsigned i = 0; i < 4; ++i) {
+            CHECK(spy_ortho.at(int(i)).constFirst().value<tile::Id>() == children[i]);
+            CHECK(spy_height.at(int(i)).constFirst().value<tile::Id>() == children[i]);
+        }
+        CHECK(assembler.n_items_in_flight() == 1);
+    }
+
+    SECTION("assemble several quads")
+    {
+        QSignalSpy spy_loaded(&assembler, &QuadLayerAssembler::quad_loaded);
+        const auto quad_a = tile::Id { 0, { 0, 0 } };
+        const auto quad_b = tile::Id { 3, { 4, 5 } };
+        assembler.load(quad_a);
+        assembler.load(quad_b);
+        for (const auto& id : quad_b.children())
+            deliver_all_layers(&assembler, id);
+        CHECK(spy_loaded.size() == 1);
+        CHECK(assembler.n_items_in_flight() == 1);
+        for (const auto& id : quad_a.children())
+            deliver_all_layers(&assembler, id);
+        REQUIRE(spy_loaded.size() == 2);
+        CHECK(assembler.n_items_in_flight() == 0);
+
+        const auto quad = spy_loaded.at(0).constFirst().value<TileQuad>();
+        CHECK(quad.id == quad_b);
+        CHECK(quad.n_tiles == 4);
+        CHECK(quad.network_info().status == NetworkInfo::Status::Good);
+        for (unsigned i = 0; i < 4; ++i) {
+            CHECK(quad.tiles[i].id == quad_b.children()[i]);
+            CHECK(*quad.tiles[i].ortho == QByteArray("ortho"));
+            CHECK(*quad.tiles[i].height == QByteArray("height"));
+#ifdef ALP_ENABLE_LABELS
+            CHECK(*quad.tiles[i].vector_tile == QByteArray("vector"));
+#endif
+        }
+    }
+
+    SECTION("missing layer empties the tile, delivering twice or unrequested is ignored")
+    {
+        QSignalSpy spy_loaded(&assembler, &QuadLayerAssembler::quad_loaded);
+        const auto quad_id = tile::Id { 0, { 0, 0 } };
+        const auto children = quad_id.children();
+        assembler.load(quad_id);
+        assembler.deliver_ortho(good_tile(tile::Id { 5, { 0, 0 } }, "unrequested"));
+        assembler.deliver_ortho(missing_tile(children[0]));
+        assembler.deliver_ortho(good_tile(children[0], "twice"));
+        for (unsigned i = 1; i < 4; ++i)
+            assembler.deliver_ortho(good_tile(children[i], "ortho"));
+        for (const auto& id : children) {
+            assembler.deliver_height(good_tile(id, "height"));
+#ifdef ALP_ENABLE_LABELS
+            assembler.deliver_vectortile(good_tile(id, "vector"));
+#endif
+        }
+        REQUIRE(spy_loaded.size() == 1);
+        const auto quad = spy_loaded.constFirst().constFirst().value<TileQuad>();
+        CHECK(quad.network_info().status == NetworkInfo::Status::NotFound);
+        CHECK(quad.tiles[0].network_info.status == NetworkInfo::Status::NotFound);
+        CHECK(quad.tiles[0].ortho->isEmpty());
+        CHECK(quad.tiles[0].height->isEmpty());
+        CHECK(*quad.tiles[1].height == QByteArray("height"));
+    }
+
+#ifdef ALP_ENABLE_LABELS
+    SECTION("layers outside their zoom range are not requested")
+    {
+        assembler.set_meta_data(Layer::VectorTile, { .min_zoom = 0, .max_zoom = 14 });
+        QSignalSpy spy_vector(&assembler, &QuadLayerAssembler::vectortile_requested);
+        QSignalSpy spy_loaded(&assembler, &QuadLayerAssembler::quad_loaded);
+        const auto quad_id = tile::Id { 14, { 0, 0 } };
+        assembler.load(quad_id);
+        CHECK(spy_vector.empty());
+        for (const auto& id : quad_id.children()) {
+            assembler.deliver_ortho(good_tile(id, "ortho"));
+            assembler.deliver_height(good_tile(id, "height"));
+        }
+        REQUIRE(spy_loaded.size() == 1);
+        const auto quad = spy_loaded.constFirst().constFirst().value<TileQuad>();
+        CHECK(quad.network_info().status == NetworkInfo::Status::Good);
+        CHECK(quad.tiles[0].vector_tile->isEmpty());
+    }
+#endif
+}
+
+TEST_CASE("nucleus/tile_scheduler/quad layer assembler benchmarks")
+{
+    constexpr unsigned n_quads = 256;
+    std::vector<tile::Id> quad_ids;
+    for (unsigned i = 0; i < n_quads; ++i)
+        quad_ids.push_back(tile::Id { 12, { 2000 + i % 16, 3000 + i / 16 } });
+    const auto payload = std::make_shared<QByteArray>(20000, 'x');
+    const auto now = utils::time_since_epoch();
+
+    BENCHMARK("QuadAssembler + LayerAssembler (16 quads in flight)")
+    {
+        QuadAssembler qa;
+        LayerAssembler la;
+        unsigned n_loaded = 0;
+        QObject::connect(&qa, &QuadAssembler::tile_requested, &la, &LayerAssembler::load);
+        QObject::connect(&la, &LayerAssembler::tile_loaded, &qa, &QuadAssembler::deliver_tile);
+        QObject::connect(&qa, &QuadAssembler::quad_loaded, [&n_loaded](const TileQuad&) { ++n_loaded; });
+        for (unsigned batch = 0; batch < n_quads; batch += 16) {
+            for (unsigned i = batch; i < batch + 16; ++i)
+                qa.load(quad_ids[i]);
+            for (unsigned i = batch; i < batch + 16; ++i) {
+                for (const auto& id : quad_ids[i].children()) {
+                    la.deliver_ortho({ id, { NetworkInfo::Status::Good, now }, payload });
+                    la.deliver_height({ id, { NetworkInfo::Status::Good, now }, payload });
+#ifdef ALP_ENABLE_LABELS
+                    la.deliver_vectortile({ id, { NetworkInfo::Status::Good, now }, payload });
+#endif
+                }
+            }
+        }
+        return n_loaded;
+    };
+
+    BENCHMARK("QuadLayerAssembler (16 quads in flight)")
+    {
+        QuadLayerAssembler assembler;
+        unsigned n_loaded = 0;
+        QObject::connect(&assembler, &QuadLayerAssembler::quad_loaded, [&n_loaded](const TileQuad&) { ++n_loaded; });
+        for (unsigned batch = 0; batch < n_quads; batch += 16) {
+            for (unsigned i = batch; i < batch + 16; ++i)
+                assembler.load(quad_ids[i]);
+            for (unsigned i = batch; i < batch + 16; ++i) {
+                for (const auto& id : quad_ids[i].children()) {
+                    assembler.deliver(Layer::Ortho, id, { NetworkInfo::Status::Good, now }, std::shared_ptr(payload));
+                    assembler.deliver(Layer::Height, id, { NetworkInfo::Status::Good, now }, std::shared_ptr(payload));
+#ifdef ALP_ENABLE_LABELS
+                    assembler.deliver(Layer::VectorTile, id, { NetworkInfo::Status::Good, now }, std::shared_ptr(payload));
+#endif
+                }
+            }
+        }
+        return n_loaded;
+    };
+}
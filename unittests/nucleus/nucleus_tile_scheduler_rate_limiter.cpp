@@ -23,6 +23,7 @@
 
 #include "RateTester.h"
 #include "nucleus/tile_scheduler/RateLimiter.h"
+#include "nucleus/tile_scheduler/utils.h"
 #include "test_helpers.h"
 
 #if !(defined(__ANDROID__) && (defined(__i386__) || defined(__x86_64__)))
@@ -181,6 +182,58 @@ TEST_CASE("nucleus/tile_scheduler/rate limiter")
         }
     }
 
+    SECTION("token bucket sends a burst and then refills continuously")
+    {
+        RateLimiter rl;
+        rl.set_limit(2, 4 * timing_multiplicator); // one token every 2 * timing_multiplicator msecs
+        rl.set_policy(RateLimiter::Policy::TokenBucket);
+        rl.set_burst(3);
+        QSignalSpy spy(&rl, &RateLimiter::quad_requested);
+        for (unsigned i = 0; i < 6; ++i)
+            rl.request_quad(tile::Id { i, { 0, 0 } });
+        CHECK(spy.size() == 3);
+        CHECK(rl.queue_size() == 3);
+        test_helpers::process_events_for(3 * timing_multiplicator);
+        CHECK(spy.size() == 4);
+        test_helpers::process_events_for(4 * timing_multiplicator);
+        CHECK(spy.size() == 6);
+        CHECK(rl.queue_size() == 0);
+
+        // after a quiet time, the full burst is available again
+        test_helpers::process_events_for(8 * timing_multiplicator);
+        for (unsigned i = 6; i < 10; ++i)
+            rl.request_quad(tile::Id { i, { 0, 0 } });
+        CHECK(spy.size() == 9);
+
+        for (int i = 0; i < spy.size(); ++i)
+            CHECK(spy[i][0].value<tile::Id>() == tile::Id { unsigned(i), { 0, 0 } });
+    }
+
+    SECTION("token bucket never exceeds burst plus refill")
+    {
+        std::mt19937 mt(43);
+        RateLimiter rl;
+        rl.set_limit(3, 5 * timing_multiplicator);
+        rl.set_policy(RateLimiter::Policy::TokenBucket);
+        rl.set_burst(4);
+        std::vector<uint64_t> sent;
+        QObject::connect(&rl, &RateLimiter::quad_requested, [&sent]() { sent.push_back(nucleus::tile_scheduler::utils::time_since_epoch()); });
+        unsigned request_no = 0;
+        for (unsigned iteration = 0; iteration < 30; ++iteration) {
+            const auto rnd_request_count = std::uniform_int_distribution<unsigned>(1, 6)(mt);
+            for (unsigned i = 0; i < rnd_request_count; ++i)
+                rl.request_quad(tile::Id { request_no++, { 0, 0 } });
+            test_helpers::process_events_for(std::uniform_int_distribution<unsigned>(0, 5 * timing_multiplicator)(mt));
+        }
+        // in any window of length t, at most burst + t * rate / period requests can go out (plus some slack for the msec clock).
+        for (size_t i = 0; i < sent.size(); ++i) {
+            for (size_t j = i; j < sent.size(); ++j) {
+                const auto window = double(sent[j] - sent[i]);
+                CHECK(double(j - i + 1) <= 4 + window * 3 / (5 * timing_multiplicator) + 0.5);
+            }
+        }
+    }
+
     SECTION("fuzzy load test")
     {
         std::mt19937 mt(42);
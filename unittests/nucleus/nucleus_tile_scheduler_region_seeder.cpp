@@ -0,0 +1,245 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/tile_scheduler/RegionSeeder.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QUrl>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/srs.h"
+#include "nucleus/tile_scheduler/LayerAssembler.h"
+#include "nucleus/tile_scheduler/QuadAssembler.h"
+#include "nucleus/tile_scheduler/RateLimiter.h"
+#include "nucleus/tile_scheduler/SlotLimiter.h"
+#include "nucleus/tile_scheduler/TileLoadService.h"
+
+using namespace nucleus::tile_scheduler;
+
+namespace {
+QByteArray read_test_data(const QString& name)
+{
+    QFile file(QString(ALP_TEST_DATA_DIR) + name);
+    const auto open = file.open(QIODevice::ReadOnly);
+    REQUIRE(open);
+    return file.readAll();
+}
+
+void write_tile(const TileLoadService& service, const tile::Id& id, const QByteArray& data)
+{
+    const auto path = QUrl(service.build_tile_url(id)).toLocalFile();
+    REQUIRE(QDir().mkpath(QFileInfo(path).absolutePath()));
+    QFile file(path);
+    REQUIRE(file.open(QIODevice::WriteOnly));
+    file.write(data);
+}
+} // namespace
+
+TEST_CASE("nucleus/tile_scheduler/region seeder")
+{
+    // around the grossglockner
+    tile::SrsBounds bounds;
+    bounds.min = nucleus::srs::lat_long_to_world({ 47.0, 12.6 });
+    bounds.max = nucleus::srs::lat_long_to_world({ 47.2, 12.8 });
+
+    SECTION("quads for region")
+    {
+        RegionSeeder seeder;
+        seeder.set_region(bounds);
+        seeder.set_zoom_range(0, 8);
+        const auto quads = seeder.quads_for_region();
+        REQUIRE(!quads.empty());
+        CHECK(quads.front() == tile::Id { 0, { 0, 0 } });
+        for (size_t i = 1; i < quads.size(); ++i) {
+            CHECK(quads[i - 1].zoom_level <= quads[i].zoom_level);
+        }
+        for (const auto& id : quads) {
+            CHECK(id.zoom_level + 1 <= 8);
+            const auto b = nucleus::srs::tile_bounds(id);
+            CHECK(b.min.x < bounds.max.x);
+            CHECK(b.max.x > bounds.min.x);
+            CHECK(b.min.y < bounds.max.y);
+            CHECK(b.max.y > bounds.min.y);
+        }
+        // every quad except the root has its parent in the list
+        for (const auto& id : quads) {
+            if (id.zoom_level == 0)
+                continue;
+            CHECK(std::find(quads.cbegin(), quads.cend(), id.parent()) != quads.cend());
+        }
+
+        seeder.set_zoom_range(4, 8);
+        const auto upper = seeder.quads_for_region();
+        CHECK(upper.size() < quads.size());
+        for (const auto& id : upper)
+            CHECK(id.zoom_level + 1 >= 4);
+
+        // a triangle inside the box covers at most the quads of the box
+        seeder.set_zoom_range(0, 12);
+        const auto box_quads = seeder.quads_for_region();
+        seeder.set_region(std::vector<glm::dvec2> { bounds.min, { bounds.max.x, bounds.min.y }, bounds.max });
+        const auto triangle_quads = seeder.quads_for_region();
+        CHECK(triangle_quads.size() < box_quads.size());
+        for (const auto& id : triangle_quads) {
+            CHECK(std::find(box_quads.cbegin(), box_quads.cend(), id) != box_quads.cend());
+        }
+    }
+
+    SECTION("seeds the cache from a local tile server")
+    {
+        // file urls stand in for the tile server
+        QTemporaryDir dir;
+        REQUIRE(dir.isValid());
+        const auto base_url = QUrl::fromLocalFile(dir.path()).toString();
+        TileLoadService height_service(base_url + "/height/", TileLoadService::UrlPattern::ZXY, ".png");
+        TileLoadService ortho_service(base_url + "/ortho/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg");
+
+        RegionSeeder seeder;
+        seeder.set_region(bounds);
+        seeder.set_zoom_range(0, 6);
+        const auto quads = seeder.quads_for_region();
+        const auto height_bytes = read_test_data("test-tile.png");
+        const auto ortho_bytes = read_test_data("test-tile_ortho.jpeg");
+        for (const auto& quad_id : quads) {
+            for (const auto& id : quad_id.children()) {
+                write_tile(height_service, id, height_bytes);
+                write_tile(ortho_service, id, ortho_bytes);
+            }
+        }
+
+        SlotLimiter sl;
+        RateLimiter rl;
+        QuadAssembler qa;
+        LayerAssembler la;
+        sl.set_limit(8);
+        rl.set_limit(1000, 1000);
+#ifdef ALP_ENABLE_LABELS
+        la.set_vectortile_enabled(false);
+#endif
+        QObject::connect(&seeder, &RegionSeeder::quads_requested, &sl, &SlotLimiter::request_quads);
+        QObject::connect(&sl, &SlotLimiter::quad_requested, &rl, &RateLimiter::request_quad);
+        QObject::connect(&rl, &RateLimiter::quad_requested, &qa, &QuadAssembler::load);
+        QObject::connect(&qa, &QuadAssembler::tile_requested, &la, &LayerAssembler::load);
+        QObject::connect(&la, &LayerAssembler::ortho_requested, &ortho_service, &TileLoadService::load);
+        QObject::connect(&la, &LayerAssembler::height_requested, &height_service, &TileLoadService::load);
+        QObject::connect(&ortho_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_ortho);
+        QObject::connect(&height_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_height);
+        QObject::connect(&la, &LayerAssembler::tile_loaded, &qa, &QuadAssembler::deliver_tile);
+        QObject::connect(&qa, &QuadAssembler::quad_loaded, &sl, &SlotLimiter::deliver_quad);
+        QObject::connect(&sl, &SlotLimiter::quad_delivered, &seeder, &RegionSeeder::receive_quad);
+
+        QSignalSpy spy_progress(&seeder, &RegionSeeder::progress_updated);
+        QSignalSpy spy_finished(&seeder, &RegionSeeder::finished);
+        seeder.start();
+        REQUIRE(spy_finished.wait(10000));
+        REQUIRE(spy_finished.size() == 1);
+        CHECK(spy_progress.size() == int(quads.size()));
+
+        const auto progress = seeder.progress();
+        CHECK(progress.n_quads_total == quads.size());
+        CHECK(progress.n_quads_done == quads.size());
+        CHECK(progress.n_quads_failed == 0);
+        CHECK(progress.n_bytes == quads.size() * 4 * size_t(height_bytes.size() + ortho_bytes.size()));
+
+        REQUIRE(seeder.cache().n_cached_objects() == quads.size());
+        for (const auto& id : quads) {
+            REQUIRE(seeder.cache().contains(id));
+            const auto& quad = seeder.cache().peak_at(id);
+            CHECK(quad.network_info().status == tile_types::NetworkInfo::Status::Good);
+            CHECK(quad.n_missing_tiles() == 0);
+        }
+
+        const auto cache_path = std::filesystem::path(dir.path().toStdString()) / "tile_cache";
+        REQUIRE(seeder.cache().write_to_disk(cache_path).has_value());
+        {
+            Cache<tile_types::TileQuad> cache;
+            REQUIRE(cache.read_from_disk(cache_path).has_value());
+            CHECK(cache.n_cached_objects() == quads.size());
+        }
+
+        // with a disk cache, quads are moved to disk while seeding
+        const auto streamed_cache_path = std::filesystem::path(dir.path().toStdString()) / "streamed_tile_cache";
+        RegionSeeder streaming_seeder;
+        streaming_seeder.set_region(bounds);
+        streaming_seeder.set_zoom_range(0, 6);
+        streaming_seeder.set_disk_cache(streamed_cache_path, 4);
+        QObject::connect(&streaming_seeder, &RegionSeeder::quads_requested, &sl, &SlotLimiter::request_quads);
+        QObject::connect(&sl, &SlotLimiter::quad_delivered, &streaming_seeder, &RegionSeeder::receive_quad);
+        QSignalSpy spy_streaming_finished(&streaming_seeder, &RegionSeeder::finished);
+        QSignalSpy spy_disk_write_failed(&streaming_seeder, &RegionSeeder::disk_write_failed);
+        unsigned max_quads_in_ram = 0;
+        QObject::connect(&streaming_seeder, &RegionSeeder::progress_updated, [&]() {
+            max_quads_in_ram = std::max(max_quads_in_ram, streaming_seeder.cache().n_cached_objects());
+        });
+        streaming_seeder.start();
+        REQUIRE(spy_streaming_finished.wait(10000));
+        CHECK(spy_disk_write_failed.isEmpty());
+        CHECK(streaming_seeder.progress().n_quads_done == quads.size());
+        CHECK(max_quads_in_ram < 4);
+        CHECK(streaming_seeder.cache().n_cached_objects() == 0);
+        {
+            Cache<tile_types::TileQuad> cache;
+            REQUIRE(cache.read_from_disk(streamed_cache_path).has_value());
+            CHECK(cache.n_cached_objects() == quads.size());
+        }
+    }
+
+    SECTION("missing tiles are retried and reported")
+    {
+        // nothing is served, but a missing file is 'not found', not a network error. so use an unreachable host.
+        TileLoadService height_service("http://localhost:1/height/", TileLoadService::UrlPattern::ZXY, ".png");
+        TileLoadService ortho_service("http://localhost:1/ortho/", TileLoadService::UrlPattern::ZYX_yPointingSouth, ".jpeg");
+
+        RegionSeeder seeder;
+        seeder.set_region(bounds);
+        seeder.set_zoom_range(0, 2);
+        seeder.set_max_retries(1);
+        QuadAssembler qa;
+        LayerAssembler la;
+#ifdef ALP_ENABLE_LABELS
+        la.set_vectortile_enabled(false);
+#endif
+        QSignalSpy spy_requested(&seeder, &RegionSeeder::quads_requested);
+        QObject::connect(&seeder, &RegionSeeder::quads_requested, &qa, [&](const std::vector<tile::Id>& ids) {
+            for (const auto& id : ids)
+                qa.load(id);
+        });
+        QObject::connect(&qa, &QuadAssembler::tile_requested, &la, &LayerAssembler::load);
+        QObject::connect(&la, &LayerAssembler::ortho_requested, &ortho_service, &TileLoadService::load);
+        QObject::connect(&la, &LayerAssembler::height_requested, &height_service, &TileLoadService::load);
+        QObject::connect(&ortho_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_ortho);
+        QObject::connect(&height_service, &TileLoadService::load_finished, &la, &LayerAssembler::deliver_height);
+        QObject::connect(&la, &LayerAssembler::tile_loaded, &qa, &QuadAssembler::deliver_tile);
+        QObject::connect(&qa, &QuadAssembler::quad_loaded, &seeder, &RegionSeeder::receive_quad);
+
+        QSignalSpy spy_finished(&seeder, &RegionSeeder::finished);
+        seeder.start();
+        REQUIRE(spy_finished.wait(10000));
+        CHECK(spy_requested.size() == 2);
+        const auto progress = seeder.progress();
+        CHECK(progress.n_quads_done == 0);
+        CHECK(progress.n_quads_failed == progress.n_quads_total);
+        CHECK(seeder.cache().n_cached_objects() == 0);
+    }
+}
@@ -403,6 +403,93 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         }
     }
 
+#ifndef __EMSCRIPTEN__
+    SECTION("partial quads are cached with the parent as fallback and requested again")
+    {
+        auto scheduler = default_scheduler();
+        scheduler->set_retry_age_for_partial_quads(20 * timing_multiplicator);
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 0, { 0, 0 } }));
+        auto partial_quad = example_tile_quad_for(tile::Id { 1, { 1, 1 } });
+        partial_quad.tiles[3].network_info.status = NetworkInfo::Status::NetworkError;
+        partial_quad.tiles[3].ortho = std::make_shared<QByteArray>();
+        partial_quad.tiles[3].height = std::make_shared<QByteArray>();
+#ifdef ALP_ENABLE_LABELS
+        partial_quad.tiles[3].vector_tile = std::make_shared<QByteArray>();
+#endif
+        REQUIRE(partial_quad.n_missing_tiles() == 1);
+        scheduler->receive_quad(partial_quad);
+
+        REQUIRE(scheduler->ram_cache().contains(tile::Id { 1, { 1, 1 } }));
+        {
+            const auto& cached = scheduler->ram_cache().peak_at(tile::Id { 1, { 1, 1 } });
+            CHECK(cached.n_missing_tiles() == 1);
+            CHECK(*cached.tiles[0].ortho == std::get<0>(example_tile_data()));
+            CHECK(cached.tiles[0].ortho_zoom_offset == 0);
+            // tile 3 is drawn from the parent (tile 1/1/1 of quad 0/0/0)
+            CHECK(*cached.tiles[3].ortho == std::get<0>(example_tile_data()));
+            CHECK(*cached.tiles[3].height == std::get<1>(example_tile_data()));
+            CHECK(cached.tiles[3].ortho_zoom_offset == 1);
+            CHECK(cached.tiles[3].height_zoom_offset == 1);
+        }
+
+        QSignalSpy request_spy(scheduler.get(), &Scheduler::quads_requested);
+        QSignalSpy gpu_spy(scheduler.get(), &Scheduler::gpu_quads_updated);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        {
+            REQUIRE(request_spy.size() == 1);
+            const auto quads = request_spy.constLast().constFirst().value<std::vector<tile::Id>>();
+            CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 0, { 0, 0 } }) == quads.end());
+            CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 1, { 1, 1 } }) == quads.end());
+        }
+        QThread::msleep(30 * timing_multiplicator);
+        scheduler->send_quad_requests();
+        {
+            REQUIRE(request_spy.size() == 2);
+            const auto quads = request_spy.constLast().constFirst().value<std::vector<tile::Id>>();
+            CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 0, { 0, 0 } }) == quads.end());
+            CHECK(std::find(quads.cbegin(), quads.cend(), tile::Id { 1, { 1, 1 } }) != quads.end());
+        }
+
+        scheduler->update_gpu_quads();
+        REQUIRE(gpu_spy.size() == 1);
+        {
+            const auto gpu_quads = gpu_spy[0][0].value<std::vector<GpuTileQuad>>();
+            REQUIRE(gpu_quads.size() == 2);
+            for (const auto& gpu_quad : gpu_quads) {
+                for (const auto& tile : gpu_quad.tiles) {
+                    REQUIRE(tile.ortho);
+                    REQUIRE(tile.height);
+                }
+            }
+        }
+
+        // the retry times out again, but the tiles received earlier are kept
+        auto failed_retry = example_tile_quad_for(tile::Id { 1, { 1, 1 } }, 4, NetworkInfo::Status::NetworkError);
+        failed_retry.tiles[0].network_info.status = NetworkInfo::Status::Good;
+        scheduler->receive_quad(failed_retry);
+        CHECK(scheduler->ram_cache().peak_at(tile::Id { 1, { 1, 1 } }).n_missing_tiles() == 1);
+
+        // the complete quad replaces the partial one, also on the gpu
+        scheduler->receive_quad(example_tile_quad_for(tile::Id { 1, { 1, 1 } }));
+        {
+            const auto& cached = scheduler->ram_cache().peak_at(tile::Id { 1, { 1, 1 } });
+            CHECK(cached.n_missing_tiles() == 0);
+            CHECK(cached.tiles[3].ortho_zoom_offset == 0);
+        }
+        scheduler->update_gpu_quads();
+        REQUIRE(gpu_spy.size() == 2);
+        {
+            const auto gpu_quads = gpu_spy[1][0].value<std::vector<GpuTileQuad>>();
+            const auto deleted_quads = gpu_spy[1][1].value<std::vector<tile::Id>>();
+            REQUIRE(gpu_quads.size() == 1);
+            CHECK(gpu_quads[0].id == tile::Id { 1, { 1, 1 } });
+            REQUIRE(deleted_quads.size() == 1);
+            CHECK(deleted_quads[0] == tile::Id { 1, { 1, 1 } });
+        }
+    }
+
+#endif
     SECTION("delivered quads are sent on to the gpu (with no repeat, only the ones in the tree)")
     {
         auto scheduler = default_scheduler();
@@ -775,6 +862,62 @@ TEST_CASE("nucleus/tile_scheduler/Scheduler")
         std::filesystem::remove_all(Scheduler::disk_cache_path());
     }
 
+    SECTION("seeded offline cache larger than the ram survives purging and persisting")
+    {
+        const auto offline_path = std::filesystem::temp_directory_path() / "alpine_scheduler_test_offline_cache";
+        std::filesystem::remove_all(offline_path);
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+        const auto seeded = example_quads_for_steffl_and_gg();
+        {
+            nucleus::tile_scheduler::MemoryCache cache;
+            for (const auto& q : seeded)
+                cache.insert(q);
+            REQUIRE(cache.move_to_disk(offline_path).has_value());
+        }
+
+        auto scheduler = default_scheduler();
+        const unsigned ram_limit = 5;
+        scheduler->set_ram_quad_limit(ram_limit);
+        scheduler->read_offline_cache(offline_path);
+        CHECK(scheduler->offline_cache().n_disk_cached_objects() == seeded.size());
+        CHECK(scheduler->ram_cache().n_cached_objects() == 0); // loaded lazily
+
+        QSignalSpy spy(scheduler.get(), &Scheduler::quads_requested);
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        REQUIRE(spy.size() == 1);
+        {
+            // seeded quads are served from disk instead of being requested
+            const auto requested = spy.constFirst().constFirst().value<std::vector<tile::Id>>();
+            CHECK(std::find(requested.cbegin(), requested.cend(), tile::Id { 3, { 4, 5 } }) == requested.end());
+            CHECK(std::find(requested.cbegin(), requested.cend(), tile::Id { 4, { 8, 10 } }) == requested.end());
+            CHECK(scheduler->ram_cache().contains(tile::Id { 4, { 8, 10 } }));
+        }
+        REQUIRE(scheduler->ram_cache().n_cached_objects() > ram_limit);
+
+        scheduler->update_camera(nucleus::camera::stored_positions::grossglockner());
+        scheduler->update_gpu_quads();
+        scheduler->purge_ram_cache();
+        CHECK(scheduler->ram_cache().n_cached_objects() == ram_limit);
+        CHECK(!scheduler->ram_cache().contains(tile::Id { 11, { 1117, 1337 } }));
+        scheduler->persist_tiles();
+
+        {
+            nucleus::tile_scheduler::MemoryCache offline_cache;
+            REQUIRE(offline_cache.read_from_disk(offline_path).has_value());
+            CHECK(offline_cache.n_cached_objects() == seeded.size());
+        }
+        CHECK(scheduler->offline_cache().n_disk_cached_objects() == seeded.size());
+
+        // purged quads are loaded from disk again
+        scheduler->update_camera(nucleus::camera::stored_positions::stephansdom());
+        scheduler->send_quad_requests();
+        CHECK(scheduler->ram_cache().contains(tile::Id { 11, { 1117, 1337 } }));
+
+        std::filesystem::remove_all(offline_path);
+        std::filesystem::remove_all(Scheduler::disk_cache_path());
+    }
+
     SECTION("notification, when a tile is received")
     {
         auto scheduler = default_scheduler();
@@ -209,4 +209,97 @@ TEST_CASE("nucleus/tile_scheduler/slot limiter")
         REQUIRE(spy.size() == 2);
         CHECK(spy[1][0].value<tile_types::TileQuad>().id == tile::Id { 1, { 2, 3 } });
     }
+
+    SECTION("limit is fixed unless adaptive")
+    {
+        SlotLimiter sl;
+        sl.set_limit(2);
+        CHECK(!sl.is_adaptive());
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        std::vector<tile::Id> ids;
+        for (unsigned i = 0; i < 20; ++i)
+            ids.push_back(tile::Id { i, { 0, 0 } });
+        sl.request_quads(ids);
+        for (int i = 0; i < 10; ++i)
+            sl.deliver_quad(tile_types::TileQuad { spy[i][0].value<tile::Id>() });
+        CHECK(sl.limit() == 2);
+        CHECK(sl.slots_taken() == 2);
+    }
+
+    SECTION("adaptive limit grows while saturated, up to the maximum")
+    {
+        SlotLimiter sl;
+        sl.set_limit(2);
+        sl.set_limit_range(1, 8);
+        sl.set_adaptive(true);
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        std::vector<tile::Id> ids;
+        for (unsigned i = 0; i < 100; ++i)
+            ids.push_back(tile::Id { i, { 0, 0 } });
+        sl.request_quads(ids);
+        REQUIRE(spy.size() == 2);
+
+        for (int i = 0; i < 4; ++i)
+            sl.deliver_quad(tile_types::TileQuad { spy[i][0].value<tile::Id>() });
+        CHECK(sl.limit() > 2);
+        CHECK(sl.slots_taken() == sl.limit());
+
+        for (int i = 4; i < 60; ++i)
+            sl.deliver_quad(tile_types::TileQuad { spy[i][0].value<tile::Id>() });
+        CHECK(sl.limit() == 8);
+        CHECK(sl.slots_taken() == 8);
+
+        // requests are still sent in order
+        for (int i = 0; i < spy.size(); ++i)
+            CHECK(spy[i][0].value<tile::Id>() == tile::Id { unsigned(i), { 0, 0 } });
+    }
+
+    SECTION("adaptive limit doesn't grow if the slots are not used")
+    {
+        SlotLimiter sl;
+        sl.set_limit(4);
+        sl.set_adaptive(true);
+        for (unsigned i = 0; i < 20; ++i) {
+            sl.request_quads({ tile::Id { i + 1, { 0, 0 } }, tile::Id { i + 1, { 1, 0 } } });
+            sl.deliver_quad(tile_types::TileQuad { tile::Id { i + 1, { 0, 0 } } });
+            sl.deliver_quad(tile_types::TileQuad { tile::Id { i + 1, { 1, 0 } } });
+        }
+        CHECK(sl.limit() == 4);
+        CHECK(sl.slots_taken() == 0);
+    }
+
+    SECTION("adaptive limit is halved on network errors, but only once per window and not below the minimum")
+    {
+        SlotLimiter sl;
+        sl.set_limit(8);
+        sl.set_limit_range(3, 16);
+        sl.set_adaptive(true);
+        QSignalSpy spy(&sl, &SlotLimiter::quad_requested);
+        std::vector<tile::Id> ids;
+        for (unsigned i = 0; i < 100; ++i)
+            ids.push_back(tile::Id { i, { 0, 0 } });
+        sl.request_quads(ids);
+        REQUIRE(spy.size() == 8);
+
+        const auto failed_quad = [](const tile::Id& id) {
+            tile_types::TileQuad quad { id, 4, {} };
+            quad.tiles[0].network_info = { tile_types::NetworkInfo::Status::NetworkError, 0 };
+            return quad;
+        };
+
+        sl.deliver_quad(failed_quad(spy[0][0].value<tile::Id>()));
+        CHECK(sl.limit() == 4);
+        CHECK(sl.slots_taken() == 7);
+        CHECK(spy.size() == 8);
+
+        // the other requests of the same window fail as well, but that is the same outage
+        sl.deliver_quad(failed_quad(spy[1][0].value<tile::Id>()));
+        CHECK(sl.limit() == 4);
+        CHECK(sl.slots_taken() == 6);
+
+        for (int i = 2; i < 30; ++i)
+            sl.deliver_quad(failed_quad(spy[i][0].value<tile::Id>()));
+        CHECK(sl.limit() == 3);
+        CHECK(sl.slots_taken() == 3);
+    }
 }
@@ -16,6 +16,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 #include <QBuffer>
 #include <QFile>
 #include <QImage>
@@ -26,6 +30,7 @@
 #include <nucleus/camera/Definition.h>
 
 #include "nucleus/camera/PositionStorage.h"
+#include "nucleus/tile_scheduler/BatchFrustumCuller.h"
 #include "nucleus/tile_scheduler/utils.h"
 #include "nucleus/utils/tile_conversion.h"
 #include "radix/quad_tree.h"
@@ -89,6 +94,123 @@ TEST_CASE("tile_scheduler/utils/refine_functor")
     };
 }
 
+TEST_CASE("tile_scheduler/utils/AabbDecorator")
+{
+    TileHeights heights;
+    heights.emplace({ 0, { 0, 0 } }, { 100, 4000 });
+
+    SECTION("cached aabbs equal computed ones")
+    {
+        const auto decorator = utils::AabbDecorator(heights);
+        const auto id = tile::Id { 3, { 4, 5 } };
+        CHECK(decorator.n_cached_aabbs() == 0);
+        const auto a = decorator.aabb(id);
+        CHECK(decorator.n_cached_aabbs() == 1);
+        const auto b = decorator.aabb(id);
+        CHECK(decorator.n_cached_aabbs() == 1);
+        const auto expected = utils::make_bounds(id, 100, 4000);
+        CHECK(a.min == expected.min);
+        CHECK(a.max == expected.max);
+        CHECK(b.min == expected.min);
+        CHECK(b.max == expected.max);
+    }
+
+    SECTION("cache is bounded")
+    {
+        const auto decorator = utils::AabbDecorator(heights, 10);
+        for (unsigned i = 0; i < 64; ++i) {
+            const auto id = tile::Id { 6, { i, 3 } };
+            const auto expected = utils::make_bounds(id, 100, 4000);
+            CHECK(decorator.aabb(id).max == expected.max);
+            CHECK(decorator.n_cached_aabbs() <= 10);
+        }
+        const auto uncached = utils::AabbDecorator(heights, 0);
+        CHECK(uncached.aabb({ 3, { 4, 5 } }).max == utils::make_bounds({ 3, { 4, 5 } }, 100, 4000).max);
+        CHECK(uncached.n_cached_aabbs() == 0);
+    }
+
+    SECTION("updating heights invalidates the tile and its descendants")
+    {
+        auto decorator = utils::AabbDecorator(heights);
+        const auto parent = tile::Id { 2, { 1, 1 } };
+        const auto child = tile::Id { 4, { 5, 6 } };
+        const auto other = tile::Id { 4, { 0, 0 } };
+        REQUIRE(utils::ancestor(child, 2) == parent);
+        (void)decorator.aabb(parent);
+        (void)decorator.aabb(child);
+        (void)decorator.aabb(other);
+        CHECK(decorator.n_cached_aabbs() == 3);
+
+        decorator.update_heights(parent, 200, 300);
+        CHECK(decorator.n_cached_aabbs() == 1);
+        CHECK(decorator.aabb(parent).min == utils::make_bounds(parent, 200, 300).min);
+        CHECK(decorator.aabb(parent).max == utils::make_bounds(parent, 200, 300).max);
+        CHECK(decorator.aabb(child).max == utils::make_bounds(child, 200, 300).max);
+        CHECK(decorator.aabb(other).max == utils::make_bounds(other, 100, 4000).max);
+    }
+
+#ifndef __EMSCRIPTEN__
+    SECTION("concurrent readers")
+    {
+        const auto decorator = utils::AabbDecorator(heights, 256);
+        std::vector<std::thread> threads;
+        std::atomic<unsigned> n_wrong = 0;
+        for (unsigned t = 0; t < 4; ++t) {
+            threads.emplace_back([&decorator, &n_wrong, t]() {
+                for (unsigned i = 0; i < 4000; ++i) {
+                    const auto id = tile::Id { 8, { (i * 7 + t) % 256, i % 256 } };
+                    if (decorator.aabb(id).max != utils::make_bounds(id, 100, 4000).max)
+                        ++n_wrong;
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        CHECK(n_wrong == 0);
+        CHECK(decorator.n_cached_aabbs() <= 256);
+    }
+#endif
+
+    SECTION("benchmark over a camera sweep")
+    {
+        QFile file(":/map/height_data.atb");
+        const auto open = file.open(QIODeviceBase::OpenModeFlag::ReadOnly);
+        assert(open);
+        Q_UNUSED(open);
+        const auto tile_heights = TileHeights::deserialise(file.readAll());
+
+        // flying from the grossglockner towards vienna, while turning slightly
+        std::vector<nucleus::camera::Definition> cameras;
+        auto camera = nucleus::camera::stored_positions::grossglockner();
+        camera.set_viewport_size({ 1920, 1080 });
+        const auto step = (nucleus::camera::stored_positions::wien().position() - camera.position()) / 60.0;
+        for (unsigned i = 0; i < 60; ++i) {
+            cameras.push_back(camera);
+            camera.move({ step.x, step.y, 0.0 });
+            camera.orbit(camera.position(), { 0.5, 0.0 });
+        }
+        const auto sweep = [&cameras](const utils::AabbDecoratorPtr& decorator) {
+            size_t n_tiles = 0;
+            for (const auto& camera : cameras) {
+                n_tiles += quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, utils::refineFunctor(camera, decorator, 1.0), [](const tile::Id& v) { return v.children(); }).size();
+            }
+            return n_tiles;
+        };
+        const auto cached = std::make_shared<utils::AabbDecorator>(tile_heights);
+        const auto uncached = std::make_shared<utils::AabbDecorator>(tile_heights, 0);
+        CHECK(sweep(cached) == sweep(uncached));
+
+        BENCHMARK("refine traversal, camera sweep, uncached aabbs")
+        {
+            return sweep(uncached);
+        };
+        BENCHMARK("refine traversal, camera sweep, cached aabbs")
+        {
+            return sweep(cached);
+        };
+    }
+}
+
 TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
 {
     QFile file(":/map/height_data.atb");
@@ -111,6 +233,13 @@ TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
         CHECK(nucleus::tile_scheduler::utils::camera_frustum_contains_tile(cam.frustum(), tile::SrsAndHeightBounds { { -10., -10., -10. }, { 10., 1., 10. } }));
         CHECK(!nucleus::tile_scheduler::utils::camera_frustum_contains_tile(cam.frustum(), tile::SrsAndHeightBounds { { -10., -10., -10. }, { 10., -1., 10. } }));
         CHECK(!nucleus::tile_scheduler::utils::camera_frustum_contains_tile(cam.frustum(), tile::SrsAndHeightBounds { { -10., 0., -10. }, { -9., 1., -9. } }));
+
+        const auto culler = nucleus::tile_scheduler::BatchFrustumCuller(cam.frustum());
+        CHECK(culler.contains(tile::SrsAndHeightBounds { { -1., 9., -1. }, { 1., 10., 1. } }));
+        CHECK(culler.contains(tile::SrsAndHeightBounds { { 0., 0., 0. }, { 1., 1., 1. } }));
+        CHECK(culler.contains(tile::SrsAndHeightBounds { { -10., -10., -10. }, { 10., 1., 10. } }));
+        CHECK(!culler.contains(tile::SrsAndHeightBounds { { -10., -10., -10. }, { 10., -1., 10. } }));
+        CHECK(!culler.contains(tile::SrsAndHeightBounds { { -10., 0., -10. }, { -9., 1., -9. } }));
     }
     SECTION("case 2")
     {
@@ -182,6 +311,23 @@ TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
             }
         }
 
+        for (const auto& camera : camera_positions) {
+            const auto camera_frustum = camera.frustum();
+            const auto culler = nucleus::tile_scheduler::BatchFrustumCuller(camera_frustum);
+            nucleus::tile_scheduler::AabbBatch aabbs;
+            for (const auto& tile_id : tile_ids)
+                aabbs.push_back(decorator->aabb(tile_id));
+            const auto visible = culler.cull(aabbs);
+            REQUIRE(visible.size() == tile_ids.size());
+            unsigned n_mismatches = 0;
+            for (size_t i = 0; i < tile_ids.size(); ++i) {
+                const auto expected = nucleus::tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabbs.at(i));
+                n_mismatches += unsigned(bool(visible[i]) != expected);
+                n_mismatches += unsigned(culler.contains(aabbs.at(i)) != expected);
+            }
+            CHECK(n_mismatches == 0);
+        }
+
         BENCHMARK("camera_frustum_contains_tile")
         {
             bool retval = false;
@@ -195,6 +341,48 @@ TEST_CASE("tile_scheduler/utils/camera_frustum_contains_tile")
             return retval;
         };
 
+        std::vector<nucleus::tile_scheduler::AabbBatch> aabb_batches;
+        std::vector<std::vector<tile::SrsAndHeightBounds>> aabb_lists;
+        for (size_t i = 0; i < camera_positions.size(); ++i) {
+            aabb_batches.emplace_back();
+            aabb_lists.emplace_back();
+            for (const auto& tile_id : tile_ids) {
+                aabb_batches.back().push_back(decorator->aabb(tile_id));
+                aabb_lists.back().push_back(decorator->aabb(tile_id));
+            }
+        }
+        BENCHMARK("camera_frustum_contains_tile (precomputed aabbs)")
+        {
+            unsigned n_visible = 0;
+            for (size_t i = 0; i < camera_positions.size(); ++i) {
+                const auto camera_frustum = camera_positions[i].frustum();
+                for (const auto& aabb : aabb_lists[i])
+                    n_visible += unsigned(nucleus::tile_scheduler::utils::camera_frustum_contains_tile(camera_frustum, aabb));
+            }
+            return n_visible;
+        };
+        BENCHMARK("BatchFrustumCuller::contains (precomputed aabbs)")
+        {
+            unsigned n_visible = 0;
+            for (size_t i = 0; i < camera_positions.size(); ++i) {
+                const auto culler = nucleus::tile_scheduler::BatchFrustumCuller(camera_positions[i].frustum());
+                for (const auto& aabb : aabb_lists[i])
+                    n_visible += unsigned(culler.contains(aabb));
+            }
+            return n_visible;
+        };
+        BENCHMARK("BatchFrustumCuller::cull (precomputed aabbs)")
+        {
+            unsigned n_visible = 0;
+            std::vector<uint8_t> visible;
+            for (size_t i = 0; i < camera_positions.size(); ++i) {
+                const auto culler = nucleus::tile_scheduler::BatchFrustumCuller(camera_positions[i].frustum());
+                culler.cull(aabb_batches[i], &visible);
+                n_visible += unsigned(std::count(visible.cbegin(), visible.cend(), uint8_t(1)));
+            }
+            return n_visible;
+        };
+
         BENCHMARK("camera_frustum_contains_tile_old")
         {
             bool retval = false;
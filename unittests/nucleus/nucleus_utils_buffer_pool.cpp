@@ -0,0 +1,159 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/BufferPool.h"
+
+#include <thread>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/Raster.h"
+
+using nucleus::utils::BufferPool;
+using nucleus::utils::PooledVector;
+
+TEST_CASE("nucleus/utils/BufferPool")
+{
+    SECTION("block sizes")
+    {
+        CHECK(BufferPool::block_size(100) == 100); // not pooled
+        CHECK(BufferPool::block_size(BufferPool::min_block_size) == BufferPool::min_block_size);
+        CHECK(BufferPool::block_size(BufferPool::min_block_size + 1) == BufferPool::min_block_size * 5 / 4);
+        CHECK(BufferPool::block_size(65 * 65 * 2) == 10 * 1024);
+        CHECK(BufferPool::block_size(256 * 256 * 4) == 256 * 256 * 4);
+        CHECK(BufferPool::block_size(256 * 256 * 4 + 1) == 256 * 256 * 5);
+        CHECK(BufferPool::block_size(BufferPool::max_block_size) == BufferPool::max_block_size);
+        CHECK(BufferPool::block_size(BufferPool::max_block_size + 1) == BufferPool::max_block_size + 1);
+        for (size_t n = BufferPool::min_block_size; n < 1024 * 1024; n += 997) {
+            const auto block_size = BufferPool::block_size(n);
+            CHECK(block_size >= n);
+            CHECK(block_size <= n + n / 4);
+        }
+    }
+
+    SECTION("freed blocks are reused")
+    {
+        BufferPool pool;
+        void* a = pool.allocate(100'000);
+        CHECK(reinterpret_cast<uintptr_t>(a) % BufferPool::alignment == 0);
+        CHECK(pool.statistics().n_bytes_in_use == BufferPool::block_size(100'000));
+        pool.deallocate(a, 100'000);
+        CHECK(pool.statistics().n_bytes_in_use == 0);
+        CHECK(pool.statistics().n_bytes_cached == BufferPool::block_size(100'000));
+
+        void* b = pool.allocate(99'000); // same size class
+        CHECK(b == a);
+        pool.deallocate(b, 99'000);
+
+        const auto stats = pool.statistics();
+        CHECK(stats.n_allocations == 2);
+        CHECK(stats.n_reused == 1);
+        CHECK(stats.n_bytes_peak == BufferPool::block_size(100'000));
+        CHECK(stats.reuse_rate() == 0.5);
+    }
+
+    SECTION("small and huge allocations are not pooled")
+    {
+        BufferPool pool;
+        for (const size_t n : { size_t(0), size_t(16), BufferPool::max_block_size + 1 }) {
+            void* p = pool.allocate(n);
+            CHECK(reinterpret_cast<uintptr_t>(p) % BufferPool::alignment == 0);
+            pool.deallocate(p, n);
+        }
+        CHECK(pool.statistics().n_allocations == 0);
+        CHECK(pool.statistics().n_bytes_cached == 0);
+    }
+
+    SECTION("cache is bounded")
+    {
+        BufferPool pool(3 * 64 * 1024);
+        std::vector<void*> blocks;
+        for (unsigned i = 0; i < 10; ++i)
+            blocks.push_back(pool.allocate(64 * 1024));
+        CHECK(pool.statistics().n_bytes_in_use == 10 * 64 * 1024);
+        for (void* p : blocks)
+            pool.deallocate(p, 64 * 1024);
+        CHECK(pool.statistics().n_bytes_in_use == 0);
+        CHECK(pool.statistics().n_bytes_cached == 3 * 64 * 1024);
+
+        pool.set_max_cached_bytes(64 * 1024);
+        CHECK(pool.statistics().n_bytes_cached == 64 * 1024);
+        pool.release_cached();
+        CHECK(pool.statistics().n_bytes_cached == 0);
+    }
+
+    SECTION("steady state doesn't grow")
+    {
+        BufferPool pool;
+        for (unsigned round = 0; round < 100; ++round) {
+            std::vector<void*> blocks;
+            for (const size_t n : { 65 * 65 * 2, 256 * 256 * 4, 256 * 256 / 2, 128 * 128 * 4 })
+                blocks.push_back(pool.allocate(n));
+            pool.deallocate(blocks[0], 65 * 65 * 2);
+            pool.deallocate(blocks[1], 256 * 256 * 4);
+            pool.deallocate(blocks[2], 256 * 256 / 2);
+            pool.deallocate(blocks[3], 128 * 128 * 4);
+        }
+        const auto stats = pool.statistics();
+        CHECK(stats.n_allocations == 400);
+        CHECK(stats.n_reused == 396);
+        CHECK(stats.n_bytes_peak == stats.n_bytes_cached);
+    }
+
+    SECTION("concurrent use")
+    {
+        BufferPool pool;
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 4; ++t) {
+            threads.emplace_back([&pool, t]() {
+                for (unsigned i = 0; i < 1000; ++i) {
+                    const auto n = size_t(8 * 1024) << ((i + t) % 6);
+                    auto* p = static_cast<uint8_t*>(pool.allocate(n));
+                    p[0] = p[n - 1] = uint8_t(i);
+                    pool.deallocate(p, n);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        CHECK(pool.statistics().n_allocations == 4000);
+        CHECK(pool.statistics().n_bytes_in_use == 0);
+    }
+
+    SECTION("rasters and vectors use the shared pool")
+    {
+        const auto before = BufferPool::shared().statistics();
+        {
+            const nucleus::Raster<uint16_t> raster({ 65, 65 });
+            CHECK(reinterpret_cast<uintptr_t>(raster.data()) % BufferPool::alignment == 0);
+            PooledVector<uint8_t> vector(256 * 256 * 4);
+            CHECK(BufferPool::shared().statistics().n_allocations == before.n_allocations + 2);
+        }
+        CHECK(BufferPool::shared().statistics().n_bytes_in_use == before.n_bytes_in_use);
+    }
+
+    SECTION("benchmark")
+    {
+        BENCHMARK("std::vector 256x256 rgba") { return std::vector<uint8_t>(256 * 256 * 4).data() != nullptr; };
+        BENCHMARK("PooledVector 256x256 rgba") { return PooledVector<uint8_t>(256 * 256 * 4).data() != nullptr; };
+        BENCHMARK("std::vector 65x65 uint16") { return std::vector<uint16_t>(65 * 65).data() != nullptr; };
+        BENCHMARK("PooledVector 65x65 uint16") { return PooledVector<uint16_t>(65 * 65).data() != nullptr; };
+    }
+}
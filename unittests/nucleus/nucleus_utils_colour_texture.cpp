@@ -0,0 +1,295 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/ColourTexture.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include <GoofyTC/goofy_tc.h>
+#include <QFile>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/WorkerPool.h"
+#include "nucleus/utils/image_loader.h"
+
+using nucleus::Raster;
+using nucleus::utils::ColourTexture;
+
+namespace {
+Raster<glm::u8vec4> ortho_tile()
+{
+    QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "test-tile_ortho.jpeg"));
+    const auto open = file.open(QIODevice::ReadOnly);
+    REQUIRE(open);
+    return nucleus::utils::image_loader::rgba8(file.readAll());
+}
+
+glm::u8vec4 rgb565(uint16_t c)
+{
+    const auto r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255 };
+}
+
+Raster<glm::u8vec4> decode_dxt1(const uint8_t* data, const glm::uvec2& size)
+{
+    Raster<glm::u8vec4> image(size);
+    for (unsigned by = 0; by < size.y / 4; ++by) {
+        for (unsigned bx = 0; bx < size.x / 4; ++bx) {
+            const auto* block = data + (by * (size.x / 4) + bx) * 8;
+            const auto c0 = uint16_t(block[0] | block[1] << 8);
+            const auto c1 = uint16_t(block[2] | block[3] << 8);
+            const auto a = glm::ivec4(rgb565(c0));
+            const auto b = glm::ivec4(rgb565(c1));
+            std::array<glm::u8vec4, 4> palette = { glm::u8vec4(a), glm::u8vec4(b), {}, { 0, 0, 0, 255 } };
+            if (c0 > c1) {
+                palette[2] = glm::u8vec4((2 * a + b) / 3);
+                palette[3] = glm::u8vec4((a + 2 * b) / 3);
+            } else {
+                palette[2] = glm::u8vec4((a + b) / 2);
+            }
+            const auto indices = uint32_t(block[4] | block[5] << 8 | block[6] << 16 | uint32_t(block[7]) << 24);
+            for (unsigned i = 0; i < 16; ++i)
+                image.pixel({ bx * 4 + i % 4, by * 4 + i / 4 }) = palette[(indices >> (2 * i)) & 3];
+        }
+    }
+    return image;
+}
+
+Raster<glm::u8vec4> decode_etc1(const uint8_t* data, const glm::uvec2& size)
+{
+    constexpr std::array<std::array<int, 4>, 8> modifiers = { { { 2, 8, -2, -8 }, { 5, 17, -5, -17 }, { 9, 29, -9, -29 }, { 13, 42, -13, -42 },
+        { 18, 60, -18, -60 }, { 24, 80, -24, -80 }, { 33, 106, -33, -106 }, { 47, 183, -47, -183 } } };
+    const auto bits = [](uint64_t v, unsigned first, unsigned n) { return int((v >> first) & ((1u << n) - 1)); };
+
+    Raster<glm::u8vec4> image(size);
+    for (unsigned by = 0; by < size.y / 4; ++by) {
+        for (unsigned bx = 0; bx < size.x / 4; ++bx) {
+            const auto* block = data + (by * (size.x / 4) + bx) * 8;
+            uint64_t v = 0;
+            for (unsigned i = 0; i < 8; ++i)
+                v = v << 8 | block[i];
+
+            std::array<glm::ivec3, 2> base;
+            if (bits(v, 33, 1)) {
+                const auto expand5 = [](int c) { return (c << 3) | (c >> 2); };
+                const auto delta = [](int d) { return d >= 4 ? d - 8 : d; };
+                const auto c1 = glm::ivec3(bits(v, 59, 5), bits(v, 51, 5), bits(v, 43, 5));
+                const auto c2 = c1 + glm::ivec3(delta(bits(v, 56, 3)), delta(bits(v, 48, 3)), delta(bits(v, 40, 3)));
+                base = { glm::ivec3(expand5(c1.x), expand5(c1.y), expand5(c1.z)), glm::ivec3(expand5(c2.x), expand5(c2.y), expand5(c2.z)) };
+            } else {
+                base = { glm::ivec3(bits(v, 60, 4), bits(v, 52, 4), bits(v, 44, 4)) * 17, glm::ivec3(bits(v, 56, 4), bits(v, 48, 4), bits(v, 40, 4)) * 17 };
+            }
+            const std::array<int, 2> tables = { bits(v, 37, 3), bits(v, 34, 3) };
+            const auto flip = bits(v, 32, 1);
+
+            for (unsigned x = 0; x < 4; ++x) {
+                for (unsigned y = 0; y < 4; ++y) {
+                    const auto i = x * 4 + y;
+                    const auto index = bits(v, 16 + i, 1) << 1 | bits(v, i, 1);
+                    const auto sub_block = flip ? (y >= 2) : (x >= 2);
+                    const auto colour = glm::clamp(base[sub_block] + modifiers[tables[sub_block]][index], 0, 255);
+                    image.pixel({ bx * 4 + x, by * 4 + y }) = glm::u8vec4(colour, 255);
+                }
+            }
+        }
+    }
+    return image;
+}
+
+double psnr(const Raster<glm::u8vec4>& a, const Raster<glm::u8vec4>& b)
+{
+    REQUIRE(a.size() == b.size());
+    double squared_error = 0;
+    for (size_t i = 0; i < a.buffer_length(); ++i) {
+        const auto d = glm::dvec3(a.buffer()[i]) - glm::dvec3(b.buffer()[i]); // rgb only
+        squared_error += glm::dot(d, d);
+    }
+    const auto mse = squared_error / double(a.buffer_length() * 3);
+    return 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+Raster<glm::u8vec4> decode(const ColourTexture& texture, unsigned mip_level = 0)
+{
+    const auto size = glm::uvec2(texture.width(mip_level), texture.height(mip_level));
+    const auto* data = texture.data(mip_level);
+    return texture.format() == ColourTexture::Format::DXT1 ? decode_dxt1(data, size) : decode_etc1(data, size);
+}
+
+Raster<glm::u8vec4> box_filtered(const Raster<glm::u8vec4>& image)
+{
+    Raster<glm::u8vec4> half(image.size() / 2u);
+    for (unsigned y = 0; y < half.height(); ++y) {
+        for (unsigned x = 0; x < half.width(); ++x) {
+            const auto sum = glm::uvec4(image.pixel({ 2 * x, 2 * y })) + glm::uvec4(image.pixel({ 2 * x + 1, 2 * y }))
+                + glm::uvec4(image.pixel({ 2 * x, 2 * y + 1 })) + glm::uvec4(image.pixel({ 2 * x + 1, 2 * y + 1 }));
+            half.pixel({ x, y }) = glm::u8vec4((sum + 2u) / 4u);
+        }
+    }
+    return half;
+}
+
+std::vector<uint8_t> reference_compression(const Raster<glm::u8vec4>& image, ColourTexture::Format format)
+{
+    // the whole image in one go, on one thread. goofy wants 16 byte aligned input.
+    struct alignas(16) AlignedBlock {
+        std::array<uint8_t, 16> data;
+    };
+    std::vector<AlignedBlock> aligned(image.size_in_bytes() / sizeof(AlignedBlock));
+    auto* input = reinterpret_cast<uint8_t*>(aligned.data());
+    std::copy(image.bytes(), image.bytes() + image.size_in_bytes(), input);
+
+    std::vector<uint8_t> compressed(image.width() * image.height() / 2);
+    const auto w = uint32_t(image.width()), h = uint32_t(image.height());
+    const auto result = format == ColourTexture::Format::DXT1 ? goofy::compressDXT1(compressed.data(), input, w, h, w * 4)
+                                                              : goofy::compressETC1(compressed.data(), input, w, h, w * 4);
+    REQUIRE(result == 0);
+    return compressed;
+}
+
+Raster<glm::u8vec4> tiled(const Raster<glm::u8vec4>& tile, unsigned n)
+{
+    Raster<glm::u8vec4> image(tile.size() * n);
+    for (unsigned y = 0; y < image.height(); ++y) {
+        for (unsigned x = 0; x < image.width(); ++x)
+            image.pixel({ x, y }) = tile.pixel({ x % tile.width(), y % tile.height() });
+    }
+    return image;
+}
+} // namespace
+
+TEST_CASE("nucleus/utils/WorkerPool")
+{
+    SECTION("all tasks run exactly once")
+    {
+        for (const unsigned n_threads : { 1u, 2u, 5u }) {
+            nucleus::utils::WorkerPool pool(n_threads);
+            CHECK(pool.n_threads() == n_threads);
+            for (const unsigned n_tasks : { 0u, 1u, 3u, 100u }) {
+                std::vector<std::atomic<int>> counts(n_tasks);
+                pool.parallel_for(n_tasks, [&](unsigned i) { ++counts[i]; });
+                for (const auto& count : counts)
+                    CHECK(count == 1);
+            }
+        }
+    }
+
+    SECTION("small and large jobs alternate")
+    {
+        // small jobs wake only some of the workers, the others must still join the next large job.
+        nucleus::utils::WorkerPool pool(8);
+        for (unsigned round = 0; round < 200; ++round) {
+            const unsigned n_tasks = round % 2 ? 2u : 50u;
+            std::vector<std::atomic<int>> counts(n_tasks);
+            pool.parallel_for(n_tasks, [&](unsigned i) { ++counts[i]; });
+            for (const auto& count : counts)
+                CHECK(count == 1);
+        }
+    }
+
+    SECTION("nested calls run serially")
+    {
+        nucleus::utils::WorkerPool pool(4);
+        std::atomic<unsigned> sum = 0;
+        pool.parallel_for(10, [&](unsigned i) { pool.parallel_for(3, [&](unsigned j) { sum += i * 3 + j; }); });
+        CHECK(sum == 29 * 30 / 2);
+    }
+}
+
+TEST_CASE("nucleus/utils/ColourTexture")
+{
+    const auto tile = ortho_tile();
+    REQUIRE(tile.size() == glm::uvec2(256, 256));
+
+    SECTION("parallel compression is identical to the serial encoder")
+    {
+        for (const auto format : { ColourTexture::Format::DXT1, ColourTexture::Format::ETC1 }) {
+            for (const auto& image : { tile, tiled(tile, 2) }) {
+                const auto texture = ColourTexture(image, format);
+                const auto reference = reference_compression(image, format);
+                REQUIRE(texture.n_bytes() == reference.size());
+                CHECK(std::equal(reference.begin(), reference.end(), texture.data()));
+            }
+        }
+    }
+
+    SECTION("psnr regression")
+    {
+        for (const auto format : { ColourTexture::Format::DXT1, ColourTexture::Format::ETC1 }) {
+            const auto reference = reference_compression(tile, format);
+            const auto reference_psnr = psnr(format == ColourTexture::Format::DXT1 ? decode_dxt1(reference.data(), tile.size()) : decode_etc1(reference.data(), tile.size()), tile);
+            const auto texture_psnr = psnr(decode(ColourTexture(tile, format)), tile);
+            CHECK(reference_psnr > 25.0); // guards the test decoders
+            CHECK(texture_psnr >= reference_psnr - 0.01);
+        }
+    }
+
+    SECTION("mip chain")
+    {
+        CHECK(ColourTexture::mip_chain_length({ 1, 1 }) == 1u);
+        CHECK(ColourTexture::mip_chain_length({ 256, 256 }) == 9u);
+        CHECK(ColourTexture::mip_chain_length({ 512, 128 }) == 10u);
+
+        const auto without = ColourTexture(tile, ColourTexture::Format::Uncompressed_RGBA);
+        CHECK(without.n_mip_levels() == 1u);
+
+        const auto rgba = ColourTexture(tile, ColourTexture::Format::Uncompressed_RGBA, ColourTexture::MipMaps::Full);
+        REQUIRE(rgba.n_mip_levels() == 9u);
+        CHECK(std::equal(tile.bytes(), tile.bytes() + tile.size_in_bytes(), rgba.data(0)));
+        auto reference = tile;
+        for (unsigned level = 1; level < rgba.n_mip_levels(); ++level) {
+            reference = box_filtered(reference);
+            REQUIRE(rgba.width(level) == reference.width());
+            REQUIRE(rgba.height(level) == reference.height());
+            REQUIRE(rgba.n_bytes(level) == reference.size_in_bytes());
+            CHECK(std::equal(reference.bytes(), reference.bytes() + reference.size_in_bytes(), rgba.data(level)));
+        }
+        CHECK(rgba.width(8) == 1u);
+        CHECK(rgba.height(8) == 1u);
+
+        for (const auto format : { ColourTexture::Format::DXT1, ColourTexture::Format::ETC1 }) {
+            const auto texture = ColourTexture(tile, format, ColourTexture::MipMaps::Full);
+            REQUIRE(texture.n_mip_levels() == 9u);
+            CHECK(std::equal(texture.data(0), texture.data(0) + texture.n_bytes(0), ColourTexture(tile, format).data()));
+            auto reference = tile;
+            for (unsigned level = 1; level < texture.n_mip_levels(); ++level) {
+                const auto block_size = std::max(texture.width(level), 4u) * std::max(texture.height(level), 4u) / 2;
+                CHECK(texture.n_bytes(level) == block_size); // levels below 4x4 still occupy one block
+                reference = box_filtered(reference);
+                if (reference.width() >= 4)
+                    CHECK(psnr(decode(texture, level), reference) > 25.0);
+            }
+        }
+    }
+
+    SECTION("benchmark")
+    {
+        const auto large = tiled(tile, 4);
+        BENCHMARK("serial DXT1 256x256") { return reference_compression(tile, ColourTexture::Format::DXT1); };
+        BENCHMARK("ColourTexture DXT1 256x256") { return ColourTexture(tile, ColourTexture::Format::DXT1); };
+        BENCHMARK("serial ETC1 256x256") { return reference_compression(tile, ColourTexture::Format::ETC1); };
+        BENCHMARK("ColourTexture ETC1 256x256") { return ColourTexture(tile, ColourTexture::Format::ETC1); };
+        BENCHMARK("serial DXT1 1024x1024") { return reference_compression(large, ColourTexture::Format::DXT1); };
+        BENCHMARK("ColourTexture DXT1 1024x1024") { return ColourTexture(large, ColourTexture::Format::DXT1); };
+        BENCHMARK("ColourTexture DXT1 256x256 with mip chain") { return ColourTexture(tile, ColourTexture::Format::DXT1, ColourTexture::MipMaps::Full); };
+    }
+}
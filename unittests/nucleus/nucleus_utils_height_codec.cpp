@@ -0,0 +1,104 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/height_codec.h"
+
+#include <random>
+#include <stdexcept>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/image_loader.h"
+#include "test_helpers.h"
+
+using nucleus::Raster;
+using namespace nucleus::utils;
+using test_helpers::test_file;
+
+namespace {
+Raster<uint16_t> round_trip(const Raster<uint16_t>& raster)
+{
+    const auto encoded = height_codec::encode(raster);
+    CHECK(height_codec::is_encoded(encoded));
+    return height_codec::decode(encoded);
+}
+} // namespace
+
+TEST_CASE("nucleus/utils/height_codec")
+{
+    const auto png = test_file("test-tile.png");
+    const auto heights = image_loader::height(png);
+    REQUIRE(heights.size() == glm::uvec2(64, 64));
+
+    SECTION("round trip of the test tile")
+    {
+        const auto decoded = round_trip(heights);
+        CHECK(decoded.size() == heights.size());
+        CHECK(decoded.buffer() == heights.buffer());
+    }
+
+    SECTION("smaller than the png")
+    {
+        const auto encoded = height_codec::encode(heights);
+        CHECK(encoded.size() < png.size());
+        CHECK(encoded.size() < qsizetype(heights.size_in_bytes()));
+    }
+
+    SECTION("round trip of edge cases")
+    {
+        std::mt19937 rng(42);
+        for (const auto size : { glm::uvec2(0, 0), glm::uvec2(1, 1), glm::uvec2(17, 3), glm::uvec2(65, 65) }) {
+            Raster<uint16_t> noise(size);
+            for (auto& h : noise)
+                h = uint16_t(rng());
+            CHECK(round_trip(noise).buffer() == noise.buffer());
+
+            const Raster<uint16_t> max(size, 0xFFFF);
+            CHECK(round_trip(max).buffer() == max.buffer());
+
+            Raster<uint16_t> steps(size);
+            for (unsigned i = 0; i < steps.buffer_length(); ++i)
+                steps.buffer()[i] = i % 2 ? 0 : 0xFFFF;
+            CHECK(round_trip(steps).buffer() == steps.buffer());
+        }
+    }
+
+    SECTION("image_loader::height reads both formats")
+    {
+        CHECK(image_loader::height(height_codec::encode(heights)).buffer() == heights.buffer());
+        CHECK(!height_codec::is_encoded(png));
+    }
+
+    SECTION("broken streams throw")
+    {
+        const auto encoded = height_codec::encode(heights);
+        CHECK_THROWS_AS(height_codec::decode(png), std::runtime_error);
+        CHECK_THROWS_AS(height_codec::decode(encoded.first(4)), std::runtime_error);
+        CHECK_THROWS_AS(height_codec::decode(encoded.first(encoded.size() - 1)), std::runtime_error);
+        CHECK_THROWS_AS(height_codec::decode(encoded + QByteArray(1, '\0')), std::runtime_error);
+    }
+
+    SECTION("benchmark")
+    {
+        const auto encoded = height_codec::encode(heights);
+        BENCHMARK("decode png") { return image_loader::height(png); };
+        BENCHMARK("decode native") { return height_codec::decode(encoded); };
+        BENCHMARK("encode native") { return height_codec::encode(heights); };
+    }
+}
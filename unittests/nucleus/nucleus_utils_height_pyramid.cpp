@@ -0,0 +1,59 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/HeightPyramid.h"
+
+#include <algorithm>
+#include <random>
+
+#include <catch2/catch_test_macros.hpp>
+
+TEST_CASE("nucleus/utils/HeightPyramid")
+{
+    nucleus::Raster<uint16_t> heights({ 6u, 4u });
+    std::mt19937 rng(42);
+    for (auto& h : heights)
+        h = uint16_t(rng() % 1000);
+    const nucleus::utils::HeightPyramid pyramid(heights);
+
+    CHECK(pyramid.n_cells() == glm::uvec2(5, 3));
+    REQUIRE(pyramid.n_levels() == 4); // 5x3, 3x2, 2x1, 1x1
+    CHECK(pyramid.level(1).size() == glm::uvec2(3, 2));
+    CHECK(pyramid.level(2).size() == glm::uvec2(2, 1));
+    CHECK(pyramid.level(3).size() == glm::uvec2(1, 1));
+    CHECK(pyramid.min_max() == glm::u16vec2(*std::min_element(heights.begin(), heights.end()), *std::max_element(heights.begin(), heights.end())));
+
+    for (unsigned level = 0; level < pyramid.n_levels(); ++level) {
+        const auto& raster = pyramid.level(level);
+        for (unsigned y = 0; y < raster.height(); ++y) {
+            for (unsigned x = 0; x < raster.width(); ++x) {
+                // samples covered by the entry
+                const auto first = glm::uvec2(x, y) << level;
+                const auto last = glm::min((glm::uvec2(x, y) + 1u) << level, pyramid.n_cells());
+                auto expected = glm::u16vec2(uint16_t(-1), 0);
+                for (unsigned sy = first.y; sy <= last.y; ++sy) {
+                    for (unsigned sx = first.x; sx <= last.x; ++sx) {
+                        const auto h = heights.pixel({ sx, sy });
+                        expected = { std::min(expected.x, h), std::max(expected.y, h) };
+                    }
+                }
+                CHECK(raster.pixel({ x, y }) == expected);
+            }
+        }
+    }
+}
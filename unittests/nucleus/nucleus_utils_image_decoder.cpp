@@ -0,0 +1,139 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/image_decoder.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#include <QDebug>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include "test_helpers.h"
+
+using namespace nucleus::utils;
+using test_helpers::test_file;
+
+namespace {
+std::span<const uint8_t> as_span(const QByteArray& bytes) { return { reinterpret_cast<const uint8_t*>(bytes.constData()), size_t(bytes.size()) }; }
+
+double mean_absolute_difference(const image_decoder::Image& a, const image_decoder::Image& b)
+{
+    REQUIRE(a.n_bytes() == b.n_bytes());
+    double sum = 0;
+    for (size_t i = 0; i < a.n_bytes(); ++i)
+        sum += std::abs(int(a.pixels[i]) - int(b.pixels[i]));
+    return sum / double(a.n_bytes());
+}
+} // namespace
+
+TEST_CASE("nucleus/utils/image_decoder")
+{
+    const auto png = test_file("test-tile.png");
+    const auto jpeg = test_file("test-tile_ortho.jpeg");
+
+    SECTION("format detection")
+    {
+        CHECK(image_decoder::format_of(as_span(png)) == image_decoder::Format::Png);
+        CHECK(image_decoder::format_of(as_span(jpeg)) == image_decoder::Format::Jpeg);
+        CHECK(image_decoder::format_of(as_span(QByteArray("not an image"))) == image_decoder::Format::Unknown);
+        CHECK(image_decoder::format_of({}) == image_decoder::Format::Unknown);
+    }
+
+    SECTION("registry")
+    {
+        const auto& decoders = image_decoder::decoders();
+        REQUIRE(!decoders.empty());
+        CHECK(decoders.back() == &image_decoder::backend::stb());
+        CHECK(&image_decoder::decoder_for(image_decoder::Format::Unknown) == &image_decoder::backend::stb());
+        CHECK(image_decoder::decoder_for(image_decoder::Format::Png).handles(image_decoder::Format::Png));
+        CHECK(image_decoder::decoder_for(image_decoder::Format::Jpeg).handles(image_decoder::Format::Jpeg));
+    }
+
+    SECTION("all backends agree with stb")
+    {
+        const auto& stb = image_decoder::backend::stb();
+        const auto stb_png = stb.decode(as_span(png), 0);
+        const auto stb_png_rgba = stb.decode(as_span(png), 4);
+        const auto stb_jpeg = stb.decode(as_span(jpeg), 4);
+        CHECK(stb_png.size == glm::uvec2(64, 64));
+        CHECK(stb_png.n_channels == 3);
+        CHECK(stb_jpeg.size == glm::uvec2(256, 256));
+        CHECK(stb_jpeg.n_channels == 4);
+
+        for (const auto* decoder : image_decoder::decoders()) {
+            INFO(std::string(decoder->name()));
+            if (decoder->handles(image_decoder::Format::Png)) {
+                const auto image = decoder->decode(as_span(png), 0);
+                CHECK(image.size == stb_png.size);
+                CHECK(image.n_channels == stb_png.n_channels);
+                CHECK(mean_absolute_difference(image, stb_png) == 0); // png is lossless
+
+                const auto rgba = decoder->decode(as_span(png), 4);
+                CHECK(mean_absolute_difference(rgba, stb_png_rgba) == 0);
+                CHECK(rgba.pixels[3] == 255);
+            }
+            if (decoder->handles(image_decoder::Format::Jpeg)) {
+                const auto image = decoder->decode(as_span(jpeg), 4);
+                CHECK(image.size == stb_jpeg.size);
+                CHECK(image.n_channels == 4);
+                // idct and chroma upsampling differ slightly between implementations
+                CHECK(mean_absolute_difference(image, stb_jpeg) < 2.0);
+                CHECK(image.pixels[3] == 255);
+            }
+            CHECK_THROWS_AS(decoder->decode(as_span(QByteArray(100, 'x')), 4), std::runtime_error);
+        }
+    }
+
+    SECTION("benchmark")
+    {
+        for (const auto* decoder : image_decoder::decoders()) {
+            const auto name = std::string(decoder->name());
+            if (decoder->handles(image_decoder::Format::Png)) {
+                BENCHMARK(name + ": test-tile.png (height)") { return decoder->decode(as_span(png), 0); };
+            }
+            if (decoder->handles(image_decoder::Format::Jpeg)) {
+                BENCHMARK(name + ": test-tile_ortho.jpeg (ortho, rgba)") { return decoder->decode(as_span(jpeg), 4); };
+            }
+        }
+    }
+}
+
+// reports decoded MB/s for each backend. hidden, run with `unittests_nucleus "[decode_throughput]"`
+TEST_CASE("nucleus/utils/image_decoder/throughput", "[.][decode_throughput]")
+{
+    constexpr auto n_runs = 500;
+    for (const auto* name : { "test-tile.png", "test-tile_ortho.jpeg" }) {
+        const auto bytes = test_file(name);
+        const auto format = image_decoder::format_of(as_span(bytes));
+        for (const auto* decoder : image_decoder::decoders()) {
+            if (!decoder->handles(format))
+                continue;
+            size_t n_decoded_bytes = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < n_runs; ++i)
+                n_decoded_bytes += decoder->decode(as_span(bytes), 0).n_bytes();
+            const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            qDebug("%s, %s: %.1f MB/s decoded, %.1f MB/s compressed", name, decoder->name().data(), double(n_decoded_bytes) / seconds / 1e6,
+                double(bytes.size()) * n_runs / seconds / 1e6);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/LruCache.h"
+
+#include <memory>
+#include <string>
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "nucleus/utils/DecodedTileCache.h"
+
+using nucleus::utils::DecodedTileCache;
+using nucleus::utils::LruCache;
+
+TEST_CASE("nucleus/utils/LruCache")
+{
+    LruCache<int, std::string> cache(3);
+    CHECK(cache.capacity() == 3);
+    CHECK(cache.size() == 0);
+    CHECK(cache.get(1) == nullptr);
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    cache.put(3, "three");
+    CHECK(cache.size() == 3);
+    REQUIRE(cache.get(1));
+    CHECK(*cache.get(1) == "one");
+
+    SECTION("least recently used entry is evicted")
+    {
+        cache.put(4, "four"); // 2 is the least recently used, 1 was just read
+        CHECK(cache.size() == 3);
+        CHECK(!cache.contains(2));
+        CHECK(cache.contains(1));
+        CHECK(cache.contains(3));
+        CHECK(cache.contains(4));
+    }
+
+    SECTION("put replaces and refreshes")
+    {
+        cache.put(2, "zwei");
+        cache.put(4, "four"); // 3 is the least recently used now
+        CHECK(!cache.contains(3));
+        REQUIRE(cache.get(2));
+        CHECK(*cache.get(2) == "zwei");
+    }
+
+    SECTION("clear")
+    {
+        cache.clear();
+        CHECK(cache.size() == 0);
+        CHECK(!cache.contains(1));
+        cache.put(5, "five");
+        CHECK(cache.size() == 1);
+    }
+}
+
+TEST_CASE("nucleus/utils/DecodedTileCache")
+{
+    DecodedTileCache<qsizetype> cache(1);
+    unsigned n_decodes = 0;
+    const auto decode = [&](const QByteArray& bytes) {
+        ++n_decodes;
+        return bytes.size();
+    };
+    auto a = std::make_shared<QByteArray>("abc");
+    const auto b = std::make_shared<QByteArray>("de");
+
+    CHECK(*cache.get(a, decode) == 3);
+    CHECK(*cache.get(a, decode) == 3);
+    CHECK(n_decodes == 1);
+
+    // evicts a
+    CHECK(*cache.get(b, decode) == 2);
+    CHECK(*cache.get(a, decode) == 3);
+    CHECK(n_decodes == 3);
+
+    // entries keep their bytes alive, so the address can't be reused while cached
+    const std::weak_ptr<QByteArray> weak_a = a;
+    a.reset();
+    CHECK(!weak_a.expired());
+}
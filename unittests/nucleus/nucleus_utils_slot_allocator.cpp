@@ -0,0 +1,191 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/SlotAllocator.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using nucleus::utils::SlotAllocator;
+using nucleus::utils::TileSlotAllocator;
+
+TEST_CASE("nucleus/utils/SlotAllocator")
+{
+    SECTION("fresh allocator hands out ascending slots")
+    {
+        SlotAllocator a(4);
+        CHECK(a.capacity() == 4);
+        CHECK(a.n_free() == 4);
+        CHECK(a.allocate() == 0u);
+        CHECK(a.allocate() == 1u);
+        CHECK(a.allocate() == 2u);
+        CHECK(a.allocate() == 3u);
+        CHECK(!a.allocate().has_value());
+        CHECK(a.n_used() == 4);
+        CHECK(a.n_free() == 0);
+    }
+
+    SECTION("freed slots are reused")
+    {
+        SlotAllocator a(4);
+        for (unsigned i = 0; i < 4; ++i)
+            (void)a.allocate();
+        CHECK(a.free(2));
+        CHECK(!a.free(2));
+        CHECK(!a.is_used(2));
+        CHECK(a.allocate() == 2u);
+        CHECK(a.is_used(2));
+    }
+
+    SECTION("allocate a specific slot")
+    {
+        SlotAllocator a(8);
+        CHECK(a.allocate(5));
+        CHECK(!a.allocate(5));
+        CHECK(a.is_used(5));
+        CHECK(a.n_used() == 1);
+        for (unsigned i = 0; i < 7; ++i) {
+            const auto slot = a.allocate();
+            REQUIRE(slot.has_value());
+            CHECK(*slot != 5);
+        }
+        CHECK(!a.allocate().has_value());
+    }
+
+    SECTION("batch allocate and free")
+    {
+        SlotAllocator a(10);
+        const auto slots = a.allocate_n(6);
+        REQUIRE(slots.size() == 6);
+        CHECK(a.n_used() == 6);
+        CHECK(a.allocate_n(5).empty());
+        CHECK(a.n_used() == 6);
+
+        a.free(std::span(slots).subspan(0, 3));
+        CHECK(a.n_used() == 3);
+        auto used = a.used_slots();
+        std::sort(used.begin(), used.end());
+        CHECK(used == std::vector<unsigned> { slots[3], slots[4], slots[5] });
+
+        a.clear();
+        CHECK(a.n_used() == 0);
+        CHECK(a.allocate() == 0u);
+    }
+
+    SECTION("statistics")
+    {
+        SlotAllocator a(16);
+        CHECK(a.statistics().fragmentation() == 0.0f);
+        for (unsigned i = 0; i < 8; ++i)
+            (void)a.allocate();
+        a.free(1);
+        a.free(3);
+        const auto stats = a.statistics();
+        CHECK(stats.n_used == 6);
+        CHECK(stats.capacity == 16);
+        CHECK(stats.high_water_mark == 8);
+        CHECK(stats.n_holes == 2);
+        CHECK(stats.fragmentation() == 0.25f);
+    }
+}
+
+TEST_CASE("nucleus/utils/TileSlotAllocator")
+{
+    const tile::Id a = { 10, { 5, 7 } };
+    const tile::Id b = { 11, { 10, 14 } };
+    const tile::Id c = { 11, { 11, 14 } };
+
+    SECTION("slots are stable")
+    {
+        TileSlotAllocator allocator(2);
+        const auto slot_a = allocator.allocate(a);
+        const auto slot_b = allocator.allocate(b);
+        REQUIRE(slot_a.has_value());
+        REQUIRE(slot_b.has_value());
+        CHECK(slot_a != slot_b);
+        CHECK(allocator.allocate(a) == slot_a);
+        CHECK(!allocator.allocate(c).has_value());
+        CHECK(allocator.slot(b) == slot_b);
+        CHECK(allocator.tile_at(*slot_a) == a);
+
+        CHECK(allocator.free(a) == slot_a);
+        CHECK(!allocator.free(a).has_value());
+        CHECK(!allocator.contains(a));
+        CHECK(!allocator.tile_at(*slot_a).has_value());
+        CHECK(allocator.slot(b) == slot_b);
+        CHECK(allocator.allocate(c) == slot_a);
+        CHECK(allocator.tile_at(*slot_a) == c);
+    }
+
+    SECTION("batch")
+    {
+        TileSlotAllocator allocator(2);
+        const std::vector<tile::Id> ids = { a, b, c };
+        const auto slots = allocator.allocate(ids);
+        REQUIRE(slots.size() == 3);
+        CHECK(slots[0].has_value());
+        CHECK(slots[1].has_value());
+        CHECK(!slots[2].has_value());
+        CHECK(allocator.n_used() == 2);
+
+        const auto freed = allocator.free(ids);
+        CHECK(freed[0] == slots[0]);
+        CHECK(freed[1] == slots[1]);
+        CHECK(!freed[2].has_value());
+        CHECK(allocator.n_used() == 0);
+        CHECK(allocator.statistics().n_holes == 0);
+    }
+
+    SECTION("benchmark")
+    {
+        // churn on a nearly full texture array, compared to the linear scan it replaces
+        constexpr unsigned capacity = 2048;
+        std::mt19937 rng(42);
+        std::vector<unsigned> to_free(capacity);
+        for (auto& slot : to_free)
+            slot = std::uniform_int_distribution<unsigned>(0, capacity - 1)(rng);
+
+        BENCHMARK("SlotAllocator free + allocate")
+        {
+            SlotAllocator allocator(capacity);
+            (void)allocator.allocate_n(capacity);
+            unsigned sum = 0;
+            for (const auto slot : to_free) {
+                allocator.free(slot);
+                sum += *allocator.allocate();
+            }
+            return sum;
+        };
+        BENCHMARK("std::vector<bool> + std::find free + allocate")
+        {
+            std::vector<bool> used(capacity, true);
+            unsigned sum = 0;
+            for (const auto slot : to_free) {
+                used[slot] = false;
+                const auto found = unsigned(std::find(used.begin(), used.end(), false) - used.begin());
+                used[found] = true;
+                sum += found;
+            }
+            return sum;
+        };
+    }
+}
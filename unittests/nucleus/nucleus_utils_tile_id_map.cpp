@@ -0,0 +1,232 @@
+/*****************************************************************************
+ * Alpine Terrain Renderer
+ * Copyright (C) 2024 alpinemaps.org
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *****************************************************************************/
+
+#include "nucleus/utils/TileIdMap.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+using nucleus::utils::TileIdMap;
+using nucleus::utils::TileIdSet;
+
+namespace {
+std::vector<tile::Id> tile_ids(unsigned n_per_zoom_level, unsigned seed)
+{
+    // unique ids, n_per_zoom_level on each zoom level from 8 to 17
+    std::mt19937 rng(seed);
+    std::unordered_set<tile::Id, tile::Id::Hasher> ids;
+    for (unsigned z = 8; z < 18; ++z) {
+        std::uniform_int_distribution<unsigned> coord(0, (1u << z) - 1);
+        const auto target_size = ids.size() + n_per_zoom_level;
+        while (ids.size() < target_size)
+            ids.insert({ z, { coord(rng), coord(rng) } });
+    }
+    return { ids.cbegin(), ids.cend() };
+}
+} // namespace
+
+TEST_CASE("nucleus/utils/TileIdMap")
+{
+    SECTION("morton key")
+    {
+        using nucleus::utils::morton_key;
+        CHECK(morton_key({ 0, { 0, 0 } }) == 0);
+        CHECK(morton_key({ 1, { 1, 0 } }) == ((1ull << 57) | 1));
+        CHECK(morton_key({ 1, { 0, 1 } }) == ((1ull << 57) | 2));
+        CHECK(morton_key({ 3, { 5, 3 } }) == ((3ull << 57) | 0b011011));
+        CHECK(morton_key({ 3, { 5, 3 }, tile::Scheme::Tms }) != morton_key({ 3, { 5, 3 }, tile::Scheme::SlippyMap }));
+    }
+
+    SECTION("behaves like std::unordered_map under random operations")
+    {
+        std::mt19937 rng(42);
+        std::uniform_int_distribution<unsigned> coord(0, 63);
+        std::uniform_int_distribution<unsigned> zoom(10, 15);
+        TileIdMap<std::string> map;
+        std::unordered_map<tile::Id, std::string, tile::Id::Hasher> reference;
+        for (int i = 0; i < 100'000; ++i) {
+            const auto id = tile::Id { zoom(rng), { coord(rng), coord(rng) } };
+            switch (rng() % 4) {
+            case 0:
+            case 1:
+                map[id] = std::to_string(i);
+                reference[id] = std::to_string(i);
+                break;
+            case 2:
+                REQUIRE(map.erase(id) == reference.erase(id));
+                break;
+            default: {
+                const auto iter = map.find(id);
+                const auto reference_iter = reference.find(id);
+                REQUIRE((iter == map.end()) == (reference_iter == reference.end()));
+                if (iter != map.end())
+                    REQUIRE(iter->second == reference_iter->second);
+            }
+            }
+            REQUIRE(map.size() == reference.size());
+        }
+        size_t n_iterated = 0;
+        for (const auto& [id, value] : map) {
+            CHECK(reference.at(id) == value);
+            ++n_iterated;
+        }
+        CHECK(n_iterated == reference.size());
+    }
+
+    SECTION("copy, move and clear")
+    {
+        TileIdMap<int> map;
+        for (const auto& id : tile_ids(100, 1))
+            map[id] = int(id.zoom_level);
+        const auto size = map.size();
+
+        auto copy = map;
+        CHECK(copy.size() == size);
+        CHECK(std::all_of(map.cbegin(), map.cend(), [&](const auto& entry) { return copy.at(entry.first) == entry.second; }));
+
+        const auto moved = std::move(copy);
+        CHECK(moved.size() == size);
+
+        const auto capacity = map.capacity();
+        map.clear();
+        CHECK(map.empty());
+        CHECK(map.begin() == map.end());
+        CHECK(map.capacity() == capacity);
+        CHECK(!map.contains(moved.begin()->first));
+    }
+
+    SECTION("erasing while iterating, erase_if")
+    {
+        TileIdMap<unsigned> map;
+        for (const auto& id : tile_ids(200, 2))
+            map[id] = id.zoom_level;
+        for (auto iter = map.begin(); iter != map.end();) {
+            if (iter->second % 2)
+                iter = map.erase(iter);
+            else
+                ++iter;
+        }
+        CHECK(std::none_of(map.cbegin(), map.cend(), [](const auto& entry) { return entry.second % 2; }));
+        CHECK(map.size() == 5 * 200);
+
+        const auto n_erased = nucleus::utils::erase_if(map, [](const auto& entry) { return entry.second < 12; });
+        CHECK(n_erased == 2 * 200);
+        CHECK(map.size() == 3 * 200);
+    }
+
+    SECTION("many erasures don't grow the table")
+    {
+        TileIdMap<int> map;
+        map.reserve(1000);
+        const auto capacity = map.capacity();
+        const auto ids = tile_ids(1000, 3);
+        for (const auto& id : ids) {
+            map[id] = 1;
+            map.erase(id);
+        }
+        CHECK(map.empty());
+        CHECK(map.capacity() == capacity);
+    }
+
+    SECTION("set")
+    {
+        const auto ids = tile_ids(100, 4);
+        TileIdSet set(ids.cbegin(), ids.cend());
+        const auto reference = std::unordered_set<tile::Id, tile::Id::Hasher>(ids.cbegin(), ids.cend());
+        CHECK(set.size() == reference.size());
+        for (const auto& id : ids)
+            CHECK(set.contains(id));
+        CHECK(!set.insert(ids.front()).second);
+        CHECK(set.erase(ids.front()) == 1);
+        CHECK(!set.contains(ids.front()));
+        const auto as_vector = std::vector<tile::Id>(set.cbegin(), set.cend());
+        CHECK(as_vector.size() == set.size());
+    }
+}
+
+TEST_CASE("nucleus/utils/TileIdMap benchmarks")
+{
+    // lookups in random order, so that the node based map doesn't profit from allocating its nodes in insertion order
+    const auto ids = tile_ids(10'000, 5);
+    auto shuffled_ids = ids;
+    std::shuffle(shuffled_ids.begin(), shuffled_ids.end(), std::mt19937(6));
+
+    BENCHMARK("std::unordered_map insert")
+    {
+        std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> map;
+        for (const auto& id : ids)
+            map[id] = id.coords.x;
+        return map.size();
+    };
+    BENCHMARK("TileIdMap insert")
+    {
+        TileIdMap<uint64_t> map;
+        for (const auto& id : ids)
+            map[id] = id.coords.x;
+        return map.size();
+    };
+
+    std::unordered_map<tile::Id, uint64_t, tile::Id::Hasher> std_map;
+    TileIdMap<uint64_t> flat_map;
+    for (const auto& id : ids) {
+        std_map[id] = id.coords.x;
+        flat_map[id] = id.coords.x;
+    }
+    BENCHMARK("std::unordered_map find")
+    {
+        uint64_t sum = 0;
+        for (const auto& id : shuffled_ids)
+            sum += std_map.find(id)->second;
+        return sum;
+    };
+    BENCHMARK("TileIdMap find")
+    {
+        uint64_t sum = 0;
+        for (const auto& id : shuffled_ids)
+            sum += flat_map.find(id)->second;
+        return sum;
+    };
+
+    BENCHMARK("std::unordered_set insert and erase (in flight tiles)")
+    {
+        std::unordered_set<tile::Id, tile::Id::Hasher> set;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            set.insert(ids[i]);
+            if (i >= 64)
+                set.erase(ids[i - 64]);
+        }
+        return set.size();
+    };
+    BENCHMARK("TileIdSet insert and erase (in flight tiles)")
+    {
+        TileIdSet set;
+        for (size_t i = 0; i < ids.size(); ++i) {
+            set.insert(ids[i]);
+            if (i >= 64)
+                set.erase(ids[i - 64]);
+        }
+        return set.size();
+    };
+}
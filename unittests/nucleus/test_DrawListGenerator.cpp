@@ -17,6 +17,9 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+#include <unordered_set>
+
 #include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
@@ -126,16 +129,93 @@ TEST_CASE("nucleus/tile_scheduler/DrawListGenerator benchmark")
         draw_list_generator.add_tile(id);
     }
 
+    std::unordered_set<tile::Id, tile::Id::Hasher> available_tiles(all_inner_nodes.cbegin(), all_inner_nodes.cend());
+    const auto full_traversal = [&](const nucleus::camera::Definition& camera) {
+        const auto refine = nucleus::tile_scheduler::utils::refineFunctor(camera, decorator, 2.0);
+        const auto draw_refine = [&](const tile::Id& tile) {
+            for (const auto& child : tile.children()) {
+                if (!available_tiles.contains(child))
+                    return false;
+            }
+            return refine(tile);
+        };
+        auto leaves = quad_tree::onTheFlyTraverse(tile::Id { 0, { 0, 0 } }, draw_refine, [](const tile::Id& v) { return v.children(); });
+        std::sort(leaves.begin(), leaves.end(), nucleus::tile_scheduler::DrawListGenerator::IdLess());
+        return leaves;
+    };
+
+    // a sweep with small steps (translation only) and occasional turns
+    std::vector<nucleus::camera::Definition> sweep;
+    for (auto camera : camera_positions) {
+        camera.set_viewport_size({ 1920, 1080 });
+        for (unsigned i = 0; i < 20; ++i) {
+            sweep.push_back(camera);
+            camera.move(camera.x_axis() * 20.0 + camera.z_axis() * -30.0);
+            if (i % 5 == 4)
+                camera.orbit(camera.position(), { 1.0, 0.0 });
+        }
+    }
+
+    SECTION("incremental result equals a full traversal")
+    {
+        for (const auto& camera : sweep) {
+            const auto& list = draw_list_generator.generate_for(camera);
+            const auto expected = full_traversal(camera);
+            REQUIRE(list.ids() == expected);
+        }
+        // removing and adding tiles
+        const auto& camera = sweep.back();
+        const auto list = draw_list_generator.generate_for(camera);
+        REQUIRE(!list.empty());
+        const auto removed = *std::max_element(list.begin(), list.end(), [](const auto& a, const auto& b) { return a.zoom_level < b.zoom_level; });
+        REQUIRE(removed.zoom_level > 0);
+        draw_list_generator.remove_tile(removed);
+        available_tiles.erase(removed);
+        CHECK(draw_list_generator.generate_for(camera).ids() == full_traversal(camera));
+        draw_list_generator.add_tile(removed);
+        available_tiles.insert(removed);
+        CHECK(draw_list_generator.generate_for(camera).ids() == full_traversal(camera));
+    }
+
+    SECTION("work scales with change")
+    {
+        auto camera = sweep.front();
+        const auto n_tiles = draw_list_generator.generate_for(camera).size();
+        const auto n_initial_evaluations = draw_list_generator.n_evaluated_tiles();
+        CHECK(n_initial_evaluations >= n_tiles);
+
+        (void)draw_list_generator.generate_for(camera);
+        CHECK(draw_list_generator.n_evaluated_tiles() == 0);
+
+        camera.move(camera.x_axis() * 1.0);
+        CHECK(draw_list_generator.generate_for(camera).ids() == full_traversal(camera));
+        CHECK(draw_list_generator.n_evaluated_tiles() < n_initial_evaluations / 4);
+    }
+
     BENCHMARK("generate_for")
     {
-        nucleus::tile_scheduler::DrawListGenerator::TileSet set;
+        size_t n = 0;
         for (const auto &camera_position : camera_positions) {
-            const auto list = draw_list_generator.generate_for(camera_position);
-            set.reserve(set.size() + list.size());
-            for (const auto &id : list) {
-                set.insert(id);
-            }
+            n += draw_list_generator.generate_for(camera_position).size();
+        }
+        return n;
+    };
+
+    BENCHMARK("generate_for, camera sweep (incremental)")
+    {
+        size_t n = 0;
+        for (const auto& camera : sweep)
+            n += draw_list_generator.generate_for(camera).size();
+        return n;
+    };
+
+    BENCHMARK("generate_for, camera sweep (reset every frame)")
+    {
+        size_t n = 0;
+        for (const auto& camera : sweep) {
+            draw_list_generator.set_permissible_screen_space_error(2.0);
+            n += draw_list_generator.generate_for(camera).size();
         }
-        return set;
+        return n;
     };
 }
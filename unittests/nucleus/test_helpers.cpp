@@ -21,6 +21,10 @@
 
 #include <QImage>
 #include <QBuffer>
+#include <QFile>
+
+#include "nucleus/Raster.h"
+#include "nucleus/utils/height_codec.h"
 
 namespace test_helpers {
 
@@ -46,4 +50,37 @@ QByteArray black_png_tile(unsigned size)
     return arr;
 }
 
+QByteArray test_file(const char* name)
+{
+    QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, name));
+    const auto open = file.open(QIODevice::ReadOnly);
+    REQUIRE(open);
+    return file.readAll();
+}
+
+QByteArray ramp_tile(unsigned size)
+{
+    nucleus::Raster<uint16_t> heights({ size, size });
+    for (unsigned y = 0; y < size; ++y) {
+        for (unsigned x = 0; x < size; ++x)
+            heights.pixel({ x, y }) = uint16_t((x + y * 100) * 8);
+    }
+    return nucleus::utils::height_codec::encode(heights);
+}
+
+nucleus::tile_scheduler::tile_types::TileQuad quad_with_heights(const tile::Id& id, const QByteArray& heights)
+{
+    using namespace nucleus::tile_scheduler;
+    tile_types::TileQuad quad;
+    quad.id = id;
+    quad.n_tiles = 4;
+    const auto children = id.children();
+    for (unsigned i = 0; i < 4; ++i) {
+        quad.tiles[i].id = children[i];
+        quad.tiles[i].height = std::make_shared<QByteArray>(heights);
+        quad.tiles[i].network_info.status = tile_types::NetworkInfo::Status::Good;
+    }
+    return quad;
+}
+
 }
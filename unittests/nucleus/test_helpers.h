@@ -24,10 +24,13 @@
 
 #include <glm/glm.hpp>
 
+#include <QByteArray>
 #include <QObject>
 #include <QSignalSpy>
 #include <QTimer>
 
+#include "nucleus/tile_scheduler/tile_types.h"
+
 using Catch::Approx;
 
 namespace test_helpers {
@@ -36,6 +39,15 @@ QByteArray white_jpeg_tile(unsigned int size);
 
 QByteArray black_png_tile(unsigned size);
 
+/// contents of a file in the test data directory
+QByteArray test_file(const char* name);
+
+/// height tile (height_codec) rising by one metre per sample to the east (x) and by 100 metres per sample to the south (rows)
+QByteArray ramp_tile(unsigned size);
+
+/// quad with the same heights in all four tiles
+nucleus::tile_scheduler::tile_types::TileQuad quad_with_heights(const tile::Id& id, const QByteArray& heights);
+
 class FailOnCopy {
     int v = 0;
 
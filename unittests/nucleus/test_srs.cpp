@@ -119,6 +119,20 @@ TEST_CASE("nucleus/srs")
         }
     }
 
+    SECTION("world to tile id")
+    {
+        constexpr auto b = 20037508.3427892;
+        CHECK(world_to_tile_id({ 0.0, 0.0 }, 0) == tile::Id { 0, { 0, 0 } });
+        CHECK(world_to_tile_id({ -b, -b }, 1) == tile::Id { 1, { 0, 0 } });
+        CHECK(world_to_tile_id({ -1.0, 1.0 }, 1) == tile::Id { 1, { 0, 1 } });
+        CHECK(world_to_tile_id({ 1.0, -1.0 }, 1) == tile::Id { 1, { 1, 0 } });
+        CHECK(world_to_tile_id({ 2 * b, 2 * b }, 3) == tile::Id { 3, { 7, 7 } }); // clamped
+        const auto id = tile::Id { 16, { 34420, 42241 } };
+        const auto bounds = tile_bounds(id);
+        CHECK(world_to_tile_id(bounds.min + bounds.size() * 0.5, 16) == id);
+        CHECK(world_to_tile_id(bounds.min + bounds.size() * 0.5, 10) == tile::Id { 10, { 34420 / 64, 42241 / 64 } });
+    }
+
     SECTION("overlap")
     {
         CHECK(overlap(tile::Id { .zoom_level = 0, .coords = { 0, 0 } }, tile::Id { .zoom_level = 0, .coords = { 0, 0 } }));
@@ -17,12 +17,18 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <algorithm>
+
 #include <QFile>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include "nucleus/utils/image_loader.h"
 #include "nucleus/utils/tile_conversion.h"
 #include "nucleus/stb/stb_image_loader.h"
+#include "test_helpers.h"
+
+using test_helpers::test_file;
 
 namespace {
 auto check_alpine_raster_format_for(const glm::u8vec4& v)
@@ -113,4 +119,88 @@ TEST_CASE("nucleus/utils/tile_conversion")
         CHECK(u16_raster.buffer()[0] == 23 * 256 + 216);
         CHECK(u16_raster.buffer()[1] == 22 * 256 + 33);
     }
+
+    SECTION("cut out descendant from ancestor height")
+    {
+        // linear ramp: cutting out and upsampling a sub tile must yield the same ramp, restricted to the sub tile
+        nucleus::Raster<uint16_t> ancestor({ 65, 65 });
+        for (unsigned y = 0; y < 65; ++y) {
+            for (unsigned x = 0; x < 65; ++x)
+                ancestor.pixel({ x, y }) = uint16_t(x * 2 + y * 200);
+        }
+        // tms: y = 0 is the southern child, i.e., the lower half of the raster
+        const auto south_east = nucleus::utils::tile_conversion::descendant_height(ancestor, tile::Id { 1, { 1, 0 } }, 1);
+        CHECK(south_east.size() == ancestor.size());
+        CHECK(south_east.pixel({ 0, 0 }) == ancestor.pixel({ 32, 32 }));
+        CHECK(south_east.pixel({ 64, 64 }) == ancestor.pixel({ 64, 64 }));
+        CHECK(south_east.pixel({ 2, 4 }) == ancestor.pixel({ 33, 34 }));
+        CHECK(south_east.pixel({ 1, 0 }) == uint16_t(ancestor.pixel({ 32, 32 }) + 1));
+
+        const auto unchanged = nucleus::utils::tile_conversion::descendant_height(ancestor, tile::Id { 1, { 1, 0 } }, 0);
+        CHECK(unchanged.buffer() == ancestor.buffer());
+    }
+
+    SECTION("cut out descendant from ancestor ortho")
+    {
+        // upper left quadrant (north west) is red, the rest black
+        nucleus::Raster<glm::u8vec4> ancestor({ 4, 4 }, { 0, 0, 0, 255 });
+        for (unsigned y = 0; y < 2; ++y) {
+            for (unsigned x = 0; x < 2; ++x)
+                ancestor.pixel({ x, y }) = { 255, 0, 0, 255 };
+        }
+        const auto north_west = nucleus::utils::tile_conversion::descendant_ortho(ancestor, tile::Id { 1, { 0, 1 } }, 1);
+        CHECK(north_west.size() == ancestor.size());
+        CHECK(north_west.pixel({ 0, 0 }) == glm::u8vec4(255, 0, 0, 255));
+        CHECK(north_west.pixel({ 1, 1 }) == glm::u8vec4(255, 0, 0, 255));
+
+        const auto south_east = nucleus::utils::tile_conversion::descendant_ortho(ancestor, tile::Id { 1, { 1, 0 } }, 1);
+        CHECK(south_east.pixel({ 2, 2 }) == glm::u8vec4(0, 0, 0, 255));
+        CHECK(south_east.pixel({ 3, 3 }) == glm::u8vec4(0, 0, 0, 255));
+    }
+
+    SECTION("decode height png directly to raster unsigned short")
+    {
+        const auto bytes = test_file("test-tile.png");
+        const auto direct = nucleus::utils::image_loader::height(bytes);
+        const auto via_rgba = nucleus::utils::tile_conversion::to_u16raster(nucleus::utils::image_loader::rgba8(bytes));
+        CHECK(direct.size() == glm::uvec2(64, 64));
+        CHECK(direct.buffer() == via_rgba.buffer());
+        CHECK(direct.buffer()[0] == 23 * 256 + 216);
+        CHECK(direct.buffer()[1] == 22 * 256 + 33);
+    }
+
+    SECTION("decode ortho jpeg directly to colour texture")
+    {
+        using Format = nucleus::utils::ColourTexture::Format;
+        const auto bytes = test_file("test-tile_ortho.jpeg");
+        const auto rgba = nucleus::utils::image_loader::rgba8(bytes);
+        for (const auto format : { Format::Uncompressed_RGBA, Format::DXT1, Format::ETC1 }) {
+            const auto direct = nucleus::utils::image_loader::colour_texture(bytes, format);
+            const auto via_raster = nucleus::utils::ColourTexture(rgba, format);
+            CHECK(direct.width() == 256);
+            CHECK(direct.height() == 256);
+            CHECK(direct.format() == format);
+            REQUIRE(direct.n_bytes() == via_raster.n_bytes());
+            CHECK(std::equal(direct.data(), direct.data() + direct.n_bytes(), via_raster.data()));
+        }
+    }
+
+    SECTION("decoding benchmark")
+    {
+        const auto height_bytes = test_file("test-tile.png");
+        const auto ortho_bytes = test_file("test-tile_ortho.jpeg");
+        BENCHMARK("height: rgba8 + to_u16raster")
+        {
+            return nucleus::utils::tile_conversion::to_u16raster(nucleus::utils::image_loader::rgba8(height_bytes));
+        };
+        BENCHMARK("height: direct") { return nucleus::utils::image_loader::height(height_bytes); };
+        BENCHMARK("ortho: rgba8 + ColourTexture (DXT1)")
+        {
+            return nucleus::utils::ColourTexture(nucleus::utils::image_loader::rgba8(ortho_bytes), nucleus::utils::ColourTexture::Format::DXT1);
+        };
+        BENCHMARK("ortho: direct (DXT1)")
+        {
+            return nucleus::utils::image_loader::colour_texture(ortho_bytes, nucleus::utils::ColourTexture::Format::DXT1);
+        };
+    }
 }
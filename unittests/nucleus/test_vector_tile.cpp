@@ -16,7 +16,12 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *****************************************************************************/
 
+#include <thread>
+#include <vector>
+
+#include <QFile>
 #include <QSignalSpy>
+#include <catch2/benchmark/catch_benchmark.hpp>
 #include <catch2/catch_test_macros.hpp>
 
 #include "nucleus/tile_scheduler/TileLoadService.h"
@@ -27,6 +32,8 @@
 
 TEST_CASE("nucleus/vector_tiles")
 {
+    nucleus::vectortile::VectorTileManager manager;
+
     SECTION("PBF parsing")
     {
         QString filepath = QString("%1%2").arg(ALP_TEST_DATA_DIR, "vectortile.mvt");
@@ -37,12 +44,13 @@ TEST_CASE("nucleus/vector_tiles")
         CHECK(data.size() > 0);
         const auto id = tile::Id { .zoom_level = 13, .coords = { 4384, 2878 }, .scheme = tile::Scheme::SlippyMap }.to(tile::Scheme::Tms);
 
-        const auto vectortile = nucleus::vectortile::VectorTileManager::to_vector_tile(id, data, nullptr);
+        const auto vectortile = manager.to_vector_tile(id, data, nullptr);
 
         REQUIRE(vectortile->contains(nucleus::vectortile::FeatureType::Peak));
 
         // std::cout << vectortile.at(nucleus::vectortile::FeatureType::Peak).size() << std::endl;
         CHECK(vectortile->at(nucleus::vectortile::FeatureType::Peak).size() == 16);
+        CHECK(manager.to_vector_tiles({ id }, { &data }, nullptr) == std::vector { vectortile });
 
         for (const auto& peak : vectortile->at(nucleus::vectortile::FeatureType::Peak)) {
 
@@ -58,6 +66,141 @@ TEST_CASE("nucleus/vector_tiles")
         }
     }
 
+    SECTION("features are shared and released with their tiles")
+    {
+        QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "vectortile.mvt"));
+        const auto open = file.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        REQUIRE(open);
+        const QByteArray data = file.readAll();
+        const auto id = tile::Id { .zoom_level = 14, .coords = { 8769, 5757 }, .scheme = tile::Scheme::SlippyMap }.to(tile::Scheme::Tms);
+        const auto neighbour = tile::Id { id.zoom_level, id.coords + glm::uvec2(1, 0) };
+        const auto descendant = id.children()[2].children()[1]; // beyond max_zoom, no data
+
+        const auto tile = manager.to_vector_tile(id, data, nullptr);
+        REQUIRE(tile->contains(nucleus::vectortile::FeatureType::Peak));
+        const auto n_peaks = tile->at(nucleus::vectortile::FeatureType::Peak).size();
+        CHECK(manager.n_tiles() == 1);
+        CHECK(manager.n_features() == n_peaks);
+
+        // same features in another tile (the data is the same) -> parsed once
+        const auto neighbour_tile = manager.to_vector_tile(neighbour, data, nullptr);
+        CHECK(manager.n_tiles() == 2);
+        CHECK(manager.n_features() == n_peaks);
+        CHECK(neighbour_tile->at(nucleus::vectortile::FeatureType::Peak) == tile->at(nucleus::vectortile::FeatureType::Peak));
+
+        // descendants without data share the tile of their ancestor at max_zoom
+        CHECK(manager.to_vector_tile(descendant, QByteArray(), nullptr) == tile);
+        CHECK(manager.n_tiles() == 2);
+        CHECK(manager.find(descendant) == tile);
+
+        const auto& peak = *tile->at(nucleus::vectortile::FeatureType::Peak).begin();
+        CHECK(manager.feature(peak->id) == peak);
+
+        manager.release(id);
+        CHECK(manager.find(id) == nullptr);
+        CHECK(manager.n_tiles() == 2); // still held by the descendant
+        manager.release(descendant);
+        CHECK(manager.n_tiles() == 1);
+        CHECK(manager.n_features() == n_peaks);
+        manager.release(neighbour);
+        CHECK(manager.n_tiles() == 0);
+        CHECK(manager.n_features() == 0);
+        CHECK(manager.feature(peak->id) == nullptr);
+        CHECK(tile->at(nucleus::vectortile::FeatureType::Peak).size() == n_peaks); // handed out tiles stay valid
+
+        // acquiring again replaces the previous acquisition
+        manager.to_vector_tile(id, data, nullptr);
+        const auto reacquired = manager.to_vector_tile(id, data, nullptr);
+        REQUIRE(reacquired->contains(nucleus::vectortile::FeatureType::Peak));
+        CHECK(reacquired->at(nucleus::vectortile::FeatureType::Peak).size() == n_peaks);
+        CHECK(manager.find(id) == reacquired);
+        CHECK(manager.n_tiles() == 1);
+        CHECK(manager.n_features() == n_peaks);
+        manager.release(id);
+        CHECK(manager.n_tiles() == 0);
+        CHECK(manager.n_features() == 0);
+        manager.release(id); // not acquired, no-op
+
+        // batches may list descendants before their ancestor
+        {
+            const auto ancestor = id;
+            const auto sibling_descendant = id.children()[0].children()[3];
+            const std::vector<tile::Id> batch_ids = { descendant, sibling_descendant, neighbour, ancestor };
+            const QByteArray no_data;
+            const std::vector<const QByteArray*> batch_data = { &no_data, &no_data, &data, &data };
+            for (unsigned round = 0; round < 10; ++round) { // scheduling differs between runs
+                nucleus::vectortile::VectorTileManager batch_manager;
+                const auto batch = batch_manager.to_vector_tiles(batch_ids, batch_data, nullptr);
+                REQUIRE(batch.size() == 4);
+                REQUIRE(batch[3]->contains(nucleus::vectortile::FeatureType::Peak));
+                CHECK(batch[3]->at(nucleus::vectortile::FeatureType::Peak).size() == n_peaks);
+                CHECK(batch[0] == batch[3]);
+                CHECK(batch[1] == batch[3]);
+                CHECK(batch_manager.find(descendant) == batch[3]);
+                CHECK(batch_manager.find(sibling_descendant) == batch[3]);
+                CHECK(batch_manager.n_tiles() == 2);
+            }
+        }
+
+        // concurrent parsing
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t]() {
+                for (unsigned i = 0; i < 16; ++i)
+                    (void)manager.to_vector_tile(tile::Id { id.zoom_level, id.coords + glm::uvec2(i, t) }, data, nullptr);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        CHECK(manager.n_tiles() == 64);
+        CHECK(manager.n_features() == n_peaks);
+        for (unsigned t = 0; t < 4; ++t) {
+            for (unsigned i = 0; i < 16; ++i)
+                manager.release(tile::Id { id.zoom_level, id.coords + glm::uvec2(i, t) });
+        }
+        CHECK(manager.n_tiles() == 0);
+        CHECK(manager.n_features() == 0);
+    }
+
+    SECTION("benchmark")
+    {
+        QFile file(QString("%1%2").arg(ALP_TEST_DATA_DIR, "vectortile.mvt"));
+        const auto open = file.open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+        REQUIRE(open);
+        const QByteArray data = file.readAll();
+        const auto id = tile::Id { .zoom_level = 13, .coords = { 4384, 2878 }, .scheme = tile::Scheme::SlippyMap }.to(tile::Scheme::Tms);
+
+        // the same data under 64 ids. features are known after the first tile, which is what happens when zooming in.
+        std::vector<tile::Id> ids;
+        for (unsigned i = 0; i < 64; ++i)
+            ids.push_back(tile::Id { id.zoom_level, id.coords + glm::uvec2(i % 8, i / 8) });
+        const std::vector<const QByteArray*> tile_data(ids.size(), &data);
+
+        BENCHMARK("mapbox::vector_tile::buffer (std::string copy)")
+        {
+            std::string copy = data.toStdString();
+            mapbox::vector_tile::buffer tile(copy);
+            return tile.getLayer("Peak").featureCount();
+        };
+        BENCHMARK("to_vector_tile (one tile)")
+        {
+            nucleus::vectortile::VectorTileManager m;
+            return m.to_vector_tile(id, data, nullptr);
+        };
+        BENCHMARK("to_vector_tile (64 tiles, serial)")
+        {
+            nucleus::vectortile::VectorTileManager m;
+            for (const auto& tile_id : ids)
+                (void)m.to_vector_tile(tile_id, data, nullptr);
+            return m.n_tiles();
+        };
+        BENCHMARK("to_vector_tiles (64 tiles, worker pool)")
+        {
+            nucleus::vectortile::VectorTileManager m;
+            return m.to_vector_tiles(ids, tile_data, nullptr).size();
+        };
+    }
+
     SECTION("Tile download")
     {
         const auto id = tile::Id { .zoom_level = 13, .coords = { 4384, 2878 }, .scheme = tile::Scheme::SlippyMap }.to(tile::Scheme::Tms);
@@ -116,7 +259,7 @@ TEST_CASE("nucleus/vector_tiles")
 
             REQUIRE(tile.data->size() > 0);
 
-            const auto vectortile = nucleus::vectortile::VectorTileManager::to_vector_tile(id, *tile.data, nullptr);
+            const auto vectortile = manager.to_vector_tile(id, *tile.data, nullptr);
 
             REQUIRE(vectortile->contains(nucleus::vectortile::FeatureType::Peak));
 
@@ -18,6 +18,8 @@
  *****************************************************************************/
 
 #include "Texture.h"
+
+#include <algorithm>
 #include <QDebug>
 
 namespace webgpu::raii {
@@ -112,18 +114,24 @@ void Texture::write(WGPUQueue queue, const nucleus::utils::ColourTexture& data,
     assert(static_cast<uint32_t>(data.height()) == m_descriptor.size.height);
     assert(data.format() == nucleus::utils::ColourTexture::Format::Uncompressed_RGBA); // TODO compressed textures
 
-    WGPUImageCopyTexture image_copy_texture {};
-    image_copy_texture.texture = m_handle;
-    image_copy_texture.aspect = WGPUTextureAspect::WGPUTextureAspect_All;
-    image_copy_texture.mipLevel = 0;
-    image_copy_texture.origin = { 0, 0, layer };
-
-    WGPUTextureDataLayout texture_data_layout {};
-    texture_data_layout.bytesPerRow = 4 * data.width(); // for uncompressed RGBA
-    texture_data_layout.rowsPerImage = data.height();
-    texture_data_layout.offset = 0;
-    WGPUExtent3D copy_extent { m_descriptor.size.width, m_descriptor.size.height, 1 };
-    wgpuQueueWriteTexture(queue, &image_copy_texture, data.data(), data.n_bytes(), &texture_data_layout, &copy_extent);
+    // every level of the descriptor must be written. unwritten levels stay zero and sample as black, the sampler's
+    // lodMaxClamp covers the whole chain (use ColourTexture::MipMaps::Full for textures with mip maps).
+    assert(uint32_t(data.n_mip_levels()) == m_descriptor.mipLevelCount);
+    const auto n_levels = std::min(uint32_t(data.n_mip_levels()), m_descriptor.mipLevelCount);
+    for (uint32_t level = 0; level < n_levels; ++level) {
+        WGPUImageCopyTexture image_copy_texture {};
+        image_copy_texture.texture = m_handle;
+        image_copy_texture.aspect = WGPUTextureAspect::WGPUTextureAspect_All;
+        image_copy_texture.mipLevel = level;
+        image_copy_texture.origin = { 0, 0, layer };
+
+        WGPUTextureDataLayout texture_data_layout {};
+        texture_data_layout.bytesPerRow = 4 * data.width(level); // for uncompressed RGBA
+        texture_data_layout.rowsPerImage = data.height(level);
+        texture_data_layout.offset = 0;
+        WGPUExtent3D copy_extent { data.width(level), data.height(level), 1 };
+        wgpuQueueWriteTexture(queue, &image_copy_texture, data.data(level), data.n_bytes(level), &texture_data_layout, &copy_extent);
+    }
 }
 
 void Texture::copy_to_texture(WGPUCommandEncoder encoder, uint32_t source_layer, const Texture& target_texture, uint32_t target_layer) const
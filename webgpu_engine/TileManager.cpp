@@ -42,12 +42,12 @@ void TileManager::init(WGPUDevice device, WGPUQueue queue, const PipelineManager
 {
     m_renderer = std::make_unique<TileRendererInstancedSingleArrayMultiCall>(device, queue, pipeline_manager, compute_graph);
     // m_renderer = std::make_unique<TileRendererInstancedSingleArray>(device, queue, pipeline_manager);
-    m_renderer->init(glm::uvec2(HEIGHTMAP_RESOLUTION), glm::uvec2(ORTHO_RESOLUTION), m_loaded_tiles.size(), N_EDGE_VERTICES);
+    m_renderer->init(glm::uvec2(HEIGHTMAP_RESOLUTION), glm::uvec2(ORTHO_RESOLUTION), m_tile_slots.capacity(), N_EDGE_VERTICES);
 }
 
 template <typename T> bool compareTileSetPair(std::pair<T, const TileSet*> t1, std::pair<T, const TileSet*> t2) { return (t1.first < t2.first); }
 
-const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::generate_tilelist(const nucleus::camera::Definition& camera) const {
+const nucleus::tile_scheduler::DrawListGenerator::TileSet TileManager::generate_tilelist(const nucleus::camera::Definition& camera) {
     return m_draw_list_generator.generate_for(camera);
 }
 
@@ -83,16 +83,17 @@ void TileManager::draw(WGPURenderPassEncoder render_pass, const nucleus::camera:
 
 void TileManager::remove_tile(const tile::Id& tile_id)
 {
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile_id);
-    assert(t != m_loaded_tiles.end()); // removing a tile that's not here. likely there is a race.
-    *t = tile::Id { unsigned(-1), {} };
+    const auto layer_index = m_tile_slots.free(tile_id);
+    assert(layer_index.has_value()); // removing a tile that's not here. likely there is a race.
+    if (!layer_index.has_value())
+        return;
     m_draw_list_generator.remove_tile(tile_id);
 
-    // clear slot
-    // or remove from list and free resources
-    const auto found_tile = std::find_if(m_gpu_tiles.begin(), m_gpu_tiles.end(), [&tile_id](const TileSet& tileset) { return tileset.tile_id == tile_id; });
-    if (found_tile != m_gpu_tiles.end())
-        m_gpu_tiles.erase(found_tile);
+    // move the last tile into the gap
+    const auto index = m_gpu_tile_index[*layer_index];
+    m_gpu_tiles[index] = m_gpu_tiles.back();
+    m_gpu_tile_index[m_gpu_tiles[index].texture_layer] = index;
+    m_gpu_tiles.pop_back();
 
     emit tiles_changed();
 }
@@ -104,8 +105,10 @@ void TileManager::set_aabb_decorator(const nucleus::tile_scheduler::utils::AabbD
 
 void TileManager::set_quad_limit(unsigned int new_limit)
 {
-    m_loaded_tiles.resize(new_limit * 4);
-    std::fill(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
+    m_tile_slots = nucleus::utils::TileSlotAllocator(new_limit * 4);
+    m_gpu_tiles.clear();
+    m_gpu_tiles.reserve(new_limit * 4);
+    m_gpu_tile_index.assign(new_limit * 4, 0);
 }
 
 void TileManager::add_tile(
@@ -116,15 +119,17 @@ void TileManager::add_tile(
     tileset.bounds = tile::SrsBounds(bounds);
 
     // find empty spot and upload texture
-    const auto t = std::find(m_loaded_tiles.begin(), m_loaded_tiles.end(), tile::Id { unsigned(-1), {} });
-    assert(t != m_loaded_tiles.end());
-    *t = id;
-    const auto layer_index = unsigned(t - m_loaded_tiles.begin());
-    tileset.texture_layer = layer_index;
+    assert(!m_tile_slots.contains(id));
+    const auto layer_index = m_tile_slots.allocate(id);
+    assert(layer_index.has_value());
+    if (!layer_index.has_value())
+        return;
+    tileset.texture_layer = *layer_index;
 
-    m_renderer->write_tile(ortho_texture, height_map, layer_index);
+    m_renderer->write_tile(ortho_texture, height_map, *layer_index);
 
     // add to m_gpu_tiles
+    m_gpu_tile_index[*layer_index] = m_gpu_tiles.size();
     m_gpu_tiles.push_back(tileset);
     m_draw_list_generator.add_tile(id);
 
@@ -202,13 +207,14 @@ void TileRendererInstancedSingleArray::init(glm::uvec2 height_resolution, glm::u
 
     m_heightmap_textures = std::make_unique<webgpu::raii::TextureWithSampler>(m_device, height_texture_desc, height_sampler_desc);
 
-    // TODO mipmaps and compression
+    // TODO compression (mip chain is precomputed on the cpu, see ColourTexture::MipMaps)
+    const auto ortho_mip_levels = uint32_t(nucleus::utils::ColourTexture::mip_chain_length(ortho_resolution));
     WGPUTextureDescriptor ortho_texture_desc {};
     ortho_texture_desc.label = "ortho texture";
     ortho_texture_desc.dimension = WGPUTextureDimension::WGPUTextureDimension_2D;
     // TODO: array layers might become larger than allowed by graphics API
     ortho_texture_desc.size = { uint32_t(ortho_resolution.x), uint32_t(ortho_resolution.y), uint32_t(num_layers) };
-    ortho_texture_desc.mipLevelCount = 1;
+    ortho_texture_desc.mipLevelCount = ortho_mip_levels;
     ortho_texture_desc.sampleCount = 1;
     ortho_texture_desc.format = WGPUTextureFormat::WGPUTextureFormat_RGBA8Unorm;
     ortho_texture_desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
@@ -222,7 +228,7 @@ void TileRendererInstancedSingleArray::init(glm::uvec2 height_resolution, glm::u
     ortho_sampler_desc.minFilter = WGPUFilterMode::WGPUFilterMode_Linear;
     ortho_sampler_desc.mipmapFilter = WGPUMipmapFilterMode::WGPUMipmapFilterMode_Linear;
     ortho_sampler_desc.lodMinClamp = 0.0f;
-    ortho_sampler_desc.lodMaxClamp = 1.0f;
+    ortho_sampler_desc.lodMaxClamp = float(ortho_mip_levels);
     ortho_sampler_desc.compare = WGPUCompareFunction::WGPUCompareFunction_Undefined;
     ortho_sampler_desc.maxAnisotropy = 1;
 
@@ -354,13 +360,14 @@ void TileRendererInstancedSingleArrayMultiCall::init(glm::uvec2 height_resolutio
 
         m_heightmap_textures.emplace_back(std::make_unique<webgpu::raii::TextureWithSampler>(m_device, height_texture_desc, height_sampler_desc));
 
-        // TODO mipmaps and compression
+        // TODO compression (mip chain is precomputed on the cpu, see ColourTexture::MipMaps)
+        const auto ortho_mip_levels = uint32_t(nucleus::utils::ColourTexture::mip_chain_length(ortho_resolution));
         WGPUTextureDescriptor ortho_texture_desc {};
         ortho_texture_desc.label = "ortho texture";
         ortho_texture_desc.dimension = WGPUTextureDimension::WGPUTextureDimension_2D;
         // TODO: array layers might become larger than allowed by graphics API
         ortho_texture_desc.size = { uint32_t(ortho_resolution.x), uint32_t(ortho_resolution.y), uint32_t(m_num_layers_per_texture) };
-        ortho_texture_desc.mipLevelCount = 1;
+        ortho_texture_desc.mipLevelCount = ortho_mip_levels;
         ortho_texture_desc.sampleCount = 1;
         ortho_texture_desc.format = WGPUTextureFormat::WGPUTextureFormat_RGBA8Unorm;
         ortho_texture_desc.usage = WGPUTextureUsage_TextureBinding | WGPUTextureUsage_CopyDst;
@@ -374,7 +381,7 @@ void TileRendererInstancedSingleArrayMultiCall::init(glm::uvec2 height_resolutio
         ortho_sampler_desc.minFilter = WGPUFilterMode::WGPUFilterMode_Linear;
         ortho_sampler_desc.mipmapFilter = WGPUMipmapFilterMode::WGPUMipmapFilterMode_Linear;
         ortho_sampler_desc.lodMinClamp = 0.0f;
-        ortho_sampler_desc.lodMaxClamp = 1.0f;
+        ortho_sampler_desc.lodMaxClamp = float(ortho_mip_levels);
         ortho_sampler_desc.compare = WGPUCompareFunction::WGPUCompareFunction_Undefined;
         ortho_sampler_desc.maxAnisotropy = 1;
 
@@ -29,6 +29,7 @@
 #include <QObject>
 #include <nucleus/tile_scheduler/DrawListGenerator.h>
 #include <nucleus/tile_scheduler/tile_types.h>
+#include <nucleus/utils/SlotAllocator.h>
 #include <webgpu/raii/BindGroup.h>
 #include <webgpu/raii/BindGroupLayout.h>
 #include <webgpu/raii/TextureWithSampler.h>
@@ -129,7 +130,7 @@ public:
     void draw(WGPURenderPassEncoder render_pass, const nucleus::camera::Definition& camera,
         const nucleus::tile_scheduler::DrawListGenerator::TileSet& draw_tiles, bool sort_tiles, glm::dvec3 sort_position) const;
 
-    const nucleus::tile_scheduler::DrawListGenerator::TileSet generate_tilelist(const nucleus::camera::Definition& camera) const;
+    const nucleus::tile_scheduler::DrawListGenerator::TileSet generate_tilelist(const nucleus::camera::Definition& camera);
     const nucleus::tile_scheduler::DrawListGenerator::TileSet cull(const nucleus::tile_scheduler::DrawListGenerator::TileSet& tileset, const nucleus::camera::Frustum& frustum) const;
 
     void set_permissible_screen_space_error(float new_permissible_screen_space_error);
@@ -150,9 +151,10 @@ private:
     static constexpr auto ORTHO_RESOLUTION = 256;
     static constexpr auto HEIGHTMAP_RESOLUTION = 65;
 
-    std::vector<tile::Id> m_loaded_tiles;
+    nucleus::utils::TileSlotAllocator m_tile_slots; // slots are texture layers
 
-    std::vector<TileSet> m_gpu_tiles;
+    std::vector<TileSet> m_gpu_tiles; // dense, in no particular order
+    std::vector<size_t> m_gpu_tile_index; // texture layer -> index in m_gpu_tiles
     unsigned m_tiles_per_set = 1;
     nucleus::tile_scheduler::DrawListGenerator m_draw_list_generator;
     const nucleus::tile_scheduler::DrawListGenerator::TileSet m_last_draw_list; // buffer last generated draw list
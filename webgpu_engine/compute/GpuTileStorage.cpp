@@ -19,7 +19,6 @@
 #include "GpuTileStorage.h"
 
 #include "nucleus/utils/image_loader.h"
-#include "nucleus/utils/tile_conversion.h"
 
 namespace webgpu_engine::compute {
 
@@ -28,7 +27,7 @@ TileStorageTexture::TileStorageTexture(WGPUDevice device, const glm::uvec2& reso
     , m_queue { wgpuDeviceGetQueue(device) }
     , m_resolution { resolution }
     , m_capacity { capacity }
-    , m_layers_used(m_capacity, false)
+    , m_layers(unsigned(m_capacity))
 {
     WGPUTextureDescriptor height_texture_desc {};
     height_texture_desc.label = "compute storage texture";
@@ -60,50 +59,39 @@ void TileStorageTexture::store(size_t layer, const QByteArray& data)
     assert(layer < m_capacity);
 
     // convert to raster and store in texture array
-    const nucleus::Raster<glm::u8vec4> height_image = nucleus::utils::image_loader::rgba8(data);
-    const auto heightraster = nucleus::utils::tile_conversion::to_u16raster(height_image);
+    const auto heightraster = nucleus::utils::image_loader::height(data);
     m_texture_array->texture().write(m_queue, heightraster, uint32_t(layer));
 
-    set_layer_used(layer);
+    m_layers.allocate(unsigned(layer)); // no-op if it was in use already
 }
 
 size_t TileStorageTexture::store(const QByteArray& data)
 {
-    size_t layer_index = find_unused_layer_index();
+    size_t layer_index = reserve();
     store(layer_index, data);
     return layer_index;
 }
 
 void TileStorageTexture::reserve(size_t layer)
 {
-    assert(!m_layers_used[layer]);
-
-    set_layer_used(layer);
+    assert(layer < m_capacity);
+    [[maybe_unused]] const auto was_free = m_layers.allocate(unsigned(layer));
+    assert(was_free);
 }
 
 size_t TileStorageTexture::reserve()
 {
-    size_t layer_index = find_unused_layer_index();
-    set_layer_used(layer_index);
-    return layer_index;
+    const auto layer_index = m_layers.allocate();
+    assert(layer_index.has_value());
+    return *layer_index;
 }
 
-void TileStorageTexture::clear()
-{
-    m_num_stored = 0;
-    m_layers_used.clear();
-    m_layers_used.resize(m_capacity, false);
-}
+void TileStorageTexture::clear() { m_layers.clear(); }
 
 void TileStorageTexture::clear(size_t layer)
 {
     assert(layer < m_capacity);
-
-    // update used layers
-    if (m_layers_used.at(layer)) {
-        m_num_stored--;
-        m_layers_used[layer] = false;
-    }
+    m_layers.free(unsigned(layer));
 }
 
 size_t TileStorageTexture::width() const { return m_texture_array->texture().descriptor().size.width; }
@@ -114,35 +102,12 @@ size_t TileStorageTexture::capacity() const { return m_capacity; }
 
 std::vector<uint32_t> TileStorageTexture::used_layer_indices() const
 {
-    std::vector<uint32_t> indices;
-    indices.reserve(m_capacity);
-    for (uint32_t i = 0; i < m_capacity; i++) {
-        if (m_layers_used.at(i)) {
-            indices.emplace_back(i);
-        }
-    }
-    return indices;
+    const auto used_slots = m_layers.used_slots();
+    return { used_slots.cbegin(), used_slots.cend() };
 }
 
 webgpu::raii::TextureWithSampler& TileStorageTexture::texture() { return *m_texture_array; }
 
 const webgpu::raii::TextureWithSampler& TileStorageTexture::texture() const { return *m_texture_array; }
 
-size_t TileStorageTexture::find_unused_layer_index() const
-{
-    assert(m_num_stored < m_capacity);
-
-    auto found_at = std::find(m_layers_used.begin(), m_layers_used.end(), false);
-    return found_at - m_layers_used.begin();
-}
-
-void TileStorageTexture::set_layer_used(size_t layer)
-{
-    // update used layers
-    if (!m_layers_used.at(layer)) {
-        m_num_stored++;
-        m_layers_used[layer] = true;
-    }
-}
-
 } // namespace webgpu_engine::compute
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include <nucleus/utils/SlotAllocator.h>
 #include <webgpu/raii/TextureWithSampler.h>
 
 namespace webgpu_engine::compute {
@@ -44,17 +45,12 @@ public:
     webgpu::raii::TextureWithSampler& texture();
     const webgpu::raii::TextureWithSampler& texture() const;
 
-private:
-    size_t find_unused_layer_index() const;
-    void set_layer_used(size_t layer);
-
 private:
     WGPUDevice m_device;
     WGPUQueue m_queue;
     glm::uvec2 m_resolution;
     size_t m_capacity;
-    size_t m_num_stored = 0; // number of stored textures
-    std::vector<bool> m_layers_used; // CPU buffer for tracking which layers are currently used
+    nucleus::utils::SlotAllocator m_layers; // CPU side tracking of the used layers
     std::unique_ptr<webgpu::raii::TextureWithSampler> m_texture_array;
 };
 